@@ -1,8 +1,132 @@
 #include "AbstractInterface.hpp"
 
+#include <algorithm>
+#include <stdexcept>
+
 
 namespace sempr { namespace gui {
 
+namespace {
+    // helper: hand the entries of the vector to the callback in chunks
+    template <class T, class Callback>
+    void splitIntoChunks(const std::vector<T>& all, Callback callback, size_t chunkSize)
+    {
+        if (chunkSize == 0) chunkSize = 1;
+
+        for (size_t first = 0; first < all.size(); first += chunkSize)
+        {
+            size_t last = std::min(first + chunkSize, all.size());
+            std::vector<T> chunk(all.begin() + first, all.begin() + last);
+            if (!callback(chunk)) return;
+        }
+    }
+}
+
+
+void ECData::setComponentJSON(const std::string& json)
+{
+    componentJSON = json;
+    componentType = polymorphicNameFromJSON(json);
+    jsonHash = hashJSON(json);
+    hasJSON = true;
+    isPatch = false;
+    patchBaseHash = 0;
+}
+
+ECData ECData::metadataOnly() const
+{
+    ECData meta(*this);
+    meta.componentJSON.clear();
+    meta.hasJSON = false;
+    meta.isPatch = false;
+    meta.patchBaseHash = 0;
+    return meta;
+}
+
+uint64_t ECData::hashJSON(const std::string& json)
+{
+    // FNV-1a, which gives the same results on every platform
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : json)
+    {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+
+std::string polymorphicNameFromJSON(const std::string& json)
+{
+    // cereal writes the name of the outermost pointer first, so the first
+    // occurence is the one we want.
+    const std::string key = "\"polymorphic_name\"";
+    auto pos = json.find(key);
+    if (pos == std::string::npos) return "";
+
+    auto colon = json.find(':', pos + key.size());
+    if (colon == std::string::npos) return "";
+    auto begin = json.find('"', colon);
+    if (begin == std::string::npos) return "";
+    auto end = json.find('"', begin + 1);
+    if (end == std::string::npos) return "";
+
+    return json.substr(begin + 1, end - begin - 1);
+}
+
+
+GraphDiff AbstractInterface::getReteNetworkDiff(uint64_t sinceRevision)
+{
+    auto diff = GraphDiff::of(getReteNetworkRepresentation());
+    diff.fromRevision = sinceRevision;
+    return diff;
+}
+
+
+ECData AbstractInterface::getComponent(const ECData& which)
+{
+    for (auto& data : listEntityComponentPairs())
+    {
+        if (data.entityId == which.entityId &&
+            data.componentId == which.componentId &&
+            data.tag == which.tag)
+        {
+            return data;
+        }
+    }
+
+    throw std::runtime_error("component " + which.componentId +
+                             " of entity " + which.entityId + " not found");
+}
+
+
+std::vector<ECData> AbstractInterface::getComponents(const std::vector<ECData>& which)
+{
+    std::vector<ECData> found;
+    for (auto& data : which)
+    {
+        try {
+            found.push_back(getComponent(data));
+        } catch (std::runtime_error&) {
+            // not found, leave it out
+        }
+    }
+    return found;
+}
+
+
+void AbstractInterface::listEntityComponentPairsChunked(
+        ec_chunk_callback_t callback, size_t chunkSize)
+{
+    splitIntoChunks(listEntityComponentPairs(), callback, chunkSize);
+}
+
+void AbstractInterface::listTriplesChunked(
+        triple_chunk_callback_t callback, size_t chunkSize)
+{
+    splitIntoChunks(listTriples(), callback, chunkSize);
+}
+
 
 void AbstractInterface::setUpdateCallback(callback_t cb)
 {
@@ -9,6 +9,9 @@
 #include <memory>
 #include <mutex>
 #include <chrono>
+#include <cstdint>
+
+#include <cereal/cereal.hpp>
 
 #include "ReteVisualSerialization.hpp"
 #include "Rule.hpp"
@@ -30,6 +33,12 @@ namespace sempr { namespace gui {
     data-exchange parts/responsibilities. Most importantly, it does not hold
     any object pointers, which prevents an implementation of AbstractInterface
     to take wrong shortcuts. (Same for the gui part).
+
+    The JSON representation can be large. An ECData can therefore also be
+    "metadata only" (hasJSON == false): Without the componentJSON, but with
+    the type of the component and a hash of the JSON, which allows to tell if
+    a copy fetched earlier (see AbstractInterface::getComponent) is still up
+    to date.
 */
 struct ECData {
     std::string entityId;
@@ -37,8 +46,56 @@ struct ECData {
     std::string componentJSON;
     std::string tag;
     bool isComponentMutable;
+
+    std::string componentType; // polymorphic type name from the json
+    uint64_t jsonHash = 0;     // hash of componentJSON, 0 if unknown
+    bool hasJSON = true;       // false if componentJSON was left out
+
+    // If set, componentJSON does not hold the json but a JsonDelta to the
+    // version with the hash patchBaseHash. jsonHash is still the hash of the
+    // complete new json.
+    bool isPatch = false;
+    uint64_t patchBaseHash = 0;
+
+    /**
+        Sets the componentJSON, and the componentType and jsonHash derived
+        from it.
+    */
+    void setComponentJSON(const std::string& json);
+
+    /**
+        Returns a copy without the componentJSON.
+    */
+    ECData metadataOnly() const;
+
+    /**
+        The hash used for jsonHash.
+    */
+    static uint64_t hashJSON(const std::string& json);
+
+    template <class Archive>
+    void serialize(Archive& ar)
+    {
+        ar( cereal::make_nvp<Archive>("entityId", entityId),
+            cereal::make_nvp<Archive>("componentId", componentId),
+            cereal::make_nvp<Archive>("componentJSON", componentJSON),
+            cereal::make_nvp<Archive>("tag", tag),
+            cereal::make_nvp<Archive>("isComponentMutable", isComponentMutable),
+            cereal::make_nvp<Archive>("componentType", componentType),
+            cereal::make_nvp<Archive>("jsonHash", jsonHash),
+            cereal::make_nvp<Archive>("hasJSON", hasJSON),
+            cereal::make_nvp<Archive>("isPatch", isPatch),
+            cereal::make_nvp<Archive>("patchBaseHash", patchBaseHash) );
+    }
 };
 
+/**
+    Reads the polymorphic type name of the outermost pointer from a json
+    representation created by cereal, without parsing all of it.
+    Returns an empty string if there is none.
+*/
+std::string polymorphicNameFromJSON(const std::string& json);
+
 
 /**
     A struct carrying information about any kind of error/exception/warning/..
@@ -87,6 +144,10 @@ public:
     typedef std::function<void(sempr::Triple, Notification)> triple_callback_t;
     typedef std::function<void(LogData)> logging_callback_t;
 
+    // for chunked listings. Return false to stop the listing early.
+    typedef std::function<bool(const std::vector<ECData>&)> ec_chunk_callback_t;
+    typedef std::function<bool(const std::vector<sempr::Triple>&)> triple_chunk_callback_t;
+
 
     /**
         Returns a simplified representation of the internal rete network --
@@ -94,6 +155,14 @@ public:
     */
     virtual Graph getReteNetworkRepresentation() = 0;
 
+    /**
+        Returns the changes of the rete network since the given revision,
+        which is 0 or the toRevision of a previous diff. If that revision is
+        not known (anymore), the diff is complete.
+        The default implementation always returns the complete network.
+    */
+    virtual GraphDiff getReteNetworkDiff(uint64_t sinceRevision);
+
     /**
         Returns a simplified representation of an explanation -- again,
         basically ids with labels.
@@ -118,6 +187,36 @@ public:
     */
     virtual std::vector<sempr::Triple> listTriples() = 0;
 
+    /**
+        Same as listEntityComponentPairs / listTriples, but the result is
+        handed to the callback in chunks of at most chunkSize entries, as soon
+        as they are available. This allows the caller to process the first
+        entries while the rest is still being fetched.
+        The default implementations just split up the complete list;
+        implementations should override them to avoid holding all the data at
+        once.
+    */
+    virtual void listEntityComponentPairsChunked(ec_chunk_callback_t callback,
+                                                 size_t chunkSize);
+    virtual void listTriplesChunked(triple_chunk_callback_t callback,
+                                    size_t chunkSize);
+
+    /**
+        Returns the complete data of a single entity-component pair,
+        identified by entityId, componentId and tag. Used to fetch the
+        componentJSON of entries that were listed without it.
+        The default implementation searches listEntityComponentPairs.
+    */
+    virtual ECData getComponent(const ECData& which);
+
+    /**
+        Same as getComponent, but for many entity-component pairs at once, so
+        that e.g. all entries a view needs are fetched in a single request.
+        Pairs that are not found are left out of the result.
+        The default implementation calls getComponent for each of them.
+    */
+    virtual std::vector<ECData> getComponents(const std::vector<ECData>& which);
+
     /**
         Adds a new component to the entity. The only relevant parameters are
         the entityId and componentJSON -- the component will be mutable by
@@ -176,5 +275,9 @@ private:
 }}
 
 Q_DECLARE_METATYPE(sempr::gui::ECData)
+Q_DECLARE_METATYPE(std::vector<sempr::gui::ECData>)
+Q_DECLARE_METATYPE(sempr::Triple)
+Q_DECLARE_METATYPE(std::vector<sempr::Triple>)
+Q_DECLARE_METATYPE(sempr::gui::AbstractInterface::Notification)
 
 #endif /* include guard: SEMPR_GUI_ABSTRACTINTERFACE_HPP_ */
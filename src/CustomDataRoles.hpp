@@ -17,9 +17,15 @@ enum Role {
     ComponentPtrRole,            // rw: component pointer
     ComponentMutableRole,        // ro: bool isComponentMutable
     ModelEntryRole,              // ro: whole ModelEntry
+    ComponentTypeRole,           // ro: polymorphic type name from the json
     // provided by the GeometryFilterProxyModel:
     CoordinatesRole,             // rw: coordinates of the geos::geom::Geometry
     GeosGeometryTypeRole,        // ro: the type of the GeosGeometry
+    PackedCoordinatesRole,       // ro: coordinates as QVector<double> of lat/long/alt
+    // provided by the ViewportFilterProxyModel:
+    DisplayCoordinatesRole,      // ro: coordinates simplified for the zoom level
+    DetailLevelRole,             // ro: level of detail of the display coordinates
+    ClusterSizeRole,             // ro: number of points represented by a point
     LastRole
 };
 
@@ -11,6 +11,10 @@
 #include <iostream>
 #include <typeinfo>
 #include <algorithm>
+#include <stdexcept>
+#include <chrono>
+#include <set>
+#include <tuple>
 
 #include "DirectConnection.hpp"
 #include "ExplanationToGraphVisitor.hpp"
@@ -18,7 +22,7 @@
 namespace sempr { namespace gui {
 
 DirectConnection::DirectConnection(sempr::Core* core, std::mutex& m)
-    : core_(core), semprMutex_(m)
+    : core_(core), semprMutex_(m), reteRevision_(0)
 {
 }
 
@@ -33,6 +37,63 @@ Graph DirectConnection::getReteNetworkRepresentation()
     return visitor.graph();
 }
 
+
+GraphDiff DirectConnection::getReteNetworkDiff(uint64_t sinceRevision)
+{
+    // The network only changes when rules are added or removed. Comparing
+    // the rules is much cheaper than visiting the whole network under the
+    // reasoner mutex.
+    std::vector<size_t> rules;
+    {
+        std::lock_guard<std::mutex> lg(semprMutex_);
+        for (auto& rule : core_->rules())
+        {
+            rules.push_back(rule->id());
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(reteMutex_);
+    if (reteSnapshots_.empty() || rules != reteRules_)
+    {
+        auto graph = std::make_shared<const Graph>(getReteNetworkRepresentation());
+        if (reteSnapshots_.empty())
+        {
+            // Start at the current time instead of 1, so that a client does
+            // not confuse the revisions of a restarted core with the ones it
+            // knows.
+            reteRevision_ = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count();
+            reteSnapshots_[reteRevision_] = graph;
+        }
+        else if (!GraphDiff::between(*reteSnapshots_[reteRevision_], *graph).empty())
+        {
+            reteSnapshots_[++reteRevision_] = graph;
+
+            // keep only a few revisions, clients that are further behind
+            // get the complete network
+            while (reteSnapshots_.size() > 8)
+            {
+                reteSnapshots_.erase(reteSnapshots_.begin());
+            }
+        }
+        reteRules_ = rules;
+    }
+
+    auto& current = *reteSnapshots_[reteRevision_];
+    auto previous = reteSnapshots_.find(sinceRevision);
+
+    GraphDiff diff;
+    if (previous != reteSnapshots_.end())
+        diff = GraphDiff::between(*previous->second, current);
+    else
+        diff = GraphDiff::of(current);
+
+    diff.fromRevision = sinceRevision;
+    diff.toRevision = reteRevision_;
+    return diff;
+}
+
+
 ExplanationGraph DirectConnection::getExplanationGeneric(rete::WME::Ptr wme)
 {
     ExplanationToGraphVisitor visitor;
@@ -110,89 +171,180 @@ std::vector<Rule> DirectConnection::getRulesRepresentation()
     return rules;
 }
 
-std::vector<sempr::Triple> DirectConnection::listTriples()
+std::vector<rete::WME::Ptr> DirectConnection::currentWMEs()
 {
-    std::vector<sempr::Triple> triples;
-    std::vector<rete::WME::Ptr> wmes;
+    std::lock_guard<std::recursive_mutex> lg(core_->reasonerMutex());
+    return core_->reasoner().getCurrentState().getWMEs();
+}
+
+
+bool DirectConnection::wmeToTriple(rete::WME::Ptr wme, sempr::Triple& st)
+{
+    auto triple = std::dynamic_pointer_cast<rete::Triple>(wme);
+    if (!triple) return false;
+
+    st = sempr::Triple(triple->subject,
+                       triple->predicate,
+                       triple->object);
+    return true;
+}
 
+
+bool DirectConnection::wmeToECData(rete::WME::Ptr wme, ECData& entry)
+{
+    auto ec = std::dynamic_pointer_cast<sempr::ECWME>(wme);
+    if (!ec) return false;
+
+    auto entity = std::get<0>(ec->value_);
+    auto component = std::get<1>(ec->value_);
+    auto tag = std::get<2>(ec->value_);
+
+    // populate the model entry with...
+    // ... the component "id" (ptr to string)
+    entry.componentId = rete::util::ptrToStr(component.get());
+    // entity id
+    entry.entityId = entity->id();
+    entry.tag = tag;
+
+    // whether it is mutable, i.e., if it is not inferred --
+    // we can check this by trying to find the component in the entity.
+    // If it is there, it is not inferred.
+    auto allComponents = entity->getComponentsWithTag<Component>();
+    std::pair<Component::Ptr, std::string> searchFor(component, tag);
+    bool inferred =
+        (std::find(allComponents.begin(), allComponents.end(), searchFor)
+         == allComponents.end());
+    entry.isComponentMutable = !inferred;
+
+    // create the serialized version of the component
+    std::stringstream ss;
     {
-        std::lock_guard<std::recursive_mutex> lg(core_->reasonerMutex());
-        wmes = core_->reasoner().getCurrentState().getWMEs();
+        cereal::JSONOutputArchive ar(ss);
+        ar(component);
     }
+    entry.setComponentJSON(ss.str());
+
+    return true;
+}
 
-    for (auto wme : wmes)
+
+namespace {
+    // helper: convert the wmes one by one and hand them to the callback in
+    // chunks, so that only one chunk of converted data exists at a time.
+    template <class T, class Convert, class Callback>
+    void convertInChunks(const std::vector<rete::WME::Ptr>& wmes,
+                         Convert convert, Callback callback, size_t chunkSize)
     {
-        auto triple = std::dynamic_pointer_cast<rete::Triple>(wme);
-        if (triple)
-        {
-            sempr::Triple st(triple->subject,
-                             triple->predicate,
-                             triple->object);
+        if (chunkSize == 0) chunkSize = 1;
 
-            triples.push_back(st);
+        std::vector<T> chunk;
+        chunk.reserve(chunkSize);
+        for (auto& wme : wmes)
+        {
+            T value;
+            if (convert(wme, value))
+            {
+                chunk.push_back(value);
+                if (chunk.size() >= chunkSize)
+                {
+                    if (!callback(chunk)) return;
+                    chunk.clear();
+                }
+            }
         }
+
+        if (!chunk.empty()) callback(chunk);
+    }
+}
+
+
+std::vector<sempr::Triple> DirectConnection::listTriples()
+{
+    std::vector<sempr::Triple> triples;
+    for (auto wme : currentWMEs())
+    {
+        sempr::Triple st;
+        if (wmeToTriple(wme, st)) triples.push_back(st);
     }
 
     return triples;
 }
 
-std::vector<ECData> DirectConnection::listEntityComponentPairs()
+void DirectConnection::listTriplesChunked(
+        triple_chunk_callback_t callback, size_t chunkSize)
 {
-    std::vector<rete::WME::Ptr> wmes;
+    convertInChunks<sempr::Triple>(currentWMEs(), &DirectConnection::wmeToTriple,
+                                   callback, chunkSize);
+}
 
+std::vector<ECData> DirectConnection::listEntityComponentPairs()
+{
+    std::vector<ECData> entries;
+    for (auto wme : currentWMEs())
     {
-        std::lock_guard<std::recursive_mutex> lg(core_->reasonerMutex());
-        wmes = core_->reasoner().getCurrentState().getWMEs();
+        ECData entry;
+        if (wmeToECData(wme, entry)) entries.push_back(entry);
     }
 
-    std::vector<ECData> entries;
-    for (auto wme : wmes)
+    return entries;
+}
+
+void DirectConnection::listEntityComponentPairsChunked(
+        ec_chunk_callback_t callback, size_t chunkSize)
+{
+    convertInChunks<ECData>(currentWMEs(), &DirectConnection::wmeToECData,
+                            callback, chunkSize);
+}
+
+
+ECData DirectConnection::getComponent(const ECData& which)
+{
+    for (auto& wme : currentWMEs())
     {
+        // check the ids before creating the json
         auto ec = std::dynamic_pointer_cast<sempr::ECWME>(wme);
-        if (ec)
-        {
-            auto entity = std::get<0>(ec->value_);
-            auto component = std::get<1>(ec->value_);
-            auto tag = std::get<2>(ec->value_);
-
-            ECData entry;
-            // populate the model entry with...
-            // ... the component "id" (ptr to string)
-            entry.componentId = rete::util::ptrToStr(component.get());
-            // entity id
-            entry.entityId = entity->id();
-            entry.tag = tag;
-
-            // whether it is mutable, i.e., if it is not inferred --
-            // we can check this by trying to find the component in the entity.
-            // If it is there, it is not inferred.
-            auto allComponents = entity->getComponentsWithTag<Component>();
-            std::pair<Component::Ptr, std::string> searchFor(component, tag);
-            bool inferred =
-                (std::find(allComponents.begin(), allComponents.end(), searchFor)
-                 == allComponents.end());
-            entry.isComponentMutable = !inferred;
-
-            std::cout << entity->id() << " " << component.get() << " isComponentMutable ? " << entry.isComponentMutable << std::endl;
-
-
-            // create the serialized version of the component
-            std::stringstream ss;
-            {
-                cereal::JSONOutputArchive ar(ss);
-                ar(std::get<1>(ec->value_));
-            }
-            entry.componentJSON = ss.str();
-            entry.tag = tag;
-
-            // add the entry to the list
-            entries.push_back(entry);
-        }
+        if (!ec) continue;
+        if (std::get<0>(ec->value_)->id() != which.entityId) continue;
+        if (rete::util::ptrToStr(std::get<1>(ec->value_).get()) != which.componentId) continue;
+        if (std::get<2>(ec->value_) != which.tag) continue;
+
+        ECData data;
+        wmeToECData(wme, data);
+        return data;
     }
 
-    return entries;
+    throw std::runtime_error("component " + which.componentId +
+                             " of entity " + which.entityId + " not found");
 }
 
+std::vector<ECData> DirectConnection::getComponents(const std::vector<ECData>& which)
+{
+    // look for all of them in a single pass over the wmes
+    std::set<std::tuple<std::string, std::string, std::string>> wanted;
+    for (auto& data : which)
+    {
+        wanted.insert(std::make_tuple(data.entityId, data.componentId, data.tag));
+    }
+
+    std::vector<ECData> found;
+    for (auto& wme : currentWMEs())
+    {
+        if (found.size() == wanted.size()) break;
+
+        auto ec = std::dynamic_pointer_cast<sempr::ECWME>(wme);
+        if (!ec) continue;
+        auto key = std::make_tuple(std::get<0>(ec->value_)->id(),
+                                   rete::util::ptrToStr(std::get<1>(ec->value_).get()),
+                                   std::get<2>(ec->value_));
+        if (!wanted.count(key)) continue;
+
+        ECData data;
+        wmeToECData(wme, data);
+        found.push_back(data);
+    }
+
+    return found;
+}
 
 void DirectConnection::addEntityComponentPair(const ECData& entry)
 {
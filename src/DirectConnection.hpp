@@ -3,6 +3,9 @@
 
 #include <sempr/Core.hpp>
 #include <mutex>
+#include <map>
+#include <memory>
+#include <vector>
 
 #include "AbstractInterface.hpp"
 
@@ -17,6 +20,13 @@ class DirectConnection : public AbstractInterface {
     sempr::Core* core_;
     std::mutex& semprMutex_;
 
+    // the last revisions of the rete network, for getReteNetworkDiff, and
+    // the ids of the rules it was created from
+    std::mutex reteMutex_;
+    uint64_t reteRevision_;
+    std::vector<size_t> reteRules_;
+    std::map<uint64_t, std::shared_ptr<const Graph>> reteSnapshots_;
+
 protected:
     ExplanationGraph getExplanationGeneric(rete::WME::Ptr wme);
 
@@ -25,14 +35,33 @@ public:
     DirectConnection(sempr::Core* core, std::mutex& m);
 
     Graph getReteNetworkRepresentation() override;
+    GraphDiff getReteNetworkDiff(uint64_t sinceRevision) override;
     ExplanationGraph getExplanation(const ECData &ec) override;
     ExplanationGraph getExplanation(sempr::Triple::Ptr triple) override;
     std::vector<Rule> getRulesRepresentation() override;
     std::vector<ECData> listEntityComponentPairs() override;
     std::vector<sempr::Triple> listTriples() override;
+    void listEntityComponentPairsChunked(ec_chunk_callback_t, size_t) override;
+    void listTriplesChunked(triple_chunk_callback_t, size_t) override;
+    ECData getComponent(const ECData& which) override;
+    std::vector<ECData> getComponents(const std::vector<ECData>& which) override;
     void addEntityComponentPair(const ECData&) override;
     void removeEntityComponentPair(const ECData&) override;
     void modifyEntityComponentPair(const ECData&) override;
+
+    /**
+        Returns a snapshot of the WMEs currently held by the reasoner.
+        Together with wmeToECData and wmeToTriple this allows to page through
+        the data without converting all of it at once, see TCPConnectionServer.
+    */
+    std::vector<rete::WME::Ptr> currentWMEs();
+
+    /**
+        Converts the wme to an ECData / sempr::Triple, if it is an ECWME / a
+        rete::Triple. Returns false if it is not.
+    */
+    static bool wmeToECData(rete::WME::Ptr wme, ECData& data);
+    static bool wmeToTriple(rete::WME::Ptr wme, sempr::Triple& triple);
 };
 
 
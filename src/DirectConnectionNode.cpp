@@ -43,7 +43,7 @@ void DirectConnectionNode::execute(
         cereal::JSONOutputArchive ar(ss);
         ar(component);
     }
-    entry.componentJSON = ss.str();
+    entry.setComponentJSON(ss.str());
 
     // only if the component is also part of the entity (and not only associated
     // in the reasoner) can we modify it.
@@ -12,7 +12,9 @@ namespace sempr { namespace gui {
     {
         msg << data.entityId << data.componentId
             << data.componentJSON << data.tag
-            << data.isComponentMutable;
+            << data.isComponentMutable
+            << data.componentType << data.jsonHash << data.hasJSON
+            << data.isPatch << data.patchBaseHash;
         return msg;
     }
 
@@ -21,7 +23,9 @@ namespace sempr { namespace gui {
     {
         msg >> data.entityId >> data.componentId
             >> data.componentJSON >> data.tag
-            >> data.isComponentMutable;
+            >> data.isComponentMutable
+            >> data.componentType >> data.jsonHash >> data.hasJSON
+            >> data.isPatch >> data.patchBaseHash;
         return msg;
     }
 
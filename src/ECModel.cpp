@@ -1,21 +1,48 @@
 #include "ECModel.hpp"
 #include "CustomDataRoles.hpp"
+#include "JsonDelta.hpp"
 
 #include <QColor>
 #include <thread>
+#include <algorithm>
+#include <functional>
 #include <iostream>
 
 namespace sempr { namespace gui {
 
+const std::chrono::seconds ECModel::fetchRetryInterval(5);
+
 ECModel::ECModel(AbstractInterface::Ptr interface)
-    : semprInterface_(interface)
+    : groupRowsValid_(0), semprInterface_(interface), loading_(false),
+      loadGeneration_(0), pendingUpdates_(true), fetching_(true)
 {
-    connect(this, &ECModel::gotEntryAdd,
-            this, &ECModel::addModelEntry);
-    connect(this, &ECModel::gotEntryUpdate,
-            this, &ECModel::updateModelEntry);
-    connect(this, &ECModel::gotEntryRemove,
-            this, &ECModel::removeModelEntry);
+    qRegisterMetaType<ECData>();
+    qRegisterMetaType<std::vector<ECData>>();
+
+    connect(this, &ECModel::gotEntryChunk,
+            this, [this](const std::vector<ECData>& chunk, int generation)
+            {
+                if (generation != loadGeneration_) return;
+
+                std::vector<ECData> entries;
+                entries.reserve(chunk.size());
+                for (auto& e : chunk)
+                {
+                    if (!removedWhileLoading_.count(
+                            std::make_tuple(e.entityId, e.componentId, e.tag)))
+                    {
+                        entries.push_back(e);
+                    }
+                }
+                addModelEntries(entries);
+            });
+    connect(this, &ECModel::loadingFinished,
+            this, [this](int generation)
+            {
+                if (generation != loadGeneration_) return;
+                loading_ = false;
+                removedWhileLoading_.clear();
+            });
 
     // Register callback for updates
     semprInterface_->setUpdateCallback(
@@ -27,45 +54,198 @@ ECModel::ECModel(AbstractInterface::Ptr interface)
             // a big deal, as it does not directly do any UI stuff,
             // BUT:
             // beginInsertRows(...) etc. emit signals that need to be processed
-            // by the views *BEFORE* data is changed! I'm not entirely sure if
-            // I understood the docs correctly, but to be sure: Lets emit
-            // a signal instead (emitting signals is thread safe), and connect
-            // it to the addModelEntry-slot (etc). As the ECModel lives in the
-            // gui thread its events are handled there, and everything should
-            // be fine.
-            //
-
-            switch (n) {
-                case AbstractInterface::ADDED:
-                    this->emit gotEntryAdd(entry);
-                    break;
-                case AbstractInterface::UPDATED:
-                    this->emit gotEntryUpdate(entry);
-                    break;
-                case AbstractInterface::REMOVED:
-                    this->emit gotEntryRemove(entry);
-                    break;
+            // by the views *BEFORE* data is changed!
+            // Instead, just remember the update. The applyTimer_ lives in the
+            // gui thread and applies all collected updates from there. This
+            // also avoids a queued signal per update, which could flood the
+            // event queue.
+            std::lock_guard<std::mutex> lock(pendingMutex_);
+            auto key = std::make_tuple(entry.entityId, entry.componentId, entry.tag);
+
+            // a delta refers to the previous version, which may still be
+            // pending. Resolve it before merging, as the merge drops it.
+            auto pending = pendingUpdates_.find(key);
+            if (entry.isPatch && pending && pending->second != AbstractInterface::REMOVED)
+            {
+                if (pending->first.isPatch)
+                {
+                    patchChains_[key].push_back(entry);
+                    return;
+                }
+                entry = resolvePatch(pending->first, entry);
             }
+
+            // a complete update replaces the pending deltas
+            if (!entry.isPatch) patchChains_.erase(key);
+            pendingUpdates_.add(key, entry, n);
         }
     );
-    // Initialize by retrieving all existing data
-    auto entries = semprInterface_->listEntityComponentPairs();
-    // Sort by entity id first.
-    std::sort(entries.begin(), entries.end(),
-            [](const ECData& left, const ECData& right)
+
+    // apply the collected updates about 30 times per second
+    applyTimer_.setInterval(33);
+    connect(&applyTimer_, &QTimer::timeout,
+            this, &ECModel::applyPendingUpdates);
+    applyTimer_.start();
+
+    // fetch the json of entries received without it in the background
+    connect(this, &ECModel::gotFetchedComponents,
+            this, &ECModel::applyFetchedComponents);
+    fetcher_ = std::thread(
+        [this]()
+        {
+            std::unique_lock<std::mutex> lock(fetchMutex_);
+            while (true)
             {
-                return left.entityId < right.entityId;
+                fetchCondition_.wait(lock,
+                    [this]() { return !fetching_ || !fetchQueue_.empty(); });
+                if (!fetching_) break;
+
+                std::vector<ECData> batch;
+                batch.swap(fetchQueue_);
+                lock.unlock();
+
+                // in chunks, so that the first ones arrive early
+                for (size_t i = 0; i < batch.size() && fetching_; i += fetchChunkSize)
+                {
+                    std::vector<ECData> chunk(
+                        batch.begin() + i,
+                        batch.begin() + std::min(batch.size(), i + fetchChunkSize));
+                    try {
+                        auto fetched = semprInterface_->getComponents(chunk);
+                        this->emit gotFetchedComponents(fetched);
+                    } catch (std::exception& e) {
+                        // requested again after fetchRetryInterval
+                        this->emit error(QString::fromStdString(e.what()));
+                    }
+                }
+
+                lock.lock();
             }
+        }
     );
-    // add them one by one, groups them by entityId.
-    for (auto& e : entries)
+
+    // Initialize by retrieving all existing data.
+    startLoading();
+}
+
+void ECModel::startLoading()
+{
+    // Fetch the data in chunks in a separate thread, so that the gui is
+    // usable while a large knowledge base is still being loaded.
+    loading_ = true;
+    int generation = ++loadGeneration_;
+
+    loader_ = std::thread(
+        [this, generation]()
+        {
+            try {
+                semprInterface_->listEntityComponentPairsChunked(
+                    [this, generation](const std::vector<ECData>& chunk) -> bool
+                    {
+                        this->emit gotEntryChunk(chunk, generation);
+                        return loading_;
+                    },
+                    1000);
+            } catch (std::exception& e) {
+                this->emit error(QString::fromStdString(e.what()));
+            }
+            this->emit loadingFinished(generation);
+        }
+    );
+}
+
+void ECModel::reload()
+{
+    // stop a load that might still be running
+    loading_ = false;
+    if (loader_.joinable()) loader_.join();
+
+    this->beginResetModel();
+    data_.clear();
+    entityRows_.clear();
+    groupRows_.clear();
+    groupRowsValid_ = 0;
+    removedWhileLoading_.clear();
+    fetchRequested_.clear();
+    this->endResetModel();
+
+    startLoading();
+}
+
+void ECModel::applyPendingUpdates()
+{
+    std::vector<UpdateBatch<ECData, EntryKey>::Entry> updates;
+    std::map<EntryKey, std::vector<ECData>> patchChains;
     {
-        addModelEntry(e);
+        std::lock_guard<std::mutex> lock(pendingMutex_);
+        if (pendingUpdates_.empty()) return;
+        updates = pendingUpdates_.take();
+        patchChains.swap(patchChains_);
+    }
+
+    // every entry occurs only once in the batch, so the order between
+    // different kinds of updates does not matter.
+    std::vector<ECData> added, removed;
+    for (auto& update : updates)
+    {
+        if (update.first.isPatch)
+        {
+            update.first = resolvePatch(update.first);
+
+            auto chain = patchChains.find(
+                std::make_tuple(update.first.entityId, update.first.componentId,
+                                update.first.tag));
+            if (chain != patchChains.end())
+            {
+                for (auto& patch : chain->second)
+                {
+                    update.first = resolvePatch(update.first, patch);
+                }
+            }
+        }
+
+        switch (update.second) {
+            case AbstractInterface::ADDED:
+                added.push_back(update.first);
+                break;
+            case AbstractInterface::REMOVED:
+                removed.push_back(update.first);
+                break;
+            case AbstractInterface::UPDATED:
+                updateModelEntry(update.first);
+                break;
+        }
+    }
+
+    removeModelEntries(removed);
+    addModelEntries(added);
+
+    for (auto& update : updates)
+    {
+        switch (update.second) {
+            case AbstractInterface::ADDED:
+                emit gotEntryAdd(update.first);
+                break;
+            case AbstractInterface::UPDATED:
+                emit gotEntryUpdate(update.first);
+                break;
+            case AbstractInterface::REMOVED:
+                emit gotEntryRemove(update.first);
+                break;
+        }
     }
 }
 
 ECModel::~ECModel()
 {
+    loading_ = false;
+    if (loader_.joinable()) loader_.join();
+    {
+        std::lock_guard<std::mutex> lock(fetchMutex_);
+        fetching_ = false;
+    }
+    fetchCondition_.notify_all();
+    if (fetcher_.joinable()) fetcher_.join();
     semprInterface_->clearUpdateCallback();
 }
 
@@ -81,32 +261,19 @@ QModelIndex ECModel::findEntry(const std::string& entityId,
                                const std::string& tag) const
 {
     // find the row of the entity-group
-    auto group = std::find_if(data_.begin(), data_.end(),
-        [&entityId](const ModelEntryGroup& group)
-        {
-            return group.entityId_ == entityId;
-        }
-    );
-
-    if (group != data_.end())
+    int entityRow = findGroupRow(entityId);
+    if (entityRow != -1)
     {
-        int entityRow = std::distance(data_.begin(), group);
+        auto& group = data_[entityRow];
         auto parent = this->index(entityRow, 0, QModelIndex());
 
-        // find the entry in the group
-        auto component = std::find_if(group->entries_.begin(), group->entries_.end(),
-            [&componentId, &tag](const ModelEntry& other)
-            {
-                return componentId == other.componentId()
-                        //&& tag == other.tag(); // search for currently set tag?
-                        && tag == other.coreData_.tag; // or for the originally set tag?
-            }
-        );
-        if (component != group->entries_.end())
+        // find the entry in the group. This uses the originally set tag, not
+        // the currently set one.
+        auto component = group.entryRows_.find(
+                            ModelEntryGroup::entryKey(componentId, tag));
+        if (component != group.entryRows_.end())
         {
-            int componentRow = std::distance(group->entries_.begin(), component);
-            auto index = parent.child(componentRow, 0);
-            return index;
+            return this->index(component->second, 0, parent);
         }
     }
 
@@ -114,82 +281,305 @@ QModelIndex ECModel::findEntry(const std::string& entityId,
 }
 
 
+void ECModel::fixGroupRows() const
+{
+    for (size_t row = groupRowsValid_; row < data_.size(); row++)
+    {
+        entityRows_[data_[row].entityId_] = row;
+        groupRows_[data_[row].groupId_] = row;
+    }
+    groupRowsValid_ = data_.size();
+}
+
+int ECModel::findGroupRow(const std::string& entityId) const
+{
+    auto it = entityRows_.find(entityId);
+    if (it == entityRows_.end()) return -1;
+    if (it->second >= groupRowsValid_)
+    {
+        fixGroupRows();
+    }
+    return it->second;
+}
+
+int ECModel::findGroupRowById(size_t groupId) const
+{
+    auto it = groupRows_.find(groupId);
+    if (it == groupRows_.end()) return -1;
+    if (it->second >= groupRowsValid_)
+    {
+        fixGroupRows();
+    }
+    return it->second;
+}
+
+
+void ECModel::requestJSON(const ModelEntry& entry) const
+{
+    auto key = std::make_tuple(entry.entityId(), entry.componentId(),
+                               entry.coreData_.tag);
+    auto now = std::chrono::steady_clock::now();
+
+    auto requested = fetchRequested_.find(key);
+    if (requested != fetchRequested_.end() &&
+        now - requested->second < fetchRetryInterval)
+    {
+        return;
+    }
+    fetchRequested_[key] = now;
+
+    {
+        std::lock_guard<std::mutex> lock(fetchMutex_);
+        fetchQueue_.push_back(entry.coreData_);
+    }
+    fetchCondition_.notify_one();
+}
+
+void ECModel::applyFetchedComponents(const std::vector<ECData>& fetched)
+{
+    for (auto& full : fetched)
+    {
+        fetchRequested_.erase(std::make_tuple(full.entityId, full.componentId, full.tag));
+
+        auto index = findEntry(full.entityId, full.componentId, full.tag);
+        if (!index.isValid()) continue;
+
+        // skip it if the entry has been updated in the meantime and refers
+        // to a different version now -- that one is requested when needed.
+        auto& entry = data_[index.parent().row()].entries_[index.row()];
+        if (entry.hasJSON()) continue;
+        if (entry.coreData_.jsonHash != 0 &&
+            entry.coreData_.jsonHash != full.jsonHash) continue;
+
+        entry.setFetchedJSON(full);
+        emit dataChanged(index, index.sibling(index.row(), 1));
+    }
+}
+
+ECData ECModel::resolvePatch(const ECData& patch) const
+{
+    auto index = findEntry(patch.entityId, patch.componentId, patch.tag);
+    if (index.isValid())
+    {
+        return resolvePatch(data_[index.parent().row()].entries_[index.row()].coreData_,
+                            patch);
+    }
+
+    // the entry is not there at all
+    ECData unknown;
+    unknown.hasJSON = false;
+    return resolvePatch(unknown, patch);
+}
+
+ECData ECModel::resolvePatch(const ECData& base, const ECData& patch)
+{
+    ECData resolved(patch);
+    resolved.isPatch = false;
+    resolved.patchBaseHash = 0;
+
+    std::string json;
+    if (!base.isPatch && base.hasJSON && base.jsonHash == patch.patchBaseHash &&
+        JsonDelta::apply(base.componentJSON, patch.componentJSON, json) &&
+        ECData::hashJSON(json) == patch.jsonHash)
+    {
+        resolved.setComponentJSON(json);
+        return resolved;
+    }
+
+    // missed an update in between, or the base is unknown
+    resolved.componentJSON.clear();
+    resolved.hasJSON = false;
+    return resolved;
+}
+
 void ECModel::addModelEntry(const ECData& entry)
 {
-    // This can happen e.g. if data was added between setting the callback
-    // for updates and the initialization of the model.
-    auto index = this->findEntry(entry.entityId, entry.componentId, entry.tag);
-    if (index.isValid()) return;
+    addModelEntries({ entry });
+}
 
-    // find the entity-group
-    auto entity = std::find_if(data_.begin(), data_.end(),
-        [&entry](const ModelEntryGroup& group) -> bool
-        {
-            return group.entityId_ == entry.entityId;
-        }
+void ECModel::addModelEntries(const std::vector<ECData>& chunk)
+{
+    // Sort by entity id first.
+    auto entries = chunk;
+    std::sort(entries.begin(), entries.end(),
+            [](const ECData& left, const ECData& right)
+            {
+                return left.entityId < right.entityId;
+            }
     );
 
-    if (entity != data_.end())
+    // Group the entries by entity first, and then insert all new entries of
+    // a known entity / all new entities together.
+    std::map<int, std::vector<ECData>> forKnownGroups;
+    std::vector<ModelEntryGroup> newGroups;
+    for (auto& e : entries)
     {
-        // the group exists, to lets add the entry
-        int entityRow = std::distance(data_.begin(), entity);
-        int componentRow = entity->entries_.size();
+        // This can happen e.g. if data was added between setting the callback
+        // for updates and the initialization of the model.
+        if (findEntry(e.entityId, e.componentId, e.tag).isValid()) continue;
 
-        // index of the parent where the row is inserted
-        auto parent = this->index(entityRow, 0, QModelIndex());
-
-        // and we are going to insert at the end of the component list
-        this->beginInsertRows(parent, componentRow, componentRow);
+        int groupRow = findGroupRow(e.entityId);
+        if (groupRow != -1)
+        {
+            forKnownGroups[groupRow].push_back(e);
+            continue;
+        }
 
-        // now, insert:
-        entity->entries_.push_back(ModelEntry(entry));
+        // entries are sorted, so the group must be the last one if it exists
+        if (newGroups.empty() || newGroups.back().entityId_ != e.entityId)
+        {
+            newGroups.push_back(ModelEntryGroup());
+            newGroups.back().entityId_ = e.entityId;
+        }
 
-        // finish insertion
-        this->endInsertRows();
+        auto& group = newGroups.back();
+        auto key = ModelEntryGroup::entryKey(e.componentId, e.tag);
+        if (group.entryRows_.find(key) == group.entryRows_.end())
+        {
+            group.entryRows_[key] = group.entries_.size();
+            group.entries_.push_back(ModelEntry(e));
+        }
     }
-    else
+
+    for (auto& groupEntries : forKnownGroups)
     {
-        // the group does not exist yet, so lets insert it.
-        int entityRow = data_.size();
+        auto& group = data_[groupEntries.first];
 
-        // parent is the root item
-        QModelIndex parent;
+        // filter duplicates within the chunk
+        std::vector<ECData> toAdd;
+        std::set<std::string> keys;
+        for (auto& e : groupEntries.second)
+        {
+            if (keys.insert(ModelEntryGroup::entryKey(e.componentId, e.tag)).second)
+            {
+                toAdd.push_back(e);
+            }
+        }
 
-        this->beginInsertRows(parent, entityRow, entityRow);
-        ModelEntryGroup group;
-        group.entityId_ = entry.entityId;
-        group.entries_.push_back(ModelEntry(entry));
-        data_.push_back(group);
+        // index of the parent where the rows are inserted, at the end of the
+        // component list
+        auto parent = this->index(groupEntries.first, 0, QModelIndex());
+        size_t first = group.entries_.size();
+
+        this->beginInsertRows(parent, first, first + toAdd.size() - 1);
+        for (auto& e : toAdd)
+        {
+            group.entryRows_[ModelEntryGroup::entryKey(e.componentId, e.tag)] =
+                group.entries_.size();
+            group.entries_.push_back(ModelEntry(e));
+        }
         this->endInsertRows();
     }
+
+    if (newGroups.empty()) return;
+
+    // the group does not exist yet, so lets insert it -- all at once.
+    size_t first = data_.size();
+    this->beginInsertRows(QModelIndex(), first, first + newGroups.size() - 1);
+    for (auto& group : newGroups)
+    {
+        entityRows_[group.entityId_] = data_.size();
+        groupRows_[group.groupId_] = data_.size();
+        data_.push_back(std::move(group));
+    }
+    // the rows of the new groups are known, but only mark them as valid if
+    // all before them are, too.
+    if (groupRowsValid_ == first) groupRowsValid_ = data_.size();
+    this->endInsertRows();
 }
 
 
 void ECModel::removeModelEntry(const ECData& entry)
 {
-    auto index = this->findEntry(entry.entityId, entry.componentId, entry.tag);
-    if (index.isValid())
+    removeModelEntries({ entry });
+}
+
+void ECModel::removeModelEntries(const std::vector<ECData>& entries)
+{
+    // collect the rows to remove, per group
+    std::map<int, std::vector<int>> rows;
+    for (auto& entry : entries)
     {
-        // signal removal of this entry
-        this->beginRemoveRows(index.parent(), index.row(), index.row());
-        // find the group
-        auto group = data_.begin() + index.parent().row();
-        // find the component
-        auto component = group->entries_.begin() + index.row();
-        // remove the entry
-        group->entries_.erase(component);
-        // signal end of removal
-        this->endRemoveRows();
+        if (loading_)
+        {
+            removedWhileLoading_.insert(
+                std::make_tuple(entry.entityId, entry.componentId, entry.tag));
+        }
+        fetchRequested_.erase(
+            std::make_tuple(entry.entityId, entry.componentId, entry.tag));
+
+        auto index = this->findEntry(entry.entityId, entry.componentId, entry.tag);
+        if (index.isValid())
+        {
+            rows[index.parent().row()].push_back(index.row());
+        }
+    }
+
+    // Go through the groups from the last to the first, and through their
+    // entries from the last to the first, so that the rows not handled yet
+    // stay valid. Adjacent rows are removed together.
+    std::vector<int> emptyGroups;
+    for (auto it = rows.rbegin(); it != rows.rend(); ++it)
+    {
+        int groupRow = it->first;
+        auto& group = data_[groupRow];
+        auto& groupRows = it->second;
+        std::sort(groupRows.begin(), groupRows.end(), std::greater<int>());
+        groupRows.erase(std::unique(groupRows.begin(), groupRows.end()),
+                        groupRows.end());
+
+        auto parent = this->index(groupRow, 0, QModelIndex());
+        size_t i = 0;
+        while (i < groupRows.size())
+        {
+            int last = groupRows[i];
+            int first = last;
+            while (++i < groupRows.size() && groupRows[i] == first - 1) first--;
+
+            this->beginRemoveRows(parent, first, last);
+            for (int row = first; row <= last; row++)
+            {
+                auto& entry = group.entries_[row];
+                group.entryRows_.erase(ModelEntryGroup::entryKey(
+                        entry.componentId(), entry.coreData_.tag));
+            }
+            group.entries_.erase(group.entries_.begin() + first,
+                                 group.entries_.begin() + last + 1);
+            this->endRemoveRows();
+        }
+
+        // update the rows of the remaining entries
+        for (size_t row = groupRows.back(); row < group.entries_.size(); row++)
+        {
+            auto& other = group.entries_[row];
+            group.entryRows_[ModelEntryGroup::entryKey(
+                    other.componentId(), other.coreData_.tag)] = row;
+        }
 
         // if this was the last entry, remove the entity-entry all together!
         // (at some points we make the assumption that there is always at least
         // one entry in every group!)
-        if (group->entries_.empty())
+        if (group.entries_.empty()) emptyGroups.push_back(groupRow);
+    }
+
+    // emptyGroups is sorted descending, too
+    size_t i = 0;
+    while (i < emptyGroups.size())
+    {
+        int last = emptyGroups[i];
+        int first = last;
+        while (++i < emptyGroups.size() && emptyGroups[i] == first - 1) first--;
+
+        this->beginRemoveRows(QModelIndex(), first, last);
+        for (int row = first; row <= last; row++)
         {
-            this->beginRemoveRows(QModelIndex(), index.parent().row(), index.parent().row());
-            data_.erase(group);
-            this->endRemoveRows();
+            entityRows_.erase(data_[row].entityId_);
+            groupRows_.erase(data_[row].groupId_);
         }
+        data_.erase(data_.begin() + first, data_.begin() + last + 1);
+        // the rows of all following groups are outdated now
+        groupRowsValid_ = std::min<size_t>(groupRowsValid_, first);
+        this->endRemoveRows();
     }
 }
 
@@ -197,12 +587,23 @@ void ECModel::updateModelEntry(const ECData& entry)
 {
     // find the entries index
     auto index = this->findEntry(entry.entityId, entry.componentId, entry.tag);
+    if (!index.isValid())
+    {
+        // not known yet, e.g. because the initial data is still loading
+        addModelEntry(entry);
+        return;
+    }
 
     // get the group
     auto group = data_.begin() + index.parent().row();
     // get the entry
     auto component = group->entries_.begin() + index.row();
-    *component = ModelEntry(entry);
+    ModelEntry updated(entry);
+    // no need to fetch the json again if the content did not change
+    updated.takeJSONFrom(*component);
+    *component = updated;
+    // a different version, which may be requested right away
+    fetchRequested_.erase(std::make_tuple(entry.entityId, entry.componentId, entry.tag));
 
     // notify views
     this->dataChanged(index, index);
@@ -367,10 +768,13 @@ QVariant ECModel::data(const QModelIndex& index, int role) const
     }
     else if (role == Role::ComponentJsonRole)
     {
+        // empty until fetched, dataChanged is emitted then
+        if (!entry.hasJSON()) requestJSON(entry);
         return QString::fromStdString(entry.json());
     }
     else if (role == Role::ComponentPtrRole)
     {
+        if (!entry.hasJSON()) requestJSON(entry);
         return QVariant::fromValue(entry.component());
     }
     else if (role == Role::ComponentMutableRole)
@@ -379,8 +783,15 @@ QVariant ECModel::data(const QModelIndex& index, int role) const
     }
     else if (role == Role::ModelEntryRole)
     {
+        if (!entry.hasJSON()) requestJSON(entry);
+        // create the component first, so that the copy shares it
+        entry.component();
         return QVariant::fromValue(entry);
     }
+    else if (role == Role::ComponentTypeRole)
+    {
+        return QString::fromStdString(entry.componentType());
+    }
     else if (role == Qt::BackgroundRole)
     {
         // grey background if the component is not mutable
@@ -409,6 +820,14 @@ bool ECModel::setData(const QModelIndex& index, const QVariant& value, int role)
 
     auto& entry = data_[index.parent().row()].entries_[index.row()];
 
+    // entries can only be edited once their json is there, as it is needed
+    // to commit the changes and to reset them
+    if (!entry.hasJSON())
+    {
+        requestJSON(entry);
+        return false;
+    }
+
     if (role == Qt::EditRole && index.column() == 1)
     {
         // set a new tag
@@ -439,7 +858,7 @@ bool ECModel::setData(const QModelIndex& index, const QVariant& value, int role)
             // So, actually, this is only supposed to trigger a "hey I changed
             // something that this pointer points to".
             auto ptr = value.value<Component::Ptr>();
-            if (ptr == entry.component_)
+            if (ptr == entry.component())
             {
                 // only on pointer-equality, do something.
                 try {
@@ -539,21 +958,15 @@ QModelIndex ECModel::parent(const QModelIndex& index) const
 
     // else, we need to find the row in data_ where the ModelEntryGroup with the
     // groupId as specified in the internalId is located.
-    auto it = std::find_if(data_.begin(), data_.end(),
-        [&index](const ModelEntryGroup& group)
-        {
-            return group.groupId_ == index.internalId();
-        }
-    );
+    int row = findGroupRowById(index.internalId());
 
-    if (it == data_.end())
+    if (row == -1)
     {
         // this should not happen. The Index we wanted to get the parent for
         // is not in the datastructure. :(
         throw std::exception();
     }
 
-    int row = std::distance(data_.begin(), it);
     return createIndex(row, 0, quintptr(0));
 }
 
@@ -568,6 +981,7 @@ QHash<int, QByteArray> ECModel::roleNames() const
     hash[Role::ComponentPtrRole] = "component";
     hash[Role::EntityIdRole] = "entityId";
     hash[Role::ModelEntryRole] = "modelEntry";
+    hash[Role::ComponentTypeRole] = "componentType";
 
     return hash;
 }
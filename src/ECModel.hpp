@@ -2,12 +2,22 @@
 #define SEMPR_GUI_ECMODEL_HPP_
 
 #include <QAbstractItemModel>
+#include <QTimer>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <set>
+#include <tuple>
 #include <string>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 
 #include "ModelEntry.hpp"
 #include "AbstractInterface.hpp"
+#include "UpdateBatch.hpp"
 
 namespace sempr { namespace gui {
 
@@ -46,12 +56,26 @@ public:
     std::string entityId_;
     std::vector<ModelEntry> entries_;
 
+    /// row of each entry in entries_, see entryKey. Kept up to date by the
+    /// ECModel.
+    std::unordered_map<std::string, size_t> entryRows_;
+
+    /// key for entryRows_: the componentId and the tag as received from the
+    /// core (coreData_.tag)
+    static std::string entryKey(const std::string& componentId,
+                                const std::string& tag)
+    {
+        return componentId + '\0' + tag;
+    }
+
     ModelEntryGroup()
         : groupId_(ModelEntryGroup::nextId())
     {
     }
     ModelEntryGroup(const ModelEntryGroup&) = default;
     ModelEntryGroup& operator = (const ModelEntryGroup&) = default;
+    ModelEntryGroup(ModelEntryGroup&&) = default;
+    ModelEntryGroup& operator = (ModelEntryGroup&&) = default;
 };
 
 /**
@@ -83,9 +107,93 @@ class ECModel : public QAbstractItemModel {
 
     std::vector<ModelEntryGroup> data_;
 
+    /**
+        Indices to find the row of a ModelEntryGroup in data_ by its entityId
+        or groupId. When a group is removed the rows of all following groups
+        change; instead of fixing them right away, only groupRowsValid_ is
+        lowered: Rows below it are known to be correct, all others are
+        recomputed on the next lookup that needs them. That way removing
+        many groups in a row does not update the indices each time.
+        (Mutable as lookups in the const methods may need to fix them.)
+    */
+    mutable std::unordered_map<std::string, size_t> entityRows_;
+    mutable std::unordered_map<size_t, size_t> groupRows_;
+    mutable size_t groupRowsValid_;
+
+    /// row of the group for the entityId/groupId in data_, or -1
+    int findGroupRow(const std::string& entityId) const;
+    int findGroupRowById(size_t groupId) const;
+    /// recompute the rows of all groups at or after groupRowsValid_
+    void fixGroupRows() const;
+
     /// the connection to sempr
     AbstractInterface::Ptr semprInterface_;
 
+    /// fetches the initial data in chunks, see startLoading
+    std::thread loader_;
+    std::atomic<bool> loading_;
+    /// incremented with every (re)load, to discard chunks of a previous one
+    /// that are still queued
+    int loadGeneration_;
+
+    /// starts the loader_ thread
+    void startLoading();
+
+    typedef std::tuple<std::string, std::string, std::string> EntryKey;
+
+    /// entries removed while the initial data is still being loaded, to not
+    /// re-add them when they are contained in a chunk fetched earlier.
+    std::set<EntryKey> removedWhileLoading_;
+
+    /**
+        Updates received through the callback of the semprInterface_ are not
+        applied one by one, but collected in pendingUpdates_ and applied
+        together by applyPendingUpdates, triggered by the applyTimer_.
+        Multiple updates for the same entry are merged.
+        A delta (ECData::isPatch) is resolved right away against the complete
+        json of a pending update of the entry. If the pending update is a
+        delta itself, which can only be resolved against the model in the gui
+        thread, the new one is not merged but appended to patchChains_, and
+        applied on top of it.
+    */
+    std::mutex pendingMutex_;
+    UpdateBatch<ECData, EntryKey> pendingUpdates_;
+    std::map<EntryKey, std::vector<ECData>> patchChains_;
+    QTimer applyTimer_;
+
+    /**
+        Entries received without json (metadata-only mode) get it in the
+        background: data() queues the missing ones with requestJSON, the
+        fetcher_ thread requests the queued ones through getComponents, up to
+        fetchChunkSize at once, and gotFetchedComponents hands them back to
+        the gui thread. fetchRequested_ holds the time of the last request of every
+        entry that still waits for its json, so that an entry is requested
+        again only after fetchRetryInterval, e.g. if the request failed.
+    */
+    std::thread fetcher_;
+    mutable std::mutex fetchMutex_;
+    mutable std::condition_variable fetchCondition_;
+    mutable std::vector<ECData> fetchQueue_;
+    std::atomic<bool> fetching_; // set to false to stop the fetcher_
+    mutable std::map<EntryKey, std::chrono::steady_clock::time_point> fetchRequested_;
+    static const std::chrono::seconds fetchRetryInterval;
+    static const size_t fetchChunkSize = 500;
+
+    /// queues the entry to get its json, unless requested recently
+    void requestJSON(const ModelEntry&) const;
+
+    /**
+        Turns an update that only carries a delta to the previous json (see
+        ECData::isPatch) into a complete one, using the json of the entry in
+        the model. If that is not possible (the entry is unknown, or holds a
+        different version than the delta was made for) the json is dropped
+        and fetched from the core again when needed.
+    */
+    ECData resolvePatch(const ECData&) const;
+
+    /// resolves the delta against the json of the given base version
+    static ECData resolvePatch(const ECData& base, const ECData& patch);
+
     /// compute the model index of the entry
     QModelIndex findEntry(const ModelEntry&) const;
     QModelIndex findEntry(const std::string& entityId,
@@ -93,14 +201,21 @@ class ECModel : public QAbstractItemModel {
                           const std::string& tag) const;
 
 signals:
-    // These are emitted from the thread that calls the set callback in
-    // semprInterface_, and are connected to the [add|remove|update]ModelEntry
-    // slots below. This is done to make sure that the slots are called from
-    // the main (gui) thread.
+    // These are emitted for every update received from the semprInterface_,
+    // after it has been applied to the model.
     void gotEntryAdd(const sempr::gui::ECData&);
     void gotEntryUpdate(const sempr::gui::ECData&);
     void gotEntryRemove(const sempr::gui::ECData&);
 
+    // emitted from the loader_ thread for every chunk of the initial data,
+    // connected to addModelEntries.
+    void gotEntryChunk(const std::vector<sempr::gui::ECData>&, int generation);
+    void loadingFinished(int generation);
+
+    // emitted from the fetcher_ thread with the complete data of entries
+    // that were received without json, connected to applyFetchedComponents.
+    void gotFetchedComponents(const std::vector<sempr::gui::ECData>&);
+
     // signal exceptions/errors, e.g. when parsing json
     void error(const QString& what);
 
@@ -111,18 +226,50 @@ public slots:
     */
     void addModelEntry(const ECData&);
 
+    /**
+        Adds multiple model entries, e.g. a chunk received during the
+        initialization. New entities are inserted all at once, and new
+        entries of a known entity, too, so that views and proxies only need
+        to handle a few insertions.
+    */
+    void addModelEntries(const std::vector<ECData>&);
+
+    /**
+        Discards all entries and loads them again from the sempr core, e.g.
+        after reconnecting to it. The model is reset once, and the data is
+        then added in chunks as in the initialization.
+    */
+    void reload();
+
     /**
         Removes a model entry from the local vector structure as indicated
         by the entity- and component-id in the ECData.
     */
     void removeModelEntry(const ECData&);
 
+    /**
+        Removes multiple model entries, signalling the removal of adjacent
+        rows at once.
+    */
+    void removeModelEntries(const std::vector<ECData>&);
+
     /**
         Updates a model entry in the internal vector structure from the given
         ECData.
     */
     void updateModelEntry(const ECData&);
 
+    /**
+        Applies the updates collected since the last call.
+    */
+    void applyPendingUpdates();
+
+    /**
+        Hands the fetched json to the entries that were received without it,
+        if they still refer to the same version.
+    */
+    void applyFetchedComponents(const std::vector<ECData>&);
+
 public:
     ECModel(AbstractInterface::Ptr interface);
     ~ECModel();
@@ -0,0 +1,249 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <memory>
+#include <chrono>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fstream>
+
+#include <QCoreApplication>
+#include <cereal/archives/json.hpp>
+#include <sempr/component/TextComponent.hpp>
+
+#include "ECModel.hpp"
+#include "CustomDataRoles.hpp"
+
+/*
+    Replays a sequence of add/update/remove events against an ECModel and
+    measures the time it takes to apply them, once through the slots one by
+    one, and once through the update callback and applyPendingUpdates, as
+    the model does it with updates from the core.
+    Afterwards, the resident memory is reported before and after all
+    components have been deserialized, i.e. with lazy and with eager
+    deserialization (Linux only).
+
+    usage: sempr-gui-ecmodel-replay-benchmark [numEvents] [batchSize]
+*/
+
+using namespace sempr::gui;
+
+namespace {
+
+/**
+    An interface without a core behind it. The model only needs it for the
+    initial (empty) listing and the update callback.
+*/
+class ReplayInterface : public AbstractInterface {
+public:
+    Graph getReteNetworkRepresentation() override { return Graph(); }
+    ExplanationGraph getExplanation(sempr::Triple::Ptr) override { return ExplanationGraph(); }
+    ExplanationGraph getExplanation(const ECData&) override { return ExplanationGraph(); }
+    std::vector<Rule> getRulesRepresentation() override { return {}; }
+    std::vector<ECData> listEntityComponentPairs() override { return {}; }
+    std::vector<sempr::Triple> listTriples() override { return {}; }
+    void addEntityComponentPair(const ECData&) override {}
+    void modifyEntityComponentPair(const ECData&) override {}
+    void removeEntityComponentPair(const ECData&) override {}
+};
+
+struct Event {
+    ECData data;
+    AbstractInterface::Notification action;
+};
+
+std::string textComponentJSON(const std::string& text)
+{
+    sempr::Component::Ptr component = std::make_shared<sempr::TextComponent>(text);
+    std::stringstream ss;
+    {
+        cereal::JSONOutputArchive ar(ss);
+        ar(component);
+    }
+    return ss.str();
+}
+
+/**
+    Creates a random but reproducible sequence of events: About 40% add a
+    component to a new or existing entity, 40% update and 20% remove an
+    existing one.
+*/
+std::vector<Event> createEvents(size_t numEvents)
+{
+    std::mt19937 random(42);
+    std::uniform_real_distribution<double> uniform(0., 1.);
+
+    std::vector<Event> events;
+    events.reserve(numEvents);
+    std::vector<ECData> present;
+    size_t nextEntity = 0, nextComponent = 0;
+
+    for (size_t i = 0; i < numEvents; i++)
+    {
+        double r = uniform(random);
+        Event event;
+        if (present.empty() || r < 0.4)
+        {
+            ECData data;
+            // a new entity every third component
+            if (present.empty() || nextComponent % 3 == 0)
+                data.entityId = "Entity_" + std::to_string(nextEntity++);
+            else
+                data.entityId = present[random() % present.size()].entityId;
+            data.componentId = "Component_" + std::to_string(nextComponent++);
+            data.isComponentMutable = true;
+            data.setComponentJSON(textComponentJSON("text " + std::to_string(i)));
+
+            present.push_back(data);
+            event.data = data;
+            event.action = AbstractInterface::ADDED;
+        }
+        else
+        {
+            size_t which = random() % present.size();
+            if (r < 0.8)
+            {
+                present[which].setComponentJSON(
+                        textComponentJSON("updated text " + std::to_string(i)));
+                event.data = present[which];
+                event.action = AbstractInterface::UPDATED;
+            }
+            else
+            {
+                event.data = present[which];
+                event.action = AbstractInterface::REMOVED;
+                present[which] = present.back();
+                present.pop_back();
+            }
+        }
+        events.push_back(event);
+    }
+
+    return events;
+}
+
+double seconds(std::chrono::steady_clock::duration d)
+{
+    return std::chrono::duration<double>(d).count();
+}
+
+/// creates a model and waits for its (empty) initial listing to finish
+std::unique_ptr<ECModel> createModel(AbstractInterface::Ptr interface)
+{
+    std::unique_ptr<ECModel> model(new ECModel(interface));
+    auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+    while (std::chrono::steady_clock::now() < until)
+    {
+        QCoreApplication::processEvents();
+    }
+    return model;
+}
+
+/// resident memory of this process in kB, from /proc/self/status; 0 if unknown
+long residentMemory()
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+    {
+        if (line.compare(0, 6, "VmRSS:") == 0)
+        {
+            return std::stol(line.substr(6));
+        }
+    }
+    return 0;
+}
+
+/// accesses the component pointer of every entry, which deserializes them
+size_t deserializeAll(const ECModel& model)
+{
+    size_t loaded = 0;
+    for (int i = 0; i < model.rowCount(QModelIndex()); i++)
+    {
+        auto group = model.index(i, 0, QModelIndex());
+        for (int j = 0; j < model.rowCount(group); j++)
+        {
+            auto component = model.data(model.index(j, 0, group), Role::ComponentPtrRole)
+                                .value<sempr::Component::Ptr>();
+            if (component) loaded++;
+        }
+    }
+    return loaded;
+}
+
+void report(const std::string& name, double time, size_t numEvents, const ECModel& model)
+{
+    std::cout << std::left << std::setw(10) << name << std::right
+              << std::fixed << std::setprecision(3)
+              << std::setw(10) << time << " s"
+              << std::setw(12) << std::setprecision(0) << numEvents / time << " events/s"
+              << std::setw(8) << model.rowCount(QModelIndex()) << " entities"
+              << std::endl;
+}
+
+}
+
+
+int main(int argc, char** args)
+{
+    QCoreApplication app(argc, args);
+
+    size_t numEvents = 100000;
+    size_t batchSize = 1000;
+    try {
+        if (argc > 1) numEvents = std::stoul(args[1]);
+        if (argc > 2) batchSize = std::max<size_t>(1, std::stoul(args[2]));
+    } catch (std::exception&) {
+        std::cerr << "usage: " << args[0] << " [numEvents] [batchSize]" << std::endl;
+        return 1;
+    }
+
+    auto events = createEvents(numEvents);
+    std::cout << numEvents << " events, batches of " << batchSize << std::endl;
+
+    // one by one, through the slots
+    {
+        auto interface = std::make_shared<ReplayInterface>();
+        auto model = createModel(interface);
+
+        auto start = std::chrono::steady_clock::now();
+        for (auto& event : events)
+        {
+            if (event.action == AbstractInterface::ADDED)
+                model->addModelEntry(event.data);
+            else if (event.action == AbstractInterface::UPDATED)
+                model->updateModelEntry(event.data);
+            else
+                model->removeModelEntry(event.data);
+        }
+        report("single", seconds(std::chrono::steady_clock::now() - start),
+               numEvents, *model);
+    }
+
+    // through the update callback, applied in batches
+    {
+        auto interface = std::make_shared<ReplayInterface>();
+        auto model = createModel(interface);
+
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < events.size(); i++)
+        {
+            interface->triggerCallback(events[i].data, events[i].action);
+            if ((i + 1) % batchSize == 0) model->applyPendingUpdates();
+        }
+        model->applyPendingUpdates();
+        report("batched", seconds(std::chrono::steady_clock::now() - start),
+               numEvents, *model);
+
+        // memory with lazy deserialization, and after loading everything
+        long lazy = residentMemory();
+        size_t loaded = deserializeAll(*model);
+        long eager = residentMemory();
+        std::cout << "resident memory: " << lazy << " kB lazy, "
+                  << eager << " kB with all " << loaded
+                  << " components deserialized" << std::endl;
+    }
+}
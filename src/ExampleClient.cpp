@@ -2,6 +2,7 @@
 #include "TCPConnectionClient.hpp"
 #include <thread>
 #include <chrono>
+#include <limits>
 
 #include "SemprGui.hpp"
 #include <QtCore>
@@ -15,8 +16,56 @@ int main(int argc, char** args)
         ip = args[1];
     }
 
+    // the binary format is the default, json is easier to debug.
+    // --metadata-only only fetches the json of components when needed.
+    auto format = sempr::gui::WireFormat::PortableBinary;
+    bool metadataOnly = false;
+    // map tiles: --offline only uses local and cached tiles, --tile-dir adds a
+    // directory of tiles (<z>/<x>/<y>.png) that is used before anything else.
+    // --prefetch <margin> downloads the tiles around the visible ones, too,
+    // which is only allowed with a --tile-url of your own tile server.
+    sempr::gui::TileServer::Config tiles;
+    for (int i = 2; i < argc; i++)
+    {
+        std::string arg(args[i]);
+        bool hasValue = i + 1 < argc;
+        if (arg == "--json") format = sempr::gui::WireFormat::JSON;
+        else if (arg == "--metadata-only") metadataOnly = true;
+        else if (arg == "--offline") tiles.offline = true;
+        else if (arg == "--tile-dir" && hasValue) tiles.tileDirectory = args[++i];
+        else if (arg == "--tile-cache" && hasValue) tiles.cacheDirectory = args[++i];
+        else if (arg == "--tile-cache-size" && hasValue)
+        {
+            // in MB
+            bool ok;
+            qint64 size = QByteArray(args[++i]).toLongLong(&ok);
+            if (!ok || size < 0 || size > (std::numeric_limits<qint64>::max() >> 20))
+            {
+                std::cerr << "invalid --tile-cache-size: " << args[i]
+                          << " (expected a size in MB)" << std::endl;
+                return 1;
+            }
+            tiles.cacheSize = size << 20;
+        }
+        else if (arg == "--tile-url" && hasValue) tiles.tileUrl = args[++i];
+        else if (arg == "--prefetch" && hasValue)
+        {
+            bool ok;
+            int margin = QByteArray(args[++i]).toInt(&ok);
+            if (!ok || margin < 0 || margin > 8)
+            {
+                std::cerr << "invalid --prefetch: " << args[i]
+                          << " (expected a margin of 0 to 8 tiles)" << std::endl;
+                return 1;
+            }
+            tiles.prefetch = true;
+            tiles.prefetchMargin = margin;
+        }
+    }
+
     auto client = std::make_shared<sempr::gui::TCPConnectionClient>();
-    client->connect("tcp://" + ip + ":4242", "tcp://" + ip + ":4243");
+    client->connect("tcp://" + ip + ":4242", "tcp://" + ip + ":4243",
+                    format, metadataOnly);
     client->start();
 
     std::cout << "started client" << std::endl;
@@ -25,7 +74,7 @@ int main(int argc, char** args)
 
     std::cout << "created app" << std::endl;
 
-    sempr::gui::SemprGui gui(client);
+    sempr::gui::SemprGui gui(client, tiles);
 
     std::cout << "created gui" << std::endl;
 
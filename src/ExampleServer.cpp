@@ -117,6 +117,8 @@ int main(int argc, char** args)
     {
         try {
             sempr.performInference();
+            // send the updates of this inference step right away
+            server.flushUpdates();
             if (firstInference)
             {
                 std::ofstream("debug.dot") << sempr.reasoner().net().toDot();
@@ -4,42 +4,113 @@
 
 namespace sempr { namespace gui {
 
+void FlattenTreeProxyModel::Node::rebuildFenwick()
+{
+    // O(n) construction: every entry passes its sum on to the next entry
+    // that covers it.
+    size_t n = children.size();
+    fenwick.assign(n + 1, 0);
+    for (size_t i = 1; i <= n; i++)
+    {
+        fenwick[i] += children[i-1]->size;
+        size_t next = i + (i & (~i + 1));
+        if (next <= n) fenwick[next] += fenwick[i];
+    }
+}
+
+void FlattenTreeProxyModel::Node::addToChild(int childRow, int delta)
+{
+    for (size_t i = childRow + 1; i < fenwick.size(); i += (i & (~i + 1)))
+    {
+        fenwick[i] += delta;
+    }
+}
+
+int FlattenTreeProxyModel::Node::sizeBefore(int childRow) const
+{
+    int sum = 0;
+    for (size_t i = childRow; i > 0; i -= (i & (~i + 1)))
+    {
+        sum += fenwick[i];
+    }
+    return sum;
+}
+
+int FlattenTreeProxyModel::Node::childAt(int& offset) const
+{
+    // find the number of children whose subtrees end before or at offset,
+    // by descending the implicit tree of the fenwick array.
+    size_t n = fenwick.size() - 1;
+    size_t step = 1;
+    while (step * 2 <= n) step *= 2;
+
+    size_t pos = 0;
+    for (; step > 0; step /= 2)
+    {
+        if (pos + step <= n && fenwick[pos + step] <= offset)
+        {
+            pos += step;
+            offset -= fenwick[pos];
+        }
+    }
+
+    return static_cast<int>(pos);
+}
+
+
 FlattenTreeProxyModel::FlattenTreeProxyModel(QObject* parent)
-    : QAbstractProxyModel(parent)
+    : QAbstractProxyModel(parent), removing_(false)
 {
 }
 
+
+std::unique_ptr<FlattenTreeProxyModel::Node> FlattenTreeProxyModel::buildNode(
+        const QModelIndex& sourceIndex, Node* parent, int row)
+{
+    std::unique_ptr<Node> node(new Node());
+    node->parent = parent;
+    node->row = row;
+
+    int numRows = sourceModel()->rowCount(sourceIndex);
+    node->children.reserve(numRows);
+    for (int i = 0; i < numRows; i++)
+    {
+        auto child = buildNode(sourceModel()->index(i, 0, sourceIndex), node.get(), i);
+        node->size += child->size;
+        node->children.push_back(std::move(child));
+    }
+    node->rebuildFenwick();
+
+    return node;
+}
+
+
 void FlattenTreeProxyModel::rebuild()
 {
-    parents_.clear();
+    root_.children.clear();
+    root_.size = 1;
 
-    auto model = sourceModel();
-    if (!model) return;
+    if (sourceModel())
+    {
+        auto built = buildNode(QModelIndex(), nullptr, 0);
+        root_.children = std::move(built->children);
+        root_.size = built->size;
+        for (auto& child : root_.children) child->parent = &root_;
+    }
 
-    addChildrenToList(QModelIndex());
+    root_.rebuildFenwick();
 }
 
 
 void FlattenTreeProxyModel::setSourceModel(QAbstractItemModel* model)
 {
     this->beginResetModel();
+
     // disconnect from previous model
-    disconnect(model, &QAbstractItemModel::dataChanged,
-            this, &FlattenTreeProxyModel::onSourceDataChanged);
-    disconnect(model, &QAbstractItemModel::modelReset,
-            this, &FlattenTreeProxyModel::onSourceModelReset);
-
-    // insertion of rows
-    disconnect(model, &QAbstractItemModel::rowsAboutToBeInserted,
-            this, &FlattenTreeProxyModel::onSourceRowsAboutToBeInserted);
-    disconnect(model, &QAbstractItemModel::rowsInserted,
-            this, &FlattenTreeProxyModel::onSourceRowsInserted);
-
-    // removal of rows
-    disconnect(model, &QAbstractItemModel::rowsAboutToBeRemoved,
-            this, &FlattenTreeProxyModel::onSourceRowsAboutToBeRemoved);
-    disconnect(model, &QAbstractItemModel::rowsRemoved,
-            this, &FlattenTreeProxyModel::onSourceRowsRemoved);
+    if (sourceModel())
+    {
+        disconnect(sourceModel(), nullptr, this, nullptr);
+    }
 
     // connect to new model
     if (model)
@@ -47,12 +118,13 @@ void FlattenTreeProxyModel::setSourceModel(QAbstractItemModel* model)
         // data changed and model reset
         connect(model, &QAbstractItemModel::dataChanged,
                 this, &FlattenTreeProxyModel::onSourceDataChanged);
+        connect(model, &QAbstractItemModel::modelAboutToBeReset,
+                this, &FlattenTreeProxyModel::onSourceModelAboutToBeReset);
         connect(model, &QAbstractItemModel::modelReset,
                 this, &FlattenTreeProxyModel::onSourceModelReset);
 
-        // insertion of rows
-        connect(model, &QAbstractItemModel::rowsAboutToBeInserted,
-                this, &FlattenTreeProxyModel::onSourceRowsAboutToBeInserted);
+        // insertion of rows. Nothing to do before, as the size of the
+        // inserted subtrees is only known afterwards.
         connect(model, &QAbstractItemModel::rowsInserted,
                 this, &FlattenTreeProxyModel::onSourceRowsInserted);
 
@@ -61,6 +133,16 @@ void FlattenTreeProxyModel::setSourceModel(QAbstractItemModel* model)
                 this, &FlattenTreeProxyModel::onSourceRowsAboutToBeRemoved);
         connect(model, &QAbstractItemModel::rowsRemoved,
                 this, &FlattenTreeProxyModel::onSourceRowsRemoved);
+
+        // moving rows changes the order, just like a layout change
+        connect(model, &QAbstractItemModel::layoutAboutToBeChanged,
+                this, &FlattenTreeProxyModel::onSourceLayoutAboutToBeChanged);
+        connect(model, &QAbstractItemModel::layoutChanged,
+                this, &FlattenTreeProxyModel::onSourceLayoutChanged);
+        connect(model, &QAbstractItemModel::rowsAboutToBeMoved,
+                this, &FlattenTreeProxyModel::onSourceLayoutAboutToBeChanged);
+        connect(model, &QAbstractItemModel::rowsMoved,
+                this, &FlattenTreeProxyModel::onSourceLayoutChanged);
     }
 
     QAbstractProxyModel::setSourceModel(model);
@@ -70,43 +152,48 @@ void FlattenTreeProxyModel::setSourceModel(QAbstractItemModel* model)
 }
 
 
-/*
-    This method is called recursively to fill the parents_ list.
-    It is always directly called for the last item that was added to it, so
-    the direct parent of the children added is the last one added.
-    Hence, the parent-index is parents_.size()-1, and since we add +1 in order
-    to use "0" for the root item, we just store parents_.size().
-*/
-void FlattenTreeProxyModel::addChildrenToList(const QModelIndex& parentIndex)
+const FlattenTreeProxyModel::Node* FlattenTreeProxyModel::nodeFor(
+        const QModelIndex& sourceIndex) const
 {
-    int numRows = sourceModel()->rowCount(parentIndex);
-    int parent = parents_.size();
+    // collect the rows on the path from the root to the index
+    std::vector<int> path;
+    for (auto i = sourceIndex; i.isValid(); i = i.parent())
+    {
+        path.push_back(i.row());
+    }
 
-    for (int i = 0; i < numRows; i++)
+    const Node* node = &root_;
+    for (auto it = path.rbegin(); it != path.rend(); ++it)
     {
-        auto childIndex = sourceModel()->index(i, 0, parentIndex);
-        // add the child
-        parents_.append(parent);
-        // and directly add the grandchildren afterwards
-        addChildrenToList(childIndex);
+        if (*it < 0 || *it >= static_cast<int>(node->children.size())) return nullptr;
+        node = node->children[*it].get();
     }
+
+    return node;
 }
 
 
-int FlattenTreeProxyModel::numDecendants(const QModelIndex& sourceIndex) const
+int FlattenTreeProxyModel::proxyRow(const Node* node) const
 {
-    int rowCount = sourceModel()->rowCount(sourceIndex);
-    // the number of descendants of this index is the number of its children,
-    // plus the number of its childrens decendants.
-    int num = rowCount;
-    for (int i = 0; i < rowCount; i++)
+    // the row of the parent, +1 for the parent itself, + all subtrees of the
+    // siblings above
+    int row = -1;
+    for (; node->parent; node = node->parent)
     {
-        auto child = sourceModel()->index(i, 0, sourceIndex);
-        // recursive!
-        num += numDecendants(child);
+        row += 1 + node->parent->sizeBefore(node->row);
     }
+    return row;
+}
 
-    return num;
+
+void FlattenTreeProxyModel::propagateSize(Node* node, int delta)
+{
+    node->size += delta;
+    for (; node->parent; node = node->parent)
+    {
+        node->parent->addToChild(node->row, delta);
+        node->parent->size += delta;
+    }
 }
 
 
@@ -115,55 +202,32 @@ QModelIndex FlattenTreeProxyModel::mapFromSource(const QModelIndex& sourceIndex)
     // invalid source -> invalid proxy
     if (!sourceIndex.isValid()) return QModelIndex();
 
-    // Basically, we need to count all indices before this.
-    // To do this, we traverse the tree again recursively: Assume we know the
-    // proxy-index of the parent of this (sourceIndex) index. All we need to do
-    // is add the number of siblings above this, and the number of all their
-    // decendants -- this we can do with numDecendants.
-    int numSiblingsAbove = sourceIndex.row();
-    int numDecendantsOfSiblingsAbove = 0;
-    for (int i = 0; i < numSiblingsAbove; i++)
-    {
-        numDecendantsOfSiblingsAbove += numDecendants(sourceIndex.sibling(i, 0));
-    }
-
-    auto parentsProxyIndex = mapFromSource(sourceIndex.parent());
-    int parentsProxyRow = (parentsProxyIndex.isValid() ? parentsProxyIndex.row() : -1);
-
-    auto proxyIndex = this->index(parentsProxyRow +
-                       numSiblingsAbove +
-                       numDecendantsOfSiblingsAbove + 1, 0);
+    auto node = nodeFor(sourceIndex);
+    if (!node) return QModelIndex();
 
-//    qDebug() << "source -> proxy: " << sourceIndex << " -> " << proxyIndex;
-    return proxyIndex;
+    return this->index(proxyRow(node), 0);
 }
 
 QModelIndex FlattenTreeProxyModel::mapToSource(const QModelIndex& proxyIndex) const
 {
-    if (!proxyIndex.isValid()) return QModelIndex();
-
-    // in order to create really valid source indices, we need to traverse
-    // the source model again, from root to child. But to figure out where to
-    // look we need to go the other way round, by checking in the internal data
-    // where the proxy-parent is, and compute the source-index for that.
-    int parentsId = parents_[proxyIndex.row()];
-    int rowInParent = 0;
-    // to compute which direct child of its parent this one is, we need to count
-    // how many other items are a direct child of it and above this entry.
-    for (int i = parentsId; i < proxyIndex.row(); i++)
+    if (!proxyIndex.isValid() || !sourceModel()) return QModelIndex();
+    if (proxyIndex.row() >= rowCount()) return QModelIndex();
+
+    // descend from the root: find the child whose subtree contains the row,
+    // until the row is the child itself.
+    QModelIndex sourceIndex;
+    const Node* node = &root_;
+    int offset = proxyIndex.row();
+    while (true)
     {
-        if (parents_[i] == parentsId) rowInParent++;
-    }
+        int childRow = node->childAt(offset);
+        sourceIndex = sourceModel()->index(childRow, 0, sourceIndex);
 
-    // now, if the parentsId is 0 it is the root item, and we can compute the
-    // index directly
-    if (parentsId == 0) return sourceModel()->index(rowInParent, 0, QModelIndex());
-    // else we just call mapToSource for the parent, recursively.
-    // (subtract 1 from the parentsId to get its index in the parents_ list!)
-    auto sourceParent = mapToSource(this->index(parentsId-1, 0));
-    auto sourceIndex = sourceModel()->index(rowInParent, 0, sourceParent);
+        if (offset == 0) break; // the child itself
+        offset -= 1;            // somewhere in the subtree of the child
+        node = node->children[childRow].get();
+    }
 
-//    qDebug() << "proxy -> source: " << proxyIndex << " -> " << sourceIndex;
     return sourceIndex;
 }
 
@@ -175,7 +239,7 @@ int FlattenTreeProxyModel::columnCount(const QModelIndex& /*parent*/) const
 int FlattenTreeProxyModel::rowCount(const QModelIndex& parent) const
 {
     if (parent.isValid()) return 0;
-    return parents_.size();
+    return root_.size - 1;
 }
 
 QModelIndex FlattenTreeProxyModel::index(int row, int column, const QModelIndex& parent) const
@@ -196,91 +260,105 @@ void FlattenTreeProxyModel::onSourceDataChanged(
         const QModelIndex& br,
         const QVector<int>& roles)
 {
-    // for every affected row, map it to the proxy index,
+    auto parent = nodeFor(tl.parent());
+    if (!parent) return;
+
+    // Without descendants in between, the rows are consecutive in the proxy,
+    // too.
+    int numChanged = br.row() - tl.row() + 1;
+    if (parent->sizeBefore(br.row() + 1) - parent->sizeBefore(tl.row()) == numChanged)
+    {
+        auto proxyTL = mapFromSource(tl);
+        auto proxyBR = this->index(proxyTL.row() + numChanged - 1, 0);
+        emit dataChanged(proxyTL, proxyBR, roles);
+        return;
+    }
+
+    // else, for every affected row, map it to the proxy index,
     // and emit a dataChanged.
     for (int sourceRow = tl.row(); sourceRow <= br.row(); sourceRow++)
     {
-        auto proxyTL = mapFromSource(tl.sibling(sourceRow, tl.column()));
-        auto proxyBR = proxyTL.sibling(proxyTL.row(), br.column());
-
-        emit dataChanged(proxyTL, proxyBR, roles);
-//        qDebug() << "FlattenTreeProxyModel onSourceDataChanged" << proxyTL << proxyBR << roles;
+        auto proxyIndex = mapFromSource(tl.sibling(sourceRow, 0));
+        emit dataChanged(proxyIndex, proxyIndex, roles);
     }
 }
 
-void FlattenTreeProxyModel::onSourceModelReset()
+void FlattenTreeProxyModel::onSourceModelAboutToBeReset()
 {
     beginResetModel();
+}
+
+void FlattenTreeProxyModel::onSourceModelReset()
+{
     rebuild();
     endResetModel();
 }
 
 
-void FlattenTreeProxyModel::onSourceRowsAboutToBeInserted(
-        const QModelIndex& sourceParent,
-        int first, int last)
+void FlattenTreeProxyModel::onSourceLayoutAboutToBeChanged()
 {
-    // find the position of the first source item in the proxy
-    auto sourceFirst = sourceModel()->index(first, 0, sourceParent);
+    emit layoutAboutToBeChanged();
 
-    if (!sourceFirst.isValid())
+    // remember where the persistent indices point to in the source
+    layoutProxyIndices_ = persistentIndexList();
+    layoutSourceIndices_.clear();
+    for (auto& proxyIndex : layoutProxyIndices_)
     {
-        // there was no entry yet!
-        beginInsertRows(QModelIndex(), 0, (last-first));
+        layoutSourceIndices_.append(QPersistentModelIndex(mapToSource(proxyIndex)));
     }
-    else
+}
+
+void FlattenTreeProxyModel::onSourceLayoutChanged()
+{
+    rebuild();
+
+    // and update them to the new positions
+    for (int i = 0; i < layoutProxyIndices_.size(); i++)
     {
-        auto proxyFirst = mapFromSource(sourceFirst);
-        // signal begin inserting
-        beginInsertRows(QModelIndex(), proxyFirst.row(), proxyFirst.row() + (last-first));
+        changePersistentIndex(layoutProxyIndices_[i],
+                              mapFromSource(layoutSourceIndices_[i]));
     }
+    layoutProxyIndices_.clear();
+    layoutSourceIndices_.clear();
+
+    emit layoutChanged();
 }
 
+
 void FlattenTreeProxyModel::onSourceRowsInserted(
         const QModelIndex& sourceParent,
         int first, int last)
 {
-    // find the position of the first source item in the proxy
-    auto sourceFirst = sourceModel()->index(first, 0, sourceParent);
-    auto proxyFirst = mapFromSource(sourceFirst);
+    auto parent = const_cast<Node*>(nodeFor(sourceParent));
+    if (!parent) return;
 
-    // beginInsertRows should have been called in onSourceRowsAboutToBeInserted
-
-    // there will be items inserted after proxyFirst, so all parent-indices
-    // below that which are greater or equal to proxyFirst must be incremented
-    // by (last-first+1). (Remember: the parents_ list holds parents rows+1)
-    for (int i = proxyFirst.row()+1; i < parents_.size(); i++)
-    {
-        if (parents_[i] >= (proxyFirst.row()+1)) parents_[i] += (last-first)+1;
-    }
-
-    // also, insert more rows which all have the same parent
-    auto proxyParent = mapFromSource(sourceParent);
-    int proxyParentId = (proxyParent.isValid() ? proxyParent.row()+1 : 0);
+    // mirror the new rows, including their children.
+    std::vector<std::unique_ptr<Node>> inserted;
+    int numInserted = 0;
     for (int i = first; i <= last; i++)
     {
-        parents_.insert(proxyFirst.row(), proxyParentId);
+        inserted.push_back(buildNode(sourceModel()->index(i, 0, sourceParent), parent, i));
+        numInserted += inserted.back()->size;
     }
 
-    endInsertRows();
+    // the new rows start where the child previously at "first" was
+    int proxyFirst = proxyRow(parent) + 1 + parent->sizeBefore(first);
+    beginInsertRows(QModelIndex(), proxyFirst, proxyFirst + numInserted - 1);
 
-    // One more thing: The items inserted may have sub-items, that we totally
-    // missed so far! So, process them recursively, treat every inserted item
-    // as a parent.
-    for (int i = first; i <= last; i++)
+    parent->children.insert(parent->children.begin() + first,
+                            std::make_move_iterator(inserted.begin()),
+                            std::make_move_iterator(inserted.end()));
+    for (size_t i = last + 1; i < parent->children.size(); i++)
     {
-        auto sourceIndex = sourceModel()->index(first, 0, sourceParent);
-        if (!sourceIndex.isValid()) continue;
-
-        int childCount = sourceModel()->rowCount(sourceIndex);
-        if (childCount > 0)
-        {
-            onSourceRowsAboutToBeInserted(sourceIndex, 0, childCount-1);
-            onSourceRowsInserted(sourceIndex, 0, childCount-1);
-        }
+        parent->children[i]->row = static_cast<int>(i);
     }
+    parent->rebuildFenwick();
 
-//    qDebug() << "after insert " << parents_;
+    // the fenwick tree of the parent has been rebuilt as a whole, its
+    // ancestors are updated incrementally
+    propagateSize(parent, numInserted);
+
+    endInsertRows();
 }
 
 
@@ -288,69 +366,40 @@ void FlattenTreeProxyModel::onSourceRowsAboutToBeRemoved(
         const QModelIndex& sourceParent,
         int first, int last)
 {
-//    qDebug() << "before remove " << parents_;
-
-    // in order to get valid indices here we do all this in the
-    // *AboutToBe*-removed method!
-    auto sourceFirst = sourceModel()->index(first, 0, sourceParent);
-    auto sourceLast = sourceModel()->index(last, 0, sourceParent);
-
-    // the first entry in the proxy to remove is the corresponding entry of
-    // sourceFirst:
-    auto proxyFirst = mapFromSource(sourceFirst);
-    auto proxyLastToplevel = mapFromSource(sourceLast);
-    // but the last entry in the proxy to remove is the last child of
-    // sourceLast! Even worse: The last descendant of sourceLast!
-    // How to find it? Just iterate the parents_ list. As soon as an entry is
-    // found that has a parent that is before proxyFirst, we found the first
-    // entry *not* to remove, as it opens a new subtree.
-    int proxyLastRow = proxyLastToplevel.row();
-    while (parents_.size() > (proxyLastRow+1) &&
-           parents_[proxyLastRow+1] >= (proxyFirst.row()+1))
-    {
-        // as long as there is a next entry
-        //      (parents_.size() > (proxyLastRow+1))
-        // and the entries parent is the first to remove or any after that,
-        //      (parents_[proxyLastRow+1] >= (proxyFirst.row()+1)
-        // step forward, the next is still to be removed:
-        proxyLastRow++;
-        // else we reached the first item not unter the tree of to-be-removed
-        // ones.
-    }
+    auto parent = nodeFor(sourceParent);
+    if (!parent) return;
 
-    beginRemoveRows(QModelIndex(), proxyFirst.row(), proxyLastRow);
+    // the subtrees of the removed rows are consecutive in the proxy
+    int proxyFirst = proxyRow(parent) + 1 + parent->sizeBefore(first);
+    int numRemoved = parent->sizeBefore(last + 1) - parent->sizeBefore(first);
 
-    // remember to do the actual removal in onSourceRowsRemoved
-    aboutToRemoveFirstRow_ = proxyFirst.row();
-    aboutToRemoveLastRow_ = proxyLastRow;
+    removing_ = true;
+    beginRemoveRows(QModelIndex(), proxyFirst, proxyFirst + numRemoved - 1);
 }
 
 void FlattenTreeProxyModel::onSourceRowsRemoved(
-        const QModelIndex& /*sourceParent*/,
-        int /*first*/, int /*last*/)
+        const QModelIndex& sourceParent,
+        int first, int last)
 {
-    // ignore input, we assume that this matches the last call to
-    // rowsAboutToBeRemoved
+    if (!removing_) return;
+    removing_ = false;
 
-    // now, what does removal mean? Removing list entries and decrementing
-    // the parent-ids of all entries below the last to be removed, if they
-    // refer to a parent id that comes after those who are removed.
-    int numRemoved = aboutToRemoveLastRow_ - aboutToRemoveFirstRow_ + 1;
+    // the source has already removed the rows, but its parent still has the
+    // same index
+    auto parent = const_cast<Node*>(nodeFor(sourceParent));
 
-    // decrement before removing.
-    for (int i = aboutToRemoveLastRow_ + 1; i < parents_.size(); i++)
+    int numRemoved = parent->sizeBefore(last + 1) - parent->sizeBefore(first);
+    parent->children.erase(parent->children.begin() + first,
+                           parent->children.begin() + last + 1);
+    for (size_t i = first; i < parent->children.size(); i++)
     {
-        if (parents_[i] >= (aboutToRemoveLastRow_+1)) parents_[i] -= numRemoved;
+        parent->children[i]->row = static_cast<int>(i);
     }
+    parent->rebuildFenwick();
 
-    // then remove
-    parents_.erase(parents_.begin() + aboutToRemoveFirstRow_,
-                   parents_.begin() + aboutToRemoveLastRow_+1);
-
+    propagateSize(parent, -numRemoved);
 
     endRemoveRows();
-
-//    qDebug() << "after remove " << parents_;
 }
 
 
@@ -3,6 +3,10 @@
 
 #include <QAbstractProxyModel>
 #include <QList>
+#include <QPersistentModelIndex>
+
+#include <vector>
+#include <memory>
 
 namespace sempr { namespace gui {
 
@@ -10,48 +14,80 @@ namespace sempr { namespace gui {
     This proxy flattens any tree model into a list. For this to work you
     need a constant column count, which is assumed to be 1.
 
-    Internally, this model tracks where the parent of an item in the source
-    model is in the list of this model as its (index+1). +1 to reserve 0 as an
-    indicator that the parent of the item is the root.
-
-    source model            this model      internal data
-    root                    root            root
-     L P1                    L P1            L [0]: 0
-       L C1                  L C1            L [1]: 1
-       L C2                  L C2            L [2]: 1
-         L C21       ->      L C21      ->   L [3]: 3
-         L C22               L C22           L [4]: 3
-     L P2                    L P2            L [5]: 0
-     L P3                    L P3            L [6]: 0
-       L C3                  L C3            L [7]: 7
-       L C4                  L C4            L [8]: 7
+    Every item is followed by all of its descendants (depth first):
+
+    source model            this model
+    root                    root
+     L P1                    L P1      (row 0)
+       L C1                  L C1      (row 1)
+       L C2                  L C2      (row 2)
+         L C21       ->      L C21     (row 3)
+         L C22               L C22     (row 4)
+     L P2                    L P2      (row 5)
+     L P3                    L P3      (row 6)
+       L C3                  L C3      (row 7)
+       L C4                  L C4      (row 8)
+
+    Internally, this model mirrors the structure of the source model: For
+    every item it knows the size of its subtree, and keeps the sizes of the
+    subtrees of its children in a Fenwick tree (binary indexed tree). The row
+    of an item is the row of its parent + 1 + the sizes of the subtrees of
+    all siblings above it, which the Fenwick tree answers in O(log n). The
+    other way round, the child whose subtree contains a row is found by a
+    binary search in the Fenwick tree. Hence both mapFromSource and
+    mapToSource take O(depth * log(width)).
 
     Limitations: This proxy...
         - Assumes a column count of 1
-        - Forwards dataChanged signals
-        - Should handle row-insertions and row-removals
-        - Was only tested with removal and insertion of one row at a time
-        - Will *not* handle moving rows
-        - Does not connect to layoutChanged
-
+        - Handles source layout changes and moved rows like a layout change,
+          i.e. rebuilds the mirror and updates the persistent indices
 */
 class FlattenTreeProxyModel : public QAbstractProxyModel {
-    // the list indicating who's whose parent
-    QList<int> parents_;
-
-    // iterates the source model to fill the parents_ list
+    Q_OBJECT
+
+    /// the mirror of an item of the source model
+    struct Node {
+        Node* parent = nullptr;
+        int row = 0;  // row in the parent
+        int size = 1; // number of items in the subtree, including this one
+        std::vector<std::unique_ptr<Node>> children;
+        std::vector<int> fenwick; // 1-based, over the sizes of the children
+
+        /// rebuilds the fenwick tree from the sizes of the children
+        void rebuildFenwick();
+        /// adds delta to the size of the child at the given row
+        void addToChild(int childRow, int delta);
+        /// sum of the sizes of the children [0, childRow)
+        int sizeBefore(int childRow) const;
+        /// the child whose subtree contains the given offset (counted from
+        /// the first child). Reduces offset to the offset within the subtree
+        int childAt(int& offset) const;
+    };
+
+    Node root_;
+
+    // creates the mirror of the subtree of the given source index
+    std::unique_ptr<Node> buildNode(const QModelIndex& sourceIndex, Node* parent, int row);
+
+    // iterates the source model to rebuild the mirror
     void rebuild();
 
-    // recursive method used in rebuild to fill the parents_ list
-    void addChildrenToList(const QModelIndex& index);
+    // the node for the given source index (root_ for an invalid one),
+    // nullptr if it is not known (yet)
+    const Node* nodeFor(const QModelIndex& sourceIndex) const;
+
+    // the row of the node in this model, -1 for root_
+    int proxyRow(const Node* node) const;
+
+    // adds delta to the size of the node and all its ancestors
+    void propagateSize(Node* node, int delta);
 
-    // count all decendants of the given sourceIndex
-    int numDecendants(const QModelIndex& sourceIndex) const;
+    // remembered between "about to be removed" and "removed"
+    bool removing_;
 
-    // first and last row to remove need to be computed in
-    // "about to be removed", but must only be removed when they are actually
-    // removed from the source, in "rowsRemoved".
-    int aboutToRemoveFirstRow_, aboutToRemoveLastRow_;
+    // remembered between "about to change the layout" and "layout changed"
+    QModelIndexList layoutProxyIndices_;
+    QList<QPersistentModelIndex> layoutSourceIndices_;
 
 private slots:
     // we need to map the indices and forward the data changed signal..
@@ -59,13 +95,10 @@ private slots:
     void onSourceDataChanged(const QModelIndex& tl, const QModelIndex& br,
                              const QVector<int>& roles = QVector<int>());
 
-    // I don't care about columns changing.
-    // Or about header data.
-    // Also, our source model will not do any real layout changes. Right?
-    // But modelReset is relevant!
+    void onSourceModelAboutToBeReset();
     void onSourceModelReset();
-    // also, when rows are inserted, removed moved, we need to know.
-    void onSourceRowsAboutToBeInserted(const QModelIndex& sourceParent, int first, int last);
+    void onSourceLayoutAboutToBeChanged();
+    void onSourceLayoutChanged();
     void onSourceRowsInserted(const QModelIndex& sourceParent, int first, int last);
     void onSourceRowsAboutToBeRemoved(const QModelIndex& sourceParent, int first, int last);
     void onSourceRowsRemoved(const QModelIndex& sourceParent, int first, int last);
@@ -0,0 +1,390 @@
+#include "ForceLayout.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace sempr { namespace gui {
+
+namespace {
+    // the desired distance between connected nodes
+    const double idealDistance = 120.;
+    // a group of nodes is approximated by its center of mass if its size
+    // divided by the distance is less than this
+    const double theta = 0.8;
+    // the maximum distance a node moves in one step
+    const double maxStep = 5.;
+    // smaller movements are ignored, the layout is considered stable then
+    const double minStep = 0.1;
+    // below this depth, all nodes in a cell are treated as one
+    const int maxDepth = 32;
+}
+
+
+ForceLayout::ForceLayout()
+    : running_(false), changed_(false), grabbed_(-1), publishedStep_(0)
+{
+}
+
+ForceLayout::~ForceLayout()
+{
+    stop();
+}
+
+
+void ForceLayout::start(const Input& input)
+{
+    stop();
+
+    size_t n = input.sizes.size();
+    x_.resize(n);
+    y_.resize(n);
+    weight_.resize(n);
+    halfWidth_.resize(n);
+    halfHeight_.resize(n);
+    fixed_.assign(n, 0);
+    for (size_t i = 0; i < n; i++)
+    {
+        x_[i] = input.positions[i].x();
+        y_[i] = input.positions[i].y();
+        halfWidth_[i] = input.sizes[i].width() / 2.;
+        halfHeight_[i] = input.sizes[i].height() / 2.;
+        weight_[i] = std::max(1., std::hypot(halfWidth_[i], halfHeight_[i]) / 30.);
+        if (i < input.fixed.size() && input.fixed[i]) fixed_[i] = 1;
+    }
+
+    edgeFrom_.clear();
+    edgeTo_.clear();
+    for (auto& edge : input.edges)
+    {
+        edgeFrom_.push_back(static_cast<int>(edge.first));
+        edgeTo_.push_back(static_cast<int>(edge.second));
+    }
+
+    bounds_ = input.bounds;
+    fx_.assign(n, 0.);
+    fy_.assign(n, 0.);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = true;
+        changed_ = false;
+        grabbed_ = -1;
+        published_.clear();
+        publishedStep_ = 0;
+    }
+
+    worker_ = std::thread(&ForceLayout::run, this);
+}
+
+
+void ForceLayout::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    wakeup_.notify_all();
+    if (worker_.joinable()) worker_.join();
+}
+
+
+bool ForceLayout::isRunning() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return running_;
+}
+
+
+void ForceLayout::setGrabbed(int node, const QPointF& position)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (node == grabbed_ && position == grabbedPosition_) return;
+        grabbed_ = node;
+        grabbedPosition_ = position;
+        changed_ = true;
+    }
+    wakeup_.notify_all();
+}
+
+
+bool ForceLayout::positions(std::vector<QPointF>& positions, uint64_t& step)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (publishedStep_ == step) return false;
+
+    positions = published_;
+    step = publishedStep_;
+    return true;
+}
+
+
+void ForceLayout::run()
+{
+    std::vector<QPointF> positions(x_.size());
+
+    while (true)
+    {
+        int grabbed;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!running_) return;
+
+            grabbed = grabbed_;
+            if (grabbed >= 0 && grabbed < static_cast<int>(x_.size()))
+            {
+                x_[grabbed] = grabbedPosition_.x();
+                y_[grabbed] = grabbedPosition_.y();
+            }
+            changed_ = false;
+        }
+
+        double moved = step(grabbed);
+
+        for (size_t i = 0; i < x_.size(); i++)
+        {
+            positions[i] = QPointF(x_[i], y_[i]);
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        published_.swap(positions);
+        publishedStep_++;
+        positions.resize(x_.size());
+
+        // about 100 steps per second, which is plenty for a display at 25
+        // frames per second. Once the layout is stable, only wake up when a
+        // node is grabbed.
+        auto pause = std::chrono::milliseconds(moved < minStep ? 200 : 10);
+        wakeup_.wait_for(lock, pause, [this]() { return !running_ || changed_; });
+    }
+}
+
+
+int ForceLayout::newCell(double cx, double cy, double half)
+{
+    Cell cell;
+    cell.cx = cx;
+    cell.cy = cy;
+    cell.half = half;
+    cell.mass = cell.mx = cell.my = 0.;
+    cell.children[0] = cell.children[1] = cell.children[2] = cell.children[3] = -1;
+    cell.body = Empty;
+
+    cells_.push_back(cell);
+    return static_cast<int>(cells_.size()) - 1;
+}
+
+
+void ForceLayout::buildTree()
+{
+    cells_.clear();
+    if (x_.empty()) return;
+
+    double minX = x_[0], maxX = x_[0], minY = y_[0], maxY = y_[0];
+    for (size_t i = 1; i < x_.size(); i++)
+    {
+        minX = std::min(minX, x_[i]);
+        maxX = std::max(maxX, x_[i]);
+        minY = std::min(minY, y_[i]);
+        maxY = std::max(maxY, y_[i]);
+    }
+
+    double half = std::max(maxX - minX, maxY - minY) / 2. + 1.;
+    newCell((minX + maxX) / 2., (minY + maxY) / 2., half);
+
+    for (size_t i = 0; i < x_.size(); i++)
+    {
+        insert(static_cast<int>(i));
+    }
+}
+
+
+void ForceLayout::insert(int node)
+{
+    // the quadrant of the cell the position is in
+    auto quadrant = [this](int cell, double x, double y) -> int
+    {
+        return (x >= cells_[cell].cx ? 1 : 0) + (y >= cells_[cell].cy ? 2 : 0);
+    };
+
+    // the child cell in the quadrant, created if needed
+    auto child = [this](int cell, int q) -> int
+    {
+        if (cells_[cell].children[q] == -1)
+        {
+            double half = cells_[cell].half / 2.;
+            double cx = cells_[cell].cx + ((q & 1) ? half : -half);
+            double cy = cells_[cell].cy + ((q & 2) ? half : -half);
+            int created = newCell(cx, cy, half); // invalidates references
+            cells_[cell].children[q] = created;
+        }
+        return cells_[cell].children[q];
+    };
+
+    double w = weight_[node];
+    int cell = 0;
+    for (int depth = 0; ; depth++)
+    {
+        bool wasEmpty = cells_[cell].mass == 0.;
+        cells_[cell].mass += w;
+        cells_[cell].mx += w * x_[node];
+        cells_[cell].my += w * y_[node];
+
+        if (wasEmpty && cells_[cell].body == Empty)
+        {
+            cells_[cell].body = node;
+            return;
+        }
+        if (cells_[cell].body == Crowded) return;
+
+        if (cells_[cell].body >= 0)
+        {
+            // a leaf with another node: too deep to split any further (e.g.
+            // nodes at the same position), or move the other node down
+            if (depth >= maxDepth)
+            {
+                cells_[cell].body = Crowded;
+                return;
+            }
+
+            int other = cells_[cell].body;
+            cells_[cell].body = Internal;
+
+            int sub = child(cell, quadrant(cell, x_[other], y_[other]));
+            cells_[sub].mass = weight_[other];
+            cells_[sub].mx = weight_[other] * x_[other];
+            cells_[sub].my = weight_[other] * y_[other];
+            cells_[sub].body = other;
+        }
+
+        cell = child(cell, quadrant(cell, x_[node], y_[node]));
+    }
+}
+
+
+void ForceLayout::repulsion(int node)
+{
+    const double k2 = idealDistance * idealDistance;
+    double x = x_[node];
+    double y = y_[node];
+    double w = weight_[node];
+    double fx = 0., fy = 0.;
+
+    stack_.clear();
+    stack_.push_back(0);
+    while (!stack_.empty())
+    {
+        const Cell& cell = cells_[stack_.back()];
+        stack_.pop_back();
+
+        if (cell.mass == 0. || cell.body == node) continue;
+
+        double mass = cell.mass;
+        double mx = cell.mx;
+        double my = cell.my;
+        if (cell.body == Crowded &&
+            x >= cell.cx - cell.half && x < cell.cx + cell.half &&
+            y >= cell.cy - cell.half && y < cell.cy + cell.half)
+        {
+            // the node is one of the crowd, and does not repel itself
+            mass -= w;
+            mx -= w * x;
+            my -= w * y;
+            if (mass <= 1e-9) continue;
+        }
+
+        double dx = x - mx / mass;
+        double dy = y - my / mass;
+        double d2 = dx * dx + dy * dy;
+
+        bool far = (4. * cell.half * cell.half) < (theta * theta * d2);
+        if (cell.body >= 0 || cell.body == Crowded || far)
+        {
+            if (d2 < 0.01)
+            {
+                // on top of each other: push in some direction that depends
+                // on the node, so that they separate (in 64 bit, node * 104729
+                // overflows an int from node 20506 on)
+                int64_t n = node;
+                dx = 0.1 * ((n * 7919) % 13 - 6) + 0.05;
+                dy = 0.1 * ((n * 104729) % 11 - 5) + 0.05;
+                d2 = dx * dx + dy * dy;
+            }
+
+            // k^2 / d, in the direction of (dx, dy) / d
+            double f = k2 * w * mass / d2;
+            fx += f * dx;
+            fy += f * dy;
+        }
+        else
+        {
+            for (int c : cell.children)
+            {
+                if (c != -1) stack_.push_back(c);
+            }
+        }
+    }
+
+    fx_[node] += fx;
+    fy_[node] += fy;
+}
+
+
+double ForceLayout::step(int grabbed)
+{
+    size_t n = x_.size();
+    std::fill(fx_.begin(), fx_.end(), 0.);
+    std::fill(fy_.begin(), fy_.end(), 0.);
+
+    // repulsion between all nodes
+    buildTree();
+    for (size_t i = 0; i < n; i++)
+    {
+        repulsion(static_cast<int>(i));
+    }
+
+    // attraction along the edges: d^2 / k, in the direction of the edge
+    for (size_t e = 0; e < edgeFrom_.size(); e++)
+    {
+        int a = edgeFrom_[e];
+        int b = edgeTo_[e];
+        double dx = x_[b] - x_[a];
+        double dy = y_[b] - y_[a];
+        double d = std::sqrt(dx * dx + dy * dy);
+        double f = d / idealDistance;
+
+        fx_[a] += f * dx;
+        fy_[a] += f * dy;
+        fx_[b] -= f * dx;
+        fy_[b] -= f * dy;
+    }
+
+    // move by the forces, but at most maxStep
+    double moved = 0.;
+    for (size_t i = 0; i < n; i++)
+    {
+        if (fixed_[i] || static_cast<int>(i) == grabbed) continue;
+
+        double f = std::sqrt(fx_[i] * fx_[i] + fy_[i] * fy_[i]);
+        double distance = std::min(f, maxStep);
+        if (distance < minStep) continue;
+
+        x_[i] += fx_[i] / f * distance;
+        y_[i] += fy_[i] / f * distance;
+
+        if (!bounds_.isEmpty())
+        {
+            x_[i] = std::min(std::max(x_[i], bounds_.left() + halfWidth_[i]),
+                             bounds_.right() - halfWidth_[i]);
+            y_[i] = std::min(std::max(y_[i], bounds_.top() + halfHeight_[i]),
+                             bounds_.bottom() - halfHeight_[i]);
+        }
+
+        moved = std::max(moved, distance);
+    }
+
+    return moved;
+}
+
+}}
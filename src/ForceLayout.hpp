@@ -0,0 +1,124 @@
+#ifndef SEMPR_GUI_FORCELAYOUT_HPP_
+#define SEMPR_GUI_FORCELAYOUT_HPP_
+
+#include <QPointF>
+#include <QSizeF>
+#include <QRectF>
+
+#include <vector>
+#include <utility>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+namespace sempr { namespace gui {
+
+/**
+    A force directed layout (Fruchterman-Reingold) that runs continuously on
+    a worker thread, for the dynamic positioning of graph nodes.
+
+    Nodes repel each other, edges pull their nodes together. The repulsion
+    is approximated with a Barnes-Hut quadtree, which is rebuilt in every
+    step: a group of nodes that is far enough away acts as a single node in
+    its center of mass. A step takes O(n log n) instead of O(n^2), so
+    thousands of nodes can be moved many times per second. The positions are
+    kept in flat arrays, and after every step a copy is published, which
+    the gui thread fetches once per frame (see positions).
+
+    A node can be fixed (e.g. the root), and one node at a time can be
+    grabbed, i.e. moved by the user instead of the forces.
+*/
+class ForceLayout {
+public:
+    struct Input {
+        // the sizes of the nodes, in scene coordinates
+        std::vector<QSizeF> sizes;
+        // the edges, as indices into sizes
+        std::vector<std::pair<size_t, size_t>> edges;
+        // the initial positions of the nodes
+        std::vector<QPointF> positions;
+        // nodes that are not moved, may be empty
+        std::vector<bool> fixed;
+        // nodes are kept in here, if not empty
+        QRectF bounds;
+    };
+
+private:
+    // the graph. The weight of a node grows with its size, so that large
+    // nodes keep more distance.
+    std::vector<double> x_, y_, weight_, halfWidth_, halfHeight_;
+    std::vector<char> fixed_;
+    std::vector<int> edgeFrom_, edgeTo_;
+    QRectF bounds_;
+
+    // the forces of the current step
+    std::vector<double> fx_, fy_;
+
+    // A cell of the quadtree. Empty cells have no mass, leaves hold a single
+    // node, or, below the maximum depth, all remaining nodes.
+    struct Cell {
+        double cx, cy, half;   // center and half of the side length
+        double mass, mx, my;   // total weight, and the weighted sum of positions
+        int children[4];       // -1 if there is none
+        int body;              // the node of a leaf, see below
+    };
+    enum { Empty = -1, Internal = -2, Crowded = -3 };
+    std::vector<Cell> cells_;
+    std::vector<int> stack_;
+
+    int newCell(double cx, double cy, double half);
+    void buildTree();
+    void insert(int node);
+    void repulsion(int node);
+
+    // one step of the layout, returns the largest distance a node moved
+    double step(int grabbed);
+
+    // the worker and the state shared with the gui thread
+    std::thread worker_;
+    mutable std::mutex mutex_;
+    std::condition_variable wakeup_;
+    bool running_;
+    bool changed_;
+    int grabbed_;
+    QPointF grabbedPosition_;
+    std::vector<QPointF> published_;
+    uint64_t publishedStep_;
+
+    void run();
+
+public:
+    ForceLayout();
+    ~ForceLayout();
+
+    /**
+        Stops a running layout, and starts a new one with the given graph
+        and initial positions.
+    */
+    void start(const Input& input);
+
+    /**
+        Stops the worker. Waits for the current step to finish.
+    */
+    void stop();
+
+    bool isRunning() const;
+
+    /**
+        Moves a node to the given position and keeps it there, until another
+        one (or -1 for none) is grabbed.
+    */
+    void setGrabbed(int node, const QPointF& position);
+
+    /**
+        Copies the positions of the nodes after the latest step into
+        positions. Returns false if there has been no step since the given
+        one. The number of the latest step is stored in step.
+    */
+    bool positions(std::vector<QPointF>& positions, uint64_t& step);
+};
+
+}}
+
+#endif /* include guard: SEMPR_GUI_FORCELAYOUT_HPP_ */
@@ -8,9 +8,15 @@
 namespace sempr { namespace gui {
 
 GeoMapWidget::GeoMapWidget(QWidget* parent)
-    : QWidget(parent), form_(new Ui::GeoMapWidget)
+    : QWidget(parent), form_(new Ui::GeoMapWidget),
+      viewportProxy_(&geometryProxy_)
 {
     form_->setupUi(this);
+
+    viewportTimer_.setSingleShot(true);
+    viewportTimer_.setInterval(100);
+    connect(&viewportTimer_, &QTimer::timeout,
+            this, &GeoMapWidget::updateViewport);
 }
 
 GeoMapWidget::~GeoMapWidget()
@@ -18,19 +24,24 @@ GeoMapWidget::~GeoMapWidget()
     delete form_;
 }
 
-void GeoMapWidget::setup(QAbstractItemModel* model, QItemSelectionModel* sourceSelectionModel)
+void GeoMapWidget::setup(QAbstractItemModel* model, QItemSelectionModel* sourceSelectionModel,
+                         const TileServer::Config& tiles)
 {
     // connect the flattener, to make the geometry filter work
     flattenProxy_.setSourceModel(model);
     // connect the geometry filter
     geometryProxy_.setSourceModel(&flattenProxy_);
-    // connect the role name proxy
-    roleNamesProxy_.setSourceModel(&geometryProxy_);
+    // the viewport filter is connected to the geometry filter on
+    // construction. Connect the role name proxy
+    roleNamesProxy_.setSourceModel(&viewportProxy_);
 
     // make the model known before loading the qml
     form_->quickWidget->rootContext()->setContextProperty("geometryModel", &roleNamesProxy_);
     // also, make *this* known, in oder to connect to signals
     form_->quickWidget->rootContext()->setContextProperty("GeoMapWidget", this);
+    // and where to get the map tiles from
+    tileServer_.start(tiles);
+    form_->quickWidget->rootContext()->setContextProperty("tileServerUrl", tileServer_.url());
 
     // load the qml
     form_->quickWidget->setSource(QUrl("qrc:/geomap.qml"));
@@ -46,6 +57,88 @@ void GeoMapWidget::setup(QAbstractItemModel* model, QItemSelectionModel* sourceS
     QObject* rootObject = form_->quickWidget->rootObject();
     connect(rootObject, SIGNAL(geometryDelegateClicked(int)),
             this, SLOT(onGeometryDelegateClicked(int)));
+
+    // update the viewport filter when the map is moved, zoomed or resized
+    QObject* map = rootObject->findChild<QObject*>("map");
+    connect(map, SIGNAL(centerChanged(QGeoCoordinate)),
+            this, SLOT(onMapViewportChanged()));
+    connect(map, SIGNAL(zoomLevelChanged(qreal)),
+            this, SLOT(onMapViewportChanged()));
+    connect(map, SIGNAL(widthChanged()),
+            this, SLOT(onMapViewportChanged()));
+    connect(map, SIGNAL(heightChanged()),
+            this, SLOT(onMapViewportChanged()));
+    updateViewport();
+}
+
+
+void GeoMapWidget::onMapViewportChanged()
+{
+    viewportTimer_.start();
+}
+
+void GeoMapWidget::updateViewport()
+{
+    QQuickItem* root = form_->quickWidget->rootObject();
+    QObject* map = root->findChild<QObject*>("map");
+    double zoomLevel = map->property("zoomLevel").toDouble();
+
+    viewportProxy_.setViewport(mapTopLeft(), mapBottomRight(), zoomLevel);
+    tileServer_.prefetch(mapTopLeft(), mapBottomRight(), zoomLevel);
+}
+
+QGeoRectangle GeoMapWidget::geometryBounds()
+{
+    return viewportProxy_.geometryBounds();
+}
+
+QGeoRectangle GeoMapWidget::geometryBoundsAt(int row)
+{
+    auto geometryIndex =
+        viewportProxy_.mapToSource(
+            roleNamesProxy_.mapToSource(
+                roleNamesProxy_.index(row, 0)
+            )
+        );
+
+    QRectF b;
+    if (!geometryProxy_.bounds(geometryIndex, b)) return QGeoRectangle();
+
+    return QGeoRectangle(QGeoCoordinate(b.bottom(), b.left()),
+                         QGeoCoordinate(b.top(), b.right()));
+}
+
+QModelIndexList GeoMapWidget::geometriesIn(const QGeoRectangle& rectangle)
+{
+    QModelIndexList indices;
+    for (auto& geometryIndex : viewportProxy_.geometriesIn(rectangle))
+    {
+        indices.append(flattenProxy_.mapToSource(geometryProxy_.mapToSource(geometryIndex)));
+    }
+    return indices;
+}
+
+QModelIndex GeoMapWidget::nearestGeometry(const QGeoCoordinate& coordinate)
+{
+    auto geometryIndex = viewportProxy_.nearestGeometry(coordinate);
+    return flattenProxy_.mapToSource(geometryProxy_.mapToSource(geometryIndex));
+}
+
+void GeoMapWidget::selectGeometriesIn(const QGeoRectangle& rectangle)
+{
+    auto indices = geometriesIn(rectangle);
+
+    QItemSelection selection;
+    for (auto& index : indices)
+    {
+        selection.select(index, index);
+    }
+    sourceSelectionModel_->select(selection, QItemSelectionModel::ClearAndSelect);
+
+    if (!indices.isEmpty())
+    {
+        sourceSelectionModel_->setCurrentIndex(indices.first(), QItemSelectionModel::NoUpdate);
+    }
 }
 
 
@@ -56,8 +149,10 @@ void GeoMapWidget::onGeometryDelegateClicked(int index)
     auto sourceIndex =
         flattenProxy_.mapToSource(
             geometryProxy_.mapToSource(
-                roleNamesProxy_.mapToSource(
-                    proxyIndex
+                viewportProxy_.mapToSource(
+                    roleNamesProxy_.mapToSource(
+                        proxyIndex
+                    )
                 )
             )
         );
@@ -70,12 +165,21 @@ void GeoMapWidget::onSourceCurrentRowChanged(
         const QModelIndex& current,
         const QModelIndex& /*previous*/)
 {
+    auto geometryIndex =
+        geometryProxy_.mapFromSource(
+            flattenProxy_.mapFromSource(
+                current
+            )
+        );
+
+    // make sure the current item is instantiated, even if it is not in the
+    // visible section of the map, so that the map can focus on it
+    viewportProxy_.setPinned(geometryIndex);
+
     auto proxyIndex =
         roleNamesProxy_.mapFromSource(
-            geometryProxy_.mapFromSource(
-                flattenProxy_.mapFromSource(
-                    current
-                )
+            viewportProxy_.mapFromSource(
+                geometryIndex
             )
         );
 
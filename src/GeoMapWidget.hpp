@@ -5,12 +5,15 @@
 #include <QStandardItemModel>
 #include <QAbstractItemModel>
 #include <QGeoCoordinate>
+#include <QGeoRectangle>
 
 #include <QTimer>
 
 #include "RoleNameProxyModel.hpp"
 #include "GeometryFilterProxyModel.hpp"
 #include "FlattenTreeProxyModel.hpp"
+#include "ViewportFilterProxyModel.hpp"
+#include "TileServer.hpp"
 
 namespace Ui {
     class GeoMapWidget;
@@ -34,10 +37,20 @@ class GeoMapWidget : public QWidget {
     // and provide access to the coordinates
     GeometryFilterProxyModel geometryProxy_;
 
+    // a proxy that only shows the geometries in the visible section of the
+    // map, in a level of detail that fits the zoom level
+    ViewportFilterProxyModel viewportProxy_;
+
+    // delays updates of the viewport while the map is moved
+    QTimer viewportTimer_;
+
     // a helper proxy that exports methods to convert role names to integers
     // and back, used for qml stuff due to a bug in the qml map view.
     RoleNameProxyModel roleNamesProxy_;
 
+    // provides the map tiles: local, cached, downloaded and prefetched
+    TileServer tileServer_;
+
 public slots:
     // updates the current (selected) item in the map view
     void onSourceCurrentRowChanged(const QModelIndex& current, const QModelIndex& previous);
@@ -45,6 +58,13 @@ public slots:
     // connected to the qml side, sets the currently selected component to the
     // one that was clicked
     void onGeometryDelegateClicked(int index);
+
+    // connected to the qml side, (re)starts the timer to update the viewport
+    void onMapViewportChanged();
+
+    // passes the visible section of the map to the viewportProxy_ and the
+    // tileServer_
+    void updateViewport();
 signals:
     // emitted when the source current row changed, contains the matching index
     // for the proxy model in use. To be connected to from the qml side to
@@ -58,9 +78,11 @@ public:
     /**
         Connects models, filters, and loads the qml.
         Takes as input the basic data model and a selection model that is
-        monitored to update the view (highlight current selection).
+        monitored to update the view (highlight current selection), and the
+        configuration of the map tiles.
     */
-    void setup(QAbstractItemModel* model, QItemSelectionModel* selectionModel);
+    void setup(QAbstractItemModel* model, QItemSelectionModel* selectionModel,
+               const TileServer::Config& tiles = TileServer::Config());
 
     // returns the center of the currently visible map section
     QGeoCoordinate mapCenter() const;
@@ -70,6 +92,26 @@ public:
 
     // returns the coordinate of the bottom-right corner of the map
     QGeoCoordinate mapBottomRight() const;
+
+    // returns the bounding box of all geometries, including those that are
+    // not instantiated in the map. Used by the qml side to reset the view.
+    Q_INVOKABLE QGeoRectangle geometryBounds();
+
+    // returns the bounding box of the geometry in the given row of the model
+    // used on the qml side. Used to focus the selected item.
+    Q_INVOKABLE QGeoRectangle geometryBoundsAt(int row);
+
+    // returns the indices (of the data model) of all geometries whose
+    // bounding box intersects the rectangle
+    QModelIndexList geometriesIn(const QGeoRectangle& rectangle);
+
+    // returns the index (of the data model) of the geometry nearest to the
+    // coordinate, invalid if there is none
+    QModelIndex nearestGeometry(const QGeoCoordinate& coordinate);
+
+    // selects all geometries in the rectangle in the selection model, and
+    // makes the first one the current item
+    Q_INVOKABLE void selectGeometriesIn(const QGeoRectangle& rectangle);
 };
 
 }}
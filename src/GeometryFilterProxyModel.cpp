@@ -2,10 +2,16 @@
 #include "CustomDataRoles.hpp"
 #include "GeosQCoordinateTranform.hpp"
 
+#include <QTimer>
+
+#include <geos/geom/Geometry.h>
+#include <geos/geom/Envelope.h>
+#include <algorithm>
+
 namespace sempr { namespace gui {
 
 GeometryFilterProxyModel::GeometryFilterProxyModel(QObject* parent)
-    : QSortFilterProxyModel(parent)
+    : QSortFilterProxyModel(parent), refilterScheduled_(false)
 {
     /*
         From the Qt documentation:
@@ -17,6 +23,183 @@ GeometryFilterProxyModel::GeometryFilterProxyModel(QObject* parent)
     this->setDynamicSortFilter(false);
 }
 
+void GeometryFilterProxyModel::setSourceModel(QAbstractItemModel* model)
+{
+    if (sourceModel())
+    {
+        disconnect(sourceModel(), nullptr, this, nullptr);
+    }
+
+    cache_.clear();
+
+    // connect before the base class does, see the header
+    if (model)
+    {
+        cache_.resize(model->rowCount());
+
+        connect(model, &QAbstractItemModel::dataChanged,
+                this, &GeometryFilterProxyModel::onSourceDataChanged);
+        connect(model, &QAbstractItemModel::rowsInserted,
+                this, &GeometryFilterProxyModel::onSourceRowsInserted);
+        connect(model, &QAbstractItemModel::rowsRemoved,
+                this, &GeometryFilterProxyModel::onSourceRowsRemoved);
+        connect(model, &QAbstractItemModel::modelReset,
+                this, &GeometryFilterProxyModel::onSourceReset);
+        connect(model, &QAbstractItemModel::layoutChanged,
+                this, &GeometryFilterProxyModel::onSourceReset);
+        connect(model, &QAbstractItemModel::rowsMoved,
+                this, &GeometryFilterProxyModel::onSourceReset);
+    }
+
+    QSortFilterProxyModel::setSourceModel(model);
+}
+
+void GeometryFilterProxyModel::onSourceDataChanged(
+        const QModelIndex& tl, const QModelIndex& br)
+{
+    if (tl.parent().isValid()) return;
+
+    bool pending = false;
+    for (int row = tl.row(); row <= br.row() && row < (int)cache_.size(); row++)
+    {
+        pending = pending || cache_[row].pending;
+        cache_[row] = Cached();
+    }
+
+    if (pending && !refilterScheduled_)
+    {
+        refilterScheduled_ = true;
+        QTimer::singleShot(0, this,
+            [this]()
+            {
+                refilterScheduled_ = false;
+                invalidateFilter();
+            });
+    }
+}
+
+void GeometryFilterProxyModel::onSourceRowsInserted(
+        const QModelIndex& parent, int first, int last)
+{
+    if (parent.isValid()) return;
+    cache_.insert(cache_.begin() + first, last - first + 1, Cached());
+}
+
+void GeometryFilterProxyModel::onSourceRowsRemoved(
+        const QModelIndex& parent, int first, int last)
+{
+    if (parent.isValid()) return;
+    cache_.erase(cache_.begin() + first, cache_.begin() + last + 1);
+}
+
+void GeometryFilterProxyModel::onSourceReset()
+{
+    cache_.clear();
+    cache_.resize(sourceModel()->rowCount());
+}
+
+
+GeometryFilterProxyModel::Cached* GeometryFilterProxyModel::cached(
+        const QModelIndex& sourceIndex) const
+{
+    if (!sourceIndex.isValid() || sourceIndex.parent().isValid()) return nullptr;
+    if (sourceIndex.row() >= (int)cache_.size()) return nullptr;
+
+    return &cache_[sourceIndex.row()];
+}
+
+void GeometryFilterProxyModel::load(
+        Cached& entry, const QModelIndex& sourceIndex) const
+{
+    if (entry.loaded) return;
+    entry.loaded = true;
+
+    auto geo = GeometryFilterProxyModel::geomPointerFromIndex(sourceIndex);
+    if (geo && geo->geometry())
+    {
+        ReadCoordinates filter;
+        geo->geometry()->apply_ro(filter);
+
+        entry.levels.push_back(filter.packedCoordinates());
+        entry.lists.resize(numDetailLevels);
+        entry.listed.resize(numDetailLevels, false);
+        entry.type = QString::fromStdString(geo->geometry()->getGeometryType());
+
+        auto env = geo->geometry()->getEnvelopeInternal();
+        entry.bounds = QRectF(env->getMinX(), env->getMinY(),
+                              env->getWidth(), env->getHeight());
+    }
+}
+
+GeometryFilterProxyModel::Cached& GeometryFilterProxyModel::loaded(
+        const QModelIndex& index, Cached& fallback) const
+{
+    auto sourceIndex = this->mapToSource(index);
+    auto entry = cached(sourceIndex);
+    if (!entry) entry = &fallback;
+
+    load(*entry, sourceIndex);
+    return *entry;
+}
+
+double GeometryFilterProxyModel::detailTolerance(int level)
+{
+    // a pixel is about 1e-5 degrees at zoom level 17, and 1e-2 at level 7
+    static const double tolerances[numDetailLevels] = {
+        0, 1e-5, 1e-4, 1e-3, 1e-2
+    };
+
+    if (level <= 0) return 0;
+    if (level >= numDetailLevels) return tolerances[numDetailLevels-1];
+    return tolerances[level];
+}
+
+const QVector<double>& GeometryFilterProxyModel::level(Cached& entry, int level) const
+{
+    level = std::max(0, std::min(level, numDetailLevels-1));
+
+    // Compute all levels at once, each from the previous one. Polygons must
+    // keep at least 4 coordinates (first == last), linestrings 2, else the
+    // previous level is used.
+    if (level > 0 && entry.levels.size() == 1)
+    {
+        int minCoordinates = (entry.type == "Polygon" ? 4 : 2);
+        for (int i = 1; i < numDetailLevels; i++)
+        {
+            auto simplified = simplifyCoordinates(entry.levels.back(), detailTolerance(i));
+            if (simplified.size() / 3 < minCoordinates) simplified = entry.levels.back();
+            entry.levels.push_back(simplified);
+        }
+    }
+
+    return entry.levels[level];
+}
+
+bool GeometryFilterProxyModel::bounds(const QModelIndex& index, QRectF& box) const
+{
+    Cached uncached;
+    auto& entry = loaded(index, uncached);
+    if (entry.type.isEmpty()) return false;
+
+    box = entry.bounds;
+    return true;
+}
+
+QVariantList GeometryFilterProxyModel::coordinates(const QModelIndex& index, int lod) const
+{
+    Cached uncached;
+    auto& entry = loaded(index, uncached);
+    if (entry.type.isEmpty()) return QVariantList();
+
+    lod = std::max(0, std::min(lod, numDetailLevels-1));
+    if (!entry.listed[lod])
+    {
+        entry.lists[lod] = ReadCoordinates::unpack(level(entry, lod));
+        entry.listed[lod] = true;
+    }
+    return entry.lists[lod];
+}
+
 std::shared_ptr<GeosGeometryInterface> GeometryFilterProxyModel::geomPointerFromIndex(const QModelIndex& index)
 {
     // use the ComponentPtrRole to get a Component::Ptr
@@ -39,37 +222,74 @@ bool GeometryFilterProxyModel::filterAcceptsRow(
         int sourceRow, const QModelIndex& sourceParent) const
 {
     auto index = sourceModel()->index(sourceRow, 0, sourceParent);
+
+    auto entry = cached(index);
+    if (entry && entry->checked) return entry->isGeometry;
+
+    // components of a type that was already checked are decided by the type
+    // name alone, without deserializing them
+    auto type = index.data(Role::ComponentTypeRole).toString();
+    if (!type.isEmpty())
+    {
+        auto known = isGeometryType_.find(type);
+        if (known != isGeometryType_.end())
+        {
+            if (entry)
+            {
+                entry->checked = true;
+                entry->isGeometry = known->second;
+            }
+            return known->second;
+        }
+    }
+
     auto geo = GeometryFilterProxyModel::geomPointerFromIndex(index);
 
     // qDebug() << "GeometryFilterProxyModel accept? " << (geo ? "yes" : "no");
 
+    // the json is still being fetched, decide when it is there
+    if (!geo && index.data(Role::ComponentJsonRole).toString().isEmpty())
+    {
+        if (entry) entry->pending = true;
+        return false;
+    }
+
+    // only remember the result if the component could be created at all
+    if (!type.isEmpty() && index.data(Role::ComponentPtrRole).value<Component::Ptr>())
+    {
+        isGeometryType_[type] = (geo != nullptr);
+    }
+
+    if (entry)
+    {
+        entry->checked = true;
+        entry->isGeometry = (geo != nullptr);
+    }
+
     if (geo) return true;
     return false;
 }
 
 QVariant GeometryFilterProxyModel::data(const QModelIndex& index, int role) const
 {
-    if (role == Role::CoordinatesRole)
+    if (role == Role::CoordinatesRole ||
+        role == Role::PackedCoordinatesRole ||
+        role == Role::GeosGeometryTypeRole)
     {
-        auto sourceIndex = this->mapToSource(index);
-        auto geo = GeometryFilterProxyModel::geomPointerFromIndex(sourceIndex);
-        if (geo && geo->geometry())
-        {
-            ReadCoordinates filter;
-            geo->geometry()->apply_ro(filter);
+        Cached uncached;
+        auto& entry = loaded(index, uncached);
 
-            return filter.coordinates();
-        }
-    }
-    else if (role == Role::GeosGeometryTypeRole)
-    {
-        auto sourceIndex = this->mapToSource(index);
-        auto geo = GeometryFilterProxyModel::geomPointerFromIndex(sourceIndex);
-        if (geo && geo->geometry())
+        if (entry.type.isEmpty()) return QVariant(); // not a geometry
+
+        if (role == Role::GeosGeometryTypeRole) return entry.type;
+        if (role == Role::PackedCoordinatesRole)
         {
-            std::string type = geo->geometry()->getGeometryType();
-            return QString::fromStdString(type);
+            // implicitly shared, no copy of the coordinates
+            return QVariant::fromValue(entry.levels[0]);
         }
+
+        // the list is shared, too, but only built when first needed
+        return coordinates(index, 0);
     }
 
     return QSortFilterProxyModel::data(index, role);
@@ -159,6 +379,7 @@ QHash<int, QByteArray> GeometryFilterProxyModel::roleNames() const
     auto names = QSortFilterProxyModel::roleNames();
     names[Role::CoordinatesRole] = "coordinates";
     names[Role::GeosGeometryTypeRole] = "geometryType";
+    names[Role::PackedCoordinatesRole] = "packedCoordinates";
     return names;
 }
 
@@ -2,17 +2,81 @@
 #define SEMPR_GUI_GEOMETRYFILTERPROXYMODEL_HPP_
 
 #include <QSortFilterProxyModel>
+#include <QVector>
+#include <QRectF>
 #include "ECModel.hpp"
 
 #include <sempr/component/GeosGeometry.hpp>
+#include <map>
+#include <vector>
 
 namespace sempr { namespace gui {
 
 /**
     This model filters the components, accepting only those who are a
     GeoGeometry, and adds roles to get and set the geometries coordinates.
+
+    The coordinates and the type of a geometry are extracted only once and
+    cached per source row, until the source signals that the row changed.
+    The cache expects a flat source model (like the FlattenTreeProxyModel);
+    rows with a valid parent are not cached.
+
+    For rendering at lower zoom levels, simplified versions of the
+    coordinates are available in a few levels of detail, see coordinates().
 */
 class GeometryFilterProxyModel : public QSortFilterProxyModel {
+    Q_OBJECT
+
+    // remembers for every polymorphic type name of a component if it is a
+    // geometry, so that filterAcceptsRow does not need to deserialize every
+    // component.
+    mutable std::map<QString, bool> isGeometryType_;
+
+    // what is known about a source row
+    struct Cached {
+        bool checked = false;   // isGeometry is known
+        bool isGeometry = false;
+        bool pending = false;   // rejected as the json is not fetched yet
+        bool loaded = false;    // type and coordinates are known
+        QString type;
+        QRectF bounds;          // x = longitude, y = latitude
+        // lat, long, alt of every coordinate, per level of detail. Only the
+        // first one is set on load, the others are added when needed.
+        std::vector<QVector<double>> levels;
+        // the coordinates as QGeoCoordinates, built on first access
+        std::vector<QVariantList> lists;
+        std::vector<bool> listed;
+    };
+    mutable std::vector<Cached> cache_;
+
+    // Rows rejected while their json was still being fetched (metadata-only
+    // mode) are checked again when it arrives. As dynamicSortFilter is off,
+    // this needs an explicit re-filter, which is done once for all rows that
+    // arrived until control returns to the event loop.
+    bool refilterScheduled_;
+
+    // the cache entry of the given source index, nullptr if not cacheable
+    Cached* cached(const QModelIndex& sourceIndex) const;
+
+    // extracts the type and coordinates of the geometry, if not done yet
+    void load(Cached& entry, const QModelIndex& sourceIndex) const;
+
+    // the loaded cache entry for an index of this model. Uses and returns
+    // the fallback if the row cannot be cached.
+    Cached& loaded(const QModelIndex& index, Cached& fallback) const;
+
+    // the simplified coordinates of the given level
+    const QVector<double>& level(Cached& entry, int level) const;
+
+private slots:
+    // keep the cache aligned with the rows of the source. These are
+    // connected before the QSortFilterProxyModel connects to the source, so
+    // the cache is up to date when it re-filters.
+    void onSourceDataChanged(const QModelIndex& tl, const QModelIndex& br);
+    void onSourceRowsInserted(const QModelIndex& parent, int first, int last);
+    void onSourceRowsRemoved(const QModelIndex& parent, int first, int last);
+    void onSourceReset();
+
 protected:
     // helper - retrieve the component ptr through the ComponentPtrRole and
     // cast it to a GeosGeometry::Ptr
@@ -21,6 +85,31 @@ protected:
 public:
     GeometryFilterProxyModel(QObject* parent = nullptr);
 
+    void setSourceModel(QAbstractItemModel* model) override;
+
+    /// number of levels of detail, 0 is the original geometry
+    static const int numDetailLevels = 5;
+
+    /**
+        The tolerance (in degrees) used to simplify the coordinates of the
+        given level of detail.
+    */
+    static double detailTolerance(int level);
+
+    /**
+        Sets box to the bounding box of the geometry at the given index, with
+        x = longitude and y = latitude. Returns false if there is no
+        geometry.
+    */
+    bool bounds(const QModelIndex& index, QRectF& box) const;
+
+    /**
+        Returns the coordinates of the geometry at the given index, as
+        QGeoCoordinates, simplified to the given level of detail. The levels
+        are computed on first access, and cached like the coordinates.
+    */
+    QVariantList coordinates(const QModelIndex& index, int level) const;
+
     /**
         Returns true if the component at the given entry is a GeosGeometry.
     */
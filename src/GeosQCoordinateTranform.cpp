@@ -3,6 +3,10 @@
 #include <geos/geom/CoordinateSequence.h>
 #include <QGeoCoordinate>
 
+#include <vector>
+#include <utility>
+#include <cmath>
+
 namespace sempr { namespace gui {
 
 
@@ -16,15 +20,12 @@ ReadCoordinates::ReadCoordinates()
 
 void ReadCoordinates::read(const geos::geom::CoordinateSequence& sequence)
 {
+    packed_.reserve(packed_.size() + 3 * static_cast<int>(sequence.size()));
     for (size_t i = 0; i < sequence.size(); i++)
     {
         auto& coordinate = sequence.getAt(i);
-        coordinates_.push_back(
-            QVariant::fromValue(
-                //                  lat         long        alt
-                QGeoCoordinate(coordinate.y, coordinate.x, coordinate.z)
-            )
-        );
+        //         lat              long             alt
+        packed_ << coordinate.y << coordinate.x << coordinate.z;
     }
 
     done_ = true;
@@ -52,12 +53,32 @@ bool ReadCoordinates::isGeometryChanged() const
 
 QList<QVariant> ReadCoordinates::coordinates() const
 {
-    return coordinates_;
+    return unpack(packed_);
+}
+
+const QVector<double>& ReadCoordinates::packedCoordinates() const
+{
+    return packed_;
+}
+
+QList<QVariant> ReadCoordinates::unpack(const QVector<double>& packed)
+{
+    QList<QVariant> coordinates;
+    coordinates.reserve(packed.size() / 3);
+    for (int i = 0; i + 2 < packed.size(); i += 3)
+    {
+        coordinates.push_back(
+            QVariant::fromValue(
+                QGeoCoordinate(packed[i], packed[i+1], packed[i+2])
+            )
+        );
+    }
+    return coordinates;
 }
 
 void ReadCoordinates::reset()
 {
-    coordinates_.clear();
+    packed_.clear();
     done_ = false;
 }
 
@@ -99,4 +120,110 @@ bool WriteCoordinates::isGeometryChanged() const
 }
 
 
+// -------------------------------------------------------------------------
+// simplifyCoordinates
+// -------------------------------------------------------------------------
+namespace {
+    // squared distance of vertex p to the segment a-b, in the lat/long plane
+    double squaredSegmentDistance(const QVector<double>& packed, int p, int a, int b)
+    {
+        double px = packed[3*p+1], py = packed[3*p];
+        double ax = packed[3*a+1], ay = packed[3*a];
+        double bx = packed[3*b+1], by = packed[3*b];
+
+        double dx = bx - ax, dy = by - ay;
+        double lengthSq = dx*dx + dy*dy;
+        double t = 0;
+        if (lengthSq > 0)
+        {
+            t = ((px - ax) * dx + (py - ay) * dy) / lengthSq;
+            t = std::max(0., std::min(1., t));
+        }
+
+        double cx = ax + t * dx - px;
+        double cy = ay + t * dy - py;
+        return cx*cx + cy*cy;
+    }
+
+    // marks the vertices in (first, last) to keep
+    void douglasPeucker(const QVector<double>& packed, int first, int last,
+                        double toleranceSq, std::vector<bool>& keep)
+    {
+        // explicit stack instead of recursion, rings may be long
+        std::vector<std::pair<int, int>> stack;
+        stack.push_back({first, last});
+
+        while (!stack.empty())
+        {
+            int a = stack.back().first;
+            int b = stack.back().second;
+            stack.pop_back();
+
+            int farthest = -1;
+            double maxDistSq = toleranceSq;
+            for (int i = a + 1; i < b; i++)
+            {
+                double distSq = squaredSegmentDistance(packed, i, a, b);
+                if (distSq > maxDistSq)
+                {
+                    farthest = i;
+                    maxDistSq = distSq;
+                }
+            }
+
+            if (farthest != -1)
+            {
+                keep[farthest] = true;
+                stack.push_back({a, farthest});
+                stack.push_back({farthest, b});
+            }
+        }
+    }
+}
+
+QVector<double> simplifyCoordinates(const QVector<double>& packed, double tolerance)
+{
+    int count = packed.size() / 3;
+    if (count < 3) return packed;
+
+    std::vector<bool> keep(count, false);
+    keep[0] = true;
+    keep[count-1] = true;
+
+    bool closed = packed[0] == packed[3*(count-1)] &&
+                  packed[1] == packed[3*(count-1)+1];
+    if (closed)
+    {
+        // the segment from first to last has length 0. Split the ring at
+        // the vertex farthest from the first one.
+        int farthest = 1;
+        double maxDistSq = -1;
+        for (int i = 1; i < count-1; i++)
+        {
+            double distSq = squaredSegmentDistance(packed, i, 0, 0);
+            if (distSq > maxDistSq)
+            {
+                farthest = i;
+                maxDistSq = distSq;
+            }
+        }
+
+        keep[farthest] = true;
+        douglasPeucker(packed, 0, farthest, tolerance*tolerance, keep);
+        douglasPeucker(packed, farthest, count-1, tolerance*tolerance, keep);
+    }
+    else
+    {
+        douglasPeucker(packed, 0, count-1, tolerance*tolerance, keep);
+    }
+
+    QVector<double> simplified;
+    for (int i = 0; i < count; i++)
+    {
+        if (keep[i]) simplified << packed[3*i] << packed[3*i+1] << packed[3*i+2];
+    }
+    return simplified;
+}
+
+
 }}
@@ -5,16 +5,18 @@
 #include <QGeoCoordinate>
 #include <QList>
 #include <QVariant>
+#include <QVector>
 
 namespace sempr { namespace gui {
 
 /**
     A coordinate filter that reads the coordinate sequence of a geometry
-    and converts it to a QList<QVariant>, where the variants hold
+    into a packed array of (latitude, longitude, altitude) triples, which can
+    be converted to a QList<QVariant>, where the variants hold
     QGeoCoordinates.
 */
 class ReadCoordinates : public geos::geom::CoordinateSequenceFilter {
-    QList<QVariant> coordinates_;
+    QVector<double> packed_;
     bool done_;
 protected:
     void read(const geos::geom::CoordinateSequence&);
@@ -31,6 +33,17 @@ public:
     */
     QList<QVariant> coordinates() const;
 
+    /**
+        Returns the coordinates as consecutive latitude, longitude and
+        altitude values.
+    */
+    const QVector<double>& packedCoordinates() const;
+
+    /**
+        Converts packed coordinates to a list of QGeoCoordinates in QVariants.
+    */
+    static QList<QVariant> unpack(const QVector<double>& packed);
+
     /**
         Resets the internal state in order to reuse the filter.
     */
@@ -55,6 +68,16 @@ public:
 };
 
 
+/**
+    Simplifies packed coordinates (latitude, longitude, altitude triples, see
+    ReadCoordinates) with the Douglas-Peucker algorithm: Only vertices that
+    are farther than tolerance (in degrees) away from the simplified line
+    are kept. The first and last vertex are always kept, and a closed ring
+    (first == last) stays closed.
+*/
+QVector<double> simplifyCoordinates(const QVector<double>& packed, double tolerance);
+
+
 }}
 
 #endif /* include guard: SEMPR_GUI_GEOSQCOORDINATETRANSFORM_HPP_ */
@@ -73,13 +73,17 @@ QRectF GraphEdgeItem::boundingRect() const
     return QRectF(fromPoint_,
                     QSizeF(toPoint_.x() - fromPoint_.x(),
                            toPoint_.y() - fromPoint_.y())).normalized()
-                                                          .adjusted(-50, -50, 50, 50);
+                                                          .adjusted(-15, -15, 15, 15); // arrow head
 }
 
 
-void GraphEdgeItem::paint(QPainter* painter, const QStyleOptionGraphicsItem*, QWidget*)
+void GraphEdgeItem::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget*)
 {
     if (!fromNode_ || !toNode_) return;
+    // overlapping nodes, nothing to draw
+    if (fromPoint_ == toPoint_) return;
+
+    const double lod = option->levelOfDetailFromTransform(painter->worldTransform());
 
     QColor solBlack(7, 54, 66);
     QColor solWhite(238, 232, 213);
@@ -89,8 +93,6 @@ void GraphEdgeItem::paint(QPainter* painter, const QStyleOptionGraphicsItem*, QW
     QColor solRed(220, 50, 47);
 
 
-    painter->setRenderHint(QPainter::RenderHint::HighQualityAntialiasing);
-
     QPen pen(solBlue, 2);
 
     if (globalHighlight_)
@@ -104,6 +106,16 @@ void GraphEdgeItem::paint(QPainter* painter, const QStyleOptionGraphicsItem*, QW
     }
 
     painter->setPen(pen);
+
+    // the arrow head would not be visible anyway
+    if (lod < GraphNodeItem::minTextLevelOfDetail)
+    {
+        painter->setRenderHint(QPainter::RenderHint::HighQualityAntialiasing, false);
+        painter->drawLine(fromPoint_, toPoint_);
+        return;
+    }
+
+    painter->setRenderHint(QPainter::RenderHint::HighQualityAntialiasing);
     painter->drawLine(fromPoint_, toPoint_);
 
     // draw an arrow head
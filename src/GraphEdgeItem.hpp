@@ -30,6 +30,11 @@ public:
     GraphNodeItem* to() const;
 
     QRectF boundingRect() const override;
+
+    /**
+        Paints the edge. When zoomed out, without arrow head and
+        antialiasing.
+    */
     void paint(QPainter*, const QStyleOptionGraphicsItem*, QWidget*) override;
 };
 
@@ -5,10 +5,14 @@
 #include <QFontMetrics>
 #include <QApplication>
 #include <QGraphicsView>
+#include <QStyleOptionGraphicsItem>
+#include <algorithm>
 #include <cmath>
 
 namespace sempr { namespace gui {
 
+const double GraphNodeItem::minTextLevelOfDetail = 0.4;
+
 GraphNodeItem::GraphNodeItem(const QString& text, Shape s)
     : text_(text), shape_(s), highlight_(false), localHighlight_(false)
 {
@@ -81,8 +85,10 @@ QFont GraphNodeItem::font() const
     return font;
 }
 
-void GraphNodeItem::paint(QPainter* painter, const QStyleOptionGraphicsItem*, QWidget*)
+void GraphNodeItem::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget*)
 {
+    const double lod = option->levelOfDetailFromTransform(painter->worldTransform());
+
     auto rect = drawingRect();
     auto txtRect = textRect();
 
@@ -108,16 +114,24 @@ void GraphNodeItem::paint(QPainter* painter, const QStyleOptionGraphicsItem*, QW
     }
 
     painter->setPen(pen);
+    painter->setBrush(background);
+
+    // zoomed out: just a box, cheap to draw for thousands of nodes
+    if (lod < minTextLevelOfDetail)
+    {
+        painter->setRenderHint(QPainter::RenderHint::HighQualityAntialiasing, false);
+        painter->drawRect(rect);
+        return;
+    }
+
     painter->setRenderHint(QPainter::RenderHint::HighQualityAntialiasing);
 
     if (shape_ == Shape::Rectangle)
     {
-        painter->fillRect(rect, background);
         painter->drawRect(rect);
     }
     else if (shape_ == Shape::Ellipse)
     {
-        painter->setBrush(background);
         painter->drawEllipse(rect);
     }
 
@@ -133,6 +147,12 @@ void GraphNodeItem::addEdge(GraphEdgeItem* edge)
 }
 
 
+void GraphNodeItem::removeEdge(GraphEdgeItem* edge)
+{
+    edges_.erase(std::remove(edges_.begin(), edges_.end(), edge), edges_.end());
+}
+
+
 std::vector<GraphEdgeItem*> GraphNodeItem::edges() const
 {
     return edges_;
@@ -217,6 +237,11 @@ void GraphNodeItem::setHighlighted(bool on)
     update();
 }
 
+QString GraphNodeItem::text() const
+{
+    return text_;
+}
+
 bool GraphNodeItem::isHighlighted() const
 {
     return highlight_;
@@ -250,125 +275,4 @@ void GraphNodeItem::hoverLeaveEvent(QGraphicsSceneHoverEvent* e)
     QGraphicsItem::hoverLeaveEvent(e);
 }
 
-
-
-void GraphNodeItem::calculateForces()
-{
-    if (!scene() || scene()->mouseGrabberItem() == this)
-    {
-        dynamicNewPos_ = pos();
-        return;
-    }
-
-    if (text_ == "Root")
-    {
-        dynamicNewPos_ = pos();
-        return;
-    }
-
-
-    auto thisRect = boundingRect();
-
-    // first part: push away from other nodes
-    qreal xvel = 0;
-    qreal yvel = 0;
-    const QList<QGraphicsItem*> items = scene()->items();
-
-
-    QMap<GraphNodeItem*, double> distances;
-
-    for (auto item : items)
-    {
-        if (item == this) continue;
-
-        GraphNodeItem* node = dynamic_cast<GraphNodeItem*>(item);
-        if (!node) continue;
-
-
-        QPointF vec = mapToItem(node, 0, 0);
-        qreal dx = vec.x();
-        qreal dy = vec.y();
-        double l = (dx*dx + dy*dy);
-
-
-        // subtract the length of the connecting lines inside the objects.
-        // -> dont push centers away, but borders!
-        // approximated by ellipses.
-        //
-        auto thisRect = boundingRect();
-        auto otherRect = node->boundingRect();
-
-        double lengthInsideThis = ellipseRadiusAtVectorIntersection(
-                                    thisRect.width()/2., thisRect.height()/2.,
-                                    dx, dy);
-        double lengthInsideOther = ellipseRadiusAtVectorIntersection(
-                                    otherRect.width()/2., otherRect.height()/2.,
-                                    -dx, -dy);
-
-        double lengthInside = lengthInsideThis + lengthInsideOther;
-        // if lengthInside >= length: contact.
-        // actual distance: length - lengthInside.
-        double lengthDiff = l - lengthInside*lengthInside;
-        if (lengthDiff < 0)
-        {
-            l = 1./(abs(lengthDiff)+10.);
-        }
-        else
-            l = lengthDiff;
-
-        distances[node] = l;
-
-        //if (l > 0)// && l < 200*200)
-        {
-            double dxvel = (dx*30.)/(abs(l)+10);
-            double dyvel = (dy*30.)/(abs(l)+10);
-
-            xvel += dxvel*abs(dxvel);
-            yvel += dyvel*abs(dyvel);
-//            xvel += (dxvel*dxvel);
-//            yvel += (dyvel*dyvel);
-        }
-    }
-
-
-    // second part: pull together by edges
-    double weight = (edges_.size() + 1) * 50;
-    for (auto edge : edges_)
-    {
-        GraphNodeItem* other;
-        if (edge->from() == this) other = edge->to();
-        else                      other = edge->from();
-
-        QPointF vec = mapToItem(other, 0, 0);
-
-        xvel -= vec.x() / weight;
-        yvel -= vec.y() / weight;
-    }
-
-    if (qAbs(xvel) < 0.1) xvel = 0;
-    if (qAbs(yvel) < 0.1) yvel = 0;
-    if (qAbs(xvel) > 5.0) xvel = 5. * (xvel < 0 ? -1. : 1.);
-    if (qAbs(yvel) > 5.0) yvel = 5. * (yvel < 0 ? -1. : 1.);
-
-    dynamicNewPos_ = pos() + QPointF(xvel, yvel);
-
-    auto sceneRect = scene()->sceneRect();
-    dynamicNewPos_.setX(
-            qMin(qMax(dynamicNewPos_.x(), sceneRect.left() + thisRect.width()/2.),
-                                          sceneRect.right() - thisRect.width()/2.));
-
-    dynamicNewPos_.setY(
-            qMin(qMax(dynamicNewPos_.y(), sceneRect.top() + thisRect.height()/2.),
-                                          sceneRect.bottom() - thisRect.height()/2.));
-
-}
-
-bool GraphNodeItem::advancePosition()
-{
-    if (dynamicNewPos_ == pos()) return false;
-    setPos(dynamicNewPos_);
-    return true;
-}
-
-
 }}
@@ -14,8 +14,6 @@ namespace sempr { namespace gui {
 class GraphNodeItem : public QGraphicsItem {
 public:
     enum Shape { Ellipse, Rectangle };
-private:
-    QPointF dynamicNewPos_; // for dynamic force positioning
 protected:
     QString text_;
     Shape shape_;
@@ -58,9 +56,17 @@ public:
                                 // boundingRect to accomodate for line thickness
     QRectF textRect() const; // size that the text will occupy
 
+    /**
+        Paints the node. When zoomed out so far that the text would be
+        unreadable, only the outline is drawn.
+    */
     void paint(QPainter*, const QStyleOptionGraphicsItem*, QWidget*) override;
 
+    /// the level of detail below which no text is drawn
+    static const double minTextLevelOfDetail;
+
     void addEdge(GraphEdgeItem* edge);
+    void removeEdge(GraphEdgeItem* edge);
     std::vector<GraphEdgeItem*> edges() const;
 
 
@@ -75,17 +81,14 @@ public:
     */
     QVariant itemChange(GraphicsItemChange change, const QVariant& value) override;
 
+    QString text() const;
+
     void setHighlighted(bool);
     bool isHighlighted() const;
 
     // highlight node locally on hover
     void hoverEnterEvent(QGraphicsSceneHoverEvent *event) override;
     void hoverLeaveEvent(QGraphicsSceneHoverEvent *event) override;
-
-    // test dynamic positioning through forces between nodes and edges,
-    // see the qt elastic nodes example
-    void calculateForces();
-    bool advancePosition();
 };
 
 }}
@@ -5,8 +5,8 @@
 
 #include <QString>
 #include <map>
-#include <rete-core/Util.hpp> // ptr to string
-#include <iostream>
+#include <mutex>
+#include <string>
 
 namespace sempr { namespace gui {
 
@@ -41,9 +41,37 @@ int _agset(void* obj, const char* name, const char* value)
 }
 
 
-void GraphvizLayout::layout(const std::vector<GraphNodeItem*>& nodes,
-                            const std::vector<GraphEdgeItem*>& edges)
+GraphvizLayout::Input GraphvizLayout::input(
+        const std::vector<GraphNodeItem*>& nodes,
+        const std::vector<GraphEdgeItem*>& edges)
+{
+    Input input;
+
+    std::map<GraphNodeItem*, size_t> indices;
+    for (auto& node : nodes)
+    {
+        indices[node] = input.sizes.size();
+        input.sizes.push_back(node->boundingRect().size());
+    }
+
+    for (auto& edge : edges)
+    {
+        auto from = indices.find(edge->from());
+        auto to = indices.find(edge->to());
+        if (from == indices.end() || to == indices.end()) continue;
+
+        input.edges.push_back({ from->second, to->second });
+    }
+
+    return input;
+}
+
+
+std::vector<QPointF> GraphvizLayout::layout(const Input& input)
 {
+    static std::mutex graphvizMutex;
+    std::lock_guard<std::mutex> lock(graphvizMutex);
+
     // create the graphviz context and a graph
     GVC_t* gvc = gvContext();
     Agraph_t* G = _agopen("mygraph", Agdirected, nullptr);
@@ -69,30 +97,28 @@ void GraphvizLayout::layout(const std::vector<GraphNodeItem*>& nodes,
     _agattr(G, AGNODE, "label", "");
 
     // create all nodes
-    std::map<GraphNodeItem*, Agnode_t*> agNodes;
-    for (auto& node : nodes)
+    std::vector<Agnode_t*> agNodes;
+    agNodes.reserve(input.sizes.size());
+    for (size_t i = 0; i < input.sizes.size(); i++)
     {
-        auto rect = node->boundingRect();
+        auto& size = input.sizes[i];
 
-        QString width = QString::number(rect.width() / dpi);
-        QString height = QString::number(rect.height() / dpi);
+        QString width = QString::number(size.width() / dpi);
+        QString height = QString::number(size.height() / dpi);
 
-        std::string nodeId = rete::util::ptrToStr(node);
+        std::string nodeId = std::to_string(i);
 
         Agnode_t* newNode = _agnode(G, nodeId.c_str(), true);
         _agset(newNode, "width", width.toStdString().c_str());
         _agset(newNode, "height", height.toStdString().c_str());
 
-        agNodes[node] = newNode;
+        agNodes.push_back(newNode);
     }
 
     // create all edges
-    for (auto& edge : edges)
+    for (auto& edge : input.edges)
     {
-        auto fromNode = agNodes[edge->from()];
-        auto toNode = agNodes[edge->to()];
-
-        _agedge(G, fromNode, toNode, nullptr, true);
+        _agedge(G, agNodes[edge.first], agNodes[edge.second], nullptr, true);
     }
 
     // do the layout
@@ -104,21 +130,34 @@ void GraphvizLayout::layout(const std::vector<GraphNodeItem*>& nodes,
     const float DotDefaultDPI = 72.f;
     float scale = dpi / DotDefaultDPI;
 
-    // apply layout information to GraphNodeItems
-    for (auto& entry : agNodes)
+    std::vector<QPointF> positions;
+    positions.reserve(agNodes.size());
+    for (auto agNode : agNodes)
     {
-        auto item = entry.first;
-        auto agNode = entry.second;
-
         auto coord = ND_coord(agNode);
-        item->setPos(coord.x * scale, -coord.y * scale);
-        item->update();
+        positions.push_back(QPointF(coord.x * scale, -coord.y * scale));
     }
 
     // cleanup
     gvFreeLayout(gvc, G);
     agclose(G);
+    gvFreeContext(gvc);
+
+    return positions;
 }
 
 
+void GraphvizLayout::layout(const std::vector<GraphNodeItem*>& nodes,
+                            const std::vector<GraphEdgeItem*>& edges)
+{
+    auto positions = layout(input(nodes, edges));
+
+    // apply layout information to GraphNodeItems
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        nodes[i]->setPos(positions[i]);
+        nodes[i]->update();
+    }
+}
+
 }}
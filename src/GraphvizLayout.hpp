@@ -6,6 +6,9 @@
 #include <vector>
 #include <utility>
 
+#include <QSizeF>
+#include <QPointF>
+
 #include "GraphNodeItem.hpp"
 #include "GraphEdgeItem.hpp"
 
@@ -19,6 +22,32 @@ class GraphvizLayout {
     GraphvizLayout() = delete;
 
 public:
+    /**
+        A graph to layout, without any reference to graphics items, so that
+        the layout can be computed on another thread.
+    */
+    struct Input {
+        // the sizes of the nodes, in scene coordinates
+        std::vector<QSizeF> sizes;
+        // the edges, as indices into sizes
+        std::vector<std::pair<size_t, size_t>> edges;
+    };
+
+    /**
+        Collects the sizes of the nodes and the edges between them. Must be
+        called on the gui thread, as the sizes depend on the fonts in use.
+        Edges to nodes that are not in the list are skipped.
+    */
+    static Input input(const std::vector<GraphNodeItem*>& nodes,
+                       const std::vector<GraphEdgeItem*>& edges);
+
+    /**
+        Computes the positions of the nodes of the input. May be called from
+        any thread; graphviz itself is not thread safe, so concurrent calls
+        are serialized.
+    */
+    static std::vector<QPointF> layout(const Input& input);
+
     /**
         Takes lists of nodes and edges and adjusts their layout by using the
         graphviz library.
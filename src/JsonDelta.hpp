@@ -0,0 +1,77 @@
+#ifndef SEMPR_GUI_JSONDELTA_HPP_
+#define SEMPR_GUI_JSONDELTA_HPP_
+
+#include <string>
+#include <sstream>
+#include <algorithm>
+
+namespace sempr { namespace gui {
+
+/**
+    A minimal text delta between two versions of the json representation of a
+    component: The length of the common prefix and suffix, and the text that
+    replaces everything in between. When only a small part of a large
+    component changes (e.g. one triple in a TripleVector) this is much smaller
+    than the complete json.
+
+    This works on the text instead of the parsed json on purpose: Applying the
+    delta reproduces the new json byte by byte, so that the result can be
+    checked against ECData::jsonHash. Re-serializing a patched json document
+    would not necessarily match the formatting of cereal.
+
+    Format: "<prefix length>:<suffix length>:<replacement>"
+*/
+struct JsonDelta {
+    static std::string create(const std::string& from, const std::string& to)
+    {
+        size_t maxCommon = std::min(from.size(), to.size());
+
+        size_t prefix = 0;
+        while (prefix < maxCommon && from[prefix] == to[prefix]) prefix++;
+
+        // the suffix must not overlap with the prefix
+        size_t suffix = 0;
+        while (suffix < maxCommon - prefix &&
+               from[from.size() - 1 - suffix] == to[to.size() - 1 - suffix])
+        {
+            suffix++;
+        }
+
+        std::stringstream ss;
+        ss << prefix << ":" << suffix << ":"
+           << to.substr(prefix, to.size() - prefix - suffix);
+        return ss.str();
+    }
+
+    /**
+        Applies the delta to base. Returns false if the delta is malformed or
+        does not fit the base.
+    */
+    static bool apply(const std::string& base, const std::string& delta,
+                      std::string& result)
+    {
+        size_t first = delta.find(':');
+        if (first == std::string::npos) return false;
+        size_t second = delta.find(':', first + 1);
+        if (second == std::string::npos) return false;
+
+        size_t prefix, suffix;
+        try {
+            prefix = std::stoul(delta.substr(0, first));
+            suffix = std::stoul(delta.substr(first + 1, second - first - 1));
+        } catch (std::exception&) {
+            return false;
+        }
+
+        if (prefix + suffix > base.size()) return false;
+
+        result = base.substr(0, prefix)
+               + delta.substr(second + 1)
+               + base.substr(base.size() - suffix);
+        return true;
+    }
+};
+
+}}
+
+#endif /* include guard: SEMPR_GUI_JSONDELTA_HPP_ */
@@ -3,20 +3,57 @@
 #include <sempr/Component.hpp>
 #include <cereal/archives/json.hpp>
 #include <sstream>
+#include <iostream>
 
 namespace sempr { namespace gui {
 
+ModelEntry::ModelEntry()
+    : componentLoaded_(false)
+{
+}
+
 ModelEntry::ModelEntry(const ECData& data)
+    : coreData_(data),
+      componentJSON_(data.componentJSON),
+      componentLoaded_(false),
+      componentType_(data.componentType.empty() ?
+                        polymorphicNameFromJSON(data.componentJSON) :
+                        data.componentType)
 {
-    coreData_ = data;
-    setJSON(data.componentJSON);
     setTag(data.tag);
 }
 
+void ModelEntry::setFetchedJSON(const ECData& full)
+{
+    coreData_.componentJSON = full.componentJSON;
+    coreData_.jsonHash = full.jsonHash;
+    coreData_.hasJSON = true;
+    componentJSON_ = full.componentJSON;
+    componentType_ = full.componentType.empty() ?
+                        polymorphicNameFromJSON(full.componentJSON) :
+                        full.componentType;
+
+    // deserialize it on the next access
+    component_ = nullptr;
+    componentLoaded_ = false;
+}
+
+void ModelEntry::takeJSONFrom(const ModelEntry& other)
+{
+    if (coreData_.hasJSON || !other.coreData_.hasJSON) return;
+    if (coreData_.jsonHash == 0 ||
+        coreData_.jsonHash != other.coreData_.jsonHash) return;
+
+    coreData_.componentJSON = other.coreData_.componentJSON;
+    coreData_.hasJSON = true;
+    componentJSON_ = coreData_.componentJSON;
+}
+
 std::string ModelEntry::entityId()           const { return coreData_.entityId; }
 std::string ModelEntry::componentId()        const { return coreData_.componentId; }
 std::string ModelEntry::tag()                const { return tag_; }
 bool        ModelEntry::isComponentMutable() const { return coreData_.isComponentMutable; }
+bool        ModelEntry::hasJSON()            const { return coreData_.hasJSON; }
 
 void ModelEntry::setTag(const std::string& tag)
 {
@@ -25,6 +62,7 @@ void ModelEntry::setTag(const std::string& tag)
 
 bool ModelEntry::isModified() const
 {
+    // (if the json is not there yet, it cannot have been modified either)
     return !(coreData_.componentJSON == componentJSON_) ||
            !(coreData_.tag == tag_);
 }
@@ -37,12 +75,34 @@ std::string ModelEntry::json() const
 
 Component::Ptr ModelEntry::component() const
 {
+    // nothing to deserialize yet, try again when the json is there
+    if (!coreData_.hasJSON) return nullptr;
+
+    if (!componentLoaded_)
+    {
+        componentLoaded_ = true;
+        try {
+            std::stringstream ss(componentJSON_);
+            cereal::JSONInputArchive ar(ss);
+            ar(component_);
+        } catch (cereal::Exception& e) {
+            std::cerr << "ModelEntry::component: " << e.what() << std::endl;
+            component_ = nullptr;
+        }
+    }
     return component_;
 }
 
+std::string ModelEntry::componentType() const
+{
+    return componentType_;
+}
+
 bool ModelEntry::setJSON(const std::string& json)
 {
     componentJSON_ = json;
+    componentType_ = polymorphicNameFromJSON(json);
+    componentLoaded_ = true;
     try {
         std::stringstream ss(json);
         cereal::JSONInputArchive ar(ss);
@@ -61,7 +121,8 @@ bool ModelEntry::setJSON(const std::string& json)
 
 void ModelEntry::componentPtrChanged()
 {
-    if (!component_) return;
+    // nothing can have changed if it was not even created yet
+    if (!componentLoaded_ || !component_) return;
 
     try {
         std::stringstream ss;
@@ -18,9 +18,14 @@ namespace sempr { namespace gui {
     string and a deserialized Component::Ptr as a "staging" area. The different
     views/editors may edit these, and the state can be reset if mistakes were
     made.
+
+    The Component::Ptr is only deserialized when it is first accessed, as
+    most components are never looked at in detail. If the entry was received
+    without the json representation (ECData::hasJSON == false), json() is
+    empty and component() is nullptr until the ECModel has fetched the json
+    in the background and handed it over through setFetchedJSON.
 */
 class ModelEntry {
-
     /**
         The data as it was retrieved by the core.
     */
@@ -39,20 +44,38 @@ class ModelEntry {
 
     /**
         A Component::Ptr deserialized from the componentJSON_, for convenience.
+        Created on the first call to component(), componentLoaded_ tells if
+        this already happened.
     */
-    Component::Ptr component_;
+    mutable Component::Ptr component_;
+    mutable bool componentLoaded_;
+
+    /// the polymorphic type name of the component, read from the json
+    std::string componentType_;
 
     friend class ECModel;
 protected:
     /**
         Constructs a ModelEntry from some received data.
-        This already tries to deserialize the json representation to set the
-        Component::Ptr.
+        The json representation is not deserialized yet, see component().
     */
     explicit ModelEntry(const ECData& data);
 
+    /**
+        Sets the json of an entry received without it, from the complete
+        data fetched from the core. Also updates the component type.
+    */
+    void setFetchedJSON(const ECData& full);
+
+    /**
+        If this entry has been received without json, but refers to the same
+        content (same jsonHash) as the other entry which already has the json,
+        take it from there instead of fetching it again.
+    */
+    void takeJSONFrom(const ModelEntry& other);
+
 public:
-    ModelEntry() = default;
+    ModelEntry();
     ModelEntry(const ModelEntry&) = default;
     ~ModelEntry() = default;
 
@@ -61,6 +84,12 @@ public:
     std::string tag() const;
     bool isComponentMutable() const;
 
+    /**
+        False while the json of an entry received without it has not been
+        fetched yet. json() is empty and component() nullptr until then.
+    */
+    bool hasJSON() const;
+
     void setTag(const std::string&);
 
     /**
@@ -77,9 +106,17 @@ public:
 
     /**
         Returns the current state of the model entry as a component ptr.
+        Deserializes the json representation on the first call, returns
+        nullptr if that fails or the json is not available yet.
     */
     Component::Ptr component() const;
 
+    /**
+        Returns the polymorphic type name of the component as stored in the
+        json representation, without deserializing it. Empty if unknown.
+    */
+    std::string componentType() const;
+
     /**
         Sets componentJSON_ = json and tries to de-serialize the component.
         On success, sets component_ to the newly created component, returns true.
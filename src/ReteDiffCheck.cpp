@@ -0,0 +1,222 @@
+#include <iostream>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ReteVisualSerialization.hpp"
+
+/*
+    Randomized check of GraphDiff::between. Creates random graphs, changes
+    them (adds and removes nodes and edges, changes labels and types), and
+    checks that the diff turns the old graph into the new one, both through
+    GraphDiff::applyTo and the way ReteWidget::patch applies it to the scene,
+    where removing a node also removes all of its edges.
+
+    usage: sempr-gui-rete-diff-check [numGraphs] [seed]
+    Returns 0 if all results match.
+*/
+
+using namespace sempr::gui;
+
+namespace {
+
+bool equal(const Graph& a, const Graph& b)
+{
+    return std::equal(a.nodes.begin(), a.nodes.end(), b.nodes.begin(), b.nodes.end(),
+                      [](const Node& x, const Node& y)
+                      {
+                          return x.id == y.id && x.label == y.label && x.type == y.type;
+                      }) &&
+           std::equal(a.edges.begin(), a.edges.end(), b.edges.begin(), b.edges.end(),
+                      [](const Edge& x, const Edge& y)
+                      {
+                          return x.from == y.from && x.to == y.to;
+                      });
+}
+
+bool hasNode(const Graph& graph, const std::string& id)
+{
+    Node key;
+    key.id = id;
+    return graph.nodes.find(key) != graph.nodes.end();
+}
+
+/// applies the diff like ReteWidget::patch does with the scene items
+Graph patched(Graph graph, const GraphDiff& diff)
+{
+    for (auto& edge : diff.removedEdges)
+    {
+        graph.edges.erase(edge);
+    }
+    for (auto& id : diff.removedNodes)
+    {
+        Node key;
+        key.id = id;
+        graph.nodes.erase(key);
+
+        // the edge items of a node are deleted with it
+        for (auto edge = graph.edges.begin(); edge != graph.edges.end();)
+        {
+            if (edge->from == id || edge->to == id) edge = graph.edges.erase(edge);
+            else ++edge;
+        }
+    }
+
+    graph.nodes.insert(diff.addedNodes.begin(), diff.addedNodes.end());
+    for (auto& edge : diff.addedEdges)
+    {
+        // edges between unknown nodes are skipped
+        if (hasNode(graph, edge.from) && hasNode(graph, edge.to))
+            graph.edges.insert(edge);
+    }
+    return graph;
+}
+
+class Check {
+    std::mt19937 random_;
+    size_t failures_;
+
+    bool chance(double p)
+    {
+        return std::uniform_real_distribution<double>(0, 1)(random_) < p;
+    }
+
+    Node randomNode(const std::string& id)
+    {
+        Node node;
+        node.id = id;
+        node.type = static_cast<Node::Type>(random_() % 3);
+        node.label = "label " + std::to_string(random_() % 3);
+        return node;
+    }
+
+    void addRandomEdges(Graph& graph, size_t count)
+    {
+        if (graph.nodes.empty()) return;
+        std::vector<std::string> ids;
+        for (auto& node : graph.nodes) ids.push_back(node.id);
+        for (size_t i = 0; i < count; i++)
+        {
+            graph.edges.insert({ ids[random_() % ids.size()],
+                                 ids[random_() % ids.size()] });
+        }
+    }
+
+    Graph randomGraph(size_t numNodes)
+    {
+        Graph graph;
+        for (size_t i = 0; i < numNodes; i++)
+        {
+            graph.nodes.insert(randomNode("node_" + std::to_string(i)));
+        }
+        addRandomEdges(graph, numNodes * 2);
+        return graph;
+    }
+
+    /// removes, replaces and adds nodes and edges
+    Graph changed(const Graph& from, size_t numNodes)
+    {
+        Graph to;
+        for (auto& node : from.nodes)
+        {
+            if (chance(0.1)) continue;
+            if (chance(0.2)) to.nodes.insert(randomNode(node.id));
+            else to.nodes.insert(node);
+        }
+        for (size_t i = numNodes; i < numNodes + 5; i++)
+        {
+            if (chance(0.5)) to.nodes.insert(randomNode("node_" + std::to_string(i)));
+        }
+
+        for (auto& edge : from.edges)
+        {
+            if (!chance(0.1) && hasNode(to, edge.from) && hasNode(to, edge.to))
+                to.edges.insert(edge);
+        }
+        addRandomEdges(to, numNodes / 4);
+        return to;
+    }
+
+    void fail(const std::string& what)
+    {
+        if (failures_++ < 10) std::cerr << "FAILED: " << what << std::endl;
+    }
+
+public:
+    Check(unsigned seed) : random_(seed), failures_(0) {}
+
+    size_t failures() const { return failures_; }
+
+    void check(const Graph& from, const Graph& to, const std::string& name)
+    {
+        auto diff = GraphDiff::between(from, to);
+
+        Graph applied = from;
+        diff.applyTo(applied);
+        if (!equal(applied, to)) fail(name + ": applyTo");
+
+        if (!equal(patched(from, diff), to)) fail(name + ": patch");
+
+        if (diff.empty() != equal(from, to)) fail(name + ": empty");
+    }
+
+    /// a node with a new label, all of its edges unchanged
+    void replacedNode()
+    {
+        Graph from;
+        from.nodes.insert({ Node::CONDITION, "a", "a" });
+        from.nodes.insert({ Node::MEMORY, "b", "b" });
+        from.nodes.insert({ Node::PRODUCTION, "c", "c" });
+        from.edges.insert({ "a", "b" });
+        from.edges.insert({ "b", "c" });
+
+        Graph to = from;
+        to.nodes.erase(Node{ Node::MEMORY, "b", "" });
+        to.nodes.insert({ Node::MEMORY, "b", "b changed" });
+
+        check(from, to, "replaced node");
+    }
+
+    void randomGraphs(size_t numGraphs)
+    {
+        for (size_t i = 0; i < numGraphs; i++)
+        {
+            size_t numNodes = 1 + random_() % 40;
+            auto from = randomGraph(numNodes);
+            auto to = changed(from, numNodes);
+            check(from, to, "random graph " + std::to_string(i));
+            check(from, from, "unchanged graph " + std::to_string(i));
+        }
+    }
+};
+
+}
+
+
+int main(int argc, char** args)
+{
+    size_t numGraphs = 1000;
+    unsigned seed = 42;
+    try {
+        if (argc > 1) numGraphs = std::stoul(args[1]);
+        if (argc > 2) seed = std::stoul(args[2]);
+    } catch (std::exception&) {
+        std::cerr << "usage: " << args[0] << " [numGraphs] [seed]" << std::endl;
+        return 2;
+    }
+
+    Check check(seed);
+    check.replacedNode();
+    check.randomGraphs(numGraphs);
+
+    if (check.failures() > 0)
+    {
+        std::cerr << check.failures() << " checks failed" << std::endl;
+        return 1;
+    }
+
+    std::cout << "all checks passed (" << numGraphs << " graphs, seed "
+              << seed << ")" << std::endl;
+    return 0;
+}
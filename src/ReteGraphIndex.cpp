@@ -0,0 +1,148 @@
+#include "ReteGraphIndex.hpp"
+
+#include <algorithm>
+
+namespace sempr { namespace gui {
+
+void ReteGraphIndex::build(const Graph& graph)
+{
+    ids_.clear();
+    indices_.clear();
+    ruleAncestors_.clear();
+    ruleDescendants_.clear();
+
+    ids_.reserve(graph.nodes.size());
+    indices_.reserve(graph.nodes.size());
+    for (auto& node : graph.nodes)
+    {
+        indices_[node.id] = static_cast<int>(ids_.size());
+        ids_.push_back(node.id);
+    }
+
+    children_.assign(ids_.size(), std::vector<int>());
+    parents_.assign(ids_.size(), std::vector<int>());
+    for (auto& edge : graph.edges)
+    {
+        int from = indexOf(edge.from);
+        int to = indexOf(edge.to);
+        if (from < 0 || to < 0) continue;
+
+        children_[from].push_back(to);
+        parents_[to].push_back(from);
+    }
+}
+
+
+void ReteGraphIndex::clearRules()
+{
+    ruleAncestors_.clear();
+    ruleDescendants_.clear();
+}
+
+
+size_t ReteGraphIndex::size() const
+{
+    return ids_.size();
+}
+
+
+int ReteGraphIndex::indexOf(const std::string& id) const
+{
+    auto it = indices_.find(id);
+    if (it == indices_.end()) return -1;
+    return it->second;
+}
+
+
+std::vector<int> ReteGraphIndex::indicesOf(const std::vector<std::string>& ids) const
+{
+    std::vector<int> indices;
+    for (auto& id : ids)
+    {
+        int index = indexOf(id);
+        if (index >= 0) indices.push_back(index);
+    }
+    return indices;
+}
+
+
+const std::string& ReteGraphIndex::idOf(int index) const
+{
+    return ids_[index];
+}
+
+
+const std::vector<int>& ReteGraphIndex::children(int index) const
+{
+    return children_[index];
+}
+
+
+const std::vector<int>& ReteGraphIndex::parents(int index) const
+{
+    return parents_[index];
+}
+
+
+std::vector<int> ReteGraphIndex::closure(
+        const std::vector<int>& start,
+        const std::vector<std::vector<int>>& adjacency) const
+{
+    std::vector<char> visited(ids_.size(), 0);
+    std::vector<int> result;
+    std::vector<int> toVisit(start);
+
+    while (!toVisit.empty())
+    {
+        int index = toVisit.back();
+        toVisit.pop_back();
+
+        if (visited[index]) continue;
+        visited[index] = 1;
+        result.push_back(index);
+
+        for (int next : adjacency[index])
+        {
+            if (!visited[next]) toVisit.push_back(next);
+        }
+    }
+
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+
+std::vector<int> ReteGraphIndex::ancestors(const std::vector<int>& start) const
+{
+    return closure(start, parents_);
+}
+
+
+std::vector<int> ReteGraphIndex::descendants(const std::vector<int>& start) const
+{
+    return closure(start, children_);
+}
+
+
+const std::vector<int>& ReteGraphIndex::ruleAncestors(const Rule& rule)
+{
+    auto it = ruleAncestors_.find(rule.id);
+    if (it == ruleAncestors_.end())
+    {
+        it = ruleAncestors_.insert({rule.id, ancestors(indicesOf(rule.effectNodes))}).first;
+    }
+    return it->second;
+}
+
+
+const std::vector<int>& ReteGraphIndex::ruleDescendants(const Rule& rule)
+{
+    auto it = ruleDescendants_.find(rule.id);
+    if (it == ruleDescendants_.end())
+    {
+        it = ruleDescendants_.insert({rule.id, descendants(indicesOf(rule.effectNodes))}).first;
+    }
+    return it->second;
+}
+
+}}
@@ -0,0 +1,78 @@
+#ifndef SEMPR_GUI_RETEGRAPHINDEX_HPP_
+#define SEMPR_GUI_RETEGRAPHINDEX_HPP_
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <cstddef>
+
+#include "ReteVisualSerialization.hpp"
+#include "Rule.hpp"
+
+namespace sempr { namespace gui {
+
+/**
+    An index of the nodes of a rete Graph: every node gets a dense integer
+    index (in the order of the graph's nodes), and the children and parents
+    of every node are stored as lists of indices. This makes walking the
+    graph O(V + E), instead of scanning all edges for every node.
+
+    The closures of rules (the ancestors and the descendants of their
+    effect nodes) are cached until the next build or clearRules.
+*/
+class ReteGraphIndex {
+    std::vector<std::string> ids_;
+    std::unordered_map<std::string, int> indices_;
+    std::vector<std::vector<int>> children_;
+    std::vector<std::vector<int>> parents_;
+
+    std::unordered_map<size_t, std::vector<int>> ruleAncestors_;
+    std::unordered_map<size_t, std::vector<int>> ruleDescendants_;
+
+    // all nodes reachable from the start nodes through the given adjacency
+    std::vector<int> closure(const std::vector<int>& start,
+                             const std::vector<std::vector<int>>& adjacency) const;
+
+public:
+    /**
+        Indexes the graph, and clears the cached closures.
+    */
+    void build(const Graph& graph);
+
+    /**
+        Clears the cached closures of the rules, e.g. when the rules were
+        fetched again.
+    */
+    void clearRules();
+
+    /// number of nodes
+    size_t size() const;
+
+    /// the index of the node, -1 if it is unknown
+    int indexOf(const std::string& id) const;
+    /// the indices of the known nodes among the ids
+    std::vector<int> indicesOf(const std::vector<std::string>& ids) const;
+    const std::string& idOf(int index) const;
+
+    const std::vector<int>& children(int index) const;
+    const std::vector<int>& parents(int index) const;
+
+    /**
+        All nodes from which one of the start nodes can be reached, and all
+        nodes that can be reached from them, respectively. Both include the
+        start nodes and are sorted.
+    */
+    std::vector<int> ancestors(const std::vector<int>& start) const;
+    std::vector<int> descendants(const std::vector<int>& start) const;
+
+    /**
+        The (cached) ancestors and descendants of the effect nodes of the
+        rule.
+    */
+    const std::vector<int>& ruleAncestors(const Rule& rule);
+    const std::vector<int>& ruleDescendants(const Rule& rule);
+};
+
+}}
+
+#endif /* include guard: SEMPR_GUI_RETEGRAPHINDEX_HPP_ */
@@ -7,6 +7,9 @@
 #include <rete-core/BetaBetaNode.hpp>
 #include <rete-core/ProductionNode.hpp>
 
+#include <algorithm>
+#include <iterator>
+
 namespace sempr { namespace gui {
 
 bool Node::operator<(const Node& other) const
@@ -21,6 +24,109 @@ bool Edge::operator<(const Edge& other) const
 }
 
 
+bool GraphDiff::empty() const
+{
+    return !complete &&
+           removedNodes.empty() && removedEdges.empty() &&
+           addedNodes.empty() && addedEdges.empty();
+}
+
+GraphDiff GraphDiff::between(const Graph& from, const Graph& to)
+{
+    GraphDiff diff;
+
+    // ids of nodes that are removed and added again
+    std::set<std::string> replaced;
+
+    // both sets are ordered by id, walk through them side by side
+    auto a = from.nodes.begin();
+    auto b = to.nodes.begin();
+    while (a != from.nodes.end() || b != to.nodes.end())
+    {
+        if (b == to.nodes.end() || (a != from.nodes.end() && *a < *b))
+        {
+            diff.removedNodes.insert(a->id);
+            ++a;
+        }
+        else if (a == from.nodes.end() || *b < *a)
+        {
+            diff.addedNodes.insert(*b);
+            ++b;
+        }
+        else
+        {
+            if (a->label != b->label || a->type != b->type)
+            {
+                diff.removedNodes.insert(a->id);
+                diff.addedNodes.insert(*b);
+                replaced.insert(a->id);
+            }
+            ++a;
+            ++b;
+        }
+    }
+
+    std::set_difference(from.edges.begin(), from.edges.end(),
+                        to.edges.begin(), to.edges.end(),
+                        std::inserter(diff.removedEdges, diff.removedEdges.end()));
+    std::set_difference(to.edges.begin(), to.edges.end(),
+                        from.edges.begin(), from.edges.end(),
+                        std::inserter(diff.addedEdges, diff.addedEdges.end()));
+
+    // removing a node removes its edges, too, so the unchanged edges of a
+    // replaced node have to be removed and added again with it
+    if (!replaced.empty())
+    {
+        auto isReplaced = [&replaced](const Edge& edge) -> bool
+        {
+            return replaced.count(edge.from) || replaced.count(edge.to);
+        };
+        for (auto& edge : from.edges)
+        {
+            if (isReplaced(edge)) diff.removedEdges.insert(edge);
+        }
+        for (auto& edge : to.edges)
+        {
+            if (isReplaced(edge)) diff.addedEdges.insert(edge);
+        }
+    }
+
+    return diff;
+}
+
+GraphDiff GraphDiff::of(const Graph& graph)
+{
+    GraphDiff diff;
+    diff.complete = true;
+    diff.addedNodes = graph.nodes;
+    diff.addedEdges = graph.edges;
+    return diff;
+}
+
+void GraphDiff::applyTo(Graph& graph) const
+{
+    if (complete)
+    {
+        graph.nodes.clear();
+        graph.edges.clear();
+    }
+
+    for (auto& id : removedNodes)
+    {
+        Node key;
+        key.id = id;
+        graph.nodes.erase(key);
+    }
+    for (auto& edge : removedEdges)
+    {
+        graph.edges.erase(edge);
+    }
+
+    graph.nodes.insert(addedNodes.begin(), addedNodes.end());
+    graph.edges.insert(addedEdges.begin(), addedEdges.end());
+}
+
+
 void CreateVisualGraphVisitor::addNode(
         Node::Type type,
         const std::string& id,
@@ -8,13 +8,15 @@
 
 #include <string>
 #include <set>
+#include <cstdint>
 
 /*
     This file provides a few classes to help with creating and transmitting a
     visual representation of a rete network. Some helper structs for the basic
     representation, which can be created through the use of a node visitor
     which traverses the graph. These can be serialized to send them over the
-    network.
+    network. Instead of the whole graph, only the changes since a previous
+    revision can be sent as a GraphDiff.
 */
 
 namespace sempr { namespace gui {
@@ -63,6 +65,52 @@ struct Graph {
 };
 
 
+/**
+    The changes of a Graph from one revision to another. A node whose label
+    or type changed is removed and added again, together with all its edges.
+*/
+struct GraphDiff {
+    uint64_t fromRevision = 0;
+    uint64_t toRevision = 0;
+
+    // If set, the previous graph is unknown to the sender (e.g. for
+    // fromRevision 0), and the added nodes and edges are the complete graph.
+    bool complete = false;
+
+    std::set<std::string> removedNodes;
+    std::set<Edge> removedEdges;
+    std::set<Node> addedNodes;
+    std::set<Edge> addedEdges;
+
+    /// true if nothing changed
+    bool empty() const;
+
+    /// the changes that turn "from" into "to"
+    static GraphDiff between(const Graph& from, const Graph& to);
+
+    /// a complete diff that contains the whole graph
+    static GraphDiff of(const Graph& graph);
+
+    /**
+        Applies the changes to the graph, removals first. A complete diff
+        replaces the graph.
+    */
+    void applyTo(Graph& graph) const;
+
+    template <class Archive>
+    void serialize(Archive& ar)
+    {
+        ar( cereal::make_nvp<Archive>("fromRevision", fromRevision),
+            cereal::make_nvp<Archive>("toRevision", toRevision),
+            cereal::make_nvp<Archive>("complete", complete),
+            cereal::make_nvp<Archive>("removedNodes", removedNodes),
+            cereal::make_nvp<Archive>("removedEdges", removedEdges),
+            cereal::make_nvp<Archive>("addedNodes", addedNodes),
+            cereal::make_nvp<Archive>("addedEdges", addedEdges) );
+    }
+};
+
+
 class CreateVisualGraphVisitor : public rete::NodeVisitor {
     Graph graph_;
 
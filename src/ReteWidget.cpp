@@ -9,25 +9,44 @@
 #include <QRectF>
 #include <cmath>
 #include <utility>
+#include <set>
+#include <algorithm>
+#include <iterator>
 
 namespace sempr { namespace gui {
 
 ReteWidget::ReteWidget(QWidget* parent)
     : QWidget(parent),
       form_(new Ui::ReteWidget),
-      timerId_(0)
+      reteRevision_(0),
+      timerId_(0), forceStep_(0),
+      layoutGeneration_(0), layoutRunning_(false), layoutPending_(false)
 {
     form_->setupUi(this);
     form_->graphicsView->setScene(&scene_);
-    form_->rulesTree->setColumnCount(2);
-    form_->rulesTree->setHeaderLabels({"ID", "Name"});
+    form_->layoutProgress->hide();
+
+    // Tuned for thousands of items: Most of the time the scene is static,
+    // for which the bsp tree index finds the visible items quickly (the
+    // dynamic positioning switches to no index, see below). The items
+    // restore the painter state themselves, and include the pen width in
+    // their bounding rects.
+    // No view caching: the scene has no background brush to cache. The
+    // nodes cache themselves in device coordinates (see GraphNodeItem). The
+    // edges don't: their geometry changes whenever a node moves, and long
+    // edges would need pixmaps as large as their bounding rects.
+    scene_.setItemIndexMethod(QGraphicsScene::BspTreeIndex);
+    form_->graphicsView->setOptimizationFlags(
+            QGraphicsView::DontSavePainterState |
+            QGraphicsView::DontAdjustForAntialiasing);
+
+    form_->rulesTree->setColumnCount(3);
+    form_->rulesTree->setHeaderLabels({"ID", "Name", "Collapse"});
     form_->ruleEdit->setReadOnly(true);
     form_->ruleEdit->setWordWrapMode(QTextOption::NoWrap);
 
     connect(form_->btnUpdate, &QPushButton::clicked,
-            this, &ReteWidget::rebuild);
-    connect(form_->btnUpdate, &QPushButton::clicked,
-            this, &ReteWidget::populateTreeWidget);
+            this, &ReteWidget::refresh);
 
     /* // this is rather distracting. Instead, only highlight selected *rules*.
     connect(&scene_, &QGraphicsScene::selectionChanged,
@@ -37,47 +56,140 @@ ReteWidget::ReteWidget(QWidget* parent)
     connect(form_->rulesTree, &QTreeWidget::currentItemChanged,
             this, &ReteWidget::onSelectedRuleChanged);
     connect(form_->rulesTree, &QTreeWidget::itemChanged,
-            this, &ReteWidget::updateGraphVisibility);
+            this, [this]() { updateGraphVisibility(); });
     connect(form_->boxDynamicPositioning, &QCheckBox::stateChanged,
             this, [this]()
             {
+                // all nodes move in every step, the index would have to
+                // be updated all the time
                 if (this->form_->boxDynamicPositioning->isChecked())
                 {
+                    scene_.setItemIndexMethod(QGraphicsScene::NoIndex);
                     timerId_ = startTimer(1000 / 25);
+                    startForceLayout();
                 }
                 else if (timerId_)
                 {
+                    stopForceLayout();
                     killTimer(timerId_);
                     timerId_ = 0;
+                    scene_.setItemIndexMethod(QGraphicsScene::BspTreeIndex);
                 }
             });
+
+    connect(this, &ReteWidget::layoutFinished,
+            this, &ReteWidget::applyLayout,
+            Qt::QueuedConnection);
 }
 
 ReteWidget::~ReteWidget()
 {
+    stopForceLayout();
+    stopLayout();
     delete form_;
 }
 
 
 void ReteWidget::timerEvent(QTimerEvent* /*event*/)
 {
-    for (auto node : nodes_)
+    if (forceNodes_.empty()) return;
+
+    // the node dragged by the user is moved by the mouse, not the forces
+    int grabbed = -1;
+    auto grabber = dynamic_cast<GraphNodeItem*>(scene_.mouseGrabberItem());
+    if (grabber)
     {
-        node.second->calculateForces();
+        auto it = std::find(forceNodes_.begin(), forceNodes_.end(), grabber);
+        if (it != forceNodes_.end())
+        {
+            grabbed = static_cast<int>(std::distance(forceNodes_.begin(), it));
+            forceLayout_.setGrabbed(grabbed, grabber->pos());
+        }
     }
+    if (grabbed == -1) forceLayout_.setGrabbed(-1, QPointF());
+
+    // at most one update per frame, no matter how many steps were done
+    if (!forceLayout_.positions(forcePositions_, forceStep_)) return;
 
-    for  (auto node : nodes_)
+    for (size_t i = 0; i < forceNodes_.size(); i++)
     {
-        node.second->advancePosition();
+        if (static_cast<int>(i) == grabbed) continue;
+
+        auto node = forceNodes_[i];
+        QPointF delta = forcePositions_[i] - node->pos();
+        if (std::abs(delta.x()) > 0.1 || std::abs(delta.y()) > 0.1)
+        {
+            node->setPos(forcePositions_[i]);
+        }
     }
 }
 
 
+void ReteWidget::startForceLayout()
+{
+    stopForceLayout();
+    if (!form_->boxDynamicPositioning->isChecked() || layoutRunning_) return;
+
+    // the visible nodes that have been placed, and the edges between them
+    std::vector<GraphNodeItem*> nodes;
+    std::vector<GraphEdgeItem*> edges;
+
+    for (auto node : nodeList_)
+    {
+        if (node->isVisible() && node->opacity() > 0) nodes.push_back(node);
+    }
+    for (auto& entry : collapsedNodes_)
+    {
+        if (entry.second->opacity() > 0) nodes.push_back(entry.second);
+    }
+    if (nodes.empty()) return;
+
+    for (auto edge : edgeList_)
+    {
+        if (edge->isVisible()) edges.push_back(edge);
+    }
+    edges.insert(edges.end(), collapsedEdges_.begin(), collapsedEdges_.end());
+
+    auto graph = GraphvizLayout::input(nodes, edges);
+
+    ForceLayout::Input input;
+    input.sizes = std::move(graph.sizes);
+    input.edges = std::move(graph.edges);
+    for (auto node : nodes)
+    {
+        input.positions.push_back(node->pos());
+        input.fixed.push_back(node->text() == "Root");
+    }
+    input.bounds = scene_.sceneRect();
+
+    forceNodes_ = std::move(nodes);
+    forceStep_ = 0;
+    forceLayout_.start(input);
+}
+
+
+void ReteWidget::stopForceLayout()
+{
+    forceLayout_.stop();
+    forceNodes_.clear();
+}
+
+
 void ReteWidget::setConnection(AbstractInterface::Ptr conn)
 {
     sempr_ = conn;
-    rebuild();
+    reteRevision_ = 0;
+    refresh();
+}
+
+
+void ReteWidget::refresh()
+{
+    bool rebuilt = updateNetwork();
     populateTreeWidget();
+
+    // a new network needs a new layout, else only the new nodes are placed
+    updateGraphVisibility(rebuilt);
 }
 
 void ReteWidget::onSelectionChanged()
@@ -98,23 +210,38 @@ void ReteWidget::onSelectionChanged()
 
 void ReteWidget::onSelectedRuleChanged(QTreeWidgetItem* current)
 {
-    auto& rule = rules_[current];
+    auto entry = rules_.find(current);
+    if (entry == rules_.end())
+    {
+        form_->ruleEdit->clear();
+        highlight(std::vector<int>());
+        return;
+    }
+
+    auto& rule = entry->second;
     form_->ruleEdit->setText(QString::fromStdString(rule.ruleString));
 
-    highlight(rule.effectNodes);
+    // the closures of the rules are cached, so this is instant after the
+    // first time
+    auto& up = index_.ruleAncestors(rule);
+    auto& down = index_.ruleDescendants(rule);
+    std::vector<int> nodes;
+    std::set_union(up.begin(), up.end(), down.begin(), down.end(),
+                   std::back_inserter(nodes));
+    highlight(nodes);
+
+    auto collapsed = collapsedNodes_.find(rule.id);
+    if (collapsed != collapsedNodes_.end()) collapsed->second->setHighlighted(true);
 }
 
 
 
 void ReteWidget::highlight(GraphNodeItem* node)
 {
-    for (auto entry : nodes_)
+    auto it = std::find(indexedNodes_.begin(), indexedNodes_.end(), node);
+    if (it != indexedNodes_.end())
     {
-        if (entry.second == node)
-        {
-            highlight(entry.first);
-            return;
-        }
+        highlight(index_.idOf(static_cast<int>(it - indexedNodes_.begin())));
     }
 }
 
@@ -127,155 +254,477 @@ void ReteWidget::highlight(const std::string& id)
 
 void ReteWidget::highlight(const std::vector<std::string>& ids)
 {
-    // un-highlight all
-    for (auto entry : nodes_)
+    // highlight not only the nodes, but all their ancestors and decendants,
+    // too.
+    auto start = index_.indicesOf(ids);
+    auto up = index_.ancestors(start);
+    auto down = index_.descendants(start);
+
+    std::vector<int> nodes;
+    std::set_union(up.begin(), up.end(), down.begin(), down.end(),
+                   std::back_inserter(nodes));
+    highlight(nodes);
+}
+
+void ReteWidget::highlight(const std::vector<int>& nodes)
+{
+    // un-highlight the previous ones
+    for (auto node : highlighted_)
     {
-        entry.second->setHighlighted(false);
-        for (auto e : entry.second->edges())
+        node->setHighlighted(false);
+        for (auto e : node->edges())
         {
             e->setGlobalHighlighted(false);
         }
     }
+    highlighted_.clear();
+    for (auto entry : collapsedNodes_)
+    {
+        entry.second->setHighlighted(false);
+    }
 
-    // highlight not only the one node, but all its ancestors and decendants,
-    // too.
-    std::set<std::pair<std::string, bool>> visited;
-    std::vector<std::pair<std::string, bool>> toVisit; // which node to visit, and in which direction (only up / only down)
-
-    for (auto& id : ids)
+    for (int index : nodes)
     {
-        toVisit.push_back({id, false});
-        toVisit.push_back({id, true});
+        indexedNodes_[index]->setHighlighted(true);
+        highlighted_.push_back(indexedNodes_[index]);
     }
 
-    while (!toVisit.empty())
+    // highlight the edges between them
+    for (auto node : highlighted_)
     {
-        auto entry = toVisit.back();
-        toVisit.pop_back();
+        for (auto e : node->edges())
+        {
+            if (e->from() == node) e->setGlobalHighlighted(e->to()->isHighlighted());
+        }
+    }
+}
 
-        if (visited.find(entry) != visited.end()) continue;
 
-        auto node = nodes_.find(entry.first);
-        if (node != nodes_.end())
-        {
-            node->second->setHighlighted(true);
+void ReteWidget::reindex()
+{
+    index_.build(graph_);
 
-            // highlight its edges?
-            auto edges = node->second->edges();
-            for (auto e : edges)
-            {
-                e->setGlobalHighlighted(
-                    e->from()->isHighlighted() &&
-                    e->to()->isHighlighted()
-                );
-            }
-        }
+    indexedNodes_.assign(index_.size(), nullptr);
+    for (size_t i = 0; i < index_.size(); i++)
+    {
+        indexedNodes_[i] = nodes_[index_.idOf(static_cast<int>(i))];
+    }
+}
 
-        // dont visit this node again.
-        visited.insert(entry);
 
-        // find all ancestors and decendants
-        for (auto edge : graph_.edges)
-        {
-            if (!entry.second && edge.from == entry.first) toVisit.push_back({edge.to, false});
-            if (entry.second && edge.to == entry.first) toVisit.push_back({edge.from, true});
-        }
+bool ReteWidget::updateNetwork()
+{
+    auto diff = sempr_->getReteNetworkDiff(reteRevision_);
+    reteRevision_ = diff.toRevision;
+
+    if (diff.complete)
+    {
+        diff.applyTo(graph_);
+        rebuild();
+        reindex();
+        return true;
     }
+
+    if (!diff.empty())
+    {
+        patch(diff);
+        reindex();
+    }
+    return false;
+}
+
+
+GraphNodeItem* ReteWidget::addNodeItem(const Node& node)
+{
+    //auto item = new GraphNodeItem(node.type, QString::fromStdString(node.label));
+    GraphNodeItem::Shape shape = GraphNodeItem::Ellipse;
+    if (node.type == Node::Type::MEMORY) shape = GraphNodeItem::Rectangle;
+
+    auto item = new GraphNodeItem(QString::fromStdString(node.label), shape);
+    scene_.addItem(item); // scene takes ownership
+    item->setFlag(QGraphicsItem::ItemIsMovable);
+    item->setOpacity(0); // until it is placed, see applyLayout / placeNewNodes
+
+    nodes_[node.id] = item;
+    nodeList_.push_back(item);
+    return item;
+}
+
+
+GraphEdgeItem* ReteWidget::addEdgeItem(GraphNodeItem* from, GraphNodeItem* to)
+{
+    auto edgeItem = new GraphEdgeItem(from, to);
+    edgeItem->adjust();
+    edgeItem->setOpacity(0);
+    scene_.addItem(edgeItem);
+
+    edgeList_.push_back(edgeItem);
+    return edgeItem;
+}
+
+
+void ReteWidget::removeEdgeItem(GraphEdgeItem* edge)
+{
+    edge->from()->removeEdge(edge);
+    edge->to()->removeEdge(edge);
+    edgeList_.erase(std::remove(edgeList_.begin(), edgeList_.end(), edge), edgeList_.end());
+    scene_.removeItem(edge);
+    delete edge;
 }
 
 
 void ReteWidget::rebuild()
 {
+    // the running layouts refer to the old items
+    stopForceLayout();
+    layoutGeneration_++;
+    layoutNodes_.clear();
+
     nodes_.clear();
     nodeList_.clear();
     edgeList_.clear();
+    highlighted_.clear();
+    collapsedNodes_.clear();
+    collapsedEdges_.clear();
     scene_.clear();
 
-    graph_ = sempr_->getReteNetworkRepresentation();
-
     for (auto node : graph_.nodes)
     {
-        //auto item = new GraphNodeItem(node.type, QString::fromStdString(node.label));
-        GraphNodeItem::Shape shape = GraphNodeItem::Ellipse;
-        if (node.type == Node::Type::MEMORY) shape = GraphNodeItem::Rectangle;
+        addNodeItem(node);
+    }
 
-        auto item = new GraphNodeItem(QString::fromStdString(node.label), shape);
-        scene_.addItem(item); // scene takes ownership
-        item->setFlag(QGraphicsItem::ItemIsMovable);
+    for (auto edge : graph_.edges)
+    {
+        addEdgeItem(nodes_[edge.from], nodes_[edge.to]);
+    }
+}
+
+
+void ReteWidget::patch(const GraphDiff& diff)
+{
+    stopForceLayout();
 
-        nodes_[node.id] = item;
-        nodeList_.push_back(item);
+    // the running layout may refer to removed items, drop its result
+    if (layoutRunning_)
+    {
+        layoutGeneration_++;
+        layoutPending_ = true;
     }
 
-    for (auto edge : graph_.edges)
+    // the collapsed nodes are created again in updateGraphVisibility
+    clearCollapsed();
+
+    for (auto& e : diff.removedEdges)
+    {
+        auto from = nodes_.find(e.from);
+        auto to = nodes_.find(e.to);
+        if (from == nodes_.end() || to == nodes_.end()) continue;
+
+        for (auto edge : from->second->edges())
+        {
+            if (edge->from() == from->second && edge->to() == to->second)
+            {
+                removeEdgeItem(edge);
+                break;
+            }
+        }
+    }
+
+    for (auto& id : diff.removedNodes)
     {
-        auto from = nodes_[edge.from];
-        auto to = nodes_[edge.to];
+        auto node = nodes_.find(id);
+        if (node == nodes_.end()) continue;
 
-        auto edgeItem = new GraphEdgeItem(from, to);
-        edgeItem->adjust();
-        scene_.addItem(edgeItem);
+        auto item = node->second;
+        for (auto edge : item->edges())
+        {
+            removeEdgeItem(edge);
+        }
 
-        edgeList_.push_back(edgeItem);
+        nodeList_.erase(std::remove(nodeList_.begin(), nodeList_.end(), item), nodeList_.end());
+        highlighted_.erase(std::remove(highlighted_.begin(), highlighted_.end(), item), highlighted_.end());
+        nodes_.erase(node);
+        scene_.removeItem(item);
+        delete item;
     }
 
+    for (auto& node : diff.addedNodes)
+    {
+        addNodeItem(node);
+    }
 
-    resetLayout();
+    for (auto& e : diff.addedEdges)
+    {
+        auto from = nodes_.find(e.from);
+        auto to = nodes_.find(e.to);
+        if (from == nodes_.end() || to == nodes_.end()) continue;
+
+        addEdgeItem(from->second, to->second);
+    }
+
+    diff.applyTo(graph_);
 }
 
 
-void ReteWidget::updateGraphVisibility()
+void ReteWidget::placeNewNodes()
 {
-    // hide all
-    for (auto& entry : nodes_)
+    auto isPlaced = [](GraphNodeItem* node) -> bool
+    {
+        return node->opacity() > 0;
+    };
+
+    std::vector<GraphNodeItem*> unplaced;
+    for (auto node : nodeList_)
     {
-        entry.second->hide();
-        entry.second->update();
-        for (auto edge : entry.second->edges())
+        if (node->isVisible() && !isPlaced(node)) unplaced.push_back(node);
+    }
+    for (auto& entry : collapsedNodes_)
+    {
+        if (!isPlaced(entry.second)) unplaced.push_back(entry.second);
+    }
+    if (unplaced.empty()) return;
+
+    QRectF sceneRect = scene_.sceneRect();
+
+    // moves the node to the right until it does not overlap another one
+    auto placeAt = [this, &isPlaced](GraphNodeItem* node, QPointF pos)
+    {
+        auto rect = node->boundingRect();
+        for (int i = 0; i < 100; i++)
         {
-            edge->setVisible(false);
-            edge->update();
+            bool overlaps = false;
+            for (auto item : scene_.items(rect.translated(pos)))
+            {
+                auto other = dynamic_cast<GraphNodeItem*>(item);
+                if (other && other != node && other->isVisible() && isPlaced(other))
+                {
+                    overlaps = true;
+                    break;
+                }
+            }
+            if (!overlaps) break;
+            pos.rx() += rect.width() + 20;
         }
+
+        node->setPos(pos);
+        node->setOpacity(1);
+    };
+
+    // place nodes one rank below their placed parents, repeatedly, as the
+    // parents may be new, too
+    bool progress = true;
+    while (progress)
+    {
+        progress = false;
+        for (auto& node : unplaced)
+        {
+            if (!node) continue;
+
+            QPointF sum;
+            int numParents = 0;
+            for (auto edge : node->edges())
+            {
+                auto parent = edge->from();
+                if (edge->to() == node && parent->isVisible() && isPlaced(parent))
+                {
+                    sum += parent->pos();
+                    numParents++;
+                }
+            }
+            if (numParents == 0) continue;
+
+            placeAt(node, sum / numParents + QPointF(0, 100));
+            node = nullptr;
+            progress = true;
+        }
+    }
+
+    // the rest (e.g. without visible parents) is put below the graph
+    QPointF next(sceneRect.left(), sceneRect.bottom() + 100);
+    for (auto node : unplaced)
+    {
+        if (!node) continue;
+        placeAt(node, next);
+        next.rx() = node->pos().x() + node->boundingRect().width() + 20;
     }
 
-    // start at the production nodes and enable all their ancestors
-    std::vector<std::string> toVisit;
+    // show the edges between placed nodes, and grow the scene
+    for (auto node : nodeList_)
+    {
+        if (!isPlaced(node)) continue;
+        for (auto edge : node->edges())
+        {
+            if (isPlaced(edge->from()) && isPlaced(edge->to())) edge->setOpacity(1);
+        }
+        if (node->isVisible())
+        {
+            sceneRect = sceneRect.united(node->mapToScene(node->boundingRect()).boundingRect());
+        }
+    }
+    for (auto edge : collapsedEdges_)
+    {
+        if (isPlaced(edge->from()) && isPlaced(edge->to())) edge->setOpacity(1);
+    }
+    for (auto& entry : collapsedNodes_)
+    {
+        auto node = entry.second;
+        sceneRect = sceneRect.united(node->mapToScene(node->boundingRect()).boundingRect());
+    }
+
+    scene_.setSceneRect(sceneRect);
+}
+
+
+void ReteWidget::clearCollapsed()
+{
+    // the running layout may refer to the collapsed nodes, drop its result
+    if (layoutRunning_)
+    {
+        layoutGeneration_++;
+        layoutPending_ = true;
+    }
+
+    for (auto edge : collapsedEdges_)
+    {
+        edge->from()->removeEdge(edge);
+        edge->to()->removeEdge(edge);
+        scene_.removeItem(edge);
+        delete edge;
+    }
+    collapsedEdges_.clear();
+
+    for (auto& entry : collapsedNodes_)
+    {
+        scene_.removeItem(entry.second);
+        delete entry.second;
+    }
+    collapsedNodes_.clear();
+}
+
+
+void ReteWidget::updateGraphVisibility(bool relayout)
+{
+    stopForceLayout();
+    clearCollapsed();
+
+    // all nodes of the checked rules: the production nodes and all their
+    // ancestors. Count the rules every node belongs to.
+    std::vector<int> numRules(index_.size(), 0);
+    std::vector<const Rule*> collapsedRules;
     for (auto& entry : rules_)
     {
-        if (entry.first->checkState(0) == Qt::Checked)
+        if (entry.first->checkState(0) != Qt::Checked) continue;
+        if (entry.first->checkState(2) == Qt::Checked) collapsedRules.push_back(&entry.second);
+
+        for (int node : index_.ruleAncestors(entry.second))
         {
-            toVisit.insert(toVisit.end(), entry.second.effectNodes.begin(),
-                                          entry.second.effectNodes.end());
+            numRules[node]++;
         }
     }
 
-    while (!toVisit.empty())
+    // the nodes only used by a collapsed rule are replaced by a single node
+    // for the rule. Shared ones stay visible.
+    std::vector<GraphNodeItem*> replacedBy(index_.size(), nullptr);
+    for (auto rule : collapsedRules)
     {
-        auto toShow = toVisit.back(); toVisit.pop_back();
-        auto item = nodes_[toShow];
-        item->show();
+        auto& ruleNodes = index_.ruleAncestors(*rule);
+
+        int numNodes = 0;
+        for (int node : ruleNodes)
+        {
+            if (numRules[node] == 1) numNodes++;
+        }
+        if (numNodes == 0) continue;
+
+        auto item = new GraphNodeItem(
+                QString("%1\n(%2 nodes)").arg(QString::fromStdString(rule->name))
+                                         .arg(numNodes),
+                GraphNodeItem::Rectangle);
+        item->setFlag(QGraphicsItem::ItemIsMovable);
+        item->setOpacity(0); // until it is placed, see applyLayout
+        scene_.addItem(item);
+        collapsedNodes_[rule->id] = item;
+
+        // in the middle of the nodes it replaces, if they have been placed
+        QPointF sum;
+        int numPlaced = 0;
+        for (int node : ruleNodes)
+        {
+            if (numRules[node] != 1) continue;
 
-        for (auto& e : item->edges())
+            replacedBy[node] = item;
+            auto replaced = indexedNodes_[node];
+            if (replaced->opacity() > 0)
+            {
+                sum += replaced->pos();
+                numPlaced++;
+            }
+        }
+        if (numPlaced > 0)
         {
-            if (e->to() == item) e->setVisible(true);
+            item->setPos(sum / numPlaced);
+            item->setOpacity(1);
         }
+    }
+
+    // show the nodes that are neither hidden nor collapsed
+    for (size_t i = 0; i < indexedNodes_.size(); i++)
+    {
+        indexedNodes_[i]->setVisible(numRules[i] > 0 && !replacedBy[i]);
+    }
+
+    for (auto edge : edgeList_)
+    {
+        edge->setVisible(edge->from()->isVisible() && edge->to()->isVisible());
+    }
 
-        for (auto& e : graph_.edges)
+    // connect the collapsed nodes to the rest, once for every pair
+    std::set<std::pair<GraphNodeItem*, GraphNodeItem*>> connected;
+    for (size_t i = 0; i < indexedNodes_.size(); i++)
+    {
+        for (int child : index_.children(static_cast<int>(i)))
         {
-            if (e.to == toShow) toVisit.push_back(e.from);
+            if (!replacedBy[i] && !replacedBy[child]) continue;
+
+            auto from = (replacedBy[i] ? replacedBy[i] : indexedNodes_[i]);
+            auto to = (replacedBy[child] ? replacedBy[child] : indexedNodes_[child]);
+            if (from == to) continue;
+            if (!replacedBy[i] && !from->isVisible()) continue;
+            if (!replacedBy[child] && !to->isVisible()) continue;
+            if (!connected.insert({from, to}).second) continue;
+
+            auto edgeItem = new GraphEdgeItem(from, to);
+            edgeItem->adjust();
+            edgeItem->setOpacity(0);
+            scene_.addItem(edgeItem);
+            collapsedEdges_.push_back(edgeItem);
         }
     }
 
-    // redo the layout
-    resetLayout();
+    // redo the layout, or keep it
+    if (relayout)
+        resetLayout();
+    else
+        placeNewNodes();
+
+    startForceLayout();
 }
 
 
 void ReteWidget::populateTreeWidget()
 {
+    // the check states of the rules, to restore them
+    std::map<size_t, std::pair<Qt::CheckState, Qt::CheckState>> states;
+    for (auto& entry : rules_)
+    {
+        if (!entry.first) continue;
+        states[entry.second.id] = { entry.first->checkState(0), entry.first->checkState(2) };
+    }
+
     form_->rulesTree->clear();
     form_->ruleEdit->clear();
     rules_.clear();
+    index_.clearRules();
 
     auto rules = sempr_->getRulesRepresentation();
 
@@ -286,6 +735,14 @@ void ReteWidget::populateTreeWidget()
         item->setText(1, QString::fromStdString(rule.name));
         //item->setFlags(item->flags() | Qt::ItemIsUserCheckable);
         item->setCheckState(0, Qt::Checked);
+        item->setCheckState(2, Qt::Unchecked); // collapse
+
+        auto state = states.find(rule.id);
+        if (state != states.end())
+        {
+            item->setCheckState(0, state->second.first);
+            item->setCheckState(2, state->second.second);
+        }
         rules_[item] = rule;
 
         form_->rulesTree->addTopLevelItem(item);
@@ -295,45 +752,118 @@ void ReteWidget::populateTreeWidget()
 
 void ReteWidget::resetLayout()
 {
+    if (layoutRunning_)
+    {
+        // start again when the current one is done
+        layoutGeneration_++;
+        layoutPending_ = true;
+        return;
+    }
+
+    startLayout();
+}
+
+
+void ReteWidget::startLayout()
+{
+    // the nodes are moved when the layout is done
+    stopForceLayout();
+
     // collect all visible nodes and edges, as we only want to take those
     // into consideration during layouting.
-    //
-
     std::vector<GraphNodeItem*> nodes;
     std::vector<GraphEdgeItem*> edges;
 
     for (auto node : nodeList_)
     {
-        if (node->isVisible())
-        {
-            nodes.push_back(node);
-        }
+        if (node->isVisible()) nodes.push_back(node);
+    }
+    for (auto& entry : collapsedNodes_)
+    {
+        nodes.push_back(entry.second);
     }
 
     for (auto edge : edgeList_)
     {
-        if (edge->from()->isVisible() && edge->to()->isVisible())
+        if (edge->isVisible()) edges.push_back(edge);
+    }
+    edges.insert(edges.end(), collapsedEdges_.begin(), collapsedEdges_.end());
+
+    // only the sizes and indices are passed to the worker
+    auto input = GraphvizLayout::input(nodes, edges);
+    layoutNodes_ = nodes;
+
+    int generation = ++layoutGeneration_;
+    layoutRunning_ = true;
+    layoutPending_ = false;
+
+    form_->layoutProgress->setFormat(tr("layouting %1 nodes").arg(nodes.size()));
+    form_->layoutProgress->show();
+
+    if (layoutWorker_.joinable()) layoutWorker_.join();
+    layoutWorker_ = std::thread(
+        [this, generation, input]()
         {
-            edges.push_back(edge);
-        }
+            LayoutResult result;
+            result.generation = generation;
+            result.positions = GraphvizLayout::layout(input);
+
+            {
+                std::lock_guard<std::mutex> lock(layoutMutex_);
+                layoutResult_ = std::move(result);
+            }
+            emit layoutFinished(generation);
+        });
+}
+
+
+void ReteWidget::stopLayout()
+{
+    // graphviz cannot be interrupted, just wait for it
+    layoutGeneration_++;
+    if (layoutWorker_.joinable()) layoutWorker_.join();
+}
+
+
+void ReteWidget::applyLayout(int generation)
+{
+    LayoutResult result;
+    {
+        std::lock_guard<std::mutex> lock(layoutMutex_);
+        if (layoutResult_.generation != generation) return;
+        result = std::move(layoutResult_);
+        layoutResult_ = LayoutResult();
     }
 
-    //GraphvizLayout::layout(nodeList_, edgeList_);
-    GraphvizLayout::layout(nodes, edges);
+    layoutRunning_ = false;
+
+    // the graph changed in the meantime
+    if (generation != layoutGeneration_ || layoutPending_)
+    {
+        startLayout();
+        return;
+    }
+
+    form_->layoutProgress->hide();
 
     QRectF boundingRect;
-    for (auto node : nodeList_)
+    for (size_t i = 0; i < layoutNodes_.size(); i++)
     {
-        if (node->isVisible())
+        auto node = layoutNodes_[i];
+        node->setPos(result.positions[i]);
+        node->setOpacity(1);
+        for (auto edge : node->edges())
         {
-            boundingRect = boundingRect.united(
-                    node->mapToScene(
-                        node->boundingRect()
-                        ).boundingRect()
-                    );
+            edge->setOpacity(1);
         }
 
+        boundingRect = boundingRect.united(
+                node->mapToScene(
+                    node->boundingRect()
+                    ).boundingRect()
+                );
     }
+    layoutNodes_.clear();
 
     scene_.setSceneRect(boundingRect);
 
@@ -341,6 +871,8 @@ void ReteWidget::resetLayout()
         boundingRect,
         Qt::KeepAspectRatio
     );
+
+    startForceLayout();
 }
 
 
@@ -8,9 +8,17 @@
 #include <QGraphicsLineItem>
 
 #include <map>
+#include <unordered_map>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
 
 #include "AbstractInterface.hpp"
 #include "GraphNodeItem.hpp"
+#include "GraphvizLayout.hpp"
+#include "ForceLayout.hpp"
+#include "ReteGraphIndex.hpp"
 
 namespace Ui {
     class ReteWidget;
@@ -21,6 +29,16 @@ namespace sempr { namespace gui {
 
 /**
     A widget with a QGraphicsView to display the rete network
+
+    As the network of a large rule base has thousands of nodes, the layout is
+    computed on a worker thread (while a progress bar is shown), the rules
+    can be collapsed into a single node each, and the items are drawn with
+    less detail when zoomed out.
+
+    On updates, only the changes of the network since the last update are
+    requested (see AbstractInterface::getReteNetworkDiff) and patched into
+    the scene. Existing nodes keep their positions, new ones are placed
+    below their parents.
 */
 class ReteWidget : public QWidget {
     Q_OBJECT
@@ -31,7 +49,7 @@ class ReteWidget : public QWidget {
     AbstractInterface::Ptr sempr_;
 
     // a list of graphics items that were added to the scene
-    std::map<std::string, GraphNodeItem*> nodes_;
+    std::unordered_map<std::string, GraphNodeItem*> nodes_;
 
     // for layouting
     std::vector<GraphNodeItem*> nodeList_;
@@ -41,27 +59,115 @@ class ReteWidget : public QWidget {
     Graph graph_;
     std::map<QTreeWidgetItem*, Rule> rules_;
 
+    // the revision of graph_ at the sempr core
+    uint64_t reteRevision_;
+
+    // the adjacency of graph_ by dense indices, with the cached closures of
+    // the rules, and the node items by the same indices
+    ReteGraphIndex index_;
+    std::vector<GraphNodeItem*> indexedNodes_;
+    void reindex();
+
+    // the currently highlighted nodes, to reset them
+    std::vector<GraphNodeItem*> highlighted_;
+
+    // the nodes that stand in for collapsed rules (by rule id), and the edges
+    // that connect them to the rest of the graph
+    std::map<size_t, GraphNodeItem*> collapsedNodes_;
+    std::vector<GraphEdgeItem*> collapsedEdges_;
+
+    // the layout running on the worker thread. Only one runs at a time; if
+    // the graph changes meanwhile, another one is started when it finished,
+    // and the outdated result is dropped.
+    std::thread layoutWorker_;
+    std::atomic<int> layoutGeneration_;
+    bool layoutRunning_;
+    bool layoutPending_;
+    // the nodes that are being laid out, in the order of the input
+    std::vector<GraphNodeItem*> layoutNodes_;
+
+    struct LayoutResult {
+        int generation = 0;
+        std::vector<QPointF> positions;
+    };
+    std::mutex layoutMutex_;
+    LayoutResult layoutResult_;
+
+    void startLayout();
+    void stopLayout();
+
+    // removes the nodes and edges of collapsed rules from the scene
+    void clearCollapsed();
+
 
     // timer for dynamic updates of the nodes position
     int timerId_;
 
+    // the dynamic positioning runs on a worker thread, too. Every frame, the
+    // latest positions are fetched and the nodes are moved.
+    ForceLayout forceLayout_;
+    // the nodes that are being positioned, in the order of the input
+    std::vector<GraphNodeItem*> forceNodes_;
+    std::vector<QPointF> forcePositions_;
+    uint64_t forceStep_;
+
+    /**
+        Starts the dynamic positioning of the visible and placed nodes, if
+        it is enabled and no layout is being computed.
+    */
+    void startForceLayout();
+
     /**
-        Requests the network information from the sempr core and re-builds the
-        visual representation the in graphics scene
+        Stops the dynamic positioning, e.g. before items are deleted.
+    */
+    void stopForceLayout();
+
+    /**
+        Requests the changes of the network since the last update from the
+        sempr core, and applies them to graph_ and the graphics scene.
+        Returns true if the scene was built from scratch.
+    */
+    bool updateNetwork();
+
+    /**
+        Re-builds the visual representation of graph_ in the graphics scene
     */
     void rebuild();
 
     /**
-        Updates the visibility of graph nodes based on the checke items in
-        the rules tree widget.
+        Removes and adds the items of the changed nodes and edges
+    */
+    void patch(const GraphDiff& diff);
+
+    GraphNodeItem* addNodeItem(const Node& node);
+    GraphEdgeItem* addEdgeItem(GraphNodeItem* from, GraphNodeItem* to);
+    void removeEdgeItem(GraphEdgeItem* edge);
+
+    /**
+        Places the visible nodes that have no position yet below their
+        placed parents, or below the graph if there are none.
+    */
+    void placeNewNodes();
+
+    /**
+        Updates the visibility of graph nodes based on the checked items in
+        the rules tree widget, and collapses the nodes that only belong to
+        rules that are marked as collapsed. Afterwards, the layout is either
+        reset or only the new nodes are placed.
     */
-    void updateGraphVisibility();
+    void updateGraphVisibility(bool relayout = true);
 
     /**
-        Requests the rules from the sempr core and rebuilds the tree widget
+        Requests the rules from the sempr core and rebuilds the tree widget.
+        The check states of rules that are still there are kept.
     */
     void populateTreeWidget();
 
+    /**
+        Updates the network and the rules
+    */
+    void refresh();
+
 
     /**
         Highlights the part of the graph connected to the given node
@@ -70,6 +176,12 @@ class ReteWidget : public QWidget {
     void highlight(GraphNodeItem* node);
     void highlight(const std::vector<std::string>& ids);
 
+    /**
+        Highlights exactly the given nodes (indices of index_) and the edges
+        between them
+    */
+    void highlight(const std::vector<int>& nodes);
+
 private slots:
     // highlight selected items (clicks in graph!)
     void onSelectionChanged();
@@ -80,6 +192,13 @@ private slots:
     // animate graph
     void timerEvent(QTimerEvent* event) override;
 
+    // moves the nodes to the computed positions
+    void applyLayout(int generation);
+
+signals:
+    // emitted from the worker thread
+    void layoutFinished(int generation);
+
 public:
     ReteWidget(QWidget* parent = nullptr);
     virtual ~ReteWidget();
@@ -91,7 +210,8 @@ public:
 
 
     /**
-        Resets the layout of the nodes
+        Resets the layout of the nodes. The layout is computed in the
+        background, the nodes are moved when it is done.
     */
     virtual void resetLayout();
 };
@@ -7,7 +7,7 @@
 namespace sempr { namespace gui {
 
 SPARQLWidget::SPARQLWidget(QWidget* parent)
-    : QWidget(parent), form_(new Ui::SPARQLWidget)
+    : QWidget(parent), form_(new Ui::SPARQLWidget), triples_(nullptr)
 {
     form_->setupUi(this);
     form_->queryList->setModel(&queries_);
@@ -36,27 +36,64 @@ void SPARQLWidget::queryItemClicked(const QModelIndex& index)
 }
 
 
-void SPARQLWidget::update(sempr::Triple triple, AbstractInterface::Notification action)
+void SPARQLWidget::setTripleModel(TripleModel* model)
 {
-    if (action == AbstractInterface::Notification::ADDED)
+    if (triples_)
     {
-        soprano_.addTriple(
-            triple.getField(sempr::Triple::Field::SUBJECT),
-            triple.getField(sempr::Triple::Field::PREDICATE),
-            triple.getField(sempr::Triple::Field::OBJECT)
-        );
+        disconnect(triples_, &TripleModel::triplesAdded,
+                   this, &SPARQLWidget::triplesAdded);
+        disconnect(triples_, &TripleModel::triplesRemoved,
+                   this, &SPARQLWidget::triplesRemoved);
     }
-    else if (action == AbstractInterface::Notification::REMOVED)
+
+    triples_ = model;
+    soprano_.reset();
+
+    if (triples_)
+    {
+        connect(triples_, &TripleModel::triplesAdded,
+                this, &SPARQLWidget::triplesAdded);
+        connect(triples_, &TripleModel::triplesRemoved,
+                this, &SPARQLWidget::triplesRemoved);
+    }
+}
+
+
+void SPARQLWidget::ensureSoprano()
+{
+    if (soprano_) return;
+
+    soprano_.reset(new SopranoModule());
+    if (!triples_) return;
+
+    auto& store = triples_->store();
+    for (size_t i = 0; i < store.size(); i++)
+    {
+        if (store.isRemoved(i)) continue;
+        soprano_->addTriple(store.subject(i), store.predicate(i), store.object(i));
+    }
+}
+
+
+void SPARQLWidget::triplesAdded(const std::vector<rete::Triple>& triples)
+{
+    // not needed until the first query
+    if (!soprano_) return;
+
+    for (auto& triple : triples)
     {
-        soprano_.removeTriple(
-            triple.getField(sempr::Triple::Field::SUBJECT),
-            triple.getField(sempr::Triple::Field::PREDICATE),
-            triple.getField(sempr::Triple::Field::OBJECT)
-        );
+        soprano_->addTriple(triple.subject, triple.predicate, triple.object);
     }
-    else
+}
+
+
+void SPARQLWidget::triplesRemoved(const std::vector<rete::Triple>& triples)
+{
+    if (!soprano_) return;
+
+    for (auto& triple : triples)
     {
-        throw std::exception(); // should never happen, triples cannot be updated
+        soprano_->removeTriple(triple.subject, triple.predicate, triple.object);
     }
 }
 
@@ -65,7 +102,8 @@ void SPARQLWidget::submitClicked()
 {
     SPARQLQuery query;
     query.query = form_->queryEdit->toPlainText().toStdString();
-    soprano_.answer(query);
+    ensureSoprano();
+    soprano_->answer(query);
 
     auto item = new SPARQLItem();
     item->update(query);
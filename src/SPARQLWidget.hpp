@@ -9,6 +9,9 @@
 #include <sempr/nodes/SopranoModule.hpp>
 #include <sempr/component/TripleContainer.hpp> // for sempr::Triple
 #include "AbstractInterface.hpp"
+#include "TripleModel.hpp"
+
+#include <memory>
 
 namespace Ui {
     class SPARQLWidget;
@@ -18,23 +21,38 @@ namespace Ui {
 namespace sempr { namespace gui {
 
 /**
-    A widget which maintains a soprano module and allows sparql queries
+    A widget which maintains a soprano module and allows sparql queries.
+
+    The triples are taken from a TripleModel. As the soprano module keeps its
+    own copy of all triples, it is only filled when the first query is made,
+    and kept up to date from then on.
 */
 class SPARQLWidget : public QWidget {
     Q_OBJECT
 
     Ui::SPARQLWidget* form_;
-    SopranoModule soprano_;
+    std::unique_ptr<SopranoModule> soprano_;
     QStandardItemModel queries_;
+
+    TripleModel* triples_;
+
+    // creates and fills the soprano_ module, if not done yet
+    void ensureSoprano();
+
+protected slots:
+    void triplesAdded(const std::vector<rete::Triple>&);
+    void triplesRemoved(const std::vector<rete::Triple>&);
+
 public:
     SPARQLWidget(QWidget* parent = nullptr);
     ~SPARQLWidget();
 
-public slots:
     /**
-        updates the internal representation
+        Sets the model that contains the triples to query
     */
-    void update(sempr::Triple, AbstractInterface::Notification);
+    void setTripleModel(TripleModel* model);
+
+public slots:
 
     /**
         evaluates the sparql query in the text entry
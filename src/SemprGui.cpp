@@ -16,12 +16,16 @@ GeosGeometry::Ptr fromWKT(const std::string& wkt)
 }
 
 
-SemprGui::SemprGui(AbstractInterface::Ptr interface)
-    : dataModel_(interface), form_(new Ui_Form()), sempr_(interface)
+SemprGui::SemprGui(AbstractInterface::Ptr interface, const TileServer::Config& tiles)
+    : dataModel_(interface), form_(new Ui_Form()), sempr_(interface),
+      loadingTriples_(true)
 {
     // register metatypes
     qRegisterMetaType<ModelEntry>();
     qRegisterMetaType<ECData>();
+    qRegisterMetaType<sempr::Triple>();
+    qRegisterMetaType<std::vector<sempr::Triple>>();
+    qRegisterMetaType<AbstractInterface::Notification>();
 
     form_->setupUi(this);
 
@@ -39,6 +43,9 @@ SemprGui::SemprGui(AbstractInterface::Ptr interface)
     connect(form_->tripleLiveViewWidget, &TripleLiveViewWidget::requestExplanation,
             this, &SemprGui::onExplainRequest);
 
+    // sparql queries use the triples of the live view
+    form_->sparqlWidget->setTripleModel(form_->tripleLiveViewWidget->tripleModel());
+
     // both views use the same model
     form_->treeView->setModel(&dataModel_);
     auto selectionModel = form_->treeView->selectionModel();
@@ -59,7 +66,7 @@ SemprGui::SemprGui(AbstractInterface::Ptr interface)
     form_->tabTriplePropertyMap->setSelectionModel(selectionModel);
 
     // setup the GeoMapWidget
-    form_->geoMapWidget->setup(&dataModel_, selectionModel);
+    form_->geoMapWidget->setup(&dataModel_, selectionModel, tiles);
 
     // setup ReteWidget
     form_->reteWidget->setConnection(interface);
@@ -198,19 +205,45 @@ SemprGui::SemprGui(AbstractInterface::Ptr interface)
     connect(form_->btnCommit, &QPushButton::clicked,
             &dataModel_, &ECModel::commit);
 
-    // initialize the triple live widget and the sparql widget
-    auto triples = interface->listTriples();
-    for (auto& triple : triples)
-    {
-        form_->tripleLiveViewWidget->tripleUpdate(triple, AbstractInterface::Notification::ADDED);
-        form_->sparqlWidget->update(triple, AbstractInterface::Notification::ADDED);
-    }
+    // initialize the triple live widget and the sparql widget. The triples
+    // are fetched in chunks in a separate thread and handed to the gui thread
+    // through gotTripleChunk, just like the live updates.
+    connect(this, &SemprGui::gotTripleChunk,
+            this, &SemprGui::addTriples);
+    connect(this, &SemprGui::gotTripleUpdate,
+            this, &SemprGui::tripleUpdate);
+    connect(this, &SemprGui::finishedTripleLoading,
+            this, [this]()
+            {
+                form_->tripleLiveViewWidget->setLoading(false);
+            });
+
+    // set before the live updates come in, so that triples removed before
+    // their chunk arrives are not re-added by it.
+    form_->tripleLiveViewWidget->setLoading(true);
 
     interface->setTripleUpdateCallback(
         [this](sempr::Triple triple, AbstractInterface::Notification action) -> void
         {
-            this->form_->tripleLiveViewWidget->tripleUpdate(triple, action);
-            this->form_->sparqlWidget->update(triple, action);
+            this->emit gotTripleUpdate(triple, action);
+        }
+    );
+
+    tripleLoader_ = std::thread(
+        [this, interface]()
+        {
+            try {
+                interface->listTriplesChunked(
+                    [this](const std::vector<sempr::Triple>& chunk) -> bool
+                    {
+                        this->emit gotTripleChunk(chunk);
+                        return loadingTriples_;
+                    },
+                    1000);
+            } catch (std::exception& e) {
+                emit dataModel_.error(QString::fromStdString(e.what()));
+            }
+            this->emit finishedTripleLoading();
         }
     );
 
@@ -228,10 +261,26 @@ SemprGui::SemprGui(AbstractInterface::Ptr interface)
 
 SemprGui::~SemprGui()
 {
+    loadingTriples_ = false;
+    if (tripleLoader_.joinable()) tripleLoader_.join();
+    sempr_->clearTripleUpdateCallback();
+
     delete form_;
 }
 
 
+void SemprGui::addTriples(const std::vector<sempr::Triple>& triples)
+{
+    form_->tripleLiveViewWidget->addTriples(triples);
+}
+
+void SemprGui::tripleUpdate(sempr::Triple triple,
+                            AbstractInterface::Notification action)
+{
+    form_->tripleLiveViewWidget->tripleUpdate(triple, action);
+}
+
+
 void SemprGui::logUpdate(const ECData& entry, const QString& mod)
 {
     QTreeWidgetItem* item = new QTreeWidgetItem();
@@ -7,9 +7,13 @@
 #include <QMenu>
 #include <QTreeWidgetItem>
 
+#include <thread>
+#include <atomic>
+
 #include "ECModel.hpp"
 #include "AbstractInterface.hpp"
 #include "UsefulWidget.hpp"
+#include "TileServer.hpp"
 
 //#include "../ui/ui_main.h"
 
@@ -22,6 +26,7 @@ namespace sempr { namespace gui {
     editors.
 */
 class SemprGui : public QWidget {
+    Q_OBJECT
 
     /// the local data model to be used by the different views
     ECModel dataModel_;
@@ -30,7 +35,25 @@ class SemprGui : public QWidget {
     Ui_Form* form_;
 
     AbstractInterface::Ptr sempr_;
+
+    /// fetches the initial set of triples in chunks
+    std::thread tripleLoader_;
+    std::atomic<bool> loadingTriples_;
+
+signals:
+    // emitted from other threads, connected to the slots below to process
+    // the triples in the gui thread.
+    void gotTripleChunk(const std::vector<sempr::Triple>&);
+    void finishedTripleLoading();
+    void gotTripleUpdate(sempr::Triple, sempr::gui::AbstractInterface::Notification);
+
 private slots:
+    /**
+        Passes the triples on to the triple live view and the sparql widget.
+    */
+    void addTriples(const std::vector<sempr::Triple>&);
+    void tripleUpdate(sempr::Triple, sempr::gui::AbstractInterface::Notification);
+
     /**
         Adds/removes the widget tab to/from the tab widget.
     */
@@ -77,7 +100,12 @@ private slots:
     */
     void onExplainRequest(const QString& s, const QString& p, const QString& o);
 public:
-    SemprGui(AbstractInterface::Ptr interface);
+    /**
+        Creates the gui for the given interface. The tile configuration is
+        passed to the geo map.
+    */
+    SemprGui(AbstractInterface::Ptr interface,
+             const TileServer::Config& tiles = TileServer::Config());
     ~SemprGui();
 };
 
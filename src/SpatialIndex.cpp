@@ -0,0 +1,524 @@
+#include "SpatialIndex.hpp"
+
+#include <algorithm>
+#include <queue>
+#include <limits>
+#include <cmath>
+
+namespace sempr { namespace gui {
+
+namespace {
+    typedef SpatialIndex::Box Box;
+
+    double enlargement(const Box& box, const Box& added)
+    {
+        Box united = box;
+        united.extend(added);
+        return united.area() - box.area();
+    }
+
+    // Sorts the range so that consecutive runs of capacity items are tiles
+    // of the STR algorithm.
+    template <class T, class BoxOf>
+    void sortTiles(std::vector<T>& items, size_t capacity, BoxOf boxOf)
+    {
+        size_t n = items.size();
+        size_t numTiles = (n + capacity - 1) / capacity;
+        size_t numSlices = static_cast<size_t>(std::ceil(std::sqrt(double(numTiles))));
+        size_t sliceSize = numSlices * capacity;
+
+        std::sort(items.begin(), items.end(),
+            [&boxOf](const T& a, const T& b)
+            {
+                return boxOf(a).minX + boxOf(a).maxX < boxOf(b).minX + boxOf(b).maxX;
+            });
+
+        for (size_t start = 0; start < n; start += sliceSize)
+        {
+            std::sort(items.begin() + start, items.begin() + std::min(n, start + sliceSize),
+                [&boxOf](const T& a, const T& b)
+                {
+                    return boxOf(a).minY + boxOf(a).maxY < boxOf(b).minY + boxOf(b).maxY;
+                });
+        }
+    }
+
+    // Guttman's quadratic split: Keeps one group in items and returns the
+    // other, each with at least minFill items.
+    template <class T, class BoxOf>
+    std::vector<T> quadraticSplit(std::vector<T>& items, size_t minFill, BoxOf boxOf)
+    {
+        size_t n = items.size();
+        std::vector<Box> boxes;
+        boxes.reserve(n);
+        for (auto& item : items) boxes.push_back(boxOf(item));
+
+        // the seeds: the pair that would waste the most area in one node
+        size_t seedA = 0, seedB = 1;
+        double maxWaste = -std::numeric_limits<double>::infinity();
+        for (size_t i = 0; i < n; i++)
+        {
+            for (size_t j = i + 1; j < n; j++)
+            {
+                Box united = boxes[i];
+                united.extend(boxes[j]);
+                double waste = united.area() - boxes[i].area() - boxes[j].area();
+                if (waste > maxWaste)
+                {
+                    maxWaste = waste;
+                    seedA = i;
+                    seedB = j;
+                }
+            }
+        }
+
+        std::vector<T> groupA, groupB;
+        Box boxA = boxes[seedA], boxB = boxes[seedB];
+        std::vector<bool> assigned(n, false);
+        groupA.push_back(std::move(items[seedA]));
+        groupB.push_back(std::move(items[seedB]));
+        assigned[seedA] = assigned[seedB] = true;
+        size_t remaining = n - 2;
+
+        while (remaining > 0)
+        {
+            // one group needs all remaining items to reach the minimum
+            bool allToA = groupA.size() + remaining <= minFill;
+            bool allToB = groupB.size() + remaining <= minFill;
+            if (allToA || allToB)
+            {
+                for (size_t i = 0; i < n; i++)
+                {
+                    if (assigned[i]) continue;
+                    if (allToA) groupA.push_back(std::move(items[i]));
+                    else        groupB.push_back(std::move(items[i]));
+                }
+                break;
+            }
+
+            // the item with the strongest preference for one of the groups
+            size_t next = 0;
+            double maxDiff = -1;
+            for (size_t i = 0; i < n; i++)
+            {
+                if (assigned[i]) continue;
+                double diff = std::abs(enlargement(boxA, boxes[i]) - enlargement(boxB, boxes[i]));
+                if (diff > maxDiff)
+                {
+                    maxDiff = diff;
+                    next = i;
+                }
+            }
+
+            double enlargeA = enlargement(boxA, boxes[next]);
+            double enlargeB = enlargement(boxB, boxes[next]);
+            bool toA = enlargeA < enlargeB ||
+                       (enlargeA == enlargeB && (boxA.area() < boxB.area() ||
+                            (boxA.area() == boxB.area() && groupA.size() <= groupB.size())));
+
+            if (toA)
+            {
+                groupA.push_back(std::move(items[next]));
+                boxA.extend(boxes[next]);
+            }
+            else
+            {
+                groupB.push_back(std::move(items[next]));
+                boxB.extend(boxes[next]);
+            }
+            assigned[next] = true;
+            remaining--;
+        }
+
+        items = std::move(groupA);
+        return groupB;
+    }
+
+    const Box& boxOfEntry(const SpatialIndex::Entry& entry)
+    {
+        return entry.box;
+    }
+}
+
+
+// -------------------------------------------------------------------------
+// Box
+// -------------------------------------------------------------------------
+SpatialIndex::Box SpatialIndex::Box::point(double x, double y)
+{
+    return Box{ x, y, x, y };
+}
+
+bool SpatialIndex::Box::intersects(const Box& other) const
+{
+    return minX <= other.maxX && other.minX <= maxX &&
+           minY <= other.maxY && other.minY <= maxY;
+}
+
+void SpatialIndex::Box::extend(const Box& other)
+{
+    minX = std::min(minX, other.minX);
+    minY = std::min(minY, other.minY);
+    maxX = std::max(maxX, other.maxX);
+    maxY = std::max(maxY, other.maxY);
+}
+
+double SpatialIndex::Box::area() const
+{
+    return (maxX - minX) * (maxY - minY);
+}
+
+double SpatialIndex::Box::squaredDistance(double x, double y) const
+{
+    double dx = std::max(0., std::max(minX - x, x - maxX));
+    double dy = std::max(0., std::max(minY - y, y - maxY));
+    return dx*dx + dy*dy;
+}
+
+
+// -------------------------------------------------------------------------
+// Node
+// -------------------------------------------------------------------------
+size_t SpatialIndex::Node::count() const
+{
+    return leaf ? entries.size() : children.size();
+}
+
+void SpatialIndex::Node::updateBox()
+{
+    if (leaf)
+    {
+        if (entries.empty()) return;
+        box = entries[0].box;
+        for (auto& entry : entries) box.extend(entry.box);
+    }
+    else
+    {
+        if (children.empty()) return;
+        box = children[0]->box;
+        for (auto& child : children) box.extend(child->box);
+    }
+}
+
+
+// -------------------------------------------------------------------------
+// SpatialIndex
+// -------------------------------------------------------------------------
+SpatialIndex::SpatialIndex()
+    : root_(new Node())
+{
+}
+
+SpatialIndex::~SpatialIndex()
+{
+}
+
+
+void SpatialIndex::clear()
+{
+    root_.reset(new Node());
+    leafOf_.clear();
+}
+
+size_t SpatialIndex::size() const
+{
+    return leafOf_.size();
+}
+
+bool SpatialIndex::contains(int id) const
+{
+    return leafOf_.find(id) != leafOf_.end();
+}
+
+bool SpatialIndex::bounds(Box& box) const
+{
+    if (leafOf_.empty()) return false;
+
+    box = root_->box;
+    return true;
+}
+
+
+void SpatialIndex::build(std::vector<Entry> entries)
+{
+    clear();
+    if (entries.empty()) return;
+
+    // the leaves
+    sortTiles(entries, maxEntries, boxOfEntry);
+
+    std::vector<std::unique_ptr<Node>> level;
+    for (size_t first = 0; first < entries.size(); first += maxEntries)
+    {
+        std::unique_ptr<Node> leaf(new Node());
+        size_t last = std::min(entries.size(), first + maxEntries);
+        leaf->entries.assign(entries.begin() + first, entries.begin() + last);
+        leaf->updateBox();
+        for (auto& entry : leaf->entries) leafOf_[entry.id] = leaf.get();
+
+        level.push_back(std::move(leaf));
+    }
+
+    // the inner levels, until there is only one node left
+    while (level.size() > 1)
+    {
+        sortTiles(level, maxEntries,
+                  [](const std::unique_ptr<Node>& n) -> const Box& { return n->box; });
+
+        std::vector<std::unique_ptr<Node>> parents;
+        for (size_t first = 0; first < level.size(); first += maxEntries)
+        {
+            std::unique_ptr<Node> parent(new Node());
+            parent->leaf = false;
+
+            size_t last = std::min(level.size(), first + maxEntries);
+            for (size_t i = first; i < last; i++)
+            {
+                level[i]->parent = parent.get();
+                parent->children.push_back(std::move(level[i]));
+            }
+            parent->updateBox();
+
+            parents.push_back(std::move(parent));
+        }
+
+        level = std::move(parents);
+    }
+
+    root_ = std::move(level[0]);
+}
+
+
+SpatialIndex::Node* SpatialIndex::chooseLeaf(const Box& box) const
+{
+    Node* node = root_.get();
+    while (!node->leaf)
+    {
+        Node* best = nullptr;
+        double bestEnlargement = 0, bestArea = 0;
+        for (auto& child : node->children)
+        {
+            double e = enlargement(child->box, box);
+            double a = child->box.area();
+            if (!best || e < bestEnlargement || (e == bestEnlargement && a < bestArea))
+            {
+                best = child.get();
+                bestEnlargement = e;
+                bestArea = a;
+            }
+        }
+        node = best;
+    }
+    return node;
+}
+
+
+std::unique_ptr<SpatialIndex::Node> SpatialIndex::split(Node* node)
+{
+    std::unique_ptr<Node> sibling(new Node());
+    sibling->leaf = node->leaf;
+
+    if (node->leaf)
+    {
+        sibling->entries = quadraticSplit(node->entries, minEntries, boxOfEntry);
+        for (auto& entry : sibling->entries) leafOf_[entry.id] = sibling.get();
+    }
+    else
+    {
+        sibling->children = quadraticSplit(node->children, minEntries,
+            [](const std::unique_ptr<Node>& n) -> const Box& { return n->box; });
+        for (auto& child : sibling->children) child->parent = sibling.get();
+    }
+
+    node->updateBox();
+    sibling->updateBox();
+    return sibling;
+}
+
+
+void SpatialIndex::adjustUpwards(Node* node)
+{
+    while (node)
+    {
+        node->updateBox();
+
+        if (node->count() > maxEntries)
+        {
+            auto sibling = split(node);
+
+            if (!node->parent)
+            {
+                // the root was split, the tree grows by one level
+                std::unique_ptr<Node> newRoot(new Node());
+                newRoot->leaf = false;
+                root_->parent = newRoot.get();
+                sibling->parent = newRoot.get();
+                newRoot->children.push_back(std::move(root_));
+                newRoot->children.push_back(std::move(sibling));
+                root_ = std::move(newRoot);
+            }
+            else
+            {
+                sibling->parent = node->parent;
+                node->parent->children.push_back(std::move(sibling));
+            }
+        }
+
+        node = node->parent;
+    }
+}
+
+
+void SpatialIndex::insert(int id, const Box& box)
+{
+    if (contains(id)) remove(id);
+
+    Node* leaf = chooseLeaf(box);
+    leaf->entries.push_back(Entry{ box, id });
+    leafOf_[id] = leaf;
+
+    adjustUpwards(leaf);
+}
+
+
+void SpatialIndex::collectEntries(const Node* node, std::vector<Entry>& entries)
+{
+    if (node->leaf)
+    {
+        entries.insert(entries.end(), node->entries.begin(), node->entries.end());
+    }
+    else
+    {
+        for (auto& child : node->children) collectEntries(child.get(), entries);
+    }
+}
+
+
+bool SpatialIndex::remove(int id)
+{
+    auto it = leafOf_.find(id);
+    if (it == leafOf_.end()) return false;
+
+    Node* node = it->second;
+    leafOf_.erase(it);
+    node->entries.erase(
+        std::find_if(node->entries.begin(), node->entries.end(),
+                     [id](const Entry& e) { return e.id == id; }));
+
+    // Walk up to the root. Underfull nodes are removed, their entries are
+    // inserted again later. The boxes of the others shrink.
+    std::vector<Entry> orphans;
+    while (node->parent)
+    {
+        Node* parent = node->parent;
+        if (node->count() < minEntries)
+        {
+            collectEntries(node, orphans);
+            parent->children.erase(
+                std::find_if(parent->children.begin(), parent->children.end(),
+                             [node](const std::unique_ptr<Node>& n) { return n.get() == node; }));
+        }
+        else
+        {
+            node->updateBox();
+        }
+        node = parent;
+    }
+    root_->updateBox();
+
+    // a root with a single child is not needed
+    while (!root_->leaf && root_->children.size() == 1)
+    {
+        std::unique_ptr<Node> child = std::move(root_->children[0]);
+        child->parent = nullptr;
+        root_ = std::move(child);
+    }
+    if (!root_->leaf && root_->children.empty())
+    {
+        root_.reset(new Node());
+    }
+
+    // the orphans still point to their removed leaves
+    for (auto& entry : orphans) leafOf_.erase(entry.id);
+    for (auto& entry : orphans) insert(entry.id, entry.box);
+
+    return true;
+}
+
+
+void SpatialIndex::query(const Box& box, std::vector<int>& ids) const
+{
+    if (leafOf_.empty()) return;
+
+    std::vector<const Node*> stack;
+    stack.push_back(root_.get());
+
+    while (!stack.empty())
+    {
+        const Node* node = stack.back();
+        stack.pop_back();
+
+        if (!node->box.intersects(box)) continue;
+
+        if (node->leaf)
+        {
+            for (auto& entry : node->entries)
+            {
+                if (entry.box.intersects(box)) ids.push_back(entry.id);
+            }
+        }
+        else
+        {
+            for (auto& child : node->children) stack.push_back(child.get());
+        }
+    }
+}
+
+
+std::vector<int> SpatialIndex::nearest(double x, double y, size_t k) const
+{
+    std::vector<int> ids;
+    if (leafOf_.empty() || k == 0) return ids;
+
+    // Best first: Always expand the closest node or entry. As the box of a
+    // node is never farther away than anything inside it, an entry that is
+    // taken from the queue is nearer than all that is left.
+    struct Item {
+        double distance;
+        const Node* node; // nullptr for an entry
+        int id;
+
+        bool operator > (const Item& other) const { return distance > other.distance; }
+    };
+    std::priority_queue<Item, std::vector<Item>, std::greater<Item>> queue;
+    queue.push(Item{ root_->box.squaredDistance(x, y), root_.get(), 0 });
+
+    while (!queue.empty() && ids.size() < k)
+    {
+        Item item = queue.top();
+        queue.pop();
+
+        if (!item.node)
+        {
+            ids.push_back(item.id);
+        }
+        else if (item.node->leaf)
+        {
+            for (auto& entry : item.node->entries)
+            {
+                queue.push(Item{ entry.box.squaredDistance(x, y), nullptr, entry.id });
+            }
+        }
+        else
+        {
+            for (auto& child : item.node->children)
+            {
+                queue.push(Item{ child->box.squaredDistance(x, y), child.get(), 0 });
+            }
+        }
+    }
+
+    return ids;
+}
+
+}}
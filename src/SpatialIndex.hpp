@@ -0,0 +1,127 @@
+#ifndef SEMPR_GUI_SPATIALINDEX_HPP_
+#define SEMPR_GUI_SPATIALINDEX_HPP_
+
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <cstddef>
+
+namespace sempr { namespace gui {
+
+/**
+    An R-tree of axis aligned boxes, each identified by an int id.
+
+    Entries can be inserted, updated and removed one by one (Guttman's
+    R-tree with quadratic splits, removal with re-insertion of the entries
+    of underfull nodes), each in O(log n). A whole set of entries can be
+    bulk loaded with the sort-tile-recursive (STR) algorithm, which packs
+    the nodes better and is faster than inserting them one by one.
+
+    Queries:
+        - all entries intersecting a box
+        - the k entries nearest to a point, by the distance to their boxes
+          (best first search)
+
+    For geometries, use x = longitude and y = latitude. Distances are
+    measured in that plane, in degrees.
+*/
+class SpatialIndex {
+public:
+    /// a box including its borders. A point is a box with min == max.
+    struct Box {
+        double minX, minY, maxX, maxY;
+
+        static Box point(double x, double y);
+
+        bool intersects(const Box& other) const;
+        void extend(const Box& other);
+        double area() const;
+        /// squared distance from the point to the box, 0 if inside
+        double squaredDistance(double x, double y) const;
+    };
+
+    struct Entry {
+        Box box;
+        int id;
+    };
+
+    SpatialIndex();
+    ~SpatialIndex();
+
+    /**
+        Discards the current content and bulk loads the given entries. The
+        ids must be unique.
+    */
+    void build(std::vector<Entry> entries);
+
+    /**
+        Inserts an entry, or moves it to the new box if the id is already
+        known.
+    */
+    void insert(int id, const Box& box);
+
+    /**
+        Removes the entry with the given id. Returns false if it is unknown.
+    */
+    bool remove(int id);
+
+    bool contains(int id) const;
+    void clear();
+    size_t size() const;
+
+    /**
+        Appends the ids of all entries whose box intersects the given one.
+    */
+    void query(const Box& box, std::vector<int>& ids) const;
+
+    /**
+        Returns the ids of the k entries nearest to the point, nearest first.
+    */
+    std::vector<int> nearest(double x, double y, size_t k = 1) const;
+
+    /**
+        Returns false if the index is empty, else sets box to the bounding
+        box of all entries.
+    */
+    bool bounds(Box& box) const;
+
+private:
+    static const size_t maxEntries = 16;
+    static const size_t minEntries = 6;
+
+    struct Node {
+        Box box;
+        Node* parent = nullptr;
+        bool leaf = true;
+        std::vector<std::unique_ptr<Node>> children; // if !leaf
+        std::vector<Entry> entries;                  // if leaf
+
+        size_t count() const;
+        void updateBox();
+    };
+
+    std::unique_ptr<Node> root_;
+
+    // the leaf every id is stored in
+    std::unordered_map<int, Node*> leafOf_;
+
+    // the leaf whose box needs the least enlargement to include the box
+    Node* chooseLeaf(const Box& box) const;
+
+    // updates the boxes from the node to the root, and splits overfull
+    // nodes on the way
+    void adjustUpwards(Node* node);
+
+    // moves about half of the children/entries of the node to a new node
+    std::unique_ptr<Node> split(Node* node);
+
+    // appends all entries in the subtree of the node
+    static void collectEntries(const Node* node, std::vector<Entry>& entries);
+
+    SpatialIndex(const SpatialIndex&) = delete;
+    SpatialIndex& operator = (const SpatialIndex&) = delete;
+};
+
+}}
+
+#endif /* include guard: SEMPR_GUI_SPATIALINDEX_HPP_ */
@@ -0,0 +1,271 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "SpatialIndex.hpp"
+
+/*
+    Randomized check of the SpatialIndex against a brute force search.
+    Inserts, moves and removes entries in random order (so that nodes are
+    split, underfull nodes collapse and their entries are re-inserted, and
+    the root shrinks), bulk loads them, and compares the results of box and
+    nearest neighbour queries after every step with those of a linear scan.
+
+    usage: sempr-gui-spatial-index-check [numOperations] [seed]
+    Returns 0 if all results match.
+*/
+
+using sempr::gui::SpatialIndex;
+
+namespace {
+
+typedef std::map<int, SpatialIndex::Box> Reference;
+
+class Check {
+    std::mt19937 random_;
+    SpatialIndex index_;
+    Reference reference_;
+    size_t failures_;
+
+    double uniform(double min, double max)
+    {
+        return std::uniform_real_distribution<double>(min, max)(random_);
+    }
+
+    SpatialIndex::Box randomBox()
+    {
+        // mostly small boxes, some points, a few large ones
+        double x = uniform(-180, 180), y = uniform(-90, 90);
+        double r = uniform(0, 1);
+        double size = (r < 0.2 ? 0 : (r < 0.95 ? uniform(0, 2) : uniform(0, 60)));
+        return { x, y, x + size, y + size * uniform(0.2, 2) };
+    }
+
+    void fail(const std::string& what)
+    {
+        if (failures_++ < 10) std::cerr << "FAILED: " << what << std::endl;
+    }
+
+    void checkSize(const std::string& step)
+    {
+        if (index_.size() != reference_.size())
+        {
+            fail(step + ": size " + std::to_string(index_.size()) +
+                 " != " + std::to_string(reference_.size()));
+        }
+    }
+
+    void checkBounds(const std::string& step)
+    {
+        SpatialIndex::Box box;
+        bool has = index_.bounds(box);
+        if (has != !reference_.empty())
+        {
+            fail(step + ": bounds of empty index");
+            return;
+        }
+        if (!has) return;
+
+        SpatialIndex::Box expected = reference_.begin()->second;
+        for (auto& entry : reference_) expected.extend(entry.second);
+        if (box.minX != expected.minX || box.minY != expected.minY ||
+            box.maxX != expected.maxX || box.maxY != expected.maxY)
+        {
+            fail(step + ": bounds");
+        }
+    }
+
+    void checkQuery(const std::string& step)
+    {
+        auto box = randomBox();
+        // sometimes a large part of the world
+        if (uniform(0, 1) < 0.1) box = { -100, -50, 100, 50 };
+
+        std::vector<int> found;
+        index_.query(box, found);
+        std::sort(found.begin(), found.end());
+
+        std::vector<int> expected;
+        for (auto& entry : reference_)
+        {
+            if (entry.second.intersects(box)) expected.push_back(entry.first);
+        }
+
+        if (found != expected)
+        {
+            fail(step + ": query found " + std::to_string(found.size()) +
+                 " instead of " + std::to_string(expected.size()) + " entries");
+        }
+    }
+
+    void checkNearest(const std::string& step)
+    {
+        double x = uniform(-180, 180), y = uniform(-90, 90);
+        size_t k = 1 + random_() % 8;
+
+        auto found = index_.nearest(x, y, k);
+
+        // compare the distances, as there may be ties
+        std::vector<double> expected;
+        for (auto& entry : reference_)
+        {
+            expected.push_back(entry.second.squaredDistance(x, y));
+        }
+        std::sort(expected.begin(), expected.end());
+        expected.resize(std::min(k, expected.size()));
+
+        std::vector<double> distances;
+        for (int id : found)
+        {
+            auto entry = reference_.find(id);
+            if (entry == reference_.end())
+            {
+                fail(step + ": nearest returned unknown id " + std::to_string(id));
+                return;
+            }
+            distances.push_back(entry->second.squaredDistance(x, y));
+        }
+
+        if (distances != expected)
+        {
+            fail(step + ": nearest " + std::to_string(k));
+        }
+    }
+
+    void checkAll(const std::string& step)
+    {
+        checkSize(step);
+        checkBounds(step);
+        checkQuery(step);
+        checkNearest(step);
+    }
+
+public:
+    Check(unsigned seed) : random_(seed), failures_(0) {}
+
+    size_t failures() const { return failures_; }
+
+    /// inserts, moves and removes entries one by one
+    void incremental(size_t numOperations, int& nextId)
+    {
+        for (size_t i = 0; i < numOperations; i++)
+        {
+            double r = uniform(0, 1);
+            // grow in the first half, shrink in the second, to collapse
+            // nodes and lower the tree again
+            double insertRate = (i < numOperations / 2 ? 0.6 : 0.2);
+
+            if (reference_.empty() || r < insertRate)
+            {
+                auto box = randomBox();
+                index_.insert(nextId, box);
+                reference_[nextId] = box;
+                nextId++;
+            }
+            else
+            {
+                auto entry = reference_.begin();
+                std::advance(entry, random_() % reference_.size());
+
+                if (r < insertRate + 0.2)
+                {
+                    auto box = randomBox();
+                    index_.insert(entry->first, box);
+                    entry->second = box;
+                }
+                else
+                {
+                    if (!index_.remove(entry->first)) fail("remove of known id");
+                    if (index_.contains(entry->first)) fail("contains removed id");
+                    reference_.erase(entry);
+                }
+            }
+
+            if (index_.remove(-1)) fail("remove of unknown id");
+
+            // checking everything after every step is quadratic
+            if (i % 7 == 0 || reference_.size() < 50)
+            {
+                checkAll("incremental step " + std::to_string(i));
+            }
+        }
+        checkAll("after incremental");
+    }
+
+    /// bulk loads the current reference, then modifies it further
+    void bulk(size_t numOperations, int& nextId)
+    {
+        std::vector<SpatialIndex::Entry> entries;
+        for (size_t i = 0; i < numOperations; i++)
+        {
+            auto box = randomBox();
+            entries.push_back({ box, nextId });
+            nextId++;
+        }
+
+        reference_.clear();
+        for (auto& entry : entries) reference_[entry.id] = entry.box;
+        index_.build(entries);
+        checkAll("after build");
+
+        incremental(numOperations, nextId);
+    }
+
+    /// removes everything, in random order
+    void removeAll()
+    {
+        std::vector<int> ids;
+        for (auto& entry : reference_) ids.push_back(entry.first);
+        std::shuffle(ids.begin(), ids.end(), random_);
+
+        for (size_t i = 0; i < ids.size(); i++)
+        {
+            if (!index_.remove(ids[i])) fail("remove during removeAll");
+            reference_.erase(ids[i]);
+            if (i % 13 == 0) checkAll("removeAll step " + std::to_string(i));
+        }
+        checkAll("after removeAll");
+    }
+};
+
+}
+
+
+int main(int argc, char** args)
+{
+    size_t numOperations = 5000;
+    unsigned seed = 42;
+    try {
+        if (argc > 1) numOperations = std::stoul(args[1]);
+        if (argc > 2) seed = std::stoul(args[2]);
+    } catch (std::exception&) {
+        std::cerr << "usage: " << args[0] << " [numOperations] [seed]" << std::endl;
+        return 2;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    Check check(seed);
+    int nextId = 0;
+    check.incremental(numOperations, nextId);
+    check.removeAll();
+    check.bulk(numOperations, nextId);
+    check.removeAll();
+
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start).count();
+
+    if (check.failures() > 0)
+    {
+        std::cerr << check.failures() << " checks failed" << std::endl;
+        return 1;
+    }
+
+    std::cout << "all checks passed (" << numOperations << " operations, seed "
+              << seed << ", " << ms << " ms)" << std::endl;
+    return 0;
+}
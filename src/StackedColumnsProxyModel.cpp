@@ -5,42 +5,150 @@
 namespace sempr { namespace gui {
 
 StackedColumnsProxyModel::StackedColumnsProxyModel(QObject* parent)
-    : QIdentityProxyModel(parent)
+    : QAbstractProxyModel(parent), forwarding_(false)
 {
 }
 
-int StackedColumnsProxyModel::rowCount(const QModelIndex& parent) const
+void StackedColumnsProxyModel::setSourceModel(QAbstractItemModel* source)
 {
-    if (parent.isValid())
+    beginResetModel();
+
+    if (sourceModel())
     {
-        return 0; // don't want to deal with child items.
-        //return QAbstractProxyModel::rowCount(parent);
+        disconnect(sourceModel(), nullptr, this, nullptr);
     }
-    else
+
+    QAbstractProxyModel::setSourceModel(source);
+
+    if (source)
     {
-        int count =  sourceModel()->rowCount(QModelIndex()) *
-                     sourceModel()->columnCount(QModelIndex());
-//        qDebug() << "proxy row count: " << count;
-        return count;
+        connect(source, &QAbstractItemModel::rowsAboutToBeInserted,
+                this, &StackedColumnsProxyModel::sourceRowsAboutToBeInserted);
+        connect(source, &QAbstractItemModel::rowsInserted,
+                this, &StackedColumnsProxyModel::sourceRowsInserted);
+        connect(source, &QAbstractItemModel::rowsAboutToBeRemoved,
+                this, &StackedColumnsProxyModel::sourceRowsAboutToBeRemoved);
+        connect(source, &QAbstractItemModel::rowsRemoved,
+                this, &StackedColumnsProxyModel::sourceRowsRemoved);
+        connect(source, &QAbstractItemModel::dataChanged,
+                this, &StackedColumnsProxyModel::sourceDataChanged);
+
+        // everything else changes the position of all cells
+        connect(source, &QAbstractItemModel::modelAboutToBeReset,
+                this, &StackedColumnsProxyModel::sourceAboutToBeReset);
+        connect(source, &QAbstractItemModel::modelReset,
+                this, &StackedColumnsProxyModel::sourceReset);
+        connect(source, &QAbstractItemModel::layoutAboutToBeChanged,
+                this, &StackedColumnsProxyModel::sourceAboutToBeReset);
+        connect(source, &QAbstractItemModel::layoutChanged,
+                this, &StackedColumnsProxyModel::sourceReset);
+        connect(source, &QAbstractItemModel::rowsAboutToBeMoved,
+                this, &StackedColumnsProxyModel::sourceAboutToBeReset);
+        connect(source, &QAbstractItemModel::rowsMoved,
+                this, &StackedColumnsProxyModel::sourceReset);
+        connect(source, &QAbstractItemModel::columnsAboutToBeInserted,
+                this, &StackedColumnsProxyModel::sourceAboutToBeReset);
+        connect(source, &QAbstractItemModel::columnsInserted,
+                this, &StackedColumnsProxyModel::sourceReset);
+        connect(source, &QAbstractItemModel::columnsAboutToBeRemoved,
+                this, &StackedColumnsProxyModel::sourceAboutToBeReset);
+        connect(source, &QAbstractItemModel::columnsRemoved,
+                this, &StackedColumnsProxyModel::sourceReset);
+        connect(source, &QAbstractItemModel::columnsAboutToBeMoved,
+                this, &StackedColumnsProxyModel::sourceAboutToBeReset);
+        connect(source, &QAbstractItemModel::columnsMoved,
+                this, &StackedColumnsProxyModel::sourceReset);
     }
+
+    endResetModel();
+}
+
+int StackedColumnsProxyModel::sourceColumns() const
+{
+    if (!sourceModel()) return 0;
+    return sourceModel()->columnCount(QModelIndex());
+}
+
+
+void StackedColumnsProxyModel::sourceRowsAboutToBeInserted(
+        const QModelIndex& parent, int first, int last)
+{
+    int columns = sourceColumns();
+    if (parent.isValid() || columns == 0) return;
+
+    forwarding_ = true;
+    beginInsertRows(QModelIndex(), first * columns, (last + 1) * columns - 1);
+}
+
+void StackedColumnsProxyModel::sourceRowsInserted(
+        const QModelIndex& /*parent*/, int /*first*/, int /*last*/)
+{
+    if (!forwarding_) return;
+    forwarding_ = false;
+    endInsertRows();
+}
+
+void StackedColumnsProxyModel::sourceRowsAboutToBeRemoved(
+        const QModelIndex& parent, int first, int last)
+{
+    int columns = sourceColumns();
+    if (parent.isValid() || columns == 0) return;
+
+    forwarding_ = true;
+    beginRemoveRows(QModelIndex(), first * columns, (last + 1) * columns - 1);
 }
 
+void StackedColumnsProxyModel::sourceRowsRemoved(
+        const QModelIndex& /*parent*/, int /*first*/, int /*last*/)
+{
+    if (!forwarding_) return;
+    forwarding_ = false;
+    endRemoveRows();
+}
 
-int StackedColumnsProxyModel::columnCount(const QModelIndex& parent) const
+void StackedColumnsProxyModel::sourceDataChanged(
+        const QModelIndex& topLeft, const QModelIndex& bottomRight,
+        const QVector<int>& roles)
 {
-    if (parent.isValid())
+    if (topLeft.parent().isValid()) return;
+
+    // the changed cells lie in between, in the stacked order
+    emit dataChanged(mapFromSource(topLeft), mapFromSource(bottomRight), roles);
+}
+
+void StackedColumnsProxyModel::sourceAboutToBeReset()
+{
+    beginResetModel();
+}
+
+void StackedColumnsProxyModel::sourceReset()
+{
+    endResetModel();
+}
+
+
+int StackedColumnsProxyModel::rowCount(const QModelIndex& parent) const
+{
+    if (parent.isValid() || !sourceModel())
     {
-        return 1;
-        //return QAbstractProxyModel::columnCount(parent);
+        return 0; // don't want to deal with child items.
     }
     else
     {
-        return 1;
+        return sourceModel()->rowCount(QModelIndex()) * sourceColumns();
     }
 }
 
-QModelIndex StackedColumnsProxyModel::index(int row, int column, const QModelIndex& /*parent*/) const
+
+int StackedColumnsProxyModel::columnCount(const QModelIndex& /*parent*/) const
 {
+    return 1;
+}
+
+QModelIndex StackedColumnsProxyModel::index(int row, int column, const QModelIndex& parent) const
+{
+    if (parent.isValid() || column != 0 || row < 0 || row >= rowCount(parent))
+        return QModelIndex();
     return createIndex(row, column);
 }
 
@@ -52,29 +160,23 @@ QModelIndex StackedColumnsProxyModel::parent(const QModelIndex& /* index */) con
 
 QModelIndex StackedColumnsProxyModel::mapFromSource(const QModelIndex& sourceIndex) const
 {
-    // (row, column) -> (column * rowsPerColumn + row, 0)
-    auto index = createIndex(
-            sourceIndex.column() * sourceModel()->rowCount(QModelIndex())
-            + sourceIndex.row(), 0);
+    if (!sourceIndex.isValid()) return QModelIndex();
 
-//    qDebug() << "mapFromSource " << sourceIndex << " -> " << index;
-    return index;
+    // (row, column) -> (row * columnCount + column, 0)
+    return createIndex(sourceIndex.row() * sourceColumns() + sourceIndex.column(), 0);
 }
 
 QModelIndex StackedColumnsProxyModel::mapToSource(const QModelIndex& proxyIndex) const
 {
-    // (column * rowsPerColumn + row) % rowsPerColumn = row
-    // (column * rowsPerColumn + row) / rowsPerColumn = column
-    int rowCount = sourceModel()->rowCount();
-    if (rowCount == 0) rowCount = 1; // avoid division by zero
-
-    auto index = sourceModel()->index(
-            proxyIndex.row() % rowCount,
-            proxyIndex.row() / rowCount);
+    if (!proxyIndex.isValid() || !sourceModel()) return QModelIndex();
 
-//    qDebug() << "mapToSource " << proxyIndex << " -> " << index;
+    // (row * columnCount + column) / columnCount = row
+    // (row * columnCount + column) % columnCount = column
+    int columns = sourceColumns();
+    if (columns == 0) return QModelIndex();
 
-    return index;
+    return sourceModel()->index(proxyIndex.row() / columns,
+                                proxyIndex.row() % columns);
 }
 
 
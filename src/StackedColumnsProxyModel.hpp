@@ -1,22 +1,47 @@
 #ifndef SEMPR_GUI_STACKEDCOLUMNSPROXYMODEL_HPP_
 #define SEMPR_GUI_STACKEDCOLUMNSPROXYMODEL_HPP_
 
-#include <QIdentityProxyModel>
+#include <QAbstractProxyModel>
 
 namespace sempr { namespace gui {
 
 /**
     This proxy model transforms a given model with multiple columns into a
     single-column model. Columns are virtually stacked by a simple
-    transformation of model indices.
+    transformation of model indices: The cells of a source row are placed
+    next to each other, i.e. (row, column) -> (row * columnCount + column).
+
+    This keeps the cells of consecutive source rows together, so that rows
+    inserted into or removed from the source are forwarded as a single
+    insertion/removal of consecutive rows, which allows the models on top of
+    this (e.g. the UniqueFilterProxyModel) to update incrementally.
 
     Use this only with flat models that have only one level of depth, i.e.
     parent() for any model index always returns an invalid QModelIndex().
 */
-class StackedColumnsProxyModel : public QIdentityProxyModel {
+class StackedColumnsProxyModel : public QAbstractProxyModel {
+    Q_OBJECT
+
+    // true while an insertion/removal of rows is forwarded
+    bool forwarding_;
+
+    int sourceColumns() const;
+
+protected slots:
+    void sourceRowsAboutToBeInserted(const QModelIndex& parent, int first, int last);
+    void sourceRowsInserted(const QModelIndex& parent, int first, int last);
+    void sourceRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last);
+    void sourceRowsRemoved(const QModelIndex& parent, int first, int last);
+    void sourceDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight,
+                           const QVector<int>& roles);
+    void sourceAboutToBeReset();
+    void sourceReset();
+
 public:
     StackedColumnsProxyModel(QObject* parent = nullptr);
 
+    void setSourceModel(QAbstractItemModel* source) override;
+
     QModelIndex mapFromSource(const QModelIndex& sourceIndex) const override;
     QModelIndex mapToSource(const QModelIndex& proxyIndex) const override;
 
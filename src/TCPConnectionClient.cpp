@@ -3,7 +3,6 @@
 #include "ECDataZMQ.hpp"
 #include "LogDataZMQ.hpp"
 
-#include <cereal/archives/json.hpp>
 #include <iostream>
 #include <exception>
 
@@ -13,22 +12,56 @@ TCPConnectionClient::TCPConnectionClient()
     : updateSubscriber_(context_, zmqpp::socket_type::subscribe),
       requestSocket_(context_, zmqpp::socket_type::request),
       loggingSubscriber_(context_, zmqpp::socket_type::subscribe),
-      running_(false)
+      stopReceiver_(context_, zmqpp::socket_type::pair),
+      stopSender_(context_, zmqpp::socket_type::pair),
+      running_(false),
+      format_(WireFormat::JSON),
+      metadataOnly_(false)
 {
+    // the endpoint only needs to be unique within our own context
+    stopReceiver_.bind("inproc://stop-update-worker");
+    stopSender_.connect("inproc://stop-update-worker");
+}
+
+TCPConnectionClient::~TCPConnectionClient()
+{
+    stop();
 }
 
 
 void TCPConnectionClient::connect(
         const std::string& updateEndpoint,
-        const std::string& requestEndpoint)
+        const std::string& requestEndpoint,
+        WireFormat preferredFormat,
+        bool metadataOnly)
 {
+    metadataOnly_ = metadataOnly;
+
     updateSubscriber_.connect(updateEndpoint);
-    updateSubscriber_.subscribe("data");
+    updateSubscriber_.subscribe(metadataOnly ? "meta" : "data");
+    updateSubscriber_.subscribe("triples");
 
     loggingSubscriber_.connect(updateEndpoint);
     loggingSubscriber_.subscribe("logging");
 
     requestSocket_.connect(requestEndpoint);
+
+    // ask the server to use our preferred format. It answers in the format
+    // it is going to use, which we then use for all following requests.
+    TCPConnectionRequest request;
+    request.action = TCPConnectionRequest::NEGOTIATE_FORMAT;
+    request.format = preferredFormat;
+
+    auto response = execRequest(request);
+    if (!response.success) throw std::runtime_error(response.msg);
+
+    format_ = response.format;
+}
+
+
+WireFormat TCPConnectionClient::wireFormat() const
+{
+    return format_;
 }
 
 
@@ -39,81 +72,129 @@ void TCPConnectionClient::start()
     updateWorker_ = std::thread(
         [this]()
         {
+            zmqpp::poller poller;
+            poller.add(updateSubscriber_, zmqpp::poller::poll_in);
+            poller.add(loggingSubscriber_, zmqpp::poller::poll_in);
+            poller.add(stopReceiver_, zmqpp::poller::poll_in);
+
             while (running_)
             {
-                zmqpp::message msg;
-                std::string topic;
-                bool msgAvailable = updateSubscriber_.receive(topic, true);
-                if (msgAvailable)
-                {
-                    updateSubscriber_.receive(msg);
-
-                    UpdateType type;
-                    msg >> type;
-                    if (type == UpdateType::EntityComponent)
-                    {
-                        ECData data;
-                        Notification action;
-
-                        msg >> data >> action;
-
-                        this->triggerCallback(data, action);
-                    }
-                    else if (type == UpdateType::Triple)
-                    {
-                        std::cout << "TCPConnectionClient - trigger triple update callback" << std::endl;
-
-                        std::string tripleString;
-                        Notification action;
-
-                        msg >> tripleString >> action;
-
-                        std::stringstream ss(tripleString);
-                        cereal::JSONInputArchive ar(ss);
-                        sempr::Triple triple;
-                        ar(triple);
-
-                        this->triggerTripleCallback(triple, action);
-                    }
-                    else
-                    {
-                        std::cerr << "unknown update message type"
-                                  << static_cast<int>(type) << std::endl;
-                    }
-                }
+                // block until anything happens
+                if (!poller.poll(zmqpp::poller::wait_forever)) continue;
 
-                bool logAvailable = loggingSubscriber_.receive(topic, true);
-                if (logAvailable)
+                if (poller.has_input(stopReceiver_))
                 {
-                    loggingSubscriber_.receive(msg);
-
-                    LogData log;
-                    msg >> log;
-                    this->triggerLoggingCallback(log);
+                    std::string signal;
+                    stopReceiver_.receive(signal);
+                    break;
                 }
 
-                if (!(msgAvailable || logAvailable))
-                {
-                    // only sleep if there is no message available
-                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
-                }
+                if (poller.has_input(updateSubscriber_)) drainUpdates();
+                if (poller.has_input(loggingSubscriber_)) drainLogs();
             }
         }
     );
 }
 
+void TCPConnectionClient::drainUpdates()
+{
+    std::string topic;
+    while (updateSubscriber_.receive(topic, true))
+    {
+        zmqpp::message msg;
+        updateSubscriber_.receive(msg);
+
+        UpdateType type;
+        msg >> type;
+        if (type == UpdateType::EntityComponent)
+        {
+            ECData data;
+            Notification action;
+
+            msg >> data >> action;
+
+            this->triggerCallback(data, action);
+        }
+        else if (type == UpdateType::Triple)
+        {
+            sempr::Triple triple;
+            Notification action;
+
+            msg >> triple >> action;
+
+            this->triggerTripleCallback(triple, action);
+        }
+        else if (type == UpdateType::EntityComponentBatch)
+        {
+            uint32_t count;
+            msg >> count;
+            for (uint32_t i = 0; i < count; i++)
+            {
+                ECData data;
+                Notification action;
+
+                msg >> data >> action;
+
+                this->triggerCallback(data, action);
+            }
+        }
+        else if (type == UpdateType::TripleBatch)
+        {
+            uint32_t count;
+            msg >> count;
+            for (uint32_t i = 0; i < count; i++)
+            {
+                sempr::Triple triple;
+                Notification action;
+
+                msg >> triple >> action;
+
+                this->triggerTripleCallback(triple, action);
+            }
+        }
+        else
+        {
+            std::cerr << "unknown update message type"
+                      << static_cast<int>(type) << std::endl;
+        }
+    }
+}
+
+void TCPConnectionClient::drainLogs()
+{
+    std::string topic;
+    while (loggingSubscriber_.receive(topic, true))
+    {
+        zmqpp::message msg;
+        loggingSubscriber_.receive(msg);
+
+        LogData log;
+        msg >> log;
+        this->triggerLoggingCallback(log);
+    }
+}
+
 void TCPConnectionClient::stop()
 {
-    running_ = false; // will stop the updateWorker
-    if (updateWorker_.joinable()) updateWorker_.join(); // wait for the thread to finish
+    if (!updateWorker_.joinable()) return;
+
+    running_ = false;
+    stopSender_.send("stop"); // wake up the updateWorker
+    updateWorker_.join(); // wait for the thread to finish
 }
 
 
 TCPConnectionResponse TCPConnectionClient::execRequest(const TCPConnectionRequest& request)
 {
     zmqpp::message reqMsg, resMsg;
-    reqMsg << request;
+    TCPConnectionRequest formatted(request);
+    if (formatted.action != TCPConnectionRequest::NEGOTIATE_FORMAT)
+    {
+        formatted.format = format_;
+    }
+    reqMsg << formatted;
 
+    std::lock_guard<std::mutex> lock(requestMutex_);
     requestSocket_.send(reqMsg);
     requestSocket_.receive(resMsg);
 
@@ -131,13 +212,24 @@ Graph TCPConnectionClient::getReteNetworkRepresentation()
 
     if (response.success)
     {
-        std::stringstream ss(response.reteNetwork);
-        cereal::JSONInputArchive ar(ss);
+        return response.reteNetwork;
+    }
+    else
+    {
+        throw std::runtime_error(response.msg); // TODO better exceptions...
+    }
+}
 
-        Graph g;
-        ar >> g;
+GraphDiff TCPConnectionClient::getReteNetworkDiff(uint64_t sinceRevision)
+{
+    TCPConnectionRequest request;
+    request.action = TCPConnectionRequest::GET_RETE_NETWORK_DIFF;
+    request.revision = sinceRevision;
+    auto response = execRequest(request);
 
-        return g;
+    if (response.success)
+    {
+        return response.reteNetworkDiff;
     }
     else
     {
@@ -203,6 +295,7 @@ std::vector<ECData> TCPConnectionClient::listEntityComponentPairs()
 {
     TCPConnectionRequest request;
     request.action = TCPConnectionRequest::LIST_ALL_EC_PAIRS;
+    request.metadataOnly = metadataOnly_;
 
     auto response = execRequest(request);
 
@@ -232,6 +325,66 @@ std::vector<sempr::Triple> TCPConnectionClient::listTriples()
     }
 }
 
+void TCPConnectionClient::listEntityComponentPairsChunked(
+        ec_chunk_callback_t callback, size_t chunkSize)
+{
+    TCPConnectionRequest request;
+    request.action = TCPConnectionRequest::LIST_EC_PAIRS_CHUNK;
+    request.chunkSize = static_cast<uint32_t>(chunkSize);
+    request.metadataOnly = metadataOnly_;
+
+    do {
+        auto response = execRequest(request);
+        if (!response.success) throw std::runtime_error(response.msg);
+
+        request.cursor = response.cursor;
+        // if the callback stops early the server discards the listing after
+        // a timeout.
+        if (!callback(response.data)) break;
+    } while (request.cursor != 0);
+}
+
+void TCPConnectionClient::listTriplesChunked(
+        triple_chunk_callback_t callback, size_t chunkSize)
+{
+    TCPConnectionRequest request;
+    request.action = TCPConnectionRequest::LIST_TRIPLES_CHUNK;
+    request.chunkSize = static_cast<uint32_t>(chunkSize);
+
+    do {
+        auto response = execRequest(request);
+        if (!response.success) throw std::runtime_error(response.msg);
+
+        request.cursor = response.cursor;
+        if (!callback(response.triples)) break;
+    } while (request.cursor != 0);
+}
+
+ECData TCPConnectionClient::getComponent(const ECData& which)
+{
+    TCPConnectionRequest request;
+    request.action = TCPConnectionRequest::GET_COMPONENT;
+    request.data = which;
+
+    auto response = execRequest(request);
+    if (!response.success) throw std::runtime_error(response.msg);
+    if (response.data.empty()) throw std::runtime_error("no component received");
+
+    return response.data[0];
+}
+
+std::vector<ECData> TCPConnectionClient::getComponents(const std::vector<ECData>& which)
+{
+    TCPConnectionRequest request;
+    request.action = TCPConnectionRequest::GET_COMPONENTS;
+    request.components = which;
+
+    auto response = execRequest(request);
+    if (!response.success) throw std::runtime_error(response.msg);
+
+    return response.data;
+}
+
 
 void TCPConnectionClient::addEntityComponentPair(const ECData& data)
 {
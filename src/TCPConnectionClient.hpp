@@ -7,6 +7,7 @@
 #include <zmqpp/zmqpp.hpp>
 #include <thread>
 #include <atomic>
+#include <mutex>
 
 namespace sempr { namespace gui {
 
@@ -22,30 +23,69 @@ class TCPConnectionClient : public AbstractInterface {
     zmqpp::socket requestSocket_;
     zmqpp::socket loggingSubscriber_;
 
-    // an extra thread handling messages incoming on updateSubscriber_
+    // an inproc pair used to wake up the updateWorker_ when stopping
+    zmqpp::socket stopReceiver_;
+    zmqpp::socket stopSender_;
+
+    // an extra thread handling messages incoming on updateSubscriber_ and
+    // loggingSubscriber_
     std::thread updateWorker_;
     std::atomic<bool> running_;
 
+    // helpers for the updateWorker_: handle all messages currently available
+    // on the respective socket
+    void drainUpdates();
+    void drainLogs();
+
+    // the format of the response payloads, negotiated in connect
+    WireFormat format_;
+
+    // whether EC pairs are listed and updated without their json
+    bool metadataOnly_;
+
+    // the request socket may be used from different threads, e.g. the gui
+    // and a thread loading the initial data in chunks.
+    std::mutex requestMutex_;
+
     // convenience method to execute a request and get a response
     TCPConnectionResponse execRequest(const TCPConnectionRequest&);
 public:
     using Ptr = std::shared_ptr<TCPConnectionClient>;
     TCPConnectionClient();
+    ~TCPConnectionClient();
 
-    // creates a connection to the server
+    /**
+        Creates a connection to the server and negotiates the format of the
+        response payloads. The server may fall back to JSON if it does not
+        support the preferred format.
+        With metadataOnly set, EC pairs are listed and updated without their
+        json, which is only fetched through getComponent when needed.
+    */
     void connect(const std::string& updateEndpoint,
-                 const std::string& requestEndpoint);
+                 const std::string& requestEndpoint,
+                 WireFormat preferredFormat = WireFormat::PortableBinary,
+                 bool metadataOnly = false);
+
+    // the format negotiated in connect
+    WireFormat wireFormat() const;
 
     // handling updates in a separate thread
     void start();
     void stop();
 
     Graph getReteNetworkRepresentation() override;
+    GraphDiff getReteNetworkDiff(uint64_t sinceRevision) override;
     ExplanationGraph getExplanation(const ECData &ec) override;
     ExplanationGraph getExplanation(sempr::Triple::Ptr triple) override;
     std::vector<Rule> getRulesRepresentation() override;
     std::vector<ECData> listEntityComponentPairs() override;
     std::vector<sempr::Triple> listTriples() override;
+    void listEntityComponentPairsChunked(ec_chunk_callback_t callback,
+                                         size_t chunkSize) override;
+    void listTriplesChunked(triple_chunk_callback_t callback,
+                            size_t chunkSize) override;
+    ECData getComponent(const ECData& which) override;
+    std::vector<ECData> getComponents(const std::vector<ECData>& which) override;
     void addEntityComponentPair(const ECData&) override;
     void modifyEntityComponentPair(const ECData&) override;
     void removeEntityComponentPair(const ECData&) override;
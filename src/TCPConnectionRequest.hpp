@@ -7,10 +7,36 @@
 
 #include <zmqpp/zmqpp.hpp>
 #include <cereal/archives/json.hpp>
+#include <cereal/archives/portable_binary.hpp>
 #include <cereal/types/vector.hpp>
+#include <cereal/types/string.hpp>
+
+#include <sstream>
+#include <stdexcept>
+#include <cstdint>
 
 namespace sempr { namespace gui {
 
+/**
+    The version of the message layout used between TCPConnectionClient and
+    TCPConnectionServer. Every request and response starts with it, and a
+    mismatch is reported as an error instead of silently misreading frames.
+*/
+const int TCPConnectionProtocolVersion = 8;
+
+/**
+    The encoding used for the bulk payload of requests and responses, i.e.
+    lists of EC pairs, triples, rules and the rete/explanation graphs.
+    PortableBinary uses cereals portable binary archive and is the default.
+    JSON is kept as a fallback, as it is human readable and hence useful for
+    debugging. The format is negotiated once in TCPConnectionClient::connect.
+*/
+enum struct WireFormat {
+    JSON = 0,
+    PortableBinary
+};
+
+
 /**
     A wrapper for a request made from the client side. Translates to the
     AbstractInterface.
@@ -25,21 +51,46 @@ struct TCPConnectionRequest {
         GET_RULES,
         LIST_ALL_TRIPLES,
         GET_EXPLANATION_ECWME,
-        GET_EXPLANATION_TRIPLE
+        GET_EXPLANATION_TRIPLE,
+        NEGOTIATE_FORMAT, // the server answers with the format it will use
+        LIST_EC_PAIRS_CHUNK,
+        LIST_TRIPLES_CHUNK,
+        GET_COMPONENT, // the complete ECData for request.data
+        GET_RETE_NETWORK_DIFF, // the changes since request.revision
+        GET_COMPONENTS // the complete ECData for all of request.components
     };
 
     Action action;
+    WireFormat format = WireFormat::JSON; // format of the response payload
     ECData data;
     sempr::Triple toExplain; // just for GET_EXPLANATION_TRIPLE
+
+    // just for LIST_[EC_PAIRS|TRIPLES]_CHUNK: 0 to start a new listing, else
+    // the cursor returned with the previous chunk.
+    uint64_t cursor = 0;
+    uint32_t chunkSize = 0;
+
+    // for LIST_ALL_EC_PAIRS and LIST_EC_PAIRS_CHUNK: leave out the json
+    bool metadataOnly = false;
+
+    // just for GET_RETE_NETWORK_DIFF: the revision the client knows
+    uint64_t revision = 0;
+
+    // just for GET_COMPONENTS: the entity-component pairs to fetch
+    std::vector<ECData> components;
 };
 
 
 /**
-    To differ between types of updates (EC or Triple)
+    To differ between types of updates (EC or Triple). The batch variants are
+    followed by the number of items, and then the items themselves, each with
+    its notification.
 */
 enum struct UpdateType {
     EntityComponent = 0,
-    Triple
+    Triple,
+    EntityComponentBatch,
+    TripleBatch
 };
 
 
@@ -50,64 +101,54 @@ enum struct UpdateType {
 struct TCPConnectionResponse {
     bool success;
     std::string msg; // in case of errors, here could be some description.
-    std::vector<ECData> data; // just for the LIST_ALL_EC_PAIRS action, contains all the EC pairs.
-    std::string reteNetwork; // just for GET_RETE_NETWORK action, json representation of a Graph
+    WireFormat format = WireFormat::JSON; // format of the payload below
+    std::vector<ECData> data; // just for the LIST_ALL_EC_PAIRS action, contains all the EC pairs. (and GET_COMPONENT[S])
+    Graph reteNetwork; // just for GET_RETE_NETWORK action
+    GraphDiff reteNetworkDiff; // just for GET_RETE_NETWORK_DIFF
     std::vector<Rule> rules; // just for GET_RULES
     std::vector<sempr::Triple> triples; // just for LIST_ALL_TRIPLES
     ExplanationGraph explanationGraph; // just for GET_EXPLANATION_[ECWME|TRIPLE]
+    uint64_t cursor = 0; // just for LIST_*_CHUNK, 0 if this was the last chunk
 };
 
 
-// helper: write sempr::gui::Rule to the message type
-inline zmqpp::message& operator << (zmqpp::message& msg, Rule r)
+// helper: serialize anything cereal can handle into a string, in the given
+// format.
+template <class T>
+std::string encodePayload(const T& value, WireFormat format)
 {
-    std::stringstream ss;
+    std::stringstream ss(std::ios::in | std::ios::out | std::ios::binary);
+    if (format == WireFormat::PortableBinary)
     {
-        cereal::JSONOutputArchive ar(ss);
-        ar(r);
+        cereal::PortableBinaryOutputArchive ar(ss);
+        ar(value);
     }
+    else
+    {
+        cereal::JSONOutputArchive ar(ss);
+        ar(value);
+    } // the json archive only finishes its output on destruction
 
-    msg << ss.str();
-    return msg;
-}
-
-// helper: read sempr::gui::Rule from message type
-inline zmqpp::message& operator >> (zmqpp::message& msg, Rule& r)
-{
-    std::string s;
-    msg >> s;
-
-    std::stringstream ss(s);
-    cereal::JSONInputArchive ar(ss);
-    ar(r);
-
-    return msg;
+    return ss.str();
 }
 
-// helper: write ExplanationGraph
-inline zmqpp::message& operator << (zmqpp::message& msg, const ExplanationGraph& graph)
+// helper: deserialize a string created by encodePayload
+template <class T>
+void decodePayload(const std::string& str, T& value, WireFormat format)
 {
-    std::stringstream ss;
+    std::stringstream ss(str, std::ios::in | std::ios::out | std::ios::binary);
+    if (format == WireFormat::PortableBinary)
     {
-        cereal::JSONOutputArchive ar(ss);
-        ar(graph);
+        cereal::PortableBinaryInputArchive ar(ss);
+        ar(value);
+    }
+    else
+    {
+        cereal::JSONInputArchive ar(ss);
+        ar(value);
     }
-    msg << ss.str();
-    return msg;
 }
 
-// helper: read ExplanationGraph
-inline zmqpp::message& operator >> (zmqpp::message& msg, ExplanationGraph& graph)
-{
-    std::string explString;
-    msg >> explString;
-
-    std::stringstream ss(explString);
-    cereal::JSONInputArchive ar(ss);
-    ar(graph);
-
-    return msg;
-}
 
 // next, we need operators to read and write requests and responses from/to
 // the zmqpp::message type.
@@ -141,70 +182,98 @@ inline zmqpp::message& operator >> (zmqpp::message& msg, UpdateType& type)
     return msg;
 }
 
-// helper: write triple
+// helper: WireFormat enum. Unknown values are read as JSON, which every
+// version of the protocol understands.
+inline zmqpp::message& operator << (zmqpp::message& msg, WireFormat format)
+{
+    msg << static_cast<int>(format);
+    return msg;
+}
+
+inline zmqpp::message& operator >> (zmqpp::message& msg, WireFormat& format)
+{
+    int tmp;
+    msg >> tmp;
+    if (tmp == static_cast<int>(WireFormat::PortableBinary))
+        format = WireFormat::PortableBinary;
+    else
+        format = WireFormat::JSON;
+    return msg;
+}
+
+// helper: write triple. A single triple is just three strings, which does
+// not need any further encoding.
 inline zmqpp::message& operator << (zmqpp::message& msg, const sempr::Triple& triple)
 {
-    std::stringstream ss;
-    {
-        cereal::JSONOutputArchive ar(ss);
-        ar(triple);
-    }
-    msg << ss.str();
+    msg << triple.getField(sempr::Triple::Field::SUBJECT)
+        << triple.getField(sempr::Triple::Field::PREDICATE)
+        << triple.getField(sempr::Triple::Field::OBJECT);
     return msg;
 }
 
 // helper: read triple
 inline zmqpp::message& operator >> (zmqpp::message& msg, sempr::Triple& triple)
 {
-    std::string tstr;
-    msg >> tstr;
-    std::stringstream ss(tstr);
-    cereal::JSONInputArchive ar(ss);
-    ar(triple);
+    std::string s, p, o;
+    msg >> s >> p >> o;
+    triple = sempr::Triple(s, p, o);
 
     return msg;
 }
 
+// helper: check the protocol version at the start of a request/response
+inline void readProtocolVersion(zmqpp::message& msg)
+{
+    int version;
+    msg >> version;
+    if (version != TCPConnectionProtocolVersion)
+    {
+        throw std::runtime_error(
+            "TCPConnection protocol version mismatch: expected " +
+            std::to_string(TCPConnectionProtocolVersion) +
+            ", got " + std::to_string(version));
+    }
+}
+
 
 // write request
 inline zmqpp::message& operator << (zmqpp::message& msg, const TCPConnectionRequest& request)
 {
+    msg << TCPConnectionProtocolVersion << request.format;
     msg << request.data << request.toExplain << request.action;
+    msg << request.cursor << request.chunkSize << request.metadataOnly;
+    msg << request.revision;
+    msg << encodePayload(request.components, request.format);
     return msg;
 }
 
 // read request
 inline zmqpp::message& operator >> (zmqpp::message& msg, TCPConnectionRequest& request)
 {
+    readProtocolVersion(msg);
+    msg >> request.format;
     msg >> request.data >> request.toExplain >> request.action;
+    msg >> request.cursor >> request.chunkSize >> request.metadataOnly;
+    msg >> request.revision;
+
+    std::string payload;
+    msg >> payload;
+    decodePayload(payload, request.components, request.format);
     return msg;
 }
 
 // write response
 inline zmqpp::message& operator << (zmqpp::message& msg, const TCPConnectionResponse& response)
 {
-    msg << response.success << response.msg;
-    msg << response.data.size();
-    for (auto& data : response.data)
-    {
-        msg << data;
-    }
-    msg << response.reteNetwork;
-
-    msg << response.rules.size();
-    for (auto& rule : response.rules)
-    {
-        msg << rule;
-    }
-
-    std::stringstream ss;
-    {
-        cereal::JSONOutputArchive ar(ss);
-        ar(response.triples);
-    }
-    msg << ss.str();
+    msg << TCPConnectionProtocolVersion << response.format;
+    msg << response.success << response.msg << response.cursor;
 
-    msg << response.explanationGraph;
+    msg << encodePayload(response.data, response.format);
+    msg << encodePayload(response.reteNetwork, response.format);
+    msg << encodePayload(response.reteNetworkDiff, response.format);
+    msg << encodePayload(response.rules, response.format);
+    msg << encodePayload(response.triples, response.format);
+    msg << encodePayload(response.explanationGraph, response.format);
 
     return msg;
 }
@@ -212,35 +281,23 @@ inline zmqpp::message& operator << (zmqpp::message& msg, const TCPConnectionResp
 // read response
 inline zmqpp::message& operator >> (zmqpp::message& msg, TCPConnectionResponse& response)
 {
-    msg >> response.success >> response.msg;
-    size_t numData;
-    msg >> numData;
-    response.data.reserve(numData);
-    for (size_t i = 0; i < numData; i++)
-    {
-        ECData d;
-        msg >> d;
-        response.data.push_back(d);
-    }
-    msg >> response.reteNetwork;
-
-    size_t numRules;
-    msg >> numRules;
-    for (size_t i = 0; i < numRules; i++)
-    {
-        Rule r;
-        msg >> r;
-        response.rules.push_back(r);
-    }
-
-    std::string triples;
-    msg >> triples;
-
-    std::stringstream ss(triples);;
-    cereal::JSONInputArchive ar(ss);
-    ar(response.triples);
-
-    msg >> response.explanationGraph;
+    readProtocolVersion(msg);
+    msg >> response.format;
+    msg >> response.success >> response.msg >> response.cursor;
+
+    std::string payload;
+    msg >> payload;
+    decodePayload(payload, response.data, response.format);
+    msg >> payload;
+    decodePayload(payload, response.reteNetwork, response.format);
+    msg >> payload;
+    decodePayload(payload, response.reteNetworkDiff, response.format);
+    msg >> payload;
+    decodePayload(payload, response.rules, response.format);
+    msg >> payload;
+    decodePayload(payload, response.triples, response.format);
+    msg >> payload;
+    decodePayload(payload, response.explanationGraph, response.format);
 
     return msg;
 }
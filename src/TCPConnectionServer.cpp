@@ -2,24 +2,50 @@
 #include "ECDataZMQ.hpp"
 #include "LogDataZMQ.hpp"
 #include "TCPConnectionRequest.hpp"
+#include "JsonDelta.hpp"
 
-#include <cereal/archives/json.hpp>
 #include <iostream>
+#include <algorithm>
+#include <deque>
 
 namespace sempr { namespace gui {
 
+namespace {
+    // The "stop" message on inproc://stop-request-handling only wakes up
+    // threads whose subscription has already arrived, which is not
+    // guaranteed right after start(). Hence the threads also re-check
+    // handlingRequests_ in this interval (in ms).
+    const long stopCheckInterval = 100;
+}
+
 TCPConnectionServer::TCPConnectionServer(
         DirectConnection::Ptr con,
         const std::string& publishEndpoint,
-        const std::string& requestEndpoint)
+        const std::string& requestEndpoint,
+        size_t numWorkers)
     :
         updatePublisher_(context_, zmqpp::socket_type::publish),
-        replySocket_(context_, zmqpp::socket_type::reply),
+        frontend_(context_, zmqpp::socket_type::router),
+        backend_(context_, zmqpp::socket_type::router),
+        stopPublisher_(context_, zmqpp::socket_type::publish),
         semprConnection_(con),
-        handlingRequests_(false)
+        numWorkers_(std::max<size_t>(numWorkers, 1)),
+        handlingRequests_(false),
+        ecBatch_(true),
+        tripleBatch_(false),
+        maxBatchSize_(1000),
+        updateFlushInterval_(50),
+        nextCursorId_(1)
 {
     updatePublisher_.bind(publishEndpoint);
-    replySocket_.bind(requestEndpoint);
+    frontend_.bind(requestEndpoint);
+    backend_.bind("inproc://request-workers");
+    stopPublisher_.bind("inproc://stop-request-handling");
+}
+
+TCPConnectionServer::~TCPConnectionServer()
+{
+    stop();
 }
 
 
@@ -27,36 +53,116 @@ void TCPConnectionServer::updateCallback(
         AbstractInterface::callback_t::first_argument_type data,
         AbstractInterface::callback_t::second_argument_type action)
 {
-    // construct the message -- just all the data entries in the ECData struct,
-    // plus the action.
-    zmqpp::message msg, topic;
-    msg << UpdateType::EntityComponent << data << action;
-    topic << "data";
-
-    // and send it to all subscribers
-    updatePublisher_.send("data", zmqpp::socket_t::send_more);
-    updatePublisher_.send(msg);
+    std::lock_guard<std::mutex> lock(publishMutex_);
+    ecBatch_.add(std::make_tuple(data.entityId, data.componentId, data.tag),
+                 data, action);
+
+    if (ecBatch_.size() >= maxBatchSize_) publishBatches();
 }
 
 void TCPConnectionServer::tripleUpdateCallback(
         AbstractInterface::triple_callback_t::first_argument_type value,
         AbstractInterface::triple_callback_t::second_argument_type action)
 {
+    std::lock_guard<std::mutex> lock(publishMutex_);
+    tripleBatch_.add(
+        std::make_tuple(value.getField(sempr::Triple::Field::SUBJECT),
+                        value.getField(sempr::Triple::Field::PREDICATE),
+                        value.getField(sempr::Triple::Field::OBJECT)),
+        value, action);
+
+    if (tripleBatch_.size() >= maxBatchSize_) publishBatches();
+}
+
+void TCPConnectionServer::publishBatches()
+{
+    // construct the messages -- the number of entries, and then just all the
+    // data entries in the ECData struct / the triple, plus the action.
+    if (!ecBatch_.empty())
+    {
+        auto entries = ecBatch_.take();
 
-    std::cout << "TCPConnectionServer::tripleUpdateCallback" << std::endl;
+        zmqpp::message msg, meta;
+        msg << UpdateType::EntityComponentBatch
+            << static_cast<uint32_t>(entries.size());
+        meta << UpdateType::EntityComponentBatch
+             << static_cast<uint32_t>(entries.size());
+        for (auto& entry : entries)
+        {
+            msg << withDelta(entry.first, entry.second) << entry.second;
+            meta << entry.first.metadataOnly() << entry.second;
+        }
 
-    zmqpp::message msg;
+        // and send it to all subscribers -- with the json to the "data" topic,
+        // and without it to the "meta" topic.
+        updatePublisher_.send("data", zmqpp::socket_t::send_more);
+        updatePublisher_.send(msg);
+        updatePublisher_.send("meta", zmqpp::socket_t::send_more);
+        updatePublisher_.send(meta);
+    }
 
-    std::stringstream ss;
+    if (!tripleBatch_.empty())
     {
-        cereal::JSONOutputArchive ar(ss);
-        ar(value);
+        auto entries = tripleBatch_.take();
+
+        zmqpp::message msg;
+        msg << UpdateType::TripleBatch
+            << static_cast<uint32_t>(entries.size());
+        for (auto& entry : entries)
+        {
+            msg << entry.first << entry.second;
+        }
+
+        updatePublisher_.send("triples", zmqpp::socket_t::send_more);
+        updatePublisher_.send(msg);
+    }
+}
+
+ECData TCPConnectionServer::withDelta(
+        const ECData& data,
+        AbstractInterface::Notification action)
+{
+    auto key = std::make_tuple(data.entityId, data.componentId, data.tag);
+    if (action == AbstractInterface::REMOVED)
+    {
+        publishedData_.erase(key);
+        return data;
+    }
+
+    ECData toSend(data);
+    auto previous = publishedData_.find(key);
+    if (action == AbstractInterface::UPDATED &&
+        previous != publishedData_.end() &&
+        previous->second.hasJSON && data.hasJSON)
+    {
+        auto delta = JsonDelta::create(previous->second.componentJSON,
+                                       data.componentJSON);
+        // only worth it if it is noticeably smaller
+        if (delta.size() < data.componentJSON.size() / 2)
+        {
+            toSend.componentJSON = delta;
+            toSend.isPatch = true;
+            toSend.patchBaseHash = previous->second.jsonHash;
+        }
     }
 
-    msg << UpdateType::Triple << ss.str() << action;
+    publishedData_[key] = data;
+    return toSend;
+}
 
-    updatePublisher_.send("data", zmqpp::socket_t::send_more);
-    updatePublisher_.send(msg);
+void TCPConnectionServer::flushUpdates()
+{
+    std::lock_guard<std::mutex> lock(publishMutex_);
+    publishBatches();
+}
+
+void TCPConnectionServer::setBatchLimits(
+        size_t maxBatchSize,
+        std::chrono::milliseconds interval)
+{
+    std::lock_guard<std::mutex> lock(publishMutex_);
+    maxBatchSize_ = std::max<size_t>(maxBatchSize, 1);
+    updateFlushInterval_ = interval;
 }
 
 void TCPConnectionServer::loggingCallback(
@@ -65,6 +171,7 @@ void TCPConnectionServer::loggingCallback(
     zmqpp::message msg;
     msg << log;
 
+    std::lock_guard<std::mutex> lock(publishMutex_);
     updatePublisher_.send("logging", zmqpp::socket_t::send_more);
     updatePublisher_.send(msg);
 }
@@ -98,55 +205,193 @@ void TCPConnectionServer::start()
         )
     );
 
-    // start a thread that handles requests
+    // start the threads that handle requests
     handlingRequests_ = true;
-    requestHandler_ = std::thread(
+
+    // send pending updates periodically
+    updateFlusher_ = std::thread(
         [this]()
         {
+            std::unique_lock<std::mutex> lock(publishMutex_);
             while (handlingRequests_)
             {
-                zmqpp::message msg;
-                bool requestAvailable = replySocket_.receive(msg, true);
-                if (requestAvailable)
-                {
-                    TCPConnectionRequest request;
-                    msg >> request;
-                    TCPConnectionResponse response = handleRequest(request);
-                    zmqpp::message responseMsg;
-                    responseMsg << response;
-                    replySocket_.send(responseMsg);
-                }
-                else
-                {
-                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
-                }
+                flushCondition_.wait_for(lock, updateFlushInterval_);
+                publishBatches();
             }
         }
     );
+
+    for (size_t i = 0; i < numWorkers_; i++)
+    {
+        workers_.push_back(std::thread(&TCPConnectionServer::workerLoop, this));
+    }
+
+    // and one that passes the requests of all clients on to the idle workers,
+    // and their responses back to the clients.
+    requestHandler_ = std::thread(&TCPConnectionServer::brokerLoop, this);
+}
+
+
+void TCPConnectionServer::brokerLoop()
+{
+    zmqpp::socket stopSubscriber(context_, zmqpp::socket_type::subscribe);
+    stopSubscriber.connect("inproc://stop-request-handling");
+    stopSubscriber.subscribe("");
+
+    // the identities of the workers that wait for a request. Requests are
+    // only taken from the frontend_ while there is one, the others stay
+    // queued there.
+    std::deque<std::string> idleWorkers;
+
+    zmqpp::poller poller;
+    poller.add(frontend_, zmqpp::poller::poll_none);
+    poller.add(backend_, zmqpp::poller::poll_in);
+    poller.add(stopSubscriber, zmqpp::poller::poll_in);
+
+    while (handlingRequests_)
+    {
+        poller.check_for(frontend_, idleWorkers.empty() ? zmqpp::poller::poll_none
+                                                        : zmqpp::poller::poll_in);
+        if (!poller.poll(stopCheckInterval)) continue;
+        if (poller.has_input(stopSubscriber)) break;
+
+        zmqpp::message msg;
+        if (poller.has_input(backend_))
+        {
+            // [worker][""] and either "READY" or the response for a client,
+            // [client][""][response...]
+            while (backend_.receive(msg, true))
+            {
+                idleWorkers.push_back(msg.get(0));
+                if (msg.parts() <= 3) continue;
+
+                msg.pop_front();
+                msg.pop_front();
+                frontend_.send(msg);
+            }
+        }
+        if (poller.has_input(frontend_))
+        {
+            // [client][""][request...] goes to the worker that has waited
+            // the longest
+            while (!idleWorkers.empty() && frontend_.receive(msg, true))
+            {
+                msg.push_front("");
+                msg.push_front(idleWorkers.front());
+                idleWorkers.pop_front();
+                backend_.send(msg);
+            }
+        }
+    }
 }
 
 
-std::string TCPConnectionServer::getReteNetwork()
+void TCPConnectionServer::workerLoop()
 {
-    auto graph = semprConnection_->getReteNetworkRepresentation();
+    zmqpp::socket socket(context_, zmqpp::socket_type::request);
+    socket.connect("inproc://request-workers");
+
+    zmqpp::socket stopSubscriber(context_, zmqpp::socket_type::subscribe);
+    stopSubscriber.connect("inproc://stop-request-handling");
+    stopSubscriber.subscribe("");
+
+    zmqpp::poller poller;
+    poller.add(socket, zmqpp::poller::poll_in);
+    poller.add(stopSubscriber, zmqpp::poller::poll_in);
+
+    // tell the broker that this worker can take a request. After that, every
+    // response does the same.
+    socket.send("READY");
+
+    while (handlingRequests_)
+    {
+        if (!poller.poll(stopCheckInterval)) continue;
+        if (poller.has_input(stopSubscriber)) break;
+        if (!poller.has_input(socket)) continue;
+
+        zmqpp::message msg;
+        socket.receive(msg);
+
+        // the envelope of the client, up to and including the empty frame,
+        // is sent back with the response
+        zmqpp::message responseMsg;
+        size_t envelope = 0;
+        while (envelope < msg.parts())
+        {
+            std::string frame;
+            msg >> frame;
+            responseMsg << frame;
+            envelope++;
+            if (frame.empty()) break;
+        }
+
+        TCPConnectionRequest request;
+        TCPConnectionResponse response;
+        try {
+            msg >> request;
+            response = handleRequest(request);
+        } catch (std::exception& e) {
+            // malformed request or protocol mismatch. Still
+            // need to reply, else the client would wait forever.
+            response.success = false;
+            response.msg = e.what();
+        }
+        responseMsg << response;
+        socket.send(responseMsg);
+    }
+}
+
+
+void TCPConnectionServer::stop()
+{
+    if (!handlingRequests_) return;
 
-    std::stringstream ss;
     {
-        cereal::JSONOutputArchive ar(ss);
-        ar(graph);
+        std::lock_guard<std::mutex> lock(publishMutex_);
+        handlingRequests_ = false;
     }
+    flushCondition_.notify_all();
+    if (updateFlusher_.joinable()) updateFlusher_.join();
 
-    return ss.str();
+    stopPublisher_.send("stop");
+
+    if (requestHandler_.joinable()) requestHandler_.join();
+    for (auto& worker : workers_)
+    {
+        if (worker.joinable()) worker.join();
+    }
+    workers_.clear();
 }
 
+
 TCPConnectionResponse TCPConnectionServer::handleRequest(const TCPConnectionRequest& request)
 {
     TCPConnectionResponse response;
+    // answer in the format the client asked for -- both are supported.
+    response.format = request.format;
     try {
+        std::unique_lock<std::mutex> modifyLock(modifyMutex_, std::defer_lock);
+        if (request.action == TCPConnectionRequest::ADD_EC_PAIR ||
+            request.action == TCPConnectionRequest::MODIFY_EC_PAIR ||
+            request.action == TCPConnectionRequest::REMOVE_EC_PAIR)
+        {
+            modifyLock.lock();
+        }
+
         // just map directly to the DirectConnection we use here.
         switch(request.action) {
             case TCPConnectionRequest::LIST_ALL_EC_PAIRS:
                 response.data = semprConnection_->listEntityComponentPairs();
+                if (request.metadataOnly)
+                {
+                    for (auto& data : response.data) data = data.metadataOnly();
+                }
+                break;
+            case TCPConnectionRequest::GET_COMPONENT:
+                response.data.push_back(semprConnection_->getComponent(request.data));
+                break;
+            case TCPConnectionRequest::GET_COMPONENTS:
+                response.data = semprConnection_->getComponents(request.components);
                 break;
             case TCPConnectionRequest::ADD_EC_PAIR:
                 semprConnection_->addEntityComponentPair(request.data);
@@ -158,7 +403,10 @@ TCPConnectionResponse TCPConnectionServer::handleRequest(const TCPConnectionRequ
                 semprConnection_->removeEntityComponentPair(request.data);
                 break;
             case TCPConnectionRequest::GET_RETE_NETWORK:
-                response.reteNetwork = getReteNetwork();
+                response.reteNetwork = semprConnection_->getReteNetworkRepresentation();
+                break;
+            case TCPConnectionRequest::GET_RETE_NETWORK_DIFF:
+                response.reteNetworkDiff = semprConnection_->getReteNetworkDiff(request.revision);
                 break;
             case TCPConnectionRequest::GET_RULES:
                 response.rules = semprConnection_->getRulesRepresentation();
@@ -175,6 +423,13 @@ TCPConnectionResponse TCPConnectionServer::handleRequest(const TCPConnectionRequ
             case TCPConnectionRequest::GET_EXPLANATION_ECWME:
                 response.explanationGraph = semprConnection_->getExplanation(request.data);
                 break;
+            case TCPConnectionRequest::NEGOTIATE_FORMAT:
+                // nothing to do, the format is already set above
+                break;
+            case TCPConnectionRequest::LIST_EC_PAIRS_CHUNK:
+            case TCPConnectionRequest::LIST_TRIPLES_CHUNK:
+                listChunk(request, response);
+                break;
         }
         response.success = true;
     } catch (std::exception& e) {
@@ -186,4 +441,92 @@ TCPConnectionResponse TCPConnectionServer::handleRequest(const TCPConnectionRequ
     return response;
 }
 
+
+void TCPConnectionServer::listChunk(
+        const TCPConnectionRequest& request,
+        TCPConnectionResponse& response)
+{
+    auto now = std::chrono::steady_clock::now();
+    uint64_t id = request.cursor;
+
+    std::shared_ptr<const std::vector<rete::WME::Ptr>> wmes;
+    size_t position;
+    {
+        std::lock_guard<std::mutex> lock(cursorMutex_);
+
+        // forget about listings that were not continued for a while, e.g.
+        // because the client was closed in the middle of it.
+        for (auto it = cursors_.begin(); it != cursors_.end();)
+        {
+            if (now - it->second.lastAccess > std::chrono::minutes(1))
+                it = cursors_.erase(it);
+            else
+                ++it;
+        }
+
+        if (id == 0)
+        {
+            // start a new listing
+            id = nextCursorId_++;
+            auto& cursor = cursors_[id];
+            cursor.wmes = std::make_shared<const std::vector<rete::WME::Ptr>>(
+                                semprConnection_->currentWMEs());
+            cursor.position = 0;
+        }
+
+        auto it = cursors_.find(id);
+        if (it == cursors_.end())
+        {
+            throw std::runtime_error("unknown or expired listing cursor");
+        }
+
+        it->second.lastAccess = now;
+        wmes = it->second.wmes;
+        position = it->second.position;
+    }
+
+    // the conversion does not need the lock, as every listing is only
+    // continued by the one client that started it.
+    size_t chunkSize = std::max<size_t>(request.chunkSize, 1);
+    size_t count = 0;
+    while (position < wmes->size() && count < chunkSize)
+    {
+        auto& wme = (*wmes)[position++];
+
+        if (request.action == TCPConnectionRequest::LIST_EC_PAIRS_CHUNK)
+        {
+            ECData data;
+            if (DirectConnection::wmeToECData(wme, data))
+            {
+                if (request.metadataOnly) data = data.metadataOnly();
+                response.data.push_back(data);
+                count++;
+            }
+        }
+        else
+        {
+            sempr::Triple triple;
+            if (DirectConnection::wmeToTriple(wme, triple))
+            {
+                response.triples.push_back(triple);
+                count++;
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(cursorMutex_);
+    if (position < wmes->size())
+    {
+        auto it = cursors_.find(id);
+        if (it != cursors_.end()) it->second.position = position;
+        response.cursor = id;
+    }
+    else
+    {
+        // done, the listing is complete
+        cursors_.erase(id);
+        response.cursor = 0;
+    }
+}
+
 }}
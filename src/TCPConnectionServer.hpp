@@ -4,9 +4,16 @@
 #include <zmqpp/zmqpp.hpp>
 #include "DirectConnection.hpp"
 #include "TCPConnectionRequest.hpp"
+#include "UpdateBatch.hpp"
 
 #include <thread>
 #include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <tuple>
+#include <vector>
 
 namespace sempr { namespace gui {
 
@@ -18,16 +25,73 @@ class TCPConnectionServer {
     zmqpp::context context_;
     // one socket to publish updates to
     zmqpp::socket updatePublisher_;
-    // one socket for explicit requests to modify data
-    zmqpp::socket replySocket_;
+    // one socket for explicit requests to modify data. Requests of all
+    // clients are forwarded to idle workers_ through the backend_ socket.
+    zmqpp::socket frontend_;
+    zmqpp::socket backend_;
+    // an inproc publisher to wake up and stop the request handling threads
+    zmqpp::socket stopPublisher_;
 
     DirectConnection::Ptr semprConnection_;
 
-    // the thread in which requests are handled
+    // the thread forwarding requests between frontend_ and backend_, see
+    // brokerLoop()
     std::thread requestHandler_;
+    // the threads in which requests are handled
+    std::vector<std::thread> workers_;
+    size_t numWorkers_;
     // a signal to stop the request handler
     std::atomic<bool> handlingRequests_;
 
+    // read-only requests are handled concurrently, but requests that modify
+    // data are done one at a time.
+    std::mutex modifyMutex_;
+
+    /**
+        Updates are not published one by one, but collected and sent in
+        batches: When the batch is full, when flushUpdates() is called (e.g.
+        after an inference step) or after updateFlushInterval_ at the latest.
+        Notifications for the same item within a batch are merged.
+        The publishMutex_ guards the batches and the updatePublisher_.
+    */
+    typedef std::tuple<std::string, std::string, std::string> ItemKey;
+    UpdateBatch<ECData, ItemKey> ecBatch_;
+    UpdateBatch<sempr::Triple, ItemKey> tripleBatch_;
+    std::mutex publishMutex_;
+    size_t maxBatchSize_;
+    std::chrono::milliseconds updateFlushInterval_;
+
+    // the last published version of every component, to send only deltas
+    // for updates. (Guarded by the publishMutex_, too.)
+    std::map<ItemKey, ECData> publishedData_;
+
+    // the thread that flushes the updates periodically
+    std::thread updateFlusher_;
+    std::condition_variable flushCondition_;
+
+    // sends the pending updates. publishMutex_ must be locked.
+    void publishBatches();
+
+    // replaces the json of an UPDATED component by a JsonDelta to the
+    // previously published version, if that is smaller, and remembers the
+    // data for the next update.
+    ECData withDelta(const ECData& data, AbstractInterface::Notification action);
+
+    /**
+        State of a chunked listing of EC pairs or triples: A snapshot of the
+        WMEs taken with the first request, and the position up to which they
+        have already been sent. Only the WME pointers are kept, the ECData and
+        triples are created chunk by chunk.
+    */
+    struct ListingCursor {
+        std::shared_ptr<const std::vector<rete::WME::Ptr>> wmes;
+        size_t position;
+        std::chrono::steady_clock::time_point lastAccess;
+    };
+    std::map<uint64_t, ListingCursor> cursors_;
+    uint64_t nextCursorId_;
+    std::mutex cursorMutex_;
+
     /**
         The function called by the DirectConnection when stuff is inferred by
         the reasoner. This will send updates on the updatePublisher.
@@ -47,24 +111,57 @@ class TCPConnectionServer {
     */
     void loggingCallback(AbstractInterface::logging_callback_t::argument_type);
 
+    /**
+        The loop of the requestHandler_: A load balancing broker. Every
+        worker announces with "READY", and then with each response, that it
+        is idle. A request is only passed on to an idle worker, so it never
+        waits behind a slow request (e.g. LIST_ALL_TRIPLES) while another
+        worker has nothing to do.
+    */
+    void brokerLoop();
+
+    /**
+        The loop run in each of the workers_: Receives requests from the
+        backend_ and sends back the responses.
+    */
+    void workerLoop();
+
     /**
         Handling a request
     */
     TCPConnectionResponse handleRequest(const TCPConnectionRequest& request);
 
-    // helper: get the rete network, serialize it to json
-    std::string getReteNetwork();
+    /**
+        Handles LIST_EC_PAIRS_CHUNK and LIST_TRIPLES_CHUNK: Fills the response
+        with the next chunk of the listing referred to by request.cursor, or
+        starts a new listing if it is 0.
+    */
+    void listChunk(const TCPConnectionRequest& request, TCPConnectionResponse& response);
 
 public:
     TCPConnectionServer(
         DirectConnection::Ptr con,
         const std::string& publishEndpoint = "tcp://*:4242",
-        const std::string& requestEndpoint = "tcp://*:4243");
+        const std::string& requestEndpoint = "tcp://*:4243",
+        size_t numWorkers = 4);
+    ~TCPConnectionServer();
 
-    // starts a new thread that handles incoming requests and connects the
+    // starts new threads that handle incoming requests and connects the
     // update callback
     void start();
     void stop();
+
+    /**
+        Publishes all updates collected so far. Call this at the end of an
+        inference step to not wait for the next periodic flush.
+    */
+    void flushUpdates();
+
+    /**
+        Sets the maximum number of updates (per type) sent in one message, and
+        the time after which pending updates are sent at the latest.
+    */
+    void setBatchLimits(size_t maxBatchSize, std::chrono::milliseconds interval);
 };
 
 }}
@@ -0,0 +1,160 @@
+#include "TileCache.hpp"
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+
+#include <algorithm>
+#include <vector>
+#include <utility>
+#include <iterator>
+
+namespace sempr { namespace gui {
+
+bool TileCache::Tile::operator == (const Tile& other) const
+{
+    return z == other.z && x == other.x && y == other.y;
+}
+
+size_t TileCache::TileHash::operator() (const Tile& tile) const
+{
+    size_t h = static_cast<size_t>(tile.z);
+    h = h * 1000003 ^ static_cast<size_t>(tile.x);
+    h = h * 1000003 ^ static_cast<size_t>(tile.y);
+    return h;
+}
+
+QString TileCache::path(const QString& directory, const Tile& tile)
+{
+    return QString("%1/%2/%3/%4.png").arg(directory).arg(tile.z).arg(tile.x).arg(tile.y);
+}
+
+
+TileCache::TileCache(const QString& directory, qint64 maxBytes)
+    : directory_(directory), maxBytes_(maxBytes), bytes_(0)
+{
+    if (maxBytes_ <= 0 || directory_.isEmpty()) return;
+    QDir().mkpath(directory_);
+
+    // register the tiles of previous sessions, oldest first
+    std::vector<std::pair<QDateTime, std::pair<Tile, qint64>>> found;
+    QDirIterator it(directory_, QStringList() << "*.png", QDir::Files,
+                    QDirIterator::Subdirectories);
+    while (it.hasNext())
+    {
+        it.next();
+        auto info = it.fileInfo();
+
+        // <directory>/<z>/<x>/<y>.png
+        bool okZ, okX, okY;
+        QDir xDir = info.dir();
+        QDir zDir = xDir;
+        zDir.cdUp();
+        Tile tile;
+        tile.y = info.completeBaseName().toInt(&okY);
+        tile.x = xDir.dirName().toInt(&okX);
+        tile.z = zDir.dirName().toInt(&okZ);
+        if (!okZ || !okX || !okY) continue;
+
+        found.push_back({ info.lastModified(), { tile, info.size() } });
+    }
+
+    std::sort(found.begin(), found.end(),
+        [](const std::pair<QDateTime, std::pair<Tile, qint64>>& a,
+           const std::pair<QDateTime, std::pair<Tile, qint64>>& b)
+        {
+            return a.first < b.first;
+        });
+    for (auto& f : found) add(f.second.first, f.second.second);
+
+    // the limit may have been lowered
+    evict();
+}
+
+
+void TileCache::add(const Tile& tile, qint64 bytes)
+{
+    auto it = entries_.find(tile);
+    if (it != entries_.end())
+    {
+        bytes_ -= it->second.bytes;
+        order_.erase(it->second.position);
+        entries_.erase(it);
+    }
+
+    order_.push_back(tile);
+    entries_[tile] = Entry{ std::prev(order_.end()), bytes };
+    bytes_ += bytes;
+}
+
+
+void TileCache::evict()
+{
+    while (bytes_ > maxBytes_ && !order_.empty())
+    {
+        Tile oldest = order_.front();
+        order_.pop_front();
+
+        auto it = entries_.find(oldest);
+        bytes_ -= it->second.bytes;
+        entries_.erase(it);
+
+        QFile::remove(path(directory_, oldest));
+    }
+}
+
+
+bool TileCache::contains(const Tile& tile) const
+{
+    return entries_.find(tile) != entries_.end();
+}
+
+
+bool TileCache::get(const Tile& tile, QByteArray& data)
+{
+    auto it = entries_.find(tile);
+    if (it == entries_.end()) return false;
+
+    QFile file(path(directory_, tile));
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        // deleted from outside
+        bytes_ -= it->second.bytes;
+        order_.erase(it->second.position);
+        entries_.erase(it);
+        return false;
+    }
+    data = file.readAll();
+
+    // now the most recently used one, also for the next session
+    order_.splice(order_.end(), order_, it->second.position);
+    file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+    return true;
+}
+
+
+void TileCache::put(const Tile& tile, const QByteArray& data)
+{
+    if (maxBytes_ <= 0 || directory_.isEmpty()) return;
+
+    QString filename = path(directory_, tile);
+    QDir().mkpath(QFileInfo(filename).path());
+
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly)) return;
+    file.write(data);
+    file.close();
+
+    add(tile, data.size());
+    evict();
+}
+
+
+qint64 TileCache::size() const
+{
+    return bytes_;
+}
+
+}}
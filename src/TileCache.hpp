@@ -0,0 +1,80 @@
+#ifndef SEMPR_GUI_TILECACHE_HPP_
+#define SEMPR_GUI_TILECACHE_HPP_
+
+#include <QString>
+#include <QByteArray>
+
+#include <list>
+#include <unordered_map>
+
+namespace sempr { namespace gui {
+
+/**
+    A cache of map tiles on disk, stored as <directory>/<z>/<x>/<y>.png.
+
+    The total size of the tiles is limited. When a new tile exceeds it, the
+    least recently used tiles are deleted. The order of use is tracked in
+    memory, and in the modification time of the files, which is updated
+    whenever a tile is read. On startup, the tiles already on disk are
+    ordered by it, so the order survives a restart.
+*/
+class TileCache {
+public:
+    struct Tile {
+        int z, x, y;
+        bool operator == (const Tile& other) const;
+    };
+
+    /**
+        Opens (and creates, if needed) the cache in the given directory. A
+        maxBytes of 0 disables the cache.
+    */
+    TileCache(const QString& directory, qint64 maxBytes);
+
+    /**
+        Reads the tile from the cache and marks it as used. Returns false if
+        it is not cached.
+    */
+    bool get(const Tile& tile, QByteArray& data);
+
+    /**
+        Returns true if the tile is cached, without marking it as used.
+    */
+    bool contains(const Tile& tile) const;
+
+    /**
+        Stores the tile, and evicts the least recently used ones to stay
+        within the size limit.
+    */
+    void put(const Tile& tile, const QByteArray& data);
+
+    qint64 size() const;
+
+    /// the path of a tile below the given directory
+    static QString path(const QString& directory, const Tile& tile);
+
+private:
+    struct TileHash {
+        size_t operator() (const Tile& tile) const;
+    };
+
+    QString directory_;
+    qint64 maxBytes_;
+    qint64 bytes_;
+
+    // least recently used first
+    std::list<Tile> order_;
+    struct Entry {
+        std::list<Tile>::iterator position;
+        qint64 bytes;
+    };
+    std::unordered_map<Tile, Entry, TileHash> entries_;
+
+    // registers a tile that is on disk as the most recently used one
+    void add(const Tile& tile, qint64 bytes);
+    void evict();
+};
+
+}}
+
+#endif /* include guard: SEMPR_GUI_TILECACHE_HPP_ */
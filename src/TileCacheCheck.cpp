@@ -0,0 +1,394 @@
+#include <iostream>
+#include <list>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QGeoCoordinate>
+#include <QHostAddress>
+#include <QNetworkProxy>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+#include <QTimer>
+#include <QUrl>
+
+#include "TileCache.hpp"
+#include "TileServer.hpp"
+
+/*
+    Checks the TileCache and the TileServer without network: The LRU order
+    and eviction of the cache against a reference list after random reads
+    and writes, the order restored from the modification times after a
+    restart, and a TileServer that serves a local tile directory and the
+    cache offline, does not prefetch unless asked to, and never prefetches
+    from tile.openstreetmap.org. Downloads only go to a closed port on
+    localhost.
+
+    usage: sempr-gui-tile-cache-check [numOperations] [seed]
+    Returns 0 if all results match.
+*/
+
+using sempr::gui::TileCache;
+using sempr::gui::TileServer;
+
+namespace {
+
+typedef TileCache::Tile Tile;
+
+size_t failures = 0;
+
+void fail(const std::string& what)
+{
+    if (failures++ < 10) std::cerr << "FAILED: " << what << std::endl;
+}
+
+std::string name(const Tile& tile)
+{
+    return std::to_string(tile.z) + "/" + std::to_string(tile.x) + "/" +
+           std::to_string(tile.y);
+}
+
+/**
+    Checks that the cache contains the tiles of the reference, and has their
+    total size. (The order is checked by the evictions.)
+*/
+void compare(const TileCache& cache,
+             const std::list<std::pair<Tile, QByteArray>>& reference,
+             const std::string& step)
+{
+    qint64 bytes = 0;
+    for (auto& entry : reference)
+    {
+        bytes += entry.second.size();
+        if (!cache.contains(entry.first)) fail(step + ": missing " + name(entry.first));
+    }
+    if (cache.size() != bytes)
+    {
+        fail(step + ": size " + std::to_string(cache.size()) +
+             " != " + std::to_string(bytes));
+    }
+}
+
+/**
+    Random reads and writes of 16 tiles of up to 100 bytes in a cache of 500
+    bytes, compared with a list in the order of use.
+*/
+void checkLRU(const QString& directory, size_t numOperations, unsigned seed)
+{
+    std::mt19937 random(seed);
+    const qint64 maxBytes = 500;
+    TileCache cache(directory, maxBytes);
+    std::list<std::pair<Tile, QByteArray>> reference;
+
+    for (size_t i = 0; i < numOperations; i++)
+    {
+        Tile tile = { 3, static_cast<int>(random() % 4), static_cast<int>(random() % 4) };
+        auto it = reference.begin();
+        while (it != reference.end() && !(it->first == tile)) ++it;
+        std::string step = "lru step " + std::to_string(i);
+
+        if (random() % 2)
+        {
+            QByteArray data(static_cast<int>(1 + random() % 100),
+                            static_cast<char>('a' + i % 26));
+            cache.put(tile, data);
+
+            if (it != reference.end()) reference.erase(it);
+            reference.push_back({ tile, data });
+            qint64 bytes = 0;
+            for (auto& entry : reference) bytes += entry.second.size();
+            while (bytes > maxBytes)
+            {
+                bytes -= reference.front().second.size();
+                Tile evicted = reference.front().first;
+                reference.pop_front();
+                if (cache.contains(evicted)) fail(step + ": not evicted " + name(evicted));
+                if (QFile::exists(TileCache::path(directory, evicted)))
+                {
+                    fail(step + ": file of " + name(evicted) + " not deleted");
+                }
+            }
+        }
+        else
+        {
+            QByteArray data;
+            bool found = cache.get(tile, data);
+            if (found != (it != reference.end()))
+            {
+                fail(step + ": get " + name(tile) + (found ? " found" : " missed"));
+            }
+            else if (found)
+            {
+                if (data != it->second) fail(step + ": data of " + name(tile));
+                reference.splice(reference.end(), reference, it);
+            }
+        }
+
+        compare(cache, reference, step);
+    }
+}
+
+/**
+    The order of use survives a restart, also with a lower size limit.
+*/
+void checkRestart(const QString& directory)
+{
+    Tile a = { 5, 1, 1 }, b = { 5, 1, 2 }, c = { 5, 1, 3 }, d = { 5, 1, 4 };
+    QByteArray data(100, 'x');
+
+    {
+        TileCache cache(directory, 300);
+        cache.put(a, data);
+        cache.put(b, data);
+        cache.put(c, data);
+
+        // the file times have a limited resolution, make them distinct
+        auto now = QDateTime::currentDateTime();
+        int age = 100;
+        for (auto& tile : { a, b, c })
+        {
+            QFile file(TileCache::path(directory, tile));
+            if (!file.open(QIODevice::ReadWrite) ||
+                !file.setFileTime(now.addSecs(-age), QFileDevice::FileModificationTime))
+            {
+                fail("restart: could not set the time of " + name(tile));
+            }
+            age -= 10;
+        }
+
+        QByteArray read;
+        if (!cache.get(a, read)) fail("restart: get before the restart");
+    }
+
+    {
+        // b is the least recently used one now
+        TileCache cache(directory, 300);
+        if (cache.size() != 300) fail("restart: size after the restart");
+        cache.put(d, data);
+        if (cache.contains(b) || !cache.contains(a) || !cache.contains(c) ||
+            !cache.contains(d))
+        {
+            fail("restart: evicted the wrong tile");
+        }
+    }
+
+    {
+        // c (then a, then d) when the limit is lowered
+        TileCache cache(directory, 200);
+        if (cache.size() != 200 || cache.contains(c) ||
+            !cache.contains(a) || !cache.contains(d))
+        {
+            fail("restart: evicted the wrong tile with a lower limit");
+        }
+    }
+
+    {
+        // a limit of 0 disables the cache
+        TileCache cache(directory, 0);
+        cache.put(b, data);
+        QByteArray read;
+        if (cache.contains(b) || cache.get(b, read) || cache.size() != 0)
+        {
+            fail("restart: disabled cache");
+        }
+    }
+}
+
+
+/**
+    Requests a tile from the server, returns the http status (0 if there is
+    no answer) and the body.
+*/
+int request(const TileServer& server, const Tile& tile, QByteArray& body)
+{
+    QTcpSocket socket;
+    QEventLoop loop;
+    QByteArray response;
+
+    QObject::connect(&socket, &QTcpSocket::connected, [&]()
+    {
+        socket.write("GET /" + QByteArray::fromStdString(name(tile)) +
+                     ".png HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n");
+    });
+    QObject::connect(&socket, &QTcpSocket::readyRead, [&]()
+    {
+        response += socket.readAll();
+    });
+    QObject::connect(&socket, &QTcpSocket::disconnected, &loop, &QEventLoop::quit);
+
+    QTimer timeout;
+    timeout.setSingleShot(true);
+    QObject::connect(&timeout, &QTimer::timeout, &loop, &QEventLoop::quit);
+    timeout.start(10000);
+
+    socket.connectToHost(QHostAddress::LocalHost, QUrl(server.url()).port());
+    loop.exec();
+    response += socket.readAll();
+
+    // "HTTP/1.1 <status> ...\r\n...\r\n\r\n<body>"
+    int headerEnd = response.indexOf("\r\n\r\n");
+    if (headerEnd == -1) return 0;
+    body = response.mid(headerEnd + 4);
+    return response.split(' ').value(1).toInt();
+}
+
+void checkResponse(const TileServer& server, const Tile& tile,
+                   int status, const QByteArray& expected,
+                   const std::string& step)
+{
+    QByteArray body;
+    int result = request(server, tile, body);
+    if (result != status || body != expected)
+    {
+        fail(step + ": " + name(tile) + " answered with " + std::to_string(result));
+    }
+}
+
+/// runs the event loop until all downloads are done, or 10 s passed
+void waitForDownloads(const TileServer& server)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (server.pendingDownloads() > 0 && timer.elapsed() < 10000)
+    {
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents, 50);
+    }
+}
+
+void checkServer(const QString& tileDirectory, const QString& cacheDirectory,
+                 const QString& emptyDirectory)
+{
+    Tile local = { 1, 0, 0 }, cached = { 1, 1, 0 }, missing = { 1, 0, 1 };
+    {
+        QFile file(TileCache::path(tileDirectory, local));
+        QDir().mkpath(QFileInfo(file).path());
+        file.open(QIODevice::WriteOnly);
+        file.write("local");
+    }
+    TileCache(cacheDirectory, 1 << 20).put(cached, "cached");
+
+    // the whole world, at zoom level 0.5: 5 tiles of level 0 and 1
+    QGeoCoordinate topLeft(80, -179), bottomRight(-80, 179);
+
+    // offline: the tile directory and the cache, nothing else
+    {
+        TileServer::Config config;
+        config.offline = true;
+        config.prefetch = true;
+        config.tileUrl = "http://127.0.0.1:1/{z}/{x}/{y}.png";
+        config.tileDirectory = tileDirectory;
+        config.cacheDirectory = cacheDirectory;
+
+        TileServer server;
+        if (!server.start(config)) { fail("offline: start"); return; }
+
+        checkResponse(server, local, 200, "local", "offline");
+        checkResponse(server, cached, 200, "cached", "offline");
+        checkResponse(server, missing, 404, "", "offline");
+        server.prefetch(topLeft, bottomRight, 0.5);
+        if (server.pendingDownloads() != 0) fail("offline: downloads");
+    }
+
+    // the default: no prefetching
+    {
+        TileServer::Config config;
+        config.tileUrl = "http://127.0.0.1:1/{z}/{x}/{y}.png";
+        config.cacheDirectory = emptyDirectory;
+
+        TileServer server;
+        if (!server.start(config)) { fail("default: start"); return; }
+        server.prefetch(topLeft, bottomRight, 0.5);
+        if (server.pendingDownloads() != 0) fail("default: prefetches");
+    }
+
+    // never from openstreetmap, even if asked to
+    {
+        TileServer::Config config;
+        config.prefetch = true;
+        config.prefetchMargin = 1;
+        config.cacheDirectory = emptyDirectory;
+
+        TileServer server;
+        if (!server.start(config)) { fail("osm: start"); return; }
+        server.prefetch(topLeft, bottomRight, 0.5);
+        if (server.pendingDownloads() != 0) fail("osm: prefetches");
+    }
+
+    // from a server of our own, which refuses the connection: failed
+    // downloads are answered with a 404, and are not cached
+    {
+        TileServer::Config config;
+        config.prefetch = true;
+        config.tileUrl = "http://127.0.0.1:1/{z}/{x}/{y}.png";
+        config.tileDirectory = tileDirectory;
+        config.cacheDirectory = emptyDirectory;
+
+        TileServer server;
+        if (!server.start(config)) { fail("own server: start"); return; }
+        server.prefetch(topLeft, bottomRight, 0.5);
+        // the local tile is not downloaded
+        if (server.pendingDownloads() != 4)
+        {
+            fail("own server: " + std::to_string(server.pendingDownloads()) +
+                 " prefetches instead of 4");
+        }
+        checkResponse(server, missing, 404, "", "own server");
+        waitForDownloads(server);
+        if (server.pendingDownloads() != 0) fail("own server: downloads do not finish");
+        if (QFile::exists(TileCache::path(emptyDirectory, missing)))
+        {
+            fail("own server: cached a failed download");
+        }
+    }
+}
+
+}
+
+
+int main(int argc, char** args)
+{
+    QCoreApplication app(argc, args);
+
+    size_t numOperations = 2000;
+    unsigned seed = 42;
+    try {
+        if (argc > 1) numOperations = std::stoul(args[1]);
+        if (argc > 2) seed = std::stoul(args[2]);
+    } catch (std::exception&) {
+        std::cerr << "usage: " << args[0] << " [numOperations] [seed]" << std::endl;
+        return 2;
+    }
+
+    // make sure nothing leaves this machine
+    QNetworkProxy::setApplicationProxy(QNetworkProxy::NoProxy);
+
+    QTemporaryDir directory;
+    if (!directory.isValid())
+    {
+        std::cerr << "could not create a temporary directory" << std::endl;
+        return 2;
+    }
+
+    checkLRU(directory.path() + "/lru", numOperations, seed);
+    checkRestart(directory.path() + "/restart");
+    checkServer(directory.path() + "/local", directory.path() + "/cache",
+                directory.path() + "/empty");
+
+    if (failures > 0)
+    {
+        std::cerr << failures << " checks failed" << std::endl;
+        return 1;
+    }
+
+    std::cout << "all checks passed (" << numOperations << " operations, seed "
+              << seed << ")" << std::endl;
+    return 0;
+}
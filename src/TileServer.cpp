@@ -0,0 +1,334 @@
+#include "TileServer.hpp"
+
+#include <QFile>
+#include <QStandardPaths>
+#include <QNetworkRequest>
+#include <QUrl>
+#include <QDebug>
+
+#include <algorithm>
+#include <cmath>
+
+namespace sempr { namespace gui {
+
+TileServer::TileServer(QObject* parent)
+    : QObject(parent), running_(0)
+{
+    connect(&server_, &QTcpServer::newConnection,
+            this, &TileServer::onNewConnection);
+    connect(&network_, &QNetworkAccessManager::finished,
+            this, &TileServer::onDownloadFinished);
+}
+
+
+bool TileServer::start(const Config& config)
+{
+    config_ = config;
+
+    if (config_.prefetch &&
+        QUrl(config_.tileUrl).host().endsWith("tile.openstreetmap.org"))
+    {
+        qWarning() << "TileServer: prefetching from tile.openstreetmap.org is"
+                      " against its tile usage policy, disabled";
+        config_.prefetch = false;
+    }
+
+    QString cacheDirectory = config_.cacheDirectory;
+    if (cacheDirectory.isEmpty())
+    {
+        cacheDirectory =
+            QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/tiles";
+    }
+    cache_.reset(new TileCache(cacheDirectory, config_.cacheSize));
+
+    if (!server_.listen(QHostAddress::LocalHost, 0))
+    {
+        qWarning() << "TileServer: could not listen:" << server_.errorString();
+        return false;
+    }
+    return true;
+}
+
+
+QString TileServer::url() const
+{
+    // the osm plugin appends <z>/<x>/<y>.png
+    return QString("http://127.0.0.1:%1/").arg(server_.serverPort());
+}
+
+
+int TileServer::pendingDownloads() const
+{
+    return static_cast<int>(queue_.size()) + running_;
+}
+
+
+QString TileServer::keyOf(const Tile& tile)
+{
+    return QString("%1/%2/%3").arg(tile.z).arg(tile.x).arg(tile.y);
+}
+
+
+bool TileServer::lookup(const Tile& tile, QByteArray& data)
+{
+    if (!config_.tileDirectory.isEmpty())
+    {
+        QFile file(TileCache::path(config_.tileDirectory, tile));
+        if (file.open(QIODevice::ReadOnly))
+        {
+            data = file.readAll();
+            return true;
+        }
+    }
+
+    return cache_ && cache_->get(tile, data);
+}
+
+
+void TileServer::onNewConnection()
+{
+    while (QTcpSocket* socket = server_.nextPendingConnection())
+    {
+        connect(socket, &QTcpSocket::readyRead,
+                this, &TileServer::onReadyRead);
+        connect(socket, &QTcpSocket::disconnected,
+                this, &TileServer::onDisconnected);
+    }
+}
+
+void TileServer::onDisconnected()
+{
+    auto socket = qobject_cast<QTcpSocket*>(sender());
+    buffers_.remove(socket);
+    socket->deleteLater();
+}
+
+void TileServer::onReadyRead()
+{
+    auto socket = qobject_cast<QTcpSocket*>(sender());
+    auto& buffer = buffers_[socket];
+    buffer.append(socket->readAll());
+
+    // wait for the end of the header
+    int end = buffer.indexOf("\r\n\r\n");
+    if (end == -1) return;
+
+    QByteArray request = buffer.left(end);
+    buffers_.remove(socket);
+    handleRequest(socket, request);
+}
+
+
+void TileServer::handleRequest(QTcpSocket* socket, const QByteArray& request)
+{
+    // "GET /<z>/<x>/<y>.png HTTP/1.1"
+    auto requestLine = request.left(request.indexOf("\r\n")).split(' ');
+    if (requestLine.size() < 2 || requestLine[0] != "GET")
+    {
+        respond(socket, QByteArray());
+        return;
+    }
+
+    auto parts = requestLine[1].split('/');
+    bool okZ = false, okX = false, okY = false;
+    Tile tile = { 0, 0, 0 };
+    if (parts.size() == 4)
+    {
+        tile.z = parts[1].toInt(&okZ);
+        tile.x = parts[2].toInt(&okX);
+        tile.y = parts[3].left(parts[3].indexOf('.')).toInt(&okY);
+    }
+    if (!okZ || !okX || !okY)
+    {
+        respond(socket, QByteArray());
+        return;
+    }
+
+    QByteArray data;
+    if (lookup(tile, data))
+    {
+        respond(socket, data);
+        return;
+    }
+
+    if (config_.offline)
+    {
+        respond(socket, QByteArray());
+        return;
+    }
+
+    // wait for the download
+    waiting_[keyOf(tile)].push_back(socket);
+    schedule(tile, true);
+}
+
+
+void TileServer::respond(QTcpSocket* socket, const QByteArray& data)
+{
+    QByteArray header;
+    if (data.isEmpty())
+    {
+        header = "HTTP/1.1 404 Not Found\r\n"
+                 "Content-Length: 0\r\n"
+                 "Connection: close\r\n\r\n";
+    }
+    else
+    {
+        header = "HTTP/1.1 200 OK\r\n"
+                 "Content-Type: image/png\r\n"
+                 "Content-Length: " + QByteArray::number(data.size()) + "\r\n"
+                 "Connection: close\r\n\r\n";
+    }
+
+    socket->write(header);
+    socket->write(data);
+    socket->disconnectFromHost();
+}
+
+
+void TileServer::schedule(const Tile& tile, bool urgent)
+{
+    QString key = keyOf(tile);
+    if (scheduled_.contains(key))
+    {
+        if (!urgent) return;
+
+        // move a queued prefetch to the front
+        auto it = std::find_if(queue_.begin(), queue_.end(),
+            [&tile](const std::pair<Tile, bool>& queued) { return queued.first == tile; });
+        if (it == queue_.end()) return; // already downloading
+        queue_.erase(it);
+    }
+
+    if (urgent) queue_.push_front({ tile, true });
+    else        queue_.push_back({ tile, false });
+    scheduled_.insert(key);
+
+    startDownloads();
+}
+
+
+void TileServer::startDownloads()
+{
+    while (running_ < config_.maxDownloads && !queue_.empty())
+    {
+        Tile tile = queue_.front().first;
+        queue_.pop_front();
+
+        QString url = config_.tileUrl;
+        url.replace("{z}", QString::number(tile.z))
+           .replace("{x}", QString::number(tile.x))
+           .replace("{y}", QString::number(tile.y));
+
+        QNetworkRequest request((QUrl(url)));
+        // required by the tile usage policy of openstreetmap
+        request.setHeader(QNetworkRequest::UserAgentHeader, "sempr-gui");
+        request.setAttribute(QNetworkRequest::User, keyOf(tile));
+
+        network_.get(request);
+        running_++;
+    }
+}
+
+
+void TileServer::onDownloadFinished(QNetworkReply* reply)
+{
+    reply->deleteLater();
+    running_--;
+
+    // "<z>/<x>/<y>", see keyOf
+    QString key = reply->request().attribute(QNetworkRequest::User).toString();
+    auto zxy = key.split('/');
+    Tile tile = { zxy.value(0).toInt(), zxy.value(1).toInt(), zxy.value(2).toInt() };
+    scheduled_.remove(key);
+
+    QByteArray data;
+    if (reply->error() == QNetworkReply::NoError)
+    {
+        data = reply->readAll();
+        if (!data.isEmpty() && cache_) cache_->put(tile, data);
+    }
+
+    // answer all that waited for this tile, 404 if it failed
+    for (auto& socket : waiting_.take(key))
+    {
+        if (socket) respond(socket, data);
+    }
+
+    startDownloads();
+}
+
+
+void TileServer::prefetch(
+        const QGeoCoordinate& topLeft,
+        const QGeoCoordinate& bottomRight,
+        double zoomLevel)
+{
+    // outdated prefetches are dropped, only those waited for are kept
+    for (auto it = queue_.begin(); it != queue_.end();)
+    {
+        if (it->second)
+        {
+            ++it;
+        }
+        else
+        {
+            scheduled_.remove(keyOf(it->first));
+            it = queue_.erase(it);
+        }
+    }
+
+    if (!config_.prefetch || config_.offline ||
+        !topLeft.isValid() || !bottomRight.isValid()) return;
+
+    // web mercator tile coordinates
+    const double pi = std::acos(-1.);
+    auto tileX = [](double lon, int n) -> int
+    {
+        return static_cast<int>(std::floor((lon + 180.) / 360. * n));
+    };
+    auto tileY = [pi](double lat, int n) -> int
+    {
+        double rad = std::max(-85.05, std::min(85.05, lat)) * pi / 180.;
+        return static_cast<int>(std::floor(
+            (1. - std::log(std::tan(rad) + 1. / std::cos(rad)) / pi) / 2. * n));
+    };
+
+    // the current zoom level first, then the one above (cheap, a quarter of
+    // the tiles) and the one below
+    int zoom = static_cast<int>(std::floor(zoomLevel));
+    const size_t maxTiles = 512;
+    size_t numQueued = 0;
+    for (int z : { zoom, zoom - 1, zoom + 1 })
+    {
+        if (z < 0 || z > 19) continue;
+
+        int n = 1 << z;
+        int minY = std::max(0, tileY(topLeft.latitude(), n) - config_.prefetchMargin);
+        int maxY = std::min(n - 1, tileY(bottomRight.latitude(), n) + config_.prefetchMargin);
+
+        // the columns from left to right, which wrap around at the date line
+        // when the section crosses it (the left one is east of the right one)
+        int left = tileX(topLeft.longitude(), n);
+        int right = tileX(bottomRight.longitude(), n);
+        if (right < left) right += n;
+        int numColumns = std::min(n, right - left + 1 + 2 * config_.prefetchMargin);
+
+        for (int column = 0; column < numColumns; column++)
+        {
+            int x = ((left - config_.prefetchMargin + column) % n + n) % n;
+            for (int y = minY; y <= maxY; y++)
+            {
+                Tile tile = { z, x, y };
+                if (cache_->contains(tile)) continue;
+                if (!config_.tileDirectory.isEmpty() &&
+                    QFile::exists(TileCache::path(config_.tileDirectory, tile))) continue;
+
+                schedule(tile, false);
+                if (++numQueued >= maxTiles) return;
+            }
+        }
+    }
+}
+
+}}
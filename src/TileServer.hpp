@@ -0,0 +1,137 @@
+#ifndef SEMPR_GUI_TILESERVER_HPP_
+#define SEMPR_GUI_TILESERVER_HPP_
+
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QPointer>
+#include <QHash>
+#include <QSet>
+#include <QGeoCoordinate>
+
+#include "TileCache.hpp"
+
+#include <memory>
+#include <deque>
+#include <vector>
+#include <utility>
+
+namespace sempr { namespace gui {
+
+/**
+    A minimal http server on localhost that provides map tiles to the qml
+    map, used as a custom tile host of the osm plugin.
+
+    A tile is taken from the first of these sources that has it:
+        1. a local tile directory (<dir>/<z>/<x>/<y>.png), e.g. prepared for
+           a robot that runs without network
+        2. the TileCache on disk
+        3. the tile url (unless offline), after which it is cached
+
+    Optionally, the tiles around the visible section of the map, and of the
+    zoom levels above and below, are downloaded in the background (see
+    prefetch), so that they are available when the map is moved or
+    connectivity is lost. This is bulk downloading, which the tile usage
+    policy of openstreetmap forbids, so it is disabled by default and never
+    done from tile.openstreetmap.org -- only use it with a tile server of
+    your own.
+*/
+class TileServer : public QObject {
+    Q_OBJECT
+public:
+    struct Config {
+        /// where to download tiles from, with placeholders {z}, {x} and {y}
+        QString tileUrl = "https://tile.openstreetmap.org/{z}/{x}/{y}.png";
+        /// local tiles to use before anything else, empty for none
+        QString tileDirectory;
+        /// the directory of the TileCache, empty for the default
+        QString cacheDirectory;
+        /// size limit of the TileCache, 0 disables it
+        qint64 cacheSize = 256 * 1024 * 1024;
+        /// never download anything
+        bool offline = false;
+        /// number of parallel downloads
+        int maxDownloads = 4;
+        /// download the tiles around the visible ones in the background.
+        /// Ignored for tile.openstreetmap.org, see above.
+        bool prefetch = false;
+        /// number of tiles to prefetch around the visible ones
+        int prefetchMargin = 0;
+    };
+
+private:
+    typedef TileCache::Tile Tile;
+
+    Config config_;
+    QTcpServer server_;
+    QNetworkAccessManager network_;
+    std::unique_ptr<TileCache> cache_;
+
+    // the unfinished requests of every connection
+    QHash<QTcpSocket*, QByteArray> buffers_;
+
+    // connections waiting for a tile that is being downloaded
+    QHash<QString, std::vector<QPointer<QTcpSocket>>> waiting_;
+
+    // tiles to download (and whether a connection waits for them), and the
+    // ones that are queued or downloading
+    std::deque<std::pair<Tile, bool>> queue_;
+    QSet<QString> scheduled_;
+    int running_;
+
+    static QString keyOf(const Tile& tile);
+
+    // reads the tile from the tile directory or the cache
+    bool lookup(const Tile& tile, QByteArray& data);
+
+    // queues a download, at the front for tiles that are waited for
+    void schedule(const Tile& tile, bool urgent);
+    void startDownloads();
+
+    // sends the tile, or a 404 for an empty one
+    void respond(QTcpSocket* socket, const QByteArray& data);
+
+    void handleRequest(QTcpSocket* socket, const QByteArray& request);
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+    void onDisconnected();
+    void onDownloadFinished(QNetworkReply* reply);
+
+public:
+    TileServer(QObject* parent = nullptr);
+
+    /**
+        Starts to listen on a free port on localhost. Returns false if that
+        fails.
+    */
+    bool start(const Config& config);
+
+    /**
+        The url to use as the osm.mapping.custom.host of the qml map plugin.
+    */
+    QString url() const;
+
+    /**
+        The number of tiles that are queued or being downloaded.
+    */
+    int pendingDownloads() const;
+
+public slots:
+    /**
+        Replaces the queue of tiles to download with the ones of the given
+        section of the map (plus a margin), on the given zoom level and the
+        ones above and below. Only drops the outdated prefetches unless
+        prefetching is enabled.
+    */
+    void prefetch(const QGeoCoordinate& topLeft,
+                  const QGeoCoordinate& bottomRight,
+                  double zoomLevel);
+};
+
+}}
+
+#endif /* include guard: SEMPR_GUI_TILESERVER_HPP_ */
@@ -0,0 +1,144 @@
+#include "TripleFilterProxyModel.hpp"
+
+namespace sempr { namespace gui {
+
+TripleFilterProxyModel::TripleFilterProxyModel(TripleModel* source, QObject* parent)
+    : QSortFilterProxyModel(parent), triples_(source), spanning_(false),
+      generation_(0)
+{
+    this->setSourceModel(source);
+
+    // wait until the text stopped changing for a moment
+    debounce_.setSingleShot(true);
+    debounce_.setInterval(150);
+    connect(&debounce_, &QTimer::timeout,
+            this, &TripleFilterProxyModel::startSearch);
+
+    connect(this, &TripleFilterProxyModel::searchFinished,
+            this, &TripleFilterProxyModel::applyResult,
+            Qt::QueuedConnection);
+}
+
+
+TripleFilterProxyModel::~TripleFilterProxyModel()
+{
+    stopWorker();
+}
+
+
+void TripleFilterProxyModel::stopWorker()
+{
+    generation_++; // cancels the search
+    if (worker_.joinable()) worker_.join();
+}
+
+
+void TripleFilterProxyModel::setFilterText(const QString& text)
+{
+    requested_ = text.toStdString();
+
+    // the running search is outdated now
+    generation_++;
+    debounce_.start();
+}
+
+
+void TripleFilterProxyModel::startSearch()
+{
+    stopWorker();
+
+    // nothing to search for in the strings
+    if (requested_.empty() || requested_.find(' ') != std::string::npos)
+    {
+        triples_->setFilter("", {}, triples_->store().revision());
+        applied_ = requested_;
+        spanning_ = !requested_.empty();
+        this->invalidateFilter();
+        return;
+    }
+
+    // If the new text extends the current one, only the strings that
+    // contain the current one can contain the new one, too.
+    bool narrow = !applied_.empty() && !spanning_ &&
+                  requested_.find(applied_) != std::string::npos;
+    std::vector<TripleStore::id_t> candidates;
+    if (narrow) candidates = triples_->store().matchingStrings();
+
+    // The revision must be taken together with the candidates: Strings added
+    // after this are not among them, and are only checked by setFilter if
+    // they are newer than the revision of the result.
+    // (Only the gui thread modifies the store, so no need to lock here.)
+    uint64_t revision = triples_->store().revision();
+
+    int generation = ++generation_;
+    std::string query = requested_;
+    const TripleStore* store = &triples_->store();
+
+    worker_ = std::thread(
+        [this, generation, query, narrow, candidates, revision, store]()
+        {
+            Result result;
+            result.generation = generation;
+            result.query = query;
+            result.revision = revision;
+
+            // locks the store in chunks, so live updates are not blocked
+            result.matching = store->findStrings(
+                query, narrow ? &candidates : nullptr,
+                [this, generation]() -> bool
+                {
+                    return generation_ != generation;
+                });
+
+            if (generation_ != generation) return;
+
+            {
+                std::lock_guard<std::mutex> lock(resultMutex_);
+                result_ = std::move(result);
+            }
+            emit searchFinished(generation);
+        });
+}
+
+
+void TripleFilterProxyModel::applyResult(int generation)
+{
+    Result result;
+    {
+        std::lock_guard<std::mutex> lock(resultMutex_);
+        if (result_.generation != generation) return;
+        result = std::move(result_);
+        result_ = Result();
+    }
+
+    // outdated in the meantime
+    if (generation != generation_) return;
+
+    triples_->setFilter(result.query, result.matching, result.revision);
+    applied_ = result.query;
+    spanning_ = false;
+    this->invalidateFilter();
+}
+
+
+bool TripleFilterProxyModel::filterAcceptsRow(
+        int sourceRow, const QModelIndex& /*sourceParent*/) const
+{
+    // the empty rows of removed triples
+    auto& store = triples_->store();
+    if (store.isRemoved(sourceRow)) return false;
+
+    if (applied_.empty()) return true;
+
+    if (spanning_)
+    {
+        std::string concat = store.subject(sourceRow) + " " +
+                             store.predicate(sourceRow) + " " +
+                             store.object(sourceRow) + " ";
+        return concat.find(applied_) != std::string::npos;
+    }
+
+    return store.rowMatchesFilter(sourceRow);
+}
+
+}}
@@ -0,0 +1,81 @@
+#ifndef SEMPR_GUI_TRIPLEFILTERPROXYMODEL_HPP_
+#define SEMPR_GUI_TRIPLEFILTERPROXYMODEL_HPP_
+
+#include <QSortFilterProxyModel>
+#include <QTimer>
+
+#include "TripleModel.hpp"
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+namespace sempr { namespace gui {
+
+/**
+    Filters a TripleModel by a fixed string that must be contained in the
+    subject, predicate or object of a triple.
+
+    In contrast to the AnyColumnFilterProxyModel, the rows are not checked
+    one by one. Instead, the strings of the TripleStore that contain the
+    filter text are searched on a worker thread (see
+    TripleStore::findStrings), and filterAcceptsRow only needs to look up
+    the three ids of a row. The search starts shortly after the text stopped
+    changing, and a running search is cancelled when a new one starts. If
+    the new text extends the previous one, only the strings that matched
+    before are searched again.
+
+    A filter text that contains a space may span multiple columns (as in
+    "subject predicate"), which cannot be answered by the strings alone.
+    Those are checked row by row, on the concatenation of all columns.
+*/
+class TripleFilterProxyModel : public QSortFilterProxyModel {
+    Q_OBJECT
+
+    TripleModel* triples_;
+
+    // the text that was requested, and the one that is currently applied
+    std::string requested_;
+    std::string applied_;
+    bool spanning_;
+
+    QTimer debounce_;
+
+    // the running search, and its result
+    std::thread worker_;
+    std::atomic<int> generation_;
+
+    struct Result {
+        int generation = 0;
+        std::string query;
+        std::vector<TripleStore::id_t> matching;
+        uint64_t revision = 0;
+    };
+    std::mutex resultMutex_;
+    Result result_;
+
+    void stopWorker();
+
+protected slots:
+    void startSearch();
+    void applyResult(int generation);
+
+signals:
+    // emitted from the worker thread
+    void searchFinished(int generation);
+
+public:
+    TripleFilterProxyModel(TripleModel* source, QObject* parent = nullptr);
+    ~TripleFilterProxyModel();
+
+    bool filterAcceptsRow(int sourceRow, const QModelIndex& sourceParent) const override;
+
+public slots:
+    void setFilterText(const QString& text);
+};
+
+}}
+
+#endif /* include guard: SEMPR_GUI_TRIPLEFILTERPROXYMODEL_HPP_ */
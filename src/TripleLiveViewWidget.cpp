@@ -4,12 +4,12 @@
 namespace sempr { namespace gui {
 
 TripleLiveViewWidget::TripleLiveViewWidget(QWidget* parent)
-    : QWidget(parent), form_(new Ui::TripleLiveViewWidget)
+    : QWidget(parent), form_(new Ui::TripleLiveViewWidget),
+      filterModel_(&allTriplesModel_),
+      pendingUpdates_(false), applyScheduled_(false), loading_(false)
 {
     form_->setupUi(this);
 
-    allTriplesModel_.setColumnCount(3);
-
     // stack & make unique, for the completer
     stackModel_.setSourceModel(&allTriplesModel_);
     uniqueModel_.setSourceModel(&stackModel_);
@@ -19,14 +19,11 @@ TripleLiveViewWidget::TripleLiveViewWidget(QWidget* parent)
 
     form_->tripleListFilterEdit->setCompleter(&completer_);
 
-    // set the filter model for displaying matching triples
-    filterModel_.setSourceModel(&allTriplesModel_);
-
+    // the filter model displays matching triples
     form_->tripleList->setModel(&filterModel_);
 
     connect(form_->tripleListFilterEdit, &QLineEdit::textChanged,
-            &filterModel_,
-            QOverload<const QString&>::of(&AnyColumnFilterProxyModel::setFilterFixedString));
+            &filterModel_, &TripleFilterProxyModel::setFilterText);
 
     form_->tripleList->setContextMenuPolicy(Qt::CustomContextMenu);
     connect(form_->tripleList, &QTreeView::customContextMenuRequested,
@@ -54,50 +51,97 @@ void TripleLiveViewWidget::onRequestMenu(const QPoint& point)
 }
 
 
+namespace {
+    // create a rete::Triple from the sempr::Triple, because the rete::Triple
+    // is already suited to be stored in a map or set.
+    rete::Triple toReteTriple(const sempr::Triple& triple)
+    {
+        return rete::Triple(
+            triple.getField(sempr::Triple::Field::SUBJECT),
+            triple.getField(sempr::Triple::Field::PREDICATE),
+            triple.getField(sempr::Triple::Field::OBJECT)
+        );
+    }
+}
+
 void TripleLiveViewWidget::tripleUpdate(
         sempr::Triple triple,
         AbstractInterface::Notification flag)
 {
-    // create a rete::Triple from the sempr::Triple, because the rete::Triple
-    // is already suited to be stored in a map or set.
-    rete::Triple rt(
-        triple.getField(sempr::Triple::Field::SUBJECT),
-        triple.getField(sempr::Triple::Field::PREDICATE),
-        triple.getField(sempr::Triple::Field::OBJECT)
-    );
+    if (flag == AbstractInterface::Notification::UPDATED)
+    {
+        // must never happen. triples cannot be updated
+        throw std::exception();
+    }
+
+    auto rt = toReteTriple(triple);
+    pendingUpdates_.add(rt, rt, flag);
+
+    if (loading_)
+    {
+        if (flag == AbstractInterface::Notification::REMOVED)
+            removedWhileLoading_.insert(rt);
+        else
+            removedWhileLoading_.erase(rt);
+    }
 
-    if (flag == AbstractInterface::Notification::ADDED)
+    if (!applyScheduled_)
     {
-        // remember the new row index for the triple
-        tripleToIndex_[rt] = allTriplesModel_.rowCount();
+        applyScheduled_ = true;
+        QTimer::singleShot(0, this, &TripleLiveViewWidget::applyPendingUpdates);
+    }
+}
 
-        auto s = new QStandardItem(QString::fromStdString(rt.subject));
-        auto p = new QStandardItem(QString::fromStdString(rt.predicate));
-        auto o = new QStandardItem(QString::fromStdString(rt.object));
 
-        // append to the model
-        allTriplesModel_.appendRow({s, p, o});
+void TripleLiveViewWidget::applyPendingUpdates()
+{
+    applyScheduled_ = false;
+    if (pendingUpdates_.empty()) return;
+
+    std::vector<rete::Triple> added, removed;
+    for (auto& update : pendingUpdates_.take())
+    {
+        if (update.second == AbstractInterface::Notification::ADDED)
+            added.push_back(update.first);
+        else
+            removed.push_back(update.first);
     }
-    else if (flag == AbstractInterface::Notification::REMOVED)
+
+    // duplicates and unknown triples are ignored by the model
+    allTriplesModel_.removeTriples(removed);
+    allTriplesModel_.addTriples(added);
+}
+
+
+void TripleLiveViewWidget::addTriples(const std::vector<sempr::Triple>& triples)
+{
+    std::vector<rete::Triple> rts;
+    rts.reserve(triples.size());
+    for (auto& triple : triples)
     {
-        // remove the triple from the model
-        int index = tripleToIndex_[rt];
-        allTriplesModel_.removeRow(index);
-
-        // remove it from the triple-to-index map
-        tripleToIndex_.erase(rt);
-        // update the triple-to-index-map, all following triples have a lower
-        // row number now
-        for (auto& entry : tripleToIndex_)
+        auto rt = toReteTriple(triple);
+        if (!removedWhileLoading_.count(rt))
         {
-            if (entry.second > index) tripleToIndex_[entry.first] = (entry.second-1);
+            rts.push_back(rt);
         }
     }
-    else
-    {
-        // must never happen. triples cannot be updated
-        throw std::exception();
-    }
+
+    // keep the order w.r.t. the updates received so far
+    applyPendingUpdates();
+    allTriplesModel_.addTriples(rts);
+}
+
+
+void TripleLiveViewWidget::setLoading(bool loading)
+{
+    loading_ = loading;
+    if (!loading_) removedWhileLoading_.clear();
+}
+
+
+TripleModel* TripleLiveViewWidget::tripleModel()
+{
+    return &allTriplesModel_;
 }
 
 
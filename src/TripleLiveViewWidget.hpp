@@ -2,15 +2,17 @@
 #define SEMPR_GUI_TRIPLELIVEVIEWWIDGET_HPP_
 
 #include <QtWidgets>
-#include <QStandardItemModel>
 
 #include "AbstractInterface.hpp"
-#include "AnyColumnFilterProxyModel.hpp"
+#include "TripleModel.hpp"
+#include "TripleFilterProxyModel.hpp"
 #include "StackedColumnsProxyModel.hpp"
 #include "UniqueFilterProxyModel.hpp"
+#include "UpdateBatch.hpp"
 
 #include <QCompleter>
-#include <map>
+#include <set>
+#include <vector>
 
 namespace Ui {
     class TripleLiveViewWidget;
@@ -37,13 +39,24 @@ class TripleLiveViewWidget : public QWidget {
 
     // model with all the triples, plus a filter that takes all columns into
     // account
-    QStandardItemModel allTriplesModel_;
-    AnyColumnFilterProxyModel filterModel_;
+    TripleModel allTriplesModel_;
+    TripleFilterProxyModel filterModel_;
 
-    std::map<rete::Triple, int> tripleToIndex_;
+    // Updates are not applied one by one, but collected until control
+    // returns to the event loop, so that e.g. the retraction of many triples
+    // at once results in a single removal in the model.
+    UpdateBatch<rete::Triple, rete::Triple> pendingUpdates_;
+    bool applyScheduled_;
+
+    // While the initial listing is still being loaded, triples removed by
+    // live updates are remembered, so that they are not re-added when they
+    // are contained in a chunk taken from an earlier snapshot.
+    bool loading_;
+    std::set<rete::Triple> removedWhileLoading_;
 
 protected slots:
     void onRequestMenu(const QPoint& point);
+    void applyPendingUpdates();
 
 public:
     TripleLiveViewWidget(QWidget* parent = nullptr);
@@ -51,6 +64,23 @@ public:
 
     void tripleUpdate(sempr::Triple, AbstractInterface::Notification);
 
+    /**
+        Adds many triples at once, e.g. a chunk of the initial listing.
+    */
+    void addTriples(const std::vector<sempr::Triple>&);
+
+    /**
+        Marks the start/end of the initial listing. While loading, triples
+        removed by live updates are dropped from the chunks passed to
+        addTriples.
+    */
+    void setLoading(bool loading);
+
+    /**
+        The model containing all triples
+    */
+    TripleModel* tripleModel();
+
 signals:
     void requestExplanation(const QString& sub, const QString& pred, const QString& obj);
 };
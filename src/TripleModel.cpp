@@ -0,0 +1,257 @@
+#include "TripleModel.hpp"
+
+#include <algorithm>
+#include <set>
+
+namespace sempr { namespace gui {
+
+const size_t TripleModel::minRemovedToCompact = 1024;
+
+
+TripleModel::TripleModel(QObject* parent)
+    : QAbstractTableModel(parent)
+{
+}
+
+
+void TripleModel::addTriples(const std::vector<rete::Triple>& triples)
+{
+    // the initial listing and the live updates may overlap, so some triples
+    // could already be known. Also, filter duplicates within the batch.
+    auto less = [](const rete::Triple* a, const rete::Triple* b) -> bool
+    {
+        return *a < *b;
+    };
+    std::set<const rete::Triple*, decltype(less)> unique(less);
+
+    std::vector<rete::Triple> toAdd;
+    for (auto& triple : triples)
+    {
+        if (store_.row(triple) == -1 && unique.insert(&triple).second)
+        {
+            toAdd.push_back(triple);
+        }
+    }
+
+    if (toAdd.empty()) return;
+
+    int first = static_cast<int>(store_.size());
+    this->beginInsertRows(QModelIndex(), first, first + toAdd.size() - 1);
+    {
+        std::lock_guard<std::mutex> lock(store_.mutex());
+        for (auto& triple : toAdd)
+        {
+            store_.append(triple);
+        }
+    }
+    this->endInsertRows();
+
+    emit triplesAdded(toAdd);
+}
+
+
+void TripleModel::removeTriples(const std::vector<rete::Triple>& triples)
+{
+    std::vector<int> rows;
+    rows.reserve(triples.size());
+    for (auto& triple : triples)
+    {
+        int row = store_.row(triple);
+        if (row != -1) rows.push_back(row);
+    }
+
+    if (rows.empty()) return;
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+
+    std::vector<rete::Triple> removed;
+    removed.reserve(rows.size());
+    for (int row : rows)
+    {
+        removed.push_back(store_.triple(row));
+    }
+
+    size_t threshold = std::max(minRemovedToCompact, store_.size() / 4);
+    if (store_.removedCount() + rows.size() < threshold)
+    {
+        // Only empty the rows. To the proxies, this is just a change of
+        // data, which they handle row by row.
+        {
+            std::lock_guard<std::mutex> lock(store_.mutex());
+            for (int row : rows)
+            {
+                store_.markRemoved(row);
+            }
+        }
+
+        // one signal for every run of adjacent rows
+        size_t runStart = 0;
+        for (size_t i = 1; i <= rows.size(); i++)
+        {
+            if (i == rows.size() || rows[i] != rows[i-1] + 1)
+            {
+                emit dataChanged(this->index(rows[runStart], 0),
+                                 this->index(rows[i-1], 2));
+                runStart = i;
+            }
+        }
+    }
+    else
+    {
+        // remove the emptied rows, too
+        int size = static_cast<int>(store_.size());
+        for (int row = 0; row < size; row++)
+        {
+            if (store_.isRemoved(row)) rows.push_back(row);
+        }
+        std::sort(rows.begin(), rows.end());
+        compact(rows);
+    }
+
+    emit triplesRemoved(removed);
+}
+
+
+void TripleModel::compact(const std::vector<int>& rows)
+{
+    // Removed rows before newSize ("holes") are filled with the kept rows
+    // after it, so that only the last rows are removed. This is done in two
+    // steps the views and proxies can follow: First, the holes are swapped
+    // with the rows that fill them as a layout change, which moves the
+    // persistent indices (e.g. of selections) along with the triples. Then,
+    // the last rows, which now contain all removed triples, are removed.
+    int oldSize = static_cast<int>(store_.size());
+    int newSize = oldSize - static_cast<int>(rows.size());
+    auto holesEnd = std::lower_bound(rows.begin(), rows.end(), newSize);
+
+    if (holesEnd != rows.begin())
+    {
+        emit layoutAboutToBeChanged();
+
+        QModelIndexList from, to;
+        {
+            std::lock_guard<std::mutex> lock(store_.mutex());
+            auto nextRemoved = holesEnd;
+            int source = newSize;
+            for (auto hole = rows.begin(); hole != holesEnd; ++hole)
+            {
+                // skip rows that are removed themselves
+                while (nextRemoved != rows.end() && *nextRemoved == source)
+                {
+                    ++nextRemoved;
+                    ++source;
+                }
+
+                store_.swapRows(*hole, source);
+                for (int column = 0; column < 3; column++)
+                {
+                    from << this->index(*hole, column) << this->index(source, column);
+                    to << this->index(source, column) << this->index(*hole, column);
+                }
+                ++source;
+            }
+        }
+        this->changePersistentIndexList(from, to);
+
+        emit layoutChanged();
+    }
+
+    std::vector<int> tail;
+    tail.reserve(rows.size());
+    for (int row = newSize; row < oldSize; row++)
+    {
+        tail.push_back(row);
+    }
+
+    this->beginRemoveRows(QModelIndex(), newSize, oldSize - 1);
+    {
+        std::lock_guard<std::mutex> lock(store_.mutex());
+        store_.removeRows(tail);
+    }
+    this->endRemoveRows();
+}
+
+
+bool TripleModel::contains(const rete::Triple& triple) const
+{
+    return store_.row(triple) != -1;
+}
+
+
+void TripleModel::clear()
+{
+    this->beginResetModel();
+    {
+        std::lock_guard<std::mutex> lock(store_.mutex());
+        store_.clear();
+    }
+    this->endResetModel();
+}
+
+
+const TripleStore& TripleModel::store() const
+{
+    return store_;
+}
+
+
+void TripleModel::setFilter(const std::string& query,
+                            const std::vector<TripleStore::id_t>& matching,
+                            uint64_t revision)
+{
+    store_.setFilter(query, matching, revision);
+}
+
+
+int TripleModel::rowCount(const QModelIndex& parent) const
+{
+    if (parent.isValid()) return 0;
+    return static_cast<int>(store_.size());
+}
+
+
+int TripleModel::columnCount(const QModelIndex& parent) const
+{
+    if (parent.isValid()) return 0;
+    return 3;
+}
+
+
+QVariant TripleModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid() || index.row() >= rowCount()) return QVariant();
+    if (role != Qt::DisplayRole && role != Qt::EditRole) return QVariant();
+    if (store_.isRemoved(index.row())) return QVariant();
+
+    switch (index.column()) {
+        case 0:
+            return QString::fromStdString(store_.subject(index.row()));
+        case 1:
+            return QString::fromStdString(store_.predicate(index.row()));
+        case 2:
+            return QString::fromStdString(store_.object(index.row()));
+    }
+
+    return QVariant();
+}
+
+
+QVariant TripleModel::headerData(int section, Qt::Orientation orientation,
+                                 int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return QAbstractTableModel::headerData(section, orientation, role);
+
+    switch (section) {
+        case 0:
+            return "subject";
+        case 1:
+            return "predicate";
+        case 2:
+            return "object";
+    }
+
+    return QVariant();
+}
+
+}}
@@ -0,0 +1,98 @@
+#ifndef SEMPR_GUI_TRIPLEMODEL_HPP_
+#define SEMPR_GUI_TRIPLEMODEL_HPP_
+
+#include <QAbstractTableModel>
+
+#include "AbstractInterface.hpp" // for rete::Triple
+#include "TripleStore.hpp"
+
+#include <vector>
+
+namespace sempr { namespace gui {
+
+/**
+    A flat, read-only table of triples with the columns subject, predicate and
+    object, as used by the TripleLiveViewWidget. The triples are stored in a
+    TripleStore, and other parts of the gui that need all triples (e.g. the
+    SPARQLWidget) read them from here instead of keeping a copy.
+
+    Removing a triple only empties its row (see TripleStore::markRemoved),
+    which is signalled as dataChanged, so that neither this model nor the
+    proxies on top of it need to move any other row. Empty rows have no
+    data, and are hidden by the TripleFilterProxyModel.
+    Once a quarter of the rows (and at least minRemovedToCompact) are empty,
+    they are all removed at once: They are filled with rows from the end of
+    the table ("swap and pop"), which is signalled as a layout change that
+    moves the persistent indices along with the rows, and the end of the
+    table is cut off. This costs about as much as re-sorting the proxies,
+    but only happens after that many removals. The order of the rows is
+    hence not meaningful; use a proxy model to sort them.
+
+    Triples are added in batches, and every batch is signalled with a
+    single rowsInserted, no matter how many triples it contains.
+*/
+class TripleModel : public QAbstractTableModel {
+    Q_OBJECT
+
+    TripleStore store_;
+
+    static const size_t minRemovedToCompact;
+
+    /// removes the given rows (sorted and unique), see above
+    void compact(const std::vector<int>& rows);
+
+public:
+    TripleModel(QObject* parent = nullptr);
+
+    /**
+        Appends the triples that are not yet contained in the model.
+    */
+    void addTriples(const std::vector<rete::Triple>& triples);
+
+    /**
+        Removes the given triples. Unknown triples are ignored. Their rows
+        are emptied, or removed together with all other empty rows.
+    */
+    void removeTriples(const std::vector<rete::Triple>& triples);
+
+    /**
+        Checks if the triple is contained in the model.
+    */
+    bool contains(const rete::Triple& triple) const;
+
+    /**
+        Removes all triples.
+    */
+    void clear();
+
+    /**
+        Read access to the triples.
+    */
+    const TripleStore& store() const;
+
+    /**
+        Sets the filter of the store, see TripleStore::setFilter. Used by the
+        TripleFilterProxyModel.
+    */
+    void setFilter(const std::string& query,
+                   const std::vector<TripleStore::id_t>& matching,
+                   uint64_t revision);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation,
+                        int role = Qt::DisplayRole) const override;
+
+signals:
+    /**
+        Emitted after every batch of changes, with the triples that were
+        actually added / removed.
+    */
+    void triplesAdded(const std::vector<rete::Triple>&);
+    void triplesRemoved(const std::vector<rete::Triple>&);
+};
+
+}}
+
+#endif /* include guard: SEMPR_GUI_TRIPLEMODEL_HPP_ */
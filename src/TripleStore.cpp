@@ -0,0 +1,469 @@
+#include "TripleStore.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+namespace sempr { namespace gui {
+
+namespace {
+    // the strings of placeholder rows
+    const std::string emptyString;
+}
+
+const TripleStore::id_t TripleStore::removedId = ~TripleStore::id_t(0);
+
+size_t TripleStore::StringPtrHash::operator() (const std::string* str) const
+{
+    return std::hash<std::string>()(*str);
+}
+
+bool TripleStore::StringPtrEqual::operator() (
+        const std::string* a, const std::string* b) const
+{
+    return *a == *b;
+}
+
+bool TripleStore::Key::operator == (const Key& other) const
+{
+    return s == other.s && p == other.p && o == other.o;
+}
+
+size_t TripleStore::hash(const Key& key)
+{
+    uint64_t h = key.s;
+    h = h * 1000003 ^ key.p;
+    h = h * 1000003 ^ key.o;
+    // mix the bits, only the lower ones are used for the slot
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    return static_cast<size_t>(h);
+}
+
+TripleStore::Key TripleStore::keyOf(int row) const
+{
+    return Key{ subjects_[row], predicates_[row], objects_[row] };
+}
+
+
+TripleStore::TripleStore()
+    : revision_(0), numRemoved_(0)
+{
+    rebuildIndex(16);
+}
+
+
+long TripleStore::findSlot(const Key& key) const
+{
+    size_t slot = hash(key) & indexMask_;
+    while (index_[slot] != -1)
+    {
+        if (keyOf(index_[slot]) == key) return static_cast<long>(slot);
+        slot = (slot + 1) & indexMask_;
+    }
+    return -1;
+}
+
+void TripleStore::insertIntoIndex(int row)
+{
+    size_t slot = hash(keyOf(row)) & indexMask_;
+    while (index_[slot] != -1) slot = (slot + 1) & indexMask_;
+    index_[slot] = row;
+}
+
+void TripleStore::eraseSlot(size_t slot)
+{
+    // Move following entries of the same probe sequence back into the gap,
+    // instead of leaving a tombstone.
+    size_t next = slot;
+    while (true)
+    {
+        next = (next + 1) & indexMask_;
+        if (index_[next] == -1) break;
+
+        size_t home = hash(keyOf(index_[next])) & indexMask_;
+        // can the entry at next be moved to slot, i.e. is its home not
+        // cyclically in (slot, next]?
+        bool stays = (slot <= next) ? (slot < home && home <= next)
+                                    : (slot < home || home <= next);
+        if (stays) continue;
+
+        index_[slot] = index_[next];
+        slot = next;
+    }
+    index_[slot] = -1;
+}
+
+void TripleStore::rebuildIndex(size_t slots)
+{
+    index_.assign(slots, -1);
+    indexMask_ = slots - 1;
+
+    for (size_t row = 0; row < subjects_.size(); row++)
+    {
+        if (isRemoved(row)) continue;
+        size_t slot = hash(keyOf(row)) & indexMask_;
+        while (index_[slot] != -1) slot = (slot + 1) & indexMask_;
+        index_[slot] = static_cast<int32_t>(row);
+    }
+}
+
+
+TripleStore::id_t TripleStore::acquire(const std::string& str)
+{
+    auto it = stringIds_.find(&str);
+    if (it != stringIds_.end())
+    {
+        useCount_[it->second]++;
+        return it->second;
+    }
+
+    id_t id;
+    if (!freeIds_.empty())
+    {
+        id = freeIds_.back();
+        freeIds_.pop_back();
+        strings_[id] = str;
+        useCount_[id] = 1;
+    }
+    else
+    {
+        id = static_cast<id_t>(strings_.size());
+        strings_.push_back(str);
+        useCount_.push_back(1);
+        signatures_.push_back(Signature());
+        assignedAt_.push_back(0);
+        matches_.push_back(0);
+    }
+
+    stringIds_[&strings_[id]] = id;
+    assigned(id);
+    return id;
+}
+
+void TripleStore::assigned(id_t id)
+{
+    auto& str = strings_[id];
+    signatures_[id] = signatureOf(str);
+    assignedAt_[id] = ++revision_;
+    matches_[id] = !filter_.empty() && str.find(filter_) != std::string::npos;
+}
+
+void TripleStore::release(id_t id)
+{
+    if (--useCount_[id] > 0) return;
+
+    stringIds_.erase(&strings_[id]);
+    std::string().swap(strings_[id]); // actually free the memory
+    freeIds_.push_back(id);
+}
+
+bool TripleStore::lookup(const std::string& str, id_t& id) const
+{
+    auto it = stringIds_.find(&str);
+    if (it == stringIds_.end()) return false;
+
+    id = it->second;
+    return true;
+}
+
+bool TripleStore::lookup(const rete::Triple& triple, Key& key) const
+{
+    return lookup(triple.subject, key.s) &&
+           lookup(triple.predicate, key.p) &&
+           lookup(triple.object, key.o);
+}
+
+
+bool TripleStore::append(const rete::Triple& triple)
+{
+    Key key;
+    if (lookup(triple, key) && findSlot(key) != -1) return false;
+
+    key.s = acquire(triple.subject);
+    key.p = acquire(triple.predicate);
+    key.o = acquire(triple.object);
+
+    // keep the load factor of the index below 1/2
+    if (2 * (subjects_.size() + 1) > index_.size())
+    {
+        rebuildIndex(2 * index_.size());
+    }
+
+    subjects_.push_back(key.s);
+    predicates_.push_back(key.p);
+    objects_.push_back(key.o);
+    insertIntoIndex(static_cast<int>(subjects_.size() - 1));
+    return true;
+}
+
+
+int TripleStore::row(const rete::Triple& triple) const
+{
+    Key key;
+    if (!lookup(triple, key)) return -1;
+
+    long slot = findSlot(key);
+    if (slot == -1) return -1;
+    return index_[slot];
+}
+
+
+void TripleStore::removeRows(const std::vector<int>& rows)
+{
+    if (rows.empty()) return;
+
+    for (int row : rows)
+    {
+        if (isRemoved(row))
+        {
+            numRemoved_--;
+            continue;
+        }
+
+        eraseSlot(findSlot(keyOf(row)));
+        release(subjects_[row]);
+        release(predicates_[row]);
+        release(objects_[row]);
+    }
+
+    // Everything from newSize on will be cut off. The removed rows before
+    // that ("holes") are filled with the remaining rows after it.
+    int newSize = static_cast<int>(subjects_.size() - rows.size());
+    auto nextRemoved = rows.begin();
+    while (nextRemoved != rows.end() && *nextRemoved < newSize) ++nextRemoved;
+    auto holesEnd = nextRemoved;
+    int source = newSize;
+
+    for (auto hole = rows.begin(); hole != holesEnd; ++hole)
+    {
+        // skip rows that are removed themselves
+        while (nextRemoved != rows.end() && *nextRemoved == source)
+        {
+            ++nextRemoved;
+            ++source;
+        }
+
+        if (!isRemoved(source)) index_[findSlot(keyOf(source))] = *hole;
+        subjects_[*hole] = subjects_[source];
+        predicates_[*hole] = predicates_[source];
+        objects_[*hole] = objects_[source];
+        ++source;
+    }
+
+    subjects_.resize(newSize);
+    predicates_.resize(newSize);
+    objects_.resize(newSize);
+}
+
+
+void TripleStore::markRemoved(int row)
+{
+    if (isRemoved(row)) return;
+
+    eraseSlot(findSlot(keyOf(row)));
+    release(subjects_[row]);
+    release(predicates_[row]);
+    release(objects_[row]);
+
+    subjects_[row] = predicates_[row] = objects_[row] = removedId;
+    numRemoved_++;
+}
+
+
+bool TripleStore::isRemoved(int row) const
+{
+    return subjects_[row] == removedId;
+}
+
+
+size_t TripleStore::removedCount() const
+{
+    return numRemoved_;
+}
+
+
+void TripleStore::swapRows(int a, int b)
+{
+    if (a == b) return;
+
+    // placeholders are not in the index
+    long slotA = isRemoved(a) ? -1 : findSlot(keyOf(a));
+    long slotB = isRemoved(b) ? -1 : findSlot(keyOf(b));
+    if (slotA != -1) index_[slotA] = b;
+    if (slotB != -1) index_[slotB] = a;
+
+    std::swap(subjects_[a], subjects_[b]);
+    std::swap(predicates_[a], predicates_[b]);
+    std::swap(objects_[a], objects_[b]);
+}
+
+
+void TripleStore::clear()
+{
+    strings_.clear();
+    useCount_.clear();
+    freeIds_.clear();
+    stringIds_.clear();
+    signatures_.clear();
+    assignedAt_.clear();
+    matches_.clear();
+    subjects_.clear();
+    predicates_.clear();
+    objects_.clear();
+    numRemoved_ = 0;
+    rebuildIndex(16);
+}
+
+
+size_t TripleStore::size() const
+{
+    return subjects_.size();
+}
+
+const std::string& TripleStore::subject(int row) const
+{
+    if (isRemoved(row)) return emptyString;
+    return strings_[subjects_[row]];
+}
+
+const std::string& TripleStore::predicate(int row) const
+{
+    if (isRemoved(row)) return emptyString;
+    return strings_[predicates_[row]];
+}
+
+const std::string& TripleStore::object(int row) const
+{
+    if (isRemoved(row)) return emptyString;
+    return strings_[objects_[row]];
+}
+
+rete::Triple TripleStore::triple(int row) const
+{
+    return rete::Triple(subject(row), predicate(row), object(row));
+}
+
+size_t TripleStore::stringCount() const
+{
+    return stringIds_.size();
+}
+
+std::mutex& TripleStore::mutex() const
+{
+    return mutex_;
+}
+
+
+TripleStore::Signature TripleStore::signatureOf(const std::string& str)
+{
+    // sets one of 256 bits for every trigram
+    Signature sig = {{ 0, 0, 0, 0 }};
+    for (size_t i = 2; i < str.size(); i++)
+    {
+        unsigned h = static_cast<unsigned char>(str[i-2]);
+        h = h * 31 + static_cast<unsigned char>(str[i-1]);
+        h = h * 31 + static_cast<unsigned char>(str[i]);
+        h = (h ^ (h >> 8)) & 255;
+        sig[h >> 6] |= uint64_t(1) << (h & 63);
+    }
+    return sig;
+}
+
+std::vector<TripleStore::id_t> TripleStore::findStrings(
+        const std::string& query,
+        const std::vector<id_t>* candidates,
+        std::function<bool()> cancelled) const
+{
+    std::vector<id_t> result;
+
+    // every trigram of the query must be in the string, too.
+    auto querySig = signatureOf(query);
+    auto check = [&](id_t id)
+    {
+        if (useCount_[id] == 0) return; // unused
+        auto& sig = signatures_[id];
+        for (size_t i = 0; i < sig.size(); i++)
+        {
+            if ((sig[i] & querySig[i]) != querySig[i]) return;
+        }
+        if (strings_[id].find(query) != std::string::npos) result.push_back(id);
+    };
+
+    // The lock is only held for a chunk of strings at a time, so that the
+    // gui thread can modify the store in between. Strings that are assigned
+    // in the meantime are checked again by setFilter, see revision().
+    const size_t chunkSize = 4096;
+    for (size_t begin = 0; ; begin += chunkSize)
+    {
+        if (cancelled && cancelled()) return {};
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t count = candidates ? candidates->size() : strings_.size();
+        if (begin >= count) break;
+
+        size_t end = std::min(count, begin + chunkSize);
+        for (size_t i = begin; i < end; i++)
+        {
+            id_t id = candidates ? (*candidates)[i] : static_cast<id_t>(i);
+            if (id < strings_.size()) check(id);
+        }
+    }
+
+    return result;
+}
+
+uint64_t TripleStore::revision() const
+{
+    return revision_;
+}
+
+void TripleStore::setFilter(const std::string& query,
+                            const std::vector<id_t>& matching,
+                            uint64_t revision)
+{
+    filter_ = query;
+    matches_.assign(strings_.size(), 0);
+    for (auto id : matching)
+    {
+        if (id < matches_.size()) matches_[id] = 1;
+    }
+
+    // strings added in the meantime (maybe with a recycled id) were not
+    // part of the search
+    for (size_t id = 0; id < strings_.size(); id++)
+    {
+        if (assignedAt_[id] > revision)
+        {
+            matches_[id] = !filter_.empty() &&
+                           strings_[id].find(filter_) != std::string::npos;
+        }
+    }
+}
+
+const std::string& TripleStore::filter() const
+{
+    return filter_;
+}
+
+std::vector<TripleStore::id_t> TripleStore::matchingStrings() const
+{
+    std::vector<id_t> ids;
+    for (size_t id = 0; id < matches_.size(); id++)
+    {
+        if (matches_[id] && useCount_[id] > 0) ids.push_back(static_cast<id_t>(id));
+    }
+    return ids;
+}
+
+bool TripleStore::rowMatchesFilter(int row) const
+{
+    if (isRemoved(row)) return false;
+    if (filter_.empty()) return true;
+    return matches_[subjects_[row]] ||
+           matches_[predicates_[row]] ||
+           matches_[objects_[row]];
+}
+
+}}
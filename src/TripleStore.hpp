@@ -0,0 +1,212 @@
+#ifndef SEMPR_GUI_TRIPLESTORE_HPP_
+#define SEMPR_GUI_TRIPLESTORE_HPP_
+
+#include "AbstractInterface.hpp" // for rete::Triple
+
+#include <vector>
+#include <deque>
+#include <array>
+#include <string>
+#include <unordered_map>
+#include <functional>
+#include <mutex>
+#include <cstdint>
+
+namespace sempr { namespace gui {
+
+/**
+    The client side copy of all triples. IRIs repeat a lot, so every string
+    is stored only once in a dictionary, and the triples are stored as three
+    columns of ids into it.
+
+    Rows are not stable: Removed rows are filled with rows from the end, see
+    removeRows. Alternatively, a row can be marked as removed (markRemoved),
+    which frees the triple but keeps the row as an empty placeholder, so that
+    no other row changes. The store is meant to be modified by the
+    TripleModel only, which also notifies views about changes.
+
+    For filtering, every string has a signature of the trigrams it contains,
+    which allows findStrings to skip most strings that cannot contain the
+    query without looking at them. The result of a search is set as the
+    current filter, and new strings are checked against it when they are
+    added.
+
+    Thread safety: Only the gui thread modifies the store, and locks mutex()
+    while doing so. Other threads may read the strings through findStrings,
+    which takes the lock itself for a chunk of strings at a time.
+*/
+class TripleStore {
+public:
+    typedef uint32_t id_t;
+
+private:
+    // The dictionary. A deque, as it does not move the strings when it
+    // grows, so that stringIds_ can point to them. Ids of strings that are
+    // no longer used are recycled.
+    std::deque<std::string> strings_;
+    std::vector<uint32_t> useCount_;
+    std::vector<id_t> freeIds_;
+
+    struct StringPtrHash {
+        size_t operator() (const std::string* str) const;
+    };
+    struct StringPtrEqual {
+        bool operator() (const std::string* a, const std::string* b) const;
+    };
+    std::unordered_map<const std::string*, id_t,
+                       StringPtrHash, StringPtrEqual> stringIds_;
+
+    // trigram signature of every string, see signatureOf
+    typedef std::array<uint64_t, 4> Signature;
+    std::vector<Signature> signatures_;
+    static Signature signatureOf(const std::string& str);
+
+    // Counts the strings added so far. assignedAt_ stores the value at which
+    // an id was (re-)assigned to its current string.
+    uint64_t revision_;
+    std::vector<uint64_t> assignedAt_;
+
+    // the current filter and which strings contain it
+    std::string filter_;
+    std::vector<char> matches_;
+
+    mutable std::mutex mutex_;
+
+    // the triples. Rows marked as removed hold removedId in all columns.
+    std::vector<id_t> subjects_, predicates_, objects_;
+    static const id_t removedId;
+    size_t numRemoved_;
+
+    struct Key {
+        id_t s, p, o;
+        bool operator == (const Key& other) const;
+    };
+    static size_t hash(const Key& key);
+    Key keyOf(int row) const;
+
+    // Finds the row of a triple. An open addressing hash table with linear
+    // probing that only stores the rows (-1 for empty slots), the keys are
+    // read from the columns. This needs only a few bytes per triple, compared
+    // to a node based std::unordered_map.
+    std::vector<int32_t> index_;
+    size_t indexMask_;
+
+    /// the slot of the row with the given key, or -1
+    long findSlot(const Key& key) const;
+    /// adds the row to the index, which must have a free slot
+    void insertIntoIndex(int row);
+    /// removes the row in the given slot from the index
+    void eraseSlot(size_t slot);
+    /// rebuilds the index with the given number of slots (a power of 2)
+    void rebuildIndex(size_t slots);
+
+    /// returns the id of the string, adding it if necessary. Increases its
+    /// use count.
+    id_t acquire(const std::string& str);
+
+    /// decreases the use count of the string, freeing it if unused.
+    void release(id_t id);
+
+    /// looks up the id of the string, returns false if it is unknown
+    bool lookup(const std::string& str, id_t& id) const;
+
+    /// looks up the key of the triple, returns false if it is unknown
+    bool lookup(const rete::Triple& triple, Key& key) const;
+
+    /// sets the signature etc. of a newly assigned id
+    void assigned(id_t id);
+
+public:
+    TripleStore();
+
+    /**
+        Appends the triple, unless it is already contained. Returns true if
+        it was added.
+    */
+    bool append(const rete::Triple& triple);
+
+    /**
+        Returns the row of the triple, -1 if it is unknown.
+    */
+    int row(const rete::Triple& triple) const;
+
+    /**
+        Removes the given rows, which must be sorted and unique. The rows that
+        are kept keep their position, except for those after size() - n
+        (where n is the number of removed rows): They are moved into the
+        gaps before that, in order.
+    */
+    void removeRows(const std::vector<int>& rows);
+
+    /**
+        Removes the triple in the row, but keeps the row as a placeholder
+        without a triple. Its strings are empty, and it does not match any
+        filter. Use removeRows to remove the placeholders later on.
+    */
+    void markRemoved(int row);
+
+    /// true if the row is a placeholder left by markRemoved
+    bool isRemoved(int row) const;
+
+    /// the number of placeholder rows
+    size_t removedCount() const;
+
+    /**
+        Exchanges the triples in the two rows.
+    */
+    void swapRows(int a, int b);
+
+    void clear();
+
+    /// the number of rows, including placeholders
+    size_t size() const;
+
+    const std::string& subject(int row) const;
+    const std::string& predicate(int row) const;
+    const std::string& object(int row) const;
+    rete::Triple triple(int row) const;
+
+    /// number of distinct strings currently stored
+    size_t stringCount() const;
+
+    /// the lock for reading from other threads, see above
+    std::mutex& mutex() const;
+
+    /**
+        Returns the ids of all strings that contain the query. If candidates
+        is given, only those ids are checked. cancelled is called from time
+        to time, and the search stops early with an empty result if it
+        returns true. Locks mutex() for a few thousand strings at a time, so
+        call it without holding the lock. Strings assigned during the search
+        may or may not be checked; setFilter checks them again.
+    */
+    std::vector<id_t> findStrings(const std::string& query,
+                                  const std::vector<id_t>* candidates,
+                                  std::function<bool()> cancelled) const;
+
+    /**
+        Increases with every string that is added. Strings added after a
+        search are checked again when its result is passed to setFilter.
+    */
+    uint64_t revision() const;
+
+    /**
+        Sets the current filter and the ids of the strings that contain it,
+        as found by findStrings at the given revision.
+    */
+    void setFilter(const std::string& query, const std::vector<id_t>& matching,
+                   uint64_t revision);
+
+    const std::string& filter() const;
+
+    /// ids of the strings that contain the current filter
+    std::vector<id_t> matchingStrings() const;
+
+    /// true if any part of the triple contains the filter, or there is none.
+    /// Always false for placeholders.
+    bool rowMatchesFilter(int row) const;
+};
+
+}}
+
+#endif /* include guard: SEMPR_GUI_TRIPLESTORE_HPP_ */
@@ -1,105 +1,341 @@
 #include "UniqueFilterProxyModel.hpp"
 
 #include <QDebug>
+#include <algorithm>
 
 namespace sempr { namespace gui {
 
 UniqueFilterProxyModel::UniqueFilterProxyModel(QObject* parent)
-    : QSortFilterProxyModel(parent)
+    : QAbstractProxyModel(parent), resetting_(false)
 {
 }
 
+
+QString UniqueFilterProxyModel::sourceValue(int row) const
+{
+    return sourceModel()->index(row, 0).data().toString();
+}
+
+
+QString UniqueFilterProxyModel::acquire(const QString& value, Added& added)
+{
+    if (value.isEmpty()) return value;
+
+    int first = static_cast<int>(values_.size());
+
+    auto it = valueToRow_.find(value);
+    if (it != valueToRow_.end())
+    {
+        int row = it.value();
+        if (row < first)
+        {
+            counts_[row]++;
+            return values_[row];
+        }
+
+        // new in this batch
+        added.counts[row - first]++;
+        return added.values[row - first];
+    }
+
+    valueToRow_.insert(value, first + static_cast<int>(added.values.size()));
+    added.values.push_back(value);
+    added.counts.push_back(1);
+    return value;
+}
+
+
+void UniqueFilterProxyModel::release(const QString& value, std::vector<int>& unused)
+{
+    if (value.isEmpty()) return;
+
+    auto it = valueToRow_.find(value);
+    if (it == valueToRow_.end()) return; // must not happen
+
+    int row = it.value();
+    if (--counts_[row] == 0) unused.push_back(row);
+}
+
+
+void UniqueFilterProxyModel::insertValues(const Added& added)
+{
+    if (added.values.empty()) return;
+
+    int first = static_cast<int>(values_.size());
+    beginInsertRows(QModelIndex(), first, first + added.values.size() - 1);
+    values_.insert(values_.end(), added.values.begin(), added.values.end());
+    counts_.insert(counts_.end(), added.counts.begin(), added.counts.end());
+    endInsertRows();
+}
+
+
+void UniqueFilterProxyModel::removeValues(std::vector<int>& unused)
+{
+    if (unused.empty()) return;
+    std::sort(unused.begin(), unused.end());
+    unused.erase(std::unique(unused.begin(), unused.end()), unused.end());
+
+    // Like in the TripleModel: The rows from newSize on are cut off, and
+    // the unused rows before that are filled with the remaining ones after
+    // it, so that no other row needs to be moved.
+    int oldSize = static_cast<int>(values_.size());
+    int newSize = oldSize - static_cast<int>(unused.size());
+    auto holesEnd = std::lower_bound(unused.begin(), unused.end(), newSize);
+    int firstHole = unused.front();
+    int lastHole = (holesEnd == unused.begin() ? -1 : *(holesEnd - 1));
+
+    beginRemoveRows(QModelIndex(), newSize, oldSize - 1);
+
+    for (int row : unused)
+    {
+        valueToRow_.remove(values_[row]);
+    }
+
+    auto nextUnused = holesEnd;
+    int source = newSize;
+    for (auto hole = unused.begin(); hole != holesEnd; ++hole)
+    {
+        while (nextUnused != unused.end() && *nextUnused == source)
+        {
+            ++nextUnused;
+            ++source;
+        }
+
+        values_[*hole] = values_[source];
+        counts_[*hole] = counts_[source];
+        valueToRow_[values_[*hole]] = *hole;
+        ++source;
+    }
+
+    values_.resize(newSize);
+    counts_.resize(newSize);
+    endRemoveRows();
+
+    if (lastHole != -1)
+    {
+        emit dataChanged(index(firstHole, 0), index(lastHole, 0));
+    }
+}
+
+
 void UniqueFilterProxyModel::buildMap()
 {
-    beginResetModel();
+    if (!resetting_) beginResetModel();
+    resetting_ = false;
+
+    sourceValues_.clear();
+    values_.clear();
+    counts_.clear();
+    valueToRow_.clear();
 
-    valueToIndex_.clear();
-//    qDebug() << "clear map";
     if (sourceModel())
     {
         int rowCount = sourceModel()->rowCount();
-//        qDebug() << "iterate source model " << sourceModel() << " with " << rowCount << " rows";
+        sourceValues_.reserve(rowCount);
+
+        Added added;
         for (int r = 0; r < rowCount; r++)
         {
-            auto index = sourceModel()->index(r, 0);
-            QVariant val = index.data();
-            if (valueToIndex_.find(val) == valueToIndex_.end())
-            {
-                valueToIndex_[val] = index;
-//                qDebug() << "added " << val << " to map";
-            }
+            sourceValues_.push_back(acquire(sourceValue(r), added));
         }
+        values_ = std::move(added.values);
+        counts_ = std::move(added.counts);
     }
 
     endResetModel();
-    invalidate();
 }
 
 
-bool UniqueFilterProxyModel::filterAcceptsRow(
-        int sourceRow,
-        const QModelIndex& sourceParent) const
+void UniqueFilterProxyModel::sourceAboutToBeReset()
 {
-    QPersistentModelIndex index = sourceModel()->index(sourceRow, 0, sourceParent);
-    QString value = sourceModel()->data(index).toString();
+    beginResetModel();
+    resetting_ = true;
+}
 
-    // find the value in the map
-    auto it = valueToIndex_.find(value);
 
-    if (it != valueToIndex_.end())
+void UniqueFilterProxyModel::sourceRowsInserted(
+        const QModelIndex& parent, int first, int last)
+{
+    if (parent.isValid()) return;
+
+    std::vector<QString> inserted;
+    inserted.reserve(last - first + 1);
+
+    Added added;
+    for (int r = first; r <= last; r++)
     {
-        // same index as the first found with the value -> all good.
-        if (*it == index) return true;
+        inserted.push_back(acquire(sourceValue(r), added));
     }
-    else
+
+    sourceValues_.insert(sourceValues_.begin() + first,
+                         inserted.begin(), inserted.end());
+    insertValues(added);
+}
+
+
+void UniqueFilterProxyModel::sourceRowsRemoved(
+        const QModelIndex& parent, int first, int last)
+{
+    if (parent.isValid()) return;
+
+    std::vector<int> unused;
+    for (int r = first; r <= last; r++)
     {
-        // seems to be a normal case, that the filterAcceptsRow is called
-        // even befor it iterated over a valid source model...
-        // just reject everything, it is queried for again later on.
-        //qDebug() << "wtf? value " << value << " not found in map!";
-        // something went wrong, the map wasn't constructed correctly...
-        //throw std::exception();
+        release(sourceValues_[r], unused);
     }
 
-    return false;
+    sourceValues_.erase(sourceValues_.begin() + first,
+                        sourceValues_.begin() + last + 1);
+    removeValues(unused);
 }
 
 
+void UniqueFilterProxyModel::sourceDataChanged(
+        const QModelIndex& topLeft, const QModelIndex& bottomRight)
+{
+    if (topLeft.parent().isValid() || topLeft.column() > 0) return;
+
+    // find the rows whose value actually changed
+    std::vector<int> changed;
+    std::vector<QString> newValues;
+    for (int r = topLeft.row(); r <= bottomRight.row(); r++)
+    {
+        QString value = sourceValue(r);
+        if (value != sourceValues_[r])
+        {
+            changed.push_back(r);
+            newValues.push_back(value);
+        }
+    }
+
+    if (changed.empty()) return;
+
+    // remove the old values first, the rows of the new ones are only known
+    // afterwards.
+    std::vector<int> unused;
+    for (int r : changed)
+    {
+        release(sourceValues_[r], unused);
+    }
+    removeValues(unused);
+
+    Added added;
+    for (size_t i = 0; i < changed.size(); i++)
+    {
+        sourceValues_[changed[i]] = acquire(newValues[i], added);
+    }
+    insertValues(added);
+}
+
 
 void UniqueFilterProxyModel::setSourceModel(QAbstractItemModel* source)
 {
     if (sourceModel())
     {
-        disconnect(sourceModel(), &QAbstractItemModel::layoutChanged,
-                   this, &UniqueFilterProxyModel::buildMap);
-        disconnect(sourceModel(), &QAbstractItemModel::modelReset,
-                   this, &UniqueFilterProxyModel::buildMap);
-        disconnect(sourceModel(), &QAbstractItemModel::dataChanged,
-                   this, &UniqueFilterProxyModel::buildMap);
-        disconnect(source, &QAbstractItemModel::rowsInserted,
-                   this, &UniqueFilterProxyModel::buildMap);
-        disconnect(source, &QAbstractItemModel::rowsInserted,
-                   this, &UniqueFilterProxyModel::buildMap);
-        disconnect(source, &QAbstractItemModel::rowsRemoved,
-                   this, &UniqueFilterProxyModel::buildMap);
+        disconnect(sourceModel(), nullptr, this, nullptr);
     }
 
-    QSortFilterProxyModel::setSourceModel(source);
-
-    connect(source, &QAbstractItemModel::layoutChanged,
-            this, &UniqueFilterProxyModel::buildMap);
-    connect(source, &QAbstractItemModel::modelReset,
-            this, &UniqueFilterProxyModel::buildMap);
-    connect(source, &QAbstractItemModel::dataChanged,
-            this, &UniqueFilterProxyModel::buildMap);
-    connect(source, &QAbstractItemModel::rowsInserted,
-            this, &UniqueFilterProxyModel::buildMap);
-    connect(source, &QAbstractItemModel::rowsInserted,
-            this, &UniqueFilterProxyModel::buildMap);
-    connect(source, &QAbstractItemModel::rowsRemoved,
-            this, &UniqueFilterProxyModel::buildMap);
+    QAbstractProxyModel::setSourceModel(source);
+
+    if (source)
+    {
+        connect(source, &QAbstractItemModel::rowsInserted,
+                this, &UniqueFilterProxyModel::sourceRowsInserted);
+        connect(source, &QAbstractItemModel::rowsRemoved,
+                this, &UniqueFilterProxyModel::sourceRowsRemoved);
+        connect(source, &QAbstractItemModel::dataChanged,
+                this, &UniqueFilterProxyModel::sourceDataChanged);
+
+        // everything else is handled by a rebuild
+        connect(source, &QAbstractItemModel::modelAboutToBeReset,
+                this, &UniqueFilterProxyModel::sourceAboutToBeReset);
+        connect(source, &QAbstractItemModel::modelReset,
+                this, &UniqueFilterProxyModel::buildMap);
+        connect(source, &QAbstractItemModel::layoutAboutToBeChanged,
+                this, &UniqueFilterProxyModel::sourceAboutToBeReset);
+        connect(source, &QAbstractItemModel::layoutChanged,
+                this, &UniqueFilterProxyModel::buildMap);
+        connect(source, &QAbstractItemModel::rowsAboutToBeMoved,
+                this, &UniqueFilterProxyModel::sourceAboutToBeReset);
+        connect(source, &QAbstractItemModel::rowsMoved,
+                this, &UniqueFilterProxyModel::buildMap);
+    }
 
     buildMap();
 }
 
+
+QModelIndex UniqueFilterProxyModel::mapFromSource(const QModelIndex& sourceIndex) const
+{
+    if (!sourceIndex.isValid() || sourceIndex.row() >= (int)sourceValues_.size())
+        return QModelIndex();
+
+    auto it = valueToRow_.find(sourceValues_[sourceIndex.row()]);
+    if (it == valueToRow_.end()) return QModelIndex();
+    return index(it.value(), 0);
+}
+
+
+QModelIndex UniqueFilterProxyModel::mapToSource(const QModelIndex& proxyIndex) const
+{
+    if (!proxyIndex.isValid() || !sourceModel()) return QModelIndex();
+
+    // Any row with the value will do. This is not needed for the completers
+    // (which only use data()), so a linear search is good enough.
+    auto& value = values_[proxyIndex.row()];
+    for (size_t r = 0; r < sourceValues_.size(); r++)
+    {
+        if (sourceValues_[r] == value) return sourceModel()->index(r, 0);
+    }
+
+    return QModelIndex();
+}
+
+
+QModelIndex UniqueFilterProxyModel::index(int row, int column, const QModelIndex& parent) const
+{
+    if (parent.isValid() || column != 0 || row < 0 || row >= rowCount())
+        return QModelIndex();
+    return createIndex(row, column);
+}
+
+
+QModelIndex UniqueFilterProxyModel::parent(const QModelIndex& /*index*/) const
+{
+    return QModelIndex();
+}
+
+
+int UniqueFilterProxyModel::rowCount(const QModelIndex& parent) const
+{
+    if (parent.isValid()) return 0;
+    return static_cast<int>(values_.size());
+}
+
+
+int UniqueFilterProxyModel::columnCount(const QModelIndex& parent) const
+{
+    if (parent.isValid()) return 0;
+    return 1;
+}
+
+
+QVariant UniqueFilterProxyModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid()) return QVariant();
+    if (role == Qt::DisplayRole || role == Qt::EditRole)
+    {
+        return values_[index.row()];
+    }
+
+    return QAbstractProxyModel::data(index, role);
+}
+
+
+Qt::ItemFlags UniqueFilterProxyModel::flags(const QModelIndex& index) const
+{
+    if (!index.isValid()) return Qt::NoItemFlags;
+    return Qt::ItemIsEnabled | Qt::ItemIsSelectable;
+}
+
 }}
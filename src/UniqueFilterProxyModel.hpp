@@ -1,34 +1,89 @@
 #ifndef SEMPR_GUI_UNIQUEFILTERPROXYMODEL_HPP_
 #define SEMPR_GUI_UNIQUEFILTERPROXYMODEL_HPP_
 
-#include <QSortFilterProxyModel>
+#include <QAbstractProxyModel>
+#include <QHash>
+#include <vector>
 
 namespace sempr { namespace gui {
 
 /**
-    This proxy removes duplicate rows based on the first column.
+    This proxy removes duplicate rows based on the first column: It contains
+    every distinct value (DisplayRole, as string) of the first column of a
+    flat source model once. Empty values are left out (e.g. the emptied rows
+    of removed triples in the TripleModel).
+
+    The proxy is updated incrementally: It counts how often every value
+    occurs in the source, and a row is only inserted when a value occurs for
+    the first time, and removed when its last occurrence is removed. To know
+    the old value of a changed or removed source row, the values of all
+    source rows are remembered (sharing the string data with the proxy
+    rows).
+
+    The order of the rows is the order in which the values first occurred,
+    except that a removed row is replaced by the last one.
 */
-class UniqueFilterProxyModel : public QSortFilterProxyModel {
+class UniqueFilterProxyModel : public QAbstractProxyModel {
     Q_OBJECT
 
-    /**
-        This map stores a mapping of a value to the firsrt index at which it
-        was found in the source model. This allows us to check in
-        filterAcceptRow if the index is in there, or if it is a duplicate.
-    */
-    QMap<QVariant, QPersistentModelIndex> valueToIndex_;
+    /// the value of every row of the source model
+    std::vector<QString> sourceValues_;
+
+    /// the distinct values, i.e. the rows of this model, and how often they
+    /// occur in the source
+    std::vector<QString> values_;
+    std::vector<int> counts_;
+    QHash<QString, int> valueToRow_;
+
+    /// true while the source is reset/changes its layout
+    bool resetting_;
+
+    /// reads the value of a row of the source model
+    QString sourceValue(int row) const;
+
+    /// values that occur for the first time, to be inserted by insertRows
+    struct Added {
+        std::vector<QString> values;
+        std::vector<int> counts;
+    };
+
+    /// counts an occurrence of the value. Returns the (shared) string, and
+    /// remembers the value in added if it is new. Ignores empty values.
+    QString acquire(const QString& value, Added& added);
+    /// removes an occurrence of the value. Remembers the row in unused if
+    /// it was the last one. Ignores empty values.
+    void release(const QString& value, std::vector<int>& unused);
+
+    /// inserts the new values collected by acquire
+    void insertValues(const Added& added);
+    /// removes the rows of unused values collected by release
+    void removeValues(std::vector<int>& unused);
 
 protected slots:
-    // rebuilds the valueToIndex-map
+    // rebuilds everything
     void buildMap();
+    void sourceAboutToBeReset();
+
+    void sourceRowsInserted(const QModelIndex& parent, int first, int last);
+    void sourceRowsRemoved(const QModelIndex& parent, int first, int last);
+    void sourceDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight);
 
 public:
     UniqueFilterProxyModel(QObject* parent = nullptr);
 
-    bool filterAcceptsRow(int sourceRow, const QModelIndex& sourceParent) const override;
-
     void setSourceModel(QAbstractItemModel* source) override;
 
+    QModelIndex mapFromSource(const QModelIndex& sourceIndex) const override;
+    QModelIndex mapToSource(const QModelIndex& proxyIndex) const override;
+
+    QModelIndex index(int row, int column, const QModelIndex& parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex& index) const override;
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    Qt::ItemFlags flags(const QModelIndex& index) const override;
 };
 
 
@@ -0,0 +1,156 @@
+#ifndef SEMPR_GUI_UPDATEBATCH_HPP_
+#define SEMPR_GUI_UPDATEBATCH_HPP_
+
+#include "AbstractInterface.hpp"
+
+#include <vector>
+#include <map>
+#include <utility>
+
+namespace sempr { namespace gui {
+
+/**
+    Collects notifications (ADDED/UPDATED/REMOVED) for some kind of data in the
+    order they arrived, and merges notifications that refer to the same item,
+    so that only the net change is left. E.g. an item that is added and
+    removed again within the same batch does not appear at all.
+
+    Data is the type of the item (ECData, sempr::Triple), Key something that
+    identifies the item and can be used in a std::map.
+
+    If removeAddIsUpdate is set, an item that is removed and added again is
+    reported as UPDATED (used for EC pairs, whose component may have changed
+    in between). Else the two notifications cancel each other out (used for
+    triples, which are identified by their whole content).
+
+    The complete merge table, previous + new notification:
+
+        ADDED   + ADDED/UPDATED -> ADDED, with the new data
+        ADDED   + REMOVED       -> nothing
+        UPDATED + ADDED/UPDATED -> UPDATED, with the new data
+        UPDATED + REMOVED       -> REMOVED
+        REMOVED + ADDED         -> UPDATED if removeAddIsUpdate, else nothing
+        REMOVED + UPDATED       -> REMOVED (the item does not exist anymore)
+        REMOVED + REMOVED       -> REMOVED
+*/
+template <class Data, class Key>
+class UpdateBatch {
+public:
+    typedef AbstractInterface::Notification Notification;
+    typedef std::pair<Data, Notification> Entry;
+
+private:
+    bool removeAddIsUpdate_;
+
+    // entries in the order of arrival. Cancelled entries are only marked as
+    // invalid to keep the indices in index_ valid.
+    std::vector<Entry> entries_;
+    std::vector<bool> valid_;
+    std::map<Key, size_t> index_;
+    size_t size_;
+
+public:
+    UpdateBatch(bool removeAddIsUpdate)
+        : removeAddIsUpdate_(removeAddIsUpdate), size_(0)
+    {
+    }
+
+    /**
+        Adds a notification to the batch, merging it with a previous one for
+        the same item.
+    */
+    void add(const Key& key, const Data& data, Notification action)
+    {
+        auto it = index_.find(key);
+        if (it == index_.end())
+        {
+            index_[key] = entries_.size();
+            entries_.push_back(Entry(data, action));
+            valid_.push_back(true);
+            size_++;
+            return;
+        }
+
+        Entry& previous = entries_[it->second];
+        bool cancel = false;
+
+        if (previous.second == AbstractInterface::ADDED)
+        {
+            // added and updated is still new, added and removed never was
+            if (action == AbstractInterface::REMOVED) cancel = true;
+            else previous.first = data;
+        }
+        else if (previous.second == AbstractInterface::UPDATED)
+        {
+            // the item existed before the batch
+            if (action == AbstractInterface::REMOVED) previous = Entry(data, action);
+            else previous.first = data;
+        }
+        else // REMOVED
+        {
+            // only adding it again brings it back, everything else refers to
+            // an item that does not exist anymore
+            if (action == AbstractInterface::ADDED)
+            {
+                if (removeAddIsUpdate_) previous = Entry(data, AbstractInterface::UPDATED);
+                else cancel = true;
+            }
+        }
+
+        if (cancel)
+        {
+            valid_[it->second] = false;
+            index_.erase(it);
+            size_--;
+        }
+    }
+
+    /**
+        The merged notification that is pending for the item, or nullptr if
+        there is none.
+    */
+    const Entry* find(const Key& key) const
+    {
+        auto it = index_.find(key);
+        if (it == index_.end()) return nullptr;
+        return &entries_[it->second];
+    }
+
+    /**
+        Number of notifications that would currently be sent
+    */
+    size_t size() const
+    {
+        return size_;
+    }
+
+    bool empty() const
+    {
+        return size_ == 0;
+    }
+
+    /**
+        Returns the merged notifications in the order of arrival and clears
+        the batch.
+    */
+    std::vector<Entry> take()
+    {
+        std::vector<Entry> result;
+        result.reserve(size_);
+        for (size_t i = 0; i < entries_.size(); i++)
+        {
+            if (valid_[i]) result.push_back(std::move(entries_[i]));
+        }
+
+        entries_.clear();
+        valid_.clear();
+        index_.clear();
+        size_ = 0;
+
+        return result;
+    }
+};
+
+}}
+
+#endif /* include guard: SEMPR_GUI_UPDATEBATCH_HPP_ */
@@ -0,0 +1,151 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "UpdateBatch.hpp"
+
+/*
+    Checks the merge table of the UpdateBatch: every pair of notifications
+    for the same item, with and without removeAddIsUpdate, a few longer
+    sequences, and the lookup of pending notifications.
+
+    usage: sempr-gui-update-batch-check
+    Returns 0 if all results match.
+*/
+
+using namespace sempr::gui;
+
+namespace {
+
+typedef AbstractInterface::Notification Notification;
+typedef UpdateBatch<std::string, int> Batch;
+
+const Notification A = AbstractInterface::ADDED;
+const Notification U = AbstractInterface::UPDATED;
+const Notification R = AbstractInterface::REMOVED;
+
+size_t failures = 0;
+
+std::string name(Notification n)
+{
+    return (n == A ? "ADDED" : (n == U ? "UPDATED" : "REMOVED"));
+}
+
+std::string name(const std::vector<Notification>& sequence)
+{
+    std::string result;
+    for (auto n : sequence) result += (result.empty() ? "" : " + ") + name(n);
+    return result;
+}
+
+/**
+    Adds the notifications for one item, with the data "0", "1", ..., and
+    checks the result. An empty expectation means that nothing is left.
+*/
+void check(bool removeAddIsUpdate, const std::vector<Notification>& sequence,
+           const std::vector<Batch::Entry>& expected)
+{
+    Batch batch(removeAddIsUpdate);
+    for (size_t i = 0; i < sequence.size(); i++)
+    {
+        batch.add(42, std::to_string(i), sequence[i]);
+    }
+
+    size_t size = batch.size();
+    auto result = batch.take();
+
+    bool ok = (size == expected.size() && result.size() == expected.size());
+    for (size_t i = 0; ok && i < result.size(); i++)
+    {
+        ok = (result[i].first == expected[i].first &&
+              result[i].second == expected[i].second);
+    }
+
+    if (!ok)
+    {
+        failures++;
+        std::cerr << "FAILED: " << name(sequence)
+                  << (removeAddIsUpdate ? " (removeAddIsUpdate)" : "") << " ->";
+        for (auto& entry : result)
+        {
+            std::cerr << " " << name(entry.second) << "(" << entry.first << ")";
+        }
+        std::cerr << std::endl;
+    }
+}
+
+}
+
+
+int main()
+{
+    for (bool flag : { false, true })
+    {
+        check(flag, { A, A }, { { "1", A } });
+        check(flag, { A, U }, { { "1", A } });
+        check(flag, { A, R }, {});
+        check(flag, { U, A }, { { "1", U } });
+        check(flag, { U, U }, { { "1", U } });
+        check(flag, { U, R }, { { "1", R } });
+        check(flag, { R, U }, { { "0", R } });
+        check(flag, { R, R }, { { "0", R } });
+
+        check(flag, { A, R, A }, { { "2", A } });
+        check(flag, { U, R, U }, { { "1", R } });
+        check(flag, { R, R, U }, { { "0", R } });
+    }
+
+    check(false, { R, A }, {});
+    check(true, { R, A }, { { "1", U } });
+
+    check(false, { R, A, R }, { { "2", R } });
+    check(true, { R, A, R }, { { "2", R } });
+    check(true, { R, A, U }, { { "2", U } });
+
+    // other items are not affected, and the order of arrival is kept
+    {
+        Batch batch(false);
+        batch.add(1, "a", A);
+        batch.add(2, "b", R);
+        batch.add(3, "c", U);
+        batch.add(1, "a", R);
+        batch.add(2, "b", A);
+        batch.add(4, "d", A);
+        auto result = batch.take();
+        if (result.size() != 2 || result[0].first != "c" || result[1].first != "d")
+        {
+            failures++;
+            std::cerr << "FAILED: several items" << std::endl;
+        }
+        if (!batch.empty())
+        {
+            failures++;
+            std::cerr << "FAILED: take does not clear the batch" << std::endl;
+        }
+    }
+
+    // find returns the merged notification
+    {
+        Batch batch(true);
+        batch.add(1, "a", A);
+        batch.add(1, "b", U);
+        batch.add(2, "c", A);
+        batch.add(2, "c", R);
+        auto found = batch.find(1);
+        if (!found || found->first != "b" || found->second != A ||
+            batch.find(2) || batch.find(3))
+        {
+            failures++;
+            std::cerr << "FAILED: find" << std::endl;
+        }
+    }
+
+    if (failures > 0)
+    {
+        std::cerr << failures << " checks failed" << std::endl;
+        return 1;
+    }
+
+    std::cout << "all checks passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,249 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "TCPConnectionClient.hpp"
+#include "TCPConnectionRequest.hpp"
+#include "ECDataZMQ.hpp"
+
+/*
+    Measures latency and throughput of triple updates from a publisher to a
+    TCPConnectionClient on the local machine. The publisher sends the
+    messages just like the TCPConnectionServer does, in batches of the given
+    size (1: every update in a message of its own). Every triple carries the
+    time it was sent, the client callback takes the time it was received.
+
+    With --polling, the updates are received by the loop the
+    TCPConnectionClient used before it blocked in a poller: One update and
+    one log message per iteration with non-blocking receives, and a sleep
+    of 10 ms whenever neither was available. It decodes the same messages,
+    so both modes can be compared on the current protocol.
+
+    usage: sempr-gui-update-publisher-benchmark [--polling] [numUpdates] [batchSize]
+*/
+
+using namespace sempr::gui;
+typedef std::chrono::steady_clock Clock;
+
+namespace {
+
+const std::string publishEndpoint = "tcp://127.0.0.1:4252";
+const std::string requestEndpoint = "tcp://127.0.0.1:4253";
+
+int64_t now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                Clock::now().time_since_epoch()).count();
+}
+
+void sendBatch(zmqpp::socket& publisher, size_t count, int64_t sequence)
+{
+    zmqpp::message msg;
+    msg << UpdateType::TripleBatch << static_cast<uint32_t>(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        sempr::Triple triple(std::to_string(now()),
+                             "<http://example.org/sequence>",
+                             std::to_string(sequence + static_cast<int64_t>(i)));
+        msg << triple << AbstractInterface::Notification::ADDED;
+    }
+
+    publisher.send("triples", zmqpp::socket_t::send_more);
+    publisher.send(msg);
+}
+
+/**
+    The old receiving loop of the TCPConnectionClient (see above), calls
+    onTriple for every triple until running is false.
+*/
+void pollingLoop(zmqpp::context& context, const std::atomic<bool>& running,
+                 const std::function<void(const sempr::Triple&)>& onTriple)
+{
+    zmqpp::socket updateSubscriber(context, zmqpp::socket_type::subscribe);
+    updateSubscriber.connect(publishEndpoint);
+    updateSubscriber.subscribe("triples");
+
+    zmqpp::socket loggingSubscriber(context, zmqpp::socket_type::subscribe);
+    loggingSubscriber.connect(publishEndpoint);
+    loggingSubscriber.subscribe("logging");
+
+    while (running)
+    {
+        zmqpp::message msg;
+        std::string topic;
+        bool msgAvailable = updateSubscriber.receive(topic, true);
+        if (msgAvailable)
+        {
+            updateSubscriber.receive(msg);
+
+            UpdateType type;
+            uint32_t count;
+            msg >> type >> count;
+            for (uint32_t i = 0; i < count; i++)
+            {
+                sempr::Triple triple;
+                AbstractInterface::Notification action;
+                msg >> triple >> action;
+                onTriple(triple);
+            }
+        }
+
+        bool logAvailable = loggingSubscriber.receive(topic, true);
+        if (logAvailable)
+        {
+            loggingSubscriber.receive(msg);
+        }
+
+        if (!(msgAvailable || logAvailable))
+        {
+            // only sleep if there is no message available
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+}
+
+}
+
+
+int main(int argc, char** args)
+{
+    bool polling = (argc > 1 && std::string(args[1]) == "--polling");
+    int first = (polling ? 2 : 1);
+
+    size_t numUpdates = 100000;
+    size_t batchSize = 1;
+    try {
+        if (argc > first) numUpdates = std::stoul(args[first]);
+        if (argc > first + 1) batchSize = std::max<size_t>(1, std::stoul(args[first + 1]));
+    } catch (std::exception&) {
+        std::cerr << "usage: " << args[0] << " [--polling] [numUpdates] [batchSize]"
+                  << std::endl;
+        return 1;
+    }
+
+    zmqpp::context context;
+    zmqpp::socket publisher(context, zmqpp::socket_type::publish);
+    zmqpp::socket replier(context, zmqpp::socket_type::reply);
+    publisher.bind(publishEndpoint);
+    replier.bind(requestEndpoint);
+
+    // the client only counts the warm-up updates (sequence < 0), and records
+    // the latency of all others.
+    std::mutex mutex;
+    std::vector<int64_t> latencies;
+    latencies.reserve(numUpdates);
+    std::atomic<size_t> received(0);
+    std::atomic<bool> subscribed(false);
+    int64_t lastReceived = 0;
+
+    auto onTriple = [&](const sempr::Triple& triple)
+    {
+        auto t = now();
+        auto sequence = std::stoll(triple.getField(sempr::Triple::Field::OBJECT));
+        if (sequence < 0)
+        {
+            subscribed = true;
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        latencies.push_back(t - std::stoll(triple.getField(sempr::Triple::Field::SUBJECT)));
+        lastReceived = t;
+        received++;
+    };
+
+    auto client = std::make_shared<TCPConnectionClient>();
+    std::atomic<bool> pollingRunning(true);
+    std::thread pollingThread;
+    if (polling)
+    {
+        pollingThread = std::thread(pollingLoop, std::ref(context),
+                                    std::cref(pollingRunning), onTriple);
+    }
+    else
+    {
+        // answer the format negotiation of the client
+        std::thread negotiation(
+            [&replier]()
+            {
+                zmqpp::message reqMsg, resMsg;
+                replier.receive(reqMsg);
+                TCPConnectionRequest request;
+                reqMsg >> request;
+
+                TCPConnectionResponse response;
+                response.success = true;
+                response.format = request.format;
+                resMsg << response;
+                replier.send(resMsg);
+            }
+        );
+
+        client->setTripleUpdateCallback(
+            [&onTriple](sempr::Triple triple, AbstractInterface::Notification)
+            {
+                onTriple(triple);
+            }
+        );
+        client->connect(publishEndpoint, requestEndpoint);
+        client->start();
+        negotiation.join();
+    }
+
+    // subscriptions are established asynchronously, send warm-up updates
+    // until the first one arrives.
+    while (!subscribed)
+    {
+        sendBatch(publisher, 1, -1);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    auto start = now();
+    for (size_t sent = 0; sent < numUpdates; sent += batchSize)
+    {
+        sendBatch(publisher, std::min(batchSize, numUpdates - sent), sent);
+    }
+
+    // wait for everything to arrive, or give up after a while, as pub/sub
+    // drops messages when the high water mark is reached.
+    auto deadline = Clock::now() + std::chrono::seconds(30);
+    while (received < numUpdates && Clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    client->stop();
+    pollingRunning = false;
+    if (pollingThread.joinable()) pollingThread.join();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (latencies.empty())
+    {
+        std::cerr << "no updates received" << std::endl;
+        return 1;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](double p)
+    {
+        size_t i = std::min(latencies.size() - 1,
+                            static_cast<size_t>(p * latencies.size()));
+        return latencies[i] / 1000.0;
+    };
+    double seconds = (lastReceived - start) / 1e9;
+
+    std::cout << std::fixed << std::setprecision(1)
+              << "received " << latencies.size() << " of " << numUpdates
+              << " updates in batches of " << batchSize
+              << (polling ? " (polling)" : "") << std::endl
+              << "throughput:  " << latencies.size() / seconds << " updates/s" << std::endl
+              << "latency p50: " << percentile(0.5) << " us" << std::endl
+              << "latency p99: " << percentile(0.99) << " us" << std::endl
+              << "latency max: " << latencies.back() / 1000.0 << " us" << std::endl;
+}
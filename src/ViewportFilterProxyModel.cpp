@@ -0,0 +1,627 @@
+#include "ViewportFilterProxyModel.hpp"
+#include "CustomDataRoles.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+#include <cmath>
+
+namespace sempr { namespace gui {
+
+ViewportFilterProxyModel::ViewportFilterProxyModel(
+        GeometryFilterProxyModel* source, QObject* parent)
+    : QAbstractProxyModel(parent), geometries_(source), idRowsDirty_(true),
+      rebuild_(true), hasViewport_(false), zoomLevel_(0), detailLevel_(0),
+      resetting_(false)
+{
+    updateTimer_.setSingleShot(true);
+    updateTimer_.setInterval(250);
+    connect(&updateTimer_, &QTimer::timeout,
+            this, &ViewportFilterProxyModel::update);
+
+    this->setSourceModel(source);
+
+    connect(source, &QAbstractItemModel::dataChanged,
+            this, &ViewportFilterProxyModel::onSourceDataChanged);
+    connect(source, &QAbstractItemModel::rowsInserted,
+            this, &ViewportFilterProxyModel::onSourceRowsInserted);
+    connect(source, &QAbstractItemModel::rowsAboutToBeRemoved,
+            this, &ViewportFilterProxyModel::onSourceRowsAboutToBeRemoved);
+    connect(source, &QAbstractItemModel::rowsRemoved,
+            this, &ViewportFilterProxyModel::onSourceRowsRemoved);
+
+    // everything else is handled by a reset
+    connect(source, &QAbstractItemModel::modelAboutToBeReset,
+            this, &ViewportFilterProxyModel::onSourceAboutToBeReset);
+    connect(source, &QAbstractItemModel::modelReset,
+            this, &ViewportFilterProxyModel::onSourceReset);
+    connect(source, &QAbstractItemModel::layoutAboutToBeChanged,
+            this, &ViewportFilterProxyModel::onSourceAboutToBeReset);
+    connect(source, &QAbstractItemModel::layoutChanged,
+            this, &ViewportFilterProxyModel::onSourceReset);
+    connect(source, &QAbstractItemModel::rowsAboutToBeMoved,
+            this, &ViewportFilterProxyModel::onSourceAboutToBeReset);
+    connect(source, &QAbstractItemModel::rowsMoved,
+            this, &ViewportFilterProxyModel::onSourceReset);
+
+    onSourceReset();
+}
+
+
+int ViewportFilterProxyModel::newId()
+{
+    if (!freeIds_.empty())
+    {
+        int id = freeIds_.back();
+        freeIds_.pop_back();
+        return id;
+    }
+
+    // the row is set when idRows_ is rebuilt
+    idRows_.push_back(-1);
+    return static_cast<int>(idRows_.size() - 1);
+}
+
+
+void ViewportFilterProxyModel::onSourceDataChanged(
+        const QModelIndex& tl, const QModelIndex& br, const QVector<int>& roles)
+{
+    if (tl.parent().isValid()) return;
+
+    for (int row = tl.row(); row <= br.row() && row < (int)rowIds_.size(); row++)
+    {
+        pending_.push_back(rowIds_[row]);
+    }
+
+    // the accepted rows in the range are adjacent proxy rows
+    auto begin = std::lower_bound(visible_.begin(), visible_.end(), tl.row());
+    auto end = std::upper_bound(begin, visible_.end(), br.row());
+    if (begin != end)
+    {
+        int proxyFirst = static_cast<int>(begin - visible_.begin());
+        int proxyLast = static_cast<int>(end - visible_.begin()) - 1;
+        emit dataChanged(this->index(proxyFirst, tl.column()),
+                         this->index(proxyLast, br.column()), roles);
+    }
+
+    if (!updateTimer_.isActive()) updateTimer_.start();
+}
+
+void ViewportFilterProxyModel::onSourceRowsInserted(
+        const QModelIndex& parent, int first, int last)
+{
+    if (parent.isValid()) return;
+    int count = last - first + 1;
+
+    // the accepted rows after them move down
+    auto position = std::lower_bound(visible_.begin(), visible_.end(), first);
+    for (auto it = position; it != visible_.end(); ++it) *it += count;
+
+    // new rows are shown until the next update
+    int proxyFirst = static_cast<int>(position - visible_.begin());
+    this->beginInsertRows(QModelIndex(), proxyFirst, proxyFirst + count - 1);
+    clusterSize_.insert(clusterSize_.begin() + first, count, 1);
+    visible_.insert(position, count, 0);
+    for (int i = 0; i < count; i++) visible_[proxyFirst + i] = first + i;
+    this->endInsertRows();
+
+    std::vector<int> ids;
+    for (int row = first; row <= last; row++) ids.push_back(newId());
+    rowIds_.insert(rowIds_.begin() + first, ids.begin(), ids.end());
+    pending_.insert(pending_.end(), ids.begin(), ids.end());
+    idRowsDirty_ = true;
+
+    if (!updateTimer_.isActive()) updateTimer_.start();
+}
+
+void ViewportFilterProxyModel::onSourceRowsAboutToBeRemoved(
+        const QModelIndex& parent, int first, int last)
+{
+    if (parent.isValid()) return;
+
+    // while the source still has the rows, remove the accepted ones
+    auto begin = std::lower_bound(visible_.begin(), visible_.end(), first);
+    auto end = std::upper_bound(begin, visible_.end(), last);
+    if (begin == end) return;
+
+    int proxyFirst = static_cast<int>(begin - visible_.begin());
+    int proxyLast = static_cast<int>(end - visible_.begin()) - 1;
+    this->beginRemoveRows(QModelIndex(), proxyFirst, proxyLast);
+    visible_.erase(begin, end);
+    this->endRemoveRows();
+}
+
+void ViewportFilterProxyModel::onSourceRowsRemoved(
+        const QModelIndex& parent, int first, int last)
+{
+    if (parent.isValid()) return;
+
+    // the accepted rows after them move up
+    int count = last - first + 1;
+    auto position = std::upper_bound(visible_.begin(), visible_.end(), last);
+    for (auto it = position; it != visible_.end(); ++it) *it -= count;
+
+    clusterSize_.erase(clusterSize_.begin() + first, clusterSize_.begin() + last + 1);
+
+    for (int row = first; row <= last; row++)
+    {
+        int id = rowIds_[row];
+        index_.remove(id);
+        idRows_[id] = -1;
+        freeIds_.push_back(id);
+    }
+    rowIds_.erase(rowIds_.begin() + first, rowIds_.begin() + last + 1);
+    idRowsDirty_ = true;
+
+    // clusters may have lost points
+    if (!updateTimer_.isActive()) updateTimer_.start();
+}
+
+void ViewportFilterProxyModel::onSourceAboutToBeReset()
+{
+    this->beginResetModel();
+    resetting_ = true;
+}
+
+void ViewportFilterProxyModel::onSourceReset()
+{
+    if (!resetting_) this->beginResetModel();
+    resetting_ = false;
+
+    // everything is shown until the next update
+    int numRows = sourceModel()->rowCount();
+    clusterSize_.assign(numRows, 1);
+    visible_.resize(numRows);
+
+    rowIds_.resize(numRows);
+    idRows_.resize(numRows);
+    for (int row = 0; row < numRows; row++)
+    {
+        visible_[row] = row;
+        rowIds_[row] = row;
+        idRows_[row] = row;
+    }
+    idRowsDirty_ = false;
+    freeIds_.clear();
+    pending_.clear();
+    rebuild_ = true;
+
+    this->endResetModel();
+
+    if (!updateTimer_.isActive()) updateTimer_.start();
+}
+
+
+void ViewportFilterProxyModel::flush()
+{
+    if (idRowsDirty_)
+    {
+        std::fill(idRows_.begin(), idRows_.end(), -1);
+        for (size_t row = 0; row < rowIds_.size(); row++)
+        {
+            idRows_[rowIds_[row]] = static_cast<int>(row);
+        }
+        idRowsDirty_ = false;
+    }
+
+    QRectF b;
+    if (rebuild_)
+    {
+        // bulk load, packs the index better than single insertions
+        std::vector<SpatialIndex::Entry> entries;
+        entries.reserve(rowIds_.size());
+        for (size_t row = 0; row < rowIds_.size(); row++)
+        {
+            if (geometries_->bounds(geometries_->index(row, 0), b))
+            {
+                entries.push_back({ { b.left(), b.top(), b.right(), b.bottom() }, rowIds_[row] });
+            }
+        }
+
+        index_.build(std::move(entries));
+        rebuild_ = false;
+    }
+    else
+    {
+        for (int id : pending_)
+        {
+            int row = idRows_[id];
+            if (row == -1) continue; // removed in the meantime
+
+            if (geometries_->bounds(geometries_->index(row, 0), b))
+            {
+                index_.insert(id, { b.left(), b.top(), b.right(), b.bottom() });
+            }
+            else
+            {
+                index_.remove(id);
+            }
+        }
+    }
+    pending_.clear();
+}
+
+
+int ViewportFilterProxyModel::detailLevelFor(double zoomLevel)
+{
+    // the size of a pixel in degrees (of longitude)
+    double pixel = 360. / (256. * std::pow(2., zoomLevel));
+
+    for (int level = GeometryFilterProxyModel::numDetailLevels-1; level > 0; level--)
+    {
+        if (GeometryFilterProxyModel::detailTolerance(level) <= pixel) return level;
+    }
+    return 0;
+}
+
+
+void ViewportFilterProxyModel::setViewport(
+        const QGeoCoordinate& topLeft,
+        const QGeoCoordinate& bottomRight,
+        double zoomLevel)
+{
+    hasViewport_ = topLeft.isValid() && bottomRight.isValid();
+    zoomLevel_ = zoomLevel;
+
+    if (hasViewport_)
+    {
+        viewport_.minX = topLeft.longitude();
+        viewport_.maxX = bottomRight.longitude();
+        viewport_.minY = bottomRight.latitude();
+        viewport_.maxY = topLeft.latitude();
+
+        // across the date line
+        if (viewport_.minX > viewport_.maxX)
+        {
+            viewport_.minX = -180;
+            viewport_.maxX = 180;
+        }
+
+        // a margin of half the size, so that small movements of the map do
+        // not make items pop up at the border
+        double marginX = 0.5 * (viewport_.maxX - viewport_.minX);
+        double marginY = 0.5 * (viewport_.maxY - viewport_.minY);
+        viewport_.minX -= marginX;
+        viewport_.maxX += marginX;
+        viewport_.minY -= marginY;
+        viewport_.maxY += marginY;
+    }
+
+    update();
+}
+
+
+void ViewportFilterProxyModel::setPinned(const QModelIndex& sourceIndex)
+{
+    QPersistentModelIndex previous = pinned_;
+    pinned_ = sourceIndex;
+
+    int row = pinned_.row();
+    if (pinned_.isValid() && row < (int)clusterSize_.size() && clusterSize_[row] == 0)
+    {
+        auto position = std::lower_bound(visible_.begin(), visible_.end(), row);
+        int proxyRow = static_cast<int>(position - visible_.begin());
+
+        this->beginInsertRows(QModelIndex(), proxyRow, proxyRow);
+        clusterSize_[row] = 1;
+        visible_.insert(position, row);
+        this->endInsertRows();
+    }
+
+    // the pinned row is shown in full detail
+    QVector<int> roles = { Role::DisplayCoordinatesRole, Role::DetailLevelRole };
+    for (auto& index : { QModelIndex(previous), QModelIndex(pinned_) })
+    {
+        auto proxyIndex = this->mapFromSource(index);
+        if (proxyIndex.isValid()) emit dataChanged(proxyIndex, proxyIndex, roles);
+    }
+}
+
+
+int ViewportFilterProxyModel::detailLevel(const QModelIndex& sourceIndex) const
+{
+    if (sourceIndex == pinned_) return 0;
+    return detailLevel_;
+}
+
+
+void ViewportFilterProxyModel::update()
+{
+    updateTimer_.stop();
+    flush();
+
+    int numRows = sourceModel()->rowCount();
+
+    // the rows to accept, in ascending order, with their cluster sizes
+    std::vector<std::pair<int, int>> next;
+    if (!hasViewport_)
+    {
+        next.reserve(numRows);
+        for (int row = 0; row < numRows; row++) next.push_back({ row, 1 });
+    }
+    else
+    {
+        std::vector<int> rows;
+        index_.query(viewport_, rows);
+        for (auto& id : rows) id = idRows_[id];
+        std::sort(rows.begin(), rows.end());
+
+        // Points that fall into the same cell of a grid of cellSize pixels
+        // (in web mercator) are represented by the first of them, i.e. the
+        // one with the lowest row, which does not change when the map is
+        // moved.
+        const double cellSize = 40;
+        const double pi = std::acos(-1.);
+        double worldSize = 256. * std::pow(2., zoomLevel_);
+        std::unordered_map<long long, size_t> cells;
+
+        for (int row : rows)
+        {
+            auto index = geometries_->index(row, 0);
+            if (index.data(Role::GeosGeometryTypeRole).toString() != "Point")
+            {
+                next.push_back({ row, 1 });
+                continue;
+            }
+
+            QRectF b;
+            geometries_->bounds(index, b);
+            double lat = std::max(-85.05, std::min(85.05, b.top())) * pi / 180.;
+            double x = (b.left() + 180.) / 360.;
+            double y = (1. - std::log(std::tan(lat) + 1. / std::cos(lat)) / pi) / 2.;
+
+            long long cellX = static_cast<long long>(x * worldSize / cellSize);
+            long long cellY = static_cast<long long>(y * worldSize / cellSize);
+            long long cell = (cellX << 32) | (cellY & 0xffffffff);
+
+            auto it = cells.find(cell);
+            if (it == cells.end())
+            {
+                cells[cell] = next.size();
+                next.push_back({ row, 1 });
+            }
+            else
+            {
+                next[it->second].second++;
+            }
+        }
+    }
+
+    int pinnedRow = pinned_.isValid() ? pinned_.row() : -1;
+    if (pinnedRow != -1 && pinnedRow < numRows)
+    {
+        auto it = std::lower_bound(next.begin(), next.end(), std::make_pair(pinnedRow, 0));
+        if (it == next.end() || it->first != pinnedRow) next.insert(it, { pinnedRow, 1 });
+    }
+
+    int newDetailLevel = hasViewport_ ? detailLevelFor(zoomLevel_) : 0;
+    bool levelChanged = (newDetailLevel != detailLevel_);
+    detailLevel_ = newDetailLevel;
+
+    // Remove the rows that are not accepted anymore, every run of adjacent
+    // proxy rows at once. From the back, so that the proxy rows of the runs
+    // before stay the same.
+    std::vector<bool> kept(visible_.size(), false);
+    for (size_t i = 0, j = 0; i < visible_.size(); i++)
+    {
+        while (j < next.size() && next[j].first < visible_[i]) j++;
+        kept[i] = (j < next.size() && next[j].first == visible_[i]);
+    }
+
+    for (int last = static_cast<int>(visible_.size()) - 1; last >= 0;)
+    {
+        if (kept[last])
+        {
+            last--;
+            continue;
+        }
+
+        int first = last;
+        while (first > 0 && !kept[first - 1]) first--;
+
+        this->beginRemoveRows(QModelIndex(), first, last);
+        for (int i = first; i <= last; i++) clusterSize_[visible_[i]] = 0;
+        visible_.erase(visible_.begin() + first, visible_.begin() + last + 1);
+        this->endRemoveRows();
+
+        last = first - 1;
+    }
+
+    // Now visible_ is a subset of next. Insert the runs of new rows between
+    // its rows, and find the kept rows whose data changed.
+    std::vector<int> changed;
+    size_t position = 0;
+    for (size_t j = 0; j < next.size();)
+    {
+        int row = next[j].first;
+        if (position < visible_.size() && visible_[position] == row)
+        {
+            if (clusterSize_[row] != next[j].second || (levelChanged && row != pinnedRow))
+            {
+                clusterSize_[row] = next[j].second;
+                changed.push_back(static_cast<int>(position));
+            }
+            position++;
+            j++;
+            continue;
+        }
+
+        size_t end = j;
+        while (end < next.size() &&
+               (position == visible_.size() || next[end].first < visible_[position]))
+        {
+            end++;
+        }
+
+        int first = static_cast<int>(position);
+        int count = static_cast<int>(end - j);
+        this->beginInsertRows(QModelIndex(), first, first + count - 1);
+        visible_.insert(visible_.begin() + position, count, 0);
+        for (int i = 0; i < count; i++)
+        {
+            visible_[first + i] = next[j + i].first;
+            clusterSize_[next[j + i].first] = next[j + i].second;
+        }
+        this->endInsertRows();
+
+        position += count;
+        j = end;
+    }
+
+    // one signal for every run of adjacent changed rows
+    QVector<int> roles = { Role::ClusterSizeRole };
+    if (levelChanged) roles << Role::DisplayCoordinatesRole << Role::DetailLevelRole;
+
+    size_t runStart = 0;
+    for (size_t i = 1; i <= changed.size(); i++)
+    {
+        if (i == changed.size() || changed[i] != changed[i-1] + 1)
+        {
+            emit dataChanged(this->index(changed[runStart], 0),
+                             this->index(changed[i-1], 0), roles);
+            runStart = i;
+        }
+    }
+}
+
+
+QModelIndex ViewportFilterProxyModel::mapFromSource(const QModelIndex& sourceIndex) const
+{
+    if (!sourceIndex.isValid() || sourceIndex.parent().isValid()) return QModelIndex();
+
+    auto it = std::lower_bound(visible_.begin(), visible_.end(), sourceIndex.row());
+    if (it == visible_.end() || *it != sourceIndex.row()) return QModelIndex();
+    return this->index(static_cast<int>(it - visible_.begin()), sourceIndex.column());
+}
+
+
+QModelIndex ViewportFilterProxyModel::mapToSource(const QModelIndex& proxyIndex) const
+{
+    if (!proxyIndex.isValid() || !sourceModel() ||
+        proxyIndex.row() >= (int)visible_.size()) return QModelIndex();
+
+    return sourceModel()->index(visible_[proxyIndex.row()], proxyIndex.column());
+}
+
+
+QModelIndex ViewportFilterProxyModel::index(int row, int column, const QModelIndex& parent) const
+{
+    if (parent.isValid() || row < 0 || row >= rowCount() ||
+        column < 0 || column >= columnCount()) return QModelIndex();
+    return createIndex(row, column);
+}
+
+
+QModelIndex ViewportFilterProxyModel::parent(const QModelIndex& /*index*/) const
+{
+    return QModelIndex();
+}
+
+
+int ViewportFilterProxyModel::rowCount(const QModelIndex& parent) const
+{
+    if (parent.isValid()) return 0;
+    return static_cast<int>(visible_.size());
+}
+
+
+int ViewportFilterProxyModel::columnCount(const QModelIndex& parent) const
+{
+    if (parent.isValid() || !sourceModel()) return 0;
+    return sourceModel()->columnCount();
+}
+
+
+QVariant ViewportFilterProxyModel::data(const QModelIndex& index, int role) const
+{
+    if (role == Role::DisplayCoordinatesRole)
+    {
+        auto sourceIndex = this->mapToSource(index);
+        return geometries_->coordinates(sourceIndex, detailLevel(sourceIndex));
+    }
+    else if (role == Role::DetailLevelRole)
+    {
+        return detailLevel(this->mapToSource(index));
+    }
+    else if (role == Role::ClusterSizeRole)
+    {
+        int row = this->mapToSource(index).row();
+        if (row < 0 || row >= (int)clusterSize_.size()) return 1;
+        return clusterSize_[row];
+    }
+
+    return QAbstractProxyModel::data(index, role);
+}
+
+
+QHash<int, QByteArray> ViewportFilterProxyModel::roleNames() const
+{
+    auto names = sourceModel() ? sourceModel()->roleNames()
+                               : QAbstractProxyModel::roleNames();
+    names[Role::DisplayCoordinatesRole] = "displayCoordinates";
+    names[Role::DetailLevelRole] = "detailLevel";
+    names[Role::ClusterSizeRole] = "clusterSize";
+    return names;
+}
+
+
+QGeoRectangle ViewportFilterProxyModel::geometryBounds()
+{
+    flush();
+
+    SpatialIndex::Box box;
+    if (!index_.bounds(box)) return QGeoRectangle();
+
+    return QGeoRectangle(QGeoCoordinate(box.maxY, box.minX),
+                         QGeoCoordinate(box.minY, box.maxX));
+}
+
+
+QModelIndexList ViewportFilterProxyModel::sourceIndices(const std::vector<int>& ids)
+{
+    QModelIndexList indices;
+    for (int id : ids)
+    {
+        indices.append(geometries_->index(idRows_[id], 0));
+    }
+    return indices;
+}
+
+
+QModelIndexList ViewportFilterProxyModel::geometriesIn(const QGeoRectangle& rectangle)
+{
+    if (!rectangle.isValid()) return QModelIndexList();
+    flush();
+
+    auto tl = rectangle.topLeft();
+    auto br = rectangle.bottomRight();
+
+    std::vector<int> ids;
+    if (tl.longitude() <= br.longitude())
+    {
+        index_.query({ tl.longitude(), br.latitude(), br.longitude(), tl.latitude() }, ids);
+    }
+    else
+    {
+        // across the date line
+        index_.query({ tl.longitude(), br.latitude(), 180, tl.latitude() }, ids);
+        index_.query({ -180, br.latitude(), br.longitude(), tl.latitude() }, ids);
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    }
+
+    return sourceIndices(ids);
+}
+
+
+QModelIndex ViewportFilterProxyModel::nearestGeometry(const QGeoCoordinate& coordinate)
+{
+    if (!coordinate.isValid()) return QModelIndex();
+    flush();
+
+    auto ids = index_.nearest(coordinate.longitude(), coordinate.latitude());
+    if (ids.empty()) return QModelIndex();
+
+    return sourceIndices(ids).first();
+}
+
+}}
@@ -0,0 +1,162 @@
+#ifndef SEMPR_GUI_VIEWPORTFILTERPROXYMODEL_HPP_
+#define SEMPR_GUI_VIEWPORTFILTERPROXYMODEL_HPP_
+
+#include <QAbstractProxyModel>
+#include <QPersistentModelIndex>
+#include <QGeoCoordinate>
+#include <QGeoRectangle>
+#include <QTimer>
+
+#include "GeometryFilterProxyModel.hpp"
+#include "SpatialIndex.hpp"
+
+#include <vector>
+
+namespace sempr { namespace gui {
+
+/**
+    Filters the geometries of a GeometryFilterProxyModel down to those that
+    intersect the visible section of the map, so that the map only needs to
+    instantiate delegates for them.
+
+    The bounding boxes of the geometries are kept in a SpatialIndex, which
+    is updated incrementally for the rows that were added, changed or removed
+    in the source (at most every few hundred milliseconds). Geometries added
+    in the meantime are shown until then. The index can also be used to find
+    geometries in a rectangle, or the one nearest to a coordinate.
+
+    Additionally, this model...
+        - chooses a level of detail for the zoom level, and provides the
+          coordinates simplified to it in the "displayCoordinates" role
+        - clusters points that would be drawn close to each other: Only one
+          of them is accepted, and "clusterSize" tells how many points it
+          represents
+        - always accepts the pinned row (the current item), and shows it in
+          full detail so that it can be edited
+
+    The accepted source rows are kept in order, and every update of the
+    viewport is compared with them: Only the rows that are hidden or shown
+    are removed or inserted (a run of adjacent rows at once), and only the
+    rows whose cluster size or level of detail changed are signalled as
+    changed. So moving the map costs O(log n + k) for k visible geometries,
+    not O(n) as filtering all rows would.
+*/
+class ViewportFilterProxyModel : public QAbstractProxyModel {
+    Q_OBJECT
+
+    GeometryFilterProxyModel* geometries_;
+
+    // The spatial index over the source rows. The rows of the entries change
+    // when rows are inserted or removed before them, so the index uses
+    // stable ids, and the source rows are mapped to them.
+    SpatialIndex index_;
+    std::vector<int> rowIds_;  // source row -> id
+    std::vector<int> idRows_;  // id -> source row, -1 if unused
+    bool idRowsDirty_;
+    std::vector<int> freeIds_;
+
+    // ids whose bounds need to be (re)indexed, or all of them
+    std::vector<int> pending_;
+    bool rebuild_;
+
+    // the section of the map to show
+    bool hasViewport_;
+    SpatialIndex::Box viewport_;
+    double zoomLevel_;
+    int detailLevel_;
+
+    // per source row: 0 = not accepted, else the number of points it stands
+    // for (1 for everything but a cluster)
+    std::vector<int> clusterSize_;
+
+    // the accepted source rows, in ascending order: proxy row -> source row
+    std::vector<int> visible_;
+
+    // a reset of the source has begun, see onSourceAboutToBeReset
+    bool resetting_;
+
+    QPersistentModelIndex pinned_;
+
+    // delays the update after changes in the source
+    QTimer updateTimer_;
+
+    // the level of detail for a zoom level
+    static int detailLevelFor(double zoomLevel);
+
+    // the level of detail of a source row
+    int detailLevel(const QModelIndex& sourceIndex) const;
+
+    // a new id for a row
+    int newId();
+
+    // brings the index and idRows_ up to date
+    void flush();
+
+    // the source indices of the given ids
+    QModelIndexList sourceIndices(const std::vector<int>& ids);
+
+private slots:
+    // keep clusterSize_, visible_ and the ids aligned with the source rows,
+    // and pass the changes on. Everything else is handled as a reset.
+    void onSourceDataChanged(const QModelIndex& tl, const QModelIndex& br,
+                             const QVector<int>& roles);
+    void onSourceRowsInserted(const QModelIndex& parent, int first, int last);
+    void onSourceRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last);
+    void onSourceRowsRemoved(const QModelIndex& parent, int first, int last);
+    void onSourceAboutToBeReset();
+    void onSourceReset();
+
+    // queries the R-tree and shows / hides the rows that changed
+    void update();
+
+public:
+    ViewportFilterProxyModel(GeometryFilterProxyModel* source, QObject* parent = nullptr);
+
+    QModelIndex mapFromSource(const QModelIndex& sourceIndex) const override;
+    QModelIndex mapToSource(const QModelIndex& proxyIndex) const override;
+
+    QModelIndex index(int row, int column,
+                      const QModelIndex& parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex& index) const override;
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+
+    QHash<int, QByteArray> roleNames() const override;
+    QVariant data(const QModelIndex& index, int role) const override;
+
+    /**
+        The bounding box of all geometries, invalid if there are none.
+    */
+    QGeoRectangle geometryBounds();
+
+    /**
+        Returns the indices (of the source model) of all geometries whose
+        bounding box intersects the given rectangle, in O(log n + k).
+    */
+    QModelIndexList geometriesIn(const QGeoRectangle& rectangle);
+
+    /**
+        Returns the index (of the source model) of the geometry whose
+        bounding box is nearest to the coordinate, or an invalid index if
+        there are no geometries.
+    */
+    QModelIndex nearestGeometry(const QGeoCoordinate& coordinate);
+
+public slots:
+    /**
+        Sets the visible section of the map. Invalid corners show everything.
+    */
+    void setViewport(const QGeoCoordinate& topLeft,
+                     const QGeoCoordinate& bottomRight,
+                     double zoomLevel);
+
+    /**
+        Sets the index (of the source model) to accept in any case, in full
+        detail.
+    */
+    void setPinned(const QModelIndex& sourceIndex);
+};
+
+}}
+
+#endif /* include guard: SEMPR_GUI_VIEWPORTFILTERPROXYMODEL_HPP_ */
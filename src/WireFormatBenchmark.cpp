@@ -0,0 +1,131 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+
+#include "TCPConnectionRequest.hpp"
+
+/*
+    Measures the time to encode/decode a TCPConnectionResponse and the number
+    of bytes it occupies on the wire, for both wire formats. The response
+    contains a listing of EC pairs and triples, similar to what a chunk of
+    LIST_EC_PAIRS_CHUNK / LIST_TRIPLES_CHUNK contains.
+
+    usage: sempr-gui-wire-format-benchmark [numEntries] [repetitions]
+*/
+
+using namespace sempr::gui;
+
+namespace {
+
+TCPConnectionResponse createResponse(size_t numEntries)
+{
+    TCPConnectionResponse response;
+    response.success = true;
+    response.cursor = 42;
+
+    for (size_t i = 0; i < numEntries; i++)
+    {
+        auto n = std::to_string(i);
+
+        ECData data;
+        data.entityId = "Entity_" + n;
+        data.componentId = "Component_" + n;
+        data.tag = (i % 3 == 0 ? "" : "tag_" + n);
+        data.isComponentMutable = (i % 2 == 0);
+        data.setComponentJSON(
+            "{\"value0\": {\"polymorphic_id\": 2147483649, "
+            "\"polymorphic_name\": \"sempr::TextComponent\", "
+            "\"ptr_wrapper\": {\"valid\": 1, \"data\": {\"value0\": {\"id\": " +
+            n + "}, \"text\": \"some text of component " + n + "\"}}}}");
+        response.data.push_back(data);
+
+        response.triples.push_back(
+            sempr::Triple("<http://example.org/subject_" + n + ">",
+                          "<http://example.org/predicate_" + std::to_string(i % 10) + ">",
+                          "\"object " + n + "\"^^<http://www.w3.org/2001/XMLSchema#string>"));
+    }
+
+    return response;
+}
+
+size_t bytesOnWire(const zmqpp::message& msg)
+{
+    size_t bytes = 0;
+    for (size_t i = 0; i < msg.parts(); i++)
+    {
+        bytes += msg.size(i);
+    }
+    return bytes;
+}
+
+void run(const TCPConnectionResponse& prototype, WireFormat format,
+         const std::string& name, int repetitions)
+{
+    TCPConnectionResponse response = prototype;
+    response.format = format;
+
+    std::chrono::nanoseconds encodeTime(0), decodeTime(0);
+    size_t bytes = 0;
+
+    for (int i = 0; i < repetitions; i++)
+    {
+        zmqpp::message msg;
+
+        auto t0 = std::chrono::steady_clock::now();
+        msg << response;
+        auto t1 = std::chrono::steady_clock::now();
+
+        bytes = bytesOnWire(msg);
+
+        TCPConnectionResponse decoded;
+        auto t2 = std::chrono::steady_clock::now();
+        msg >> decoded;
+        auto t3 = std::chrono::steady_clock::now();
+
+        if (decoded.data.size() != response.data.size() ||
+            decoded.triples.size() != response.triples.size())
+        {
+            std::cerr << name << ": decoded response differs" << std::endl;
+        }
+
+        encodeTime += t1 - t0;
+        decodeTime += t3 - t2;
+    }
+
+    auto ms = [repetitions](std::chrono::nanoseconds d)
+    {
+        return std::chrono::duration<double, std::milli>(d).count() / repetitions;
+    };
+
+    std::cout << std::left << std::setw(16) << name
+              << std::right << std::setw(12) << bytes << " bytes"
+              << std::setw(12) << std::fixed << std::setprecision(3)
+              << ms(encodeTime) << " ms encode"
+              << std::setw(12) << ms(decodeTime) << " ms decode"
+              << std::endl;
+}
+
+}
+
+
+int main(int argc, char** args)
+{
+    size_t numEntries = 1000;
+    int repetitions = 20;
+    try {
+        if (argc > 1) numEntries = std::stoul(args[1]);
+        if (argc > 2) repetitions = std::stoi(args[2]);
+    } catch (std::exception&) {
+        std::cerr << "usage: " << args[0] << " [numEntries] [repetitions]" << std::endl;
+        return 1;
+    }
+    if (repetitions < 1) repetitions = 1;
+
+    std::cout << numEntries << " EC pairs and triples, mean of "
+              << repetitions << " runs" << std::endl;
+
+    auto response = createResponse(numEntries);
+    run(response, WireFormat::JSON, "json", repetitions);
+    run(response, WireFormat::PortableBinary, "portable binary", repetitions);
+}
@@ -24,10 +24,12 @@ MapItemGroup {
         }
     }
 
-    // create the handle that allows us to modify the existing coordinate
+    // create the handle that allows us to modify the existing coordinate.
+    // Only when the geometry is shown in full detail, else there are too many
+    // of them, and editing a simplified geometry would drop coordinates.
     Instantiator {
         id: coordInstantiator
-        model: item.coordinates
+        model: (item.detailLevel === 0 ? item.coordinates : [])
         delegate: MapCircle {
             center: modelData
             radius: sliderVertexSize.value
@@ -129,7 +131,7 @@ MapItemGroup {
     // also, create handles in-between that allow us to add more coordinates
     Instantiator {
         id: coordAddingInstantiator
-        model: item.coordinates
+        model: (item.detailLevel === 0 ? item.coordinates : [])
         delegate: Loader {
             // need to explicitely define the variables that shall be passed on to the
             // loaded component.
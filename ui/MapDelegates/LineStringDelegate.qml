@@ -7,7 +7,8 @@ CoordinateDelegate {
 
     MapPolyline {
         id: lineString
-        path: model.coordinates
+        // simplified for the current zoom level
+        path: model.displayCoordinates
         line.color: (isCurrentItem ? "#60808000" : "#60008000") // semi-transparent color
         line.width: 3
 
@@ -16,7 +17,9 @@ CoordinateDelegate {
             property var lastPath: null
             anchors.fill: parent
             drag.target: parent
-            drag.axis: (model.isMutable && boxAllowEditing.checked ? Drag.XAndYAxis : Drag.None)
+            // the path may be simplified, only the original can be moved
+            drag.axis: (model.isMutable && boxAllowEditing.checked && model.detailLevel === 0 ?
+                            Drag.XAndYAxis : Drag.None)
             drag.smoothed: false
 
             onClicked: geoWidget.geometryDelegateClicked(coordDelegate.geometryIndex)
@@ -64,12 +64,13 @@ CoordinateDelegate {
 
         coordinate: marker.coordinate
 
-        visible: map.zoomLevel >= map.maximumZoomLevel-2
+        // always show the number of points of a cluster
+        visible: map.zoomLevel >= map.maximumZoomLevel-2 || model.clusterSize > 1
 
         sourceItem: Text {
             id: text
             anchors.fill: parent
-            text: model.entityId
+            text: (model.clusterSize > 1 ? model.clusterSize + " points" : model.entityId)
             horizontalAlignment: Text.AlignHCenter
             verticalAlignment: Text.AlignVCenter
         }
@@ -17,9 +17,13 @@ Item {
     // The plugin definition we want to use for the map.
     // "osm" is OpenStreetMap, which is the only one you don't need any other
     // parameters for.
+    // The tiles are provided by the TileServer of the GeoMapWidget, which
+    // serves local, cached and downloaded tiles as a custom host.
     Plugin {
         id: mapPlugin
         name: "osm"
+        PluginParameter { name: "osm.mapping.custom.host"; value: tileServerUrl }
+        PluginParameter { name: "osm.mapping.providersrepository.disabled"; value: true }
     }
 
     // focus on the currently selected item
@@ -28,32 +32,16 @@ Item {
         onCurrentRowChanged: {
             if (boxAutoFocusOnSelectedItem.checked)
             {
-                // first, hide all items that are not the selected on
-                for (var c in map.children)
+                // ask for the bounds of the item instead of fitting the view to the visible
+                // map items, which would need to hide all the other ones first.
+                var region = GeoMapWidget.geometryBoundsAt(currentProxyIndex.row)
+                if (region.isValid)
                 {
-                    var child = map.children[c]
-                    if ("isCurrentItem" in child)
-                    {
-                        // i wanted to use child.isCurrentItem, but this leads to a race condition
-                        // as this property is only set in onCurrentRowChanged of the
-                        // CoordinateDelegate. Hence this reimplemenation/redundancy.
-                        child.visible = (currentProxyIndex.row === child.geometryIndex)
-                    }
-                }
-
-                // then fit to visible items
-                map.fitViewportToVisibleMapItems()
-
-                // and show all items again
-                for (c in map.children)
-                {
-                    var child = map.children[c]
-                    child.visible = true
+                    if (region.width > 0 || region.height > 0)
+                        map.visibleRegion = region
+                    else
+                        map.center = region.center // a point
                 }
-
-                // newer versions of Qt5 have methods to fit the viewport to
-                // a list of items, but I'm stuck to an older version that can only
-                // adjust to "all items" or "all visible items".
             }
         }
     }
@@ -70,8 +58,17 @@ Item {
         center: QtPositioning.coordinate(52.283, 8.050)
         zoomLevel: 14
 
+        // the custom host is the last of the map types of the osm plugin
+        function useTileServer() {
+            if (supportedMapTypes.length > 0)
+                activeMapType = supportedMapTypes[supportedMapTypes.length - 1]
+        }
+        Component.onCompleted: useTileServer()
+        onSupportedMapTypesChanged: useTileServer()
+
         // since MapItemView does not work with MapItemGroups, an Instantiator is used as
-        // a workaround
+        // a workaround. geometryModel only contains the items in (and around) the visible
+        // section of the map, see ViewportFilterProxyModel.
 
         Instantiator {
             model: geometryModel
@@ -98,6 +95,46 @@ Item {
         }
     } // map
 
+    // a tool to select all geometries in a rectangle that is drawn with the mouse.
+    // The geometries are found through the spatial index on the c++ side, not only
+    // the ones that are instantiated in the map.
+    MouseArea {
+        id: selectionArea
+        anchors.fill: map
+        enabled: boxSelectInRectangle.checked
+        property point start
+
+        onPressed: {
+            start = Qt.point(mouse.x, mouse.y)
+            selectionRectangle.x = mouse.x
+            selectionRectangle.y = mouse.y
+            selectionRectangle.width = 0
+            selectionRectangle.height = 0
+            selectionRectangle.visible = true
+        }
+        onPositionChanged: {
+            selectionRectangle.x = Math.min(start.x, mouse.x)
+            selectionRectangle.y = Math.min(start.y, mouse.y)
+            selectionRectangle.width = Math.abs(mouse.x - start.x)
+            selectionRectangle.height = Math.abs(mouse.y - start.y)
+        }
+        onReleased: {
+            selectionRectangle.visible = false
+            var topLeft = map.toCoordinate(Qt.point(selectionRectangle.x, selectionRectangle.y))
+            var bottomRight = map.toCoordinate(
+                        Qt.point(selectionRectangle.x + selectionRectangle.width,
+                                 selectionRectangle.y + selectionRectangle.height))
+            GeoMapWidget.selectGeometriesIn(QtPositioning.rectangle(topLeft, bottomRight))
+        }
+    }
+
+    Rectangle {
+        id: selectionRectangle
+        visible: false
+        color: "#300000ff"
+        border.color: "blue"
+    }
+
     // some controls, overlaying the map, in a column layout:
     Item {
         width: 200
@@ -136,10 +173,12 @@ Item {
                     implicitWidth: controlsContainer.width - 20
 
                     onClicked: {
-                        map.fitViewportToVisibleMapItems()
-                        if (!map.visibleChildren)
+                        // not all items are instantiated, so ask for the bounds of all
+                        // geometries instead of fitting to the visible map items
+                        var region = GeoMapWidget.geometryBounds()
+                        if (region.isValid)
                         {
-                            text: "nothing to display"
+                            map.visibleRegion = region
                         }
                     }
                 }
@@ -162,6 +201,16 @@ Item {
                     height: 50
                 }
 
+                // a checkbox to draw a rectangle on the map instead of moving it, selecting
+                // all geometries within
+                CheckBox {
+                    id: boxSelectInRectangle
+                    text: "select in rectangle"
+                    font.pointSize: 10
+                    checked: false
+                    height: 50
+                }
+
                 // a checkbox to enable/disable focussing the selected object
                 CheckBox {
                     id: boxAutoFocusOnSelectedItem